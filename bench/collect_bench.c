@@ -0,0 +1,129 @@
+/**
+ * @brief  Measure prefix searches with parallel collection of large subtrees, for several numbers of threads.
+ *         Keys are random words of lower case letters. Two sets of prefixes are searched:
+ *           - one letter, each matching about 1/26 of the keys, collected in parallel,
+ *           - five letters, each matching a handful of keys, below the threshold.
+ *         Every answer is checked against the one found without parallel collection, in order.
+ *
+ *         Usage: collect_bench [keyNum] [nodeThreshold] [maxThreadNum]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <assert.h>
+
+#include "radix_tree_dictionary.h"
+
+#define DEFAULT_KEY_NUM 1000000
+#define DEFAULT_NODE_THRESHOLD 4096
+#define DEFAULT_MAX_THREAD_NUM 8
+
+#define MIN_KEY_LEN 6
+#define MAX_KEY_LEN 16
+#define ALPHABET_SIZE 26
+
+#define LARGE_PREFIX_LEN 1
+#define LARGE_QUERY_NUM 52
+#define SMALL_PREFIX_LEN 5
+#define SMALL_QUERY_NUM 200000
+
+
+static double secondsSince(struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+
+static char* randomWord(int minLen, int maxLen) {
+    int len = minLen + rand() % (maxLen - minLen + 1);
+    char* word = (char*) malloc(len + 1);
+    assert(word);
+    for (int j = 0; j < len; j++) {
+        word[j] = 'a' + rand() % ALPHABET_SIZE;
+    }
+    word[len] = '\0';
+    return word;
+}
+
+
+// Search the prefixes, and fold the records found into a hash that depends on their order.
+static uint64_t searchAll(RDictionary* rDict, char** prefixes, int prefixNum, double* seconds) {
+    uint64_t hash = 0;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int q = 0; q < prefixNum; q++) {
+        int matchedKeyNum, matchedRecordNum, comparedStr, comparedChar, comparedBit;
+        MatchedData** matched = prefixMatching(rDict, prefixes[q], &matchedKeyNum, &matchedRecordNum,
+                                               &comparedStr, &comparedChar, &comparedBit, NULL);
+        for (int i = 0; i < matchedKeyNum; i++) {
+            hash = hash * 31 + (uintptr_t) matched[i]->list[0];
+            free(matched[i]);
+        }
+        free(matched);
+    }
+    *seconds = secondsSince(&start);
+    return hash;
+}
+
+
+static void keepRecord(void* data) {
+}
+
+
+int main(int argc, char* argv[]) {
+    srand(1);
+    int keyNum = argc > 1 ? atoi(argv[1]) : DEFAULT_KEY_NUM;
+    size_t nodeThreshold = argc > 2 ? (size_t) atol(argv[2]) : DEFAULT_NODE_THRESHOLD;
+    int maxThreadNum = argc > 3 ? atoi(argv[3]) : DEFAULT_MAX_THREAD_NUM;
+    assert(keyNum > 0 && maxThreadNum > 0);
+
+    RDictionary* rDict = createRDict();
+    for (int i = 0; i < keyNum; i++) {
+        char* key = randomWord(MIN_KEY_LEN, MAX_KEY_LEN);
+        rDictInsert(rDict, key, (void*) (uintptr_t) (i + 1), NULL);
+        free(key);
+    }
+    char* largePrefixes[LARGE_QUERY_NUM];
+    for (int q = 0; q < LARGE_QUERY_NUM; q++) {
+        largePrefixes[q] = randomWord(LARGE_PREFIX_LEN, LARGE_PREFIX_LEN);
+    }
+    char** smallPrefixes = (char**) malloc(SMALL_QUERY_NUM * sizeof(char*));
+    assert(smallPrefixes);
+    for (int q = 0; q < SMALL_QUERY_NUM; q++) {
+        smallPrefixes[q] = randomWord(SMALL_PREFIX_LEN, SMALL_PREFIX_LEN);
+    }
+    printf("%d keys, parallel above %zu nodes\n", keyNum, nodeThreshold);
+
+    uint64_t largeHash = 0, smallHash = 0;
+    double largeBase = 0, smallBase = 0;
+    for (int threadNum = 1; threadNum <= maxThreadNum; threadNum *= 2) {
+        rDictEnableParallelCollect(rDict, threadNum, nodeThreshold);
+        double largeSec, smallSec;
+        uint64_t large = searchAll(rDict, largePrefixes, LARGE_QUERY_NUM, &largeSec);
+        uint64_t small = searchAll(rDict, smallPrefixes, SMALL_QUERY_NUM, &smallSec);
+        if (threadNum == 1) {
+            largeHash = large;
+            smallHash = small;
+            largeBase = largeSec;
+            smallBase = smallSec;
+        }
+        printf("%2d threads   1-letter prefix %9.1f us/query  x%.2f   5-letter prefix %7.1f ns/query  x%.2f%s\n",
+               threadNum, largeSec * 1e6 / LARGE_QUERY_NUM, largeBase / largeSec,
+               smallSec * 1e9 / SMALL_QUERY_NUM, smallBase / smallSec,
+               large == largeHash && small == smallHash ? "" : "   MISMATCH");
+    }
+
+    freeRDict(rDict, keepRecord);
+    for (int q = 0; q < LARGE_QUERY_NUM; q++) {
+        free(largePrefixes[q]);
+    }
+    for (int q = 0; q < SMALL_QUERY_NUM; q++) {
+        free(smallPrefixes[q]);
+    }
+    free(smallPrefixes);
+    return 0;
+}
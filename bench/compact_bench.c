@@ -0,0 +1,153 @@
+/**
+ * @brief  Measure the searches of a radix tree dictionary before and after rDictCompact.
+ *         Random keys are inserted in random order, so the nodes of a path sit at unrelated heap
+ *         addresses. With the default number of keys the tree is a few hundred MB, far larger
+ *         than the last level cache, and most steps of a search miss it.
+ *         The same searches are timed on the scattered tree and on the compacted one:
+ *           - exact lookups of keys in the tree (rDictFind), in random order,
+ *           - prefix searches of short prefixes of those keys (prefixMatching).
+ *
+ *         Usage: compact_bench [keyNum] [queryNum]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <assert.h>
+
+#include "radix_tree_dictionary.h"
+#include "my_bool.h"
+
+#define DEFAULT_KEY_NUM 2000000
+#define DEFAULT_QUERY_NUM 1000000
+
+// Keys are words of lower case letters
+#define MIN_KEY_LEN 6
+#define MAX_KEY_LEN 16
+#define ALPHABET_SIZE 26
+
+// Prefix searches use the first few letters of a key, which usually match a handful of keys
+#define PREFIX_LEN 5
+
+
+static double secondsSince(struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+
+static char** makeKeys(int keyNum) {
+    char** keys = (char**) malloc(keyNum * sizeof(char*));
+    assert(keys);
+    for (int i = 0; i < keyNum; i++) {
+        int len = MIN_KEY_LEN + rand() % (MAX_KEY_LEN - MIN_KEY_LEN + 1);
+        keys[i] = (char*) malloc(len + 1);
+        assert(keys[i]);
+        for (int j = 0; j < len; j++) {
+            keys[i][j] = 'a' + rand() % ALPHABET_SIZE;
+        }
+        keys[i][len] = '\0';
+    }
+    return keys;
+}
+
+
+// Time exact lookups of the queries, and return a checksum of the records found.
+static long long timeFind(RDictionary* rDict, char** queries, int queryNum, double* seconds) {
+    long long checksum = 0;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int q = 0; q < queryNum; q++) {
+        int recordNum = 0;
+        void** list = rDictFind(rDict, queries[q], &recordNum);
+        if (list != NULL) {
+            checksum += (uintptr_t) list[0];
+        }
+    }
+    *seconds = secondsSince(&start);
+    return checksum;
+}
+
+
+// Time prefix searches of the queries, and return a checksum of the records found.
+static long long timePrefix(RDictionary* rDict, char** queries, int queryNum, double* seconds) {
+    long long checksum = 0;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int q = 0; q < queryNum; q++) {
+        int matchedKeyNum, matchedRecordNum, comparedStr, comparedChar, comparedBit;
+        MatchedData** matched = prefixMatching(rDict, queries[q], &matchedKeyNum, &matchedRecordNum,
+                                               &comparedStr, &comparedChar, &comparedBit, NULL);
+        for (int i = 0; i < matchedKeyNum; i++) {
+            checksum += (uintptr_t) matched[i]->list[0];
+            free(matched[i]);
+        }
+        free(matched);
+    }
+    *seconds = secondsSince(&start);
+    return checksum;
+}
+
+
+static void keepRecord(void* data) {
+}
+
+
+int main(int argc, char* argv[]) {
+    srand(1);
+    int keyNum = argc > 1 ? atoi(argv[1]) : DEFAULT_KEY_NUM;
+    int queryNum = argc > 2 ? atoi(argv[2]) : DEFAULT_QUERY_NUM;
+    assert(keyNum > 0 && queryNum > 0);
+
+    char** keys = makeKeys(keyNum);
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    RDictionary* rDict = createRDict();
+    for (int i = 0; i < keyNum; i++) {
+        rDictInsert(rDict, keys[i], (void*) (uintptr_t) (i + 1), NULL);
+    }
+    printf("%d keys, built in %.1f ms\n", keyNum, secondsSince(&start) * 1e3);
+
+    char** findQueries = (char**) malloc(queryNum * sizeof(char*));
+    char** prefixQueries = (char**) malloc(queryNum * sizeof(char*));
+    assert(findQueries && prefixQueries);
+    for (int q = 0; q < queryNum; q++) {
+        findQueries[q] = keys[rand() % keyNum];
+        prefixQueries[q] = (char*) malloc(PREFIX_LEN + 1);
+        assert(prefixQueries[q]);
+        memcpy(prefixQueries[q], keys[rand() % keyNum], PREFIX_LEN);
+        prefixQueries[q][PREFIX_LEN] = '\0';
+    }
+
+    double findBefore, findAfter, prefixBefore, prefixAfter;
+    long long findChecksum = timeFind(rDict, findQueries, queryNum, &findBefore);
+    long long prefixChecksum = timePrefix(rDict, prefixQueries, queryNum, &prefixBefore);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    rDictCompact(rDict);
+    printf("compacted in %.1f ms\n", secondsSince(&start) * 1e3);
+
+    BOOL same = timeFind(rDict, findQueries, queryNum, &findAfter) == findChecksum;
+    same = timePrefix(rDict, prefixQueries, queryNum, &prefixAfter) == prefixChecksum && same;
+
+    printf("%-24s before %8.1f ns/query   after %8.1f ns/query   x%.2f\n", "exact lookup",
+           findBefore * 1e9 / queryNum, findAfter * 1e9 / queryNum, findBefore / findAfter);
+    printf("%-24s before %8.1f ns/query   after %8.1f ns/query   x%.2f%s\n", "prefix search",
+           prefixBefore * 1e9 / queryNum, prefixAfter * 1e9 / queryNum, prefixBefore / prefixAfter,
+           same ? "" : "   MISMATCH");
+
+    freeRDict(rDict, keepRecord);
+    for (int i = 0; i < keyNum; i++) {
+        free(keys[i]);
+    }
+    for (int q = 0; q < queryNum; q++) {
+        free(prefixQueries[q]);
+    }
+    free(keys);
+    free(findQueries);
+    free(prefixQueries);
+    return 0;
+}
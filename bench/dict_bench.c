@@ -0,0 +1,618 @@
+/**
+ * @brief  Compare the linked list, sorted array and radix tree dictionaries on the same keys.
+ *         Datasets:
+ *           - cafe:    trading names of a cafe data file (--data), the cafes are the records
+ *           - uniform: random words of lower case letters
+ *           - prefix:  a few long stems followed by short random words, so most keys share long prefixes
+ *           - zipf:    words drawn from a vocabulary with a Zipf distribution, for keys and queries,
+ *                      so a few keys have many records and most queries hit them
+ *         Workloads:
+ *           - insert:  every key into an empty dictionary
+ *           - exact:   search whole keys of the dictionary
+ *           - prefix:  search the first few characters of keys of the dictionary
+ *           - miss:    search keys whose last character is changed, so nothing matches
+ *         Each operation is timed on its own. For each engine and workload the throughput, p50/p99/p999
+ *         latency and the comparison counters of the dictionaries (bits, chars, strings) are printed,
+ *         with the bytes allocated per key while inserting, and written as JSON with --json.
+ *         The hash engine only finds whole keys, so a prefix query only matches a key equal to it.
+ *         The scan engine is the list with its keys packed, scanned by --threads threads once there are
+ *         enough of them.
+ *         The eytzinger engine is the sorted array optimised for reads once loaded, which is counted in the
+ *         insert time. The bulk engine is the same, with its items appended then sorted and built at once
+ *         by --threads threads, the build is only counted in the insert throughput. The learned engine is
+ *         the bulk one searched through a learned index of at most --max-error blocks of error, its size
+ *         and accuracy are printed once it is built.
+ *         The list and scan engines look at all of their keys for each search, so they only run
+ *         {LIST_MAX_QUERY_NUM} of them.
+ *         With --perf, the hardware counters of the radix tree operations are printed after each workload,
+ *         the latencies then include reading the counters.
+ *
+ *         Usage: dict_bench [--dataset cafe|uniform|prefix|zipf] [--data file] [--keys n] [--queries n]
+ *                           [--engines list,hash,scan,sorted,eytzinger,bulk,learned,radix]
+ *                           [--threads n]
+ *                           [--max-error n] [--seed n] [--json file] [--perf]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <malloc.h>
+#include <assert.h>
+#include <cjson/cJSON.h>
+
+#include "dictionary.h"
+#include "sorted_array_dictionary.h"
+#include "radix_tree_dictionary.h"
+#include "cafe_data.h"
+#include "perf_counters.h"
+#include "my_bool.h"
+
+#define DEFAULT_KEY_NUM 100000
+#define DEFAULT_QUERY_NUM 100000
+#define DEFAULT_MAX_ERROR 4
+#define LIST_MAX_QUERY_NUM 2000
+
+#define BIT_PER_CHAR 8
+
+// Random words
+#define MIN_WORD_LEN 6
+#define MAX_WORD_LEN 16
+#define ALPHABET_SIZE 26
+
+// Shared-prefix dataset: keys are one of STEM_NUM stems, a space and a short word
+#define STEM_NUM 64
+#define MIN_STEM_LEN 8
+#define MAX_STEM_LEN 24
+#define MIN_SUFFIX_LEN 2
+#define MAX_SUFFIX_LEN 6
+
+// Zipf dataset: a vocabulary of one word for every ZIPF_KEYS_PER_WORD keys, ranked with exponent ZIPF_EXPONENT
+#define ZIPF_KEYS_PER_WORD 8
+#define ZIPF_EXPONENT 1.0
+
+// Prefix queries keep this many characters of a key (fewer if it is shorter)
+#define MIN_PREFIX_LEN 2
+#define MAX_PREFIX_LEN 5
+
+// Miss queries end with this character instead of the last one of a key
+#define MISS_CHAR '~'
+
+#define ENGINE_LIST      0
+#define ENGINE_HASH      1     // the list with a hash index, for exact keys
+#define ENGINE_SCAN      2     // the list with packed keys
+#define ENGINE_SORTED    3
+#define ENGINE_EYTZINGER 4     // the sorted array optimised for reads once loaded
+#define ENGINE_BULK      5     // the same, appended then built at once
+#define ENGINE_LEARNED   6     // the same, searched through a learned index
+#define ENGINE_RADIX     7
+#define ENGINE_NUM       8
+
+#define WORKLOAD_INSERT 0
+#define WORKLOAD_EXACT  1
+#define WORKLOAD_PREFIX 2
+#define WORKLOAD_MISS   3
+#define WORKLOAD_NUM    4
+
+static const char* engineNames[ENGINE_NUM] = {"list", "hash", "scan", "sorted", "eytzinger", "bulk", "learned", "radix"};
+static const char* workloadNames[WORKLOAD_NUM] = {"insert", "exact", "prefix", "miss"};
+
+typedef struct DatasetStruct Dataset;
+struct DatasetStruct {
+    char* name;
+    int keyNum;
+    char** keys;
+    void** records;
+    int queryNum;
+    char** queries[WORKLOAD_NUM];   // no queries for inserts
+};
+
+typedef struct WorkloadResultStruct WorkloadResult;
+struct WorkloadResultStruct {
+    int opNum;
+    double seconds;
+    double p50;             // latencies in ns
+    double p99;
+    double p999;
+    long long matchedNum;   // records found
+    long long comparedBit;
+    long long comparedChar;
+    long long comparedStr;
+};
+
+
+static uint64_t nanosecondsNow() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+
+static char* randomWord(int minLen, int maxLen) {
+    int len = minLen + rand() % (maxLen - minLen + 1);
+    char* word = (char*) malloc(len + 1);
+    assert(word);
+    for (int j = 0; j < len; j++) {
+        word[j] = 'a' + rand() % ALPHABET_SIZE;
+    }
+    word[len] = '\0';
+    return word;
+}
+
+
+static char* copyString(char* str) {
+    char* copy = (char*) malloc(strlen(str) + 1);
+    assert(copy);
+    strcpy(copy, str);
+    return copy;
+}
+
+
+// Cumulative probabilities of the ranks of a Zipf distribution.
+static double* makeZipfTable(int rankNum, double exponent) {
+    double* cdf = (double*) malloc(rankNum * sizeof(double));
+    assert(cdf);
+    double sum = 0;
+    for (int i = 0; i < rankNum; i++) {
+        sum += 1 / pow(i + 1, exponent);
+        cdf[i] = sum;
+    }
+    for (int i = 0; i < rankNum; i++) {
+        cdf[i] /= sum;
+    }
+    return cdf;
+}
+
+
+static int drawZipf(double* cdf, int rankNum) {
+    double u = (double) rand() / ((double) RAND_MAX + 1);
+    int low = 0, high = rankNum - 1;
+    while (low < high) {
+        int mid = (low + high) / 2;
+        if (cdf[mid] < u) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+
+static int readCafeKeys(Dataset* data, char* dataFilename, int maxKeyNum) {
+    FILE* dataFile = fopen(dataFilename, "r");
+    if (dataFile == NULL) {
+        fprintf(stderr, "can't open %s\n", dataFilename);
+        exit(EXIT_FAILURE);
+    }
+    readHeadLine(dataFile);
+    int num = 0;
+    Cafe* cafe;
+    while (num < maxKeyNum && (cafe = readCafe(dataFile)) != NULL) {
+        data->keys[num] = (char*) getTradingName(cafe);
+        data->records[num] = cafe;
+        num ++;
+    }
+    fclose(dataFile);
+    return num;
+}
+
+
+static Dataset* makeDataset(char* name, char* dataFilename, int keyNum, int queryNum) {
+    Dataset* data = (Dataset*) malloc(sizeof(Dataset));
+    assert(data);
+    data->name = name;
+    data->keys = (char**) malloc(keyNum * sizeof(char*));
+    data->records = (void**) malloc(keyNum * sizeof(void*));
+    assert(data->keys && data->records);
+
+    // with Zipf, queries are drawn from the vocabulary in the same way as keys
+    char** vocabulary = NULL;
+    int wordNum = 0;
+    double* zipf = NULL;
+
+    if (strcmp(name, "cafe") == 0) {
+        if (dataFilename == NULL) {
+            fprintf(stderr, "the cafe dataset needs --data\n");
+            exit(EXIT_FAILURE);
+        }
+        keyNum = readCafeKeys(data, dataFilename, keyNum);
+        assert(keyNum > 0);
+    } else if (strcmp(name, "uniform") == 0) {
+        for (int i = 0; i < keyNum; i++) {
+            data->keys[i] = randomWord(MIN_WORD_LEN, MAX_WORD_LEN);
+        }
+    } else if (strcmp(name, "prefix") == 0) {
+        char* stems[STEM_NUM];
+        for (int i = 0; i < STEM_NUM; i++) {
+            stems[i] = randomWord(MIN_STEM_LEN, MAX_STEM_LEN);
+        }
+        for (int i = 0; i < keyNum; i++) {
+            char* stem = stems[rand() % STEM_NUM];
+            char* suffix = randomWord(MIN_SUFFIX_LEN, MAX_SUFFIX_LEN);
+            data->keys[i] = (char*) malloc(strlen(stem) + strlen(suffix) + 2);
+            assert(data->keys[i]);
+            sprintf(data->keys[i], "%s %s", stem, suffix);
+            free(suffix);
+        }
+        for (int i = 0; i < STEM_NUM; i++) {
+            free(stems[i]);
+        }
+    } else if (strcmp(name, "zipf") == 0) {
+        wordNum = keyNum / ZIPF_KEYS_PER_WORD > 0 ? keyNum / ZIPF_KEYS_PER_WORD : 1;
+        vocabulary = (char**) malloc(wordNum * sizeof(char*));
+        assert(vocabulary);
+        for (int i = 0; i < wordNum; i++) {
+            vocabulary[i] = randomWord(MIN_WORD_LEN, MAX_WORD_LEN);
+        }
+        zipf = makeZipfTable(wordNum, ZIPF_EXPONENT);
+        for (int i = 0; i < keyNum; i++) {
+            data->keys[i] = copyString(vocabulary[drawZipf(zipf, wordNum)]);
+        }
+    } else {
+        fprintf(stderr, "unknown dataset %s\n", name);
+        exit(EXIT_FAILURE);
+    }
+    if (strcmp(name, "cafe") != 0) {
+        for (int i = 0; i < keyNum; i++) {
+            data->records[i] = (void*) (uintptr_t) (i + 1);
+        }
+    }
+    data->keyNum = keyNum;
+
+    data->queryNum = queryNum;
+    data->queries[WORKLOAD_INSERT] = NULL;
+    for (int w = WORKLOAD_EXACT; w < WORKLOAD_NUM; w++) {
+        data->queries[w] = (char**) malloc(queryNum * sizeof(char*));
+        assert(data->queries[w]);
+    }
+    for (int q = 0; q < queryNum; q++) {
+        char* key = vocabulary != NULL ? vocabulary[drawZipf(zipf, wordNum)] : data->keys[rand() % keyNum];
+        data->queries[WORKLOAD_EXACT][q] = copyString(key);
+
+        key = vocabulary != NULL ? vocabulary[drawZipf(zipf, wordNum)] : data->keys[rand() % keyNum];
+        char* prefix = copyString(key);
+        size_t prefixLen = MIN_PREFIX_LEN + rand() % (MAX_PREFIX_LEN - MIN_PREFIX_LEN + 1);
+        if (prefixLen < strlen(prefix)) {
+            prefix[prefixLen] = '\0';
+        }
+        data->queries[WORKLOAD_PREFIX][q] = prefix;
+
+        key = vocabulary != NULL ? vocabulary[drawZipf(zipf, wordNum)] : data->keys[rand() % keyNum];
+        char* miss = copyString(key);
+        miss[strlen(miss) - 1] = MISS_CHAR;
+        data->queries[WORKLOAD_MISS][q] = miss;
+    }
+
+    if (vocabulary != NULL) {
+        for (int i = 0; i < wordNum; i++) {
+            free(vocabulary[i]);
+        }
+        free(vocabulary);
+        free(zipf);
+    }
+    return data;
+}
+
+
+static void freeDataset(Dataset* data) {
+    BOOL cafes = strcmp(data->name, "cafe") == 0;
+    for (int i = 0; i < data->keyNum; i++) {
+        free(data->keys[i]);
+        if (cafes) {
+            freeCafe(data->records[i]);
+        }
+    }
+    for (int w = WORKLOAD_EXACT; w < WORKLOAD_NUM; w++) {
+        for (int q = 0; q < data->queryNum; q++) {
+            free(data->queries[w][q]);
+        }
+        free(data->queries[w]);
+    }
+    free(data->keys);
+    free(data->records);
+    free(data);
+}
+
+
+// The linked list compares its own keys with the given one, so the arguments are swapped
+// for the given key to be matched as a prefix, as in the other dictionaries.
+static int cmpGivenPrefix(void* storedKey, void* givenKey, int* count) {
+    return cmpTradingNameAndCount(givenKey, storedKey, count);
+}
+
+
+static void keepRecord(void* data) {
+}
+
+
+// The engines from ENGINE_LIST to ENGINE_SCAN are all linked list dictionaries
+static BOOL isLinkedList(int engine) {
+    return engine >= ENGINE_LIST && engine <= ENGINE_SCAN;
+}
+
+
+// The engines from ENGINE_SORTED to ENGINE_LEARNED are all sorted array dictionaries
+static BOOL isSortedArray(int engine) {
+    return engine >= ENGINE_SORTED && engine <= ENGINE_LEARNED;
+}
+
+
+static void* createEngine(int engine, int threadNum) {
+    if (engine == ENGINE_LIST) {
+        return createDict();
+    } else if (engine == ENGINE_HASH) {
+        return createHashedDict(hashTradingName, cmpTradingName);
+    } else if (engine == ENGINE_SCAN) {
+        Dictionary* dict = createDict();
+        dictEnablePackedKeys(dict, threadNum);
+        return dict;
+    } else if (isSortedArray(engine)) {
+        return createSDict();
+    }
+    return createRDict();
+}
+
+
+// The list and the array keep the key they are given, the tree makes its own copy.
+static void insertKey(int engine, void* dict, char* key, void* record) {
+    if (isLinkedList(engine)) {
+        dictAppend((Dictionary*) dict, copyString(key), record);
+    } else if (engine == ENGINE_BULK || engine == ENGINE_LEARNED) {
+        sDictAppend((SDictionary*) dict, copyString(key), record);
+    } else if (engine == ENGINE_SORTED || engine == ENGINE_EYTZINGER) {
+        sDictInsert((SDictionary*) dict, copyString(key), record, cmpTradingName);
+    } else {
+        rDictInsert((RDictionary*) dict, key, record, NULL);
+    }
+}
+
+
+static void searchKey(int engine, void* dict, char* query, WorkloadResult* result) {
+    int matchedNum = 0, comparedStr = 0, comparedChar = 0, comparedBit = 0;
+    if (engine == ENGINE_LIST || engine == ENGINE_HASH) {
+        void** matched = searchDictByKey((Dictionary*) dict, query, &matchedNum, &comparedStr, &comparedChar,
+                                         cmpGivenPrefix);
+        comparedBit = BIT_PER_CHAR * comparedChar;
+        free(matched);
+    } else if (engine == ENGINE_SCAN) {
+        void** matched = searchDictByPrefix((Dictionary*) dict, query, &matchedNum, &comparedStr, &comparedChar);
+        comparedBit = BIT_PER_CHAR * comparedChar;
+        free(matched);
+    } else if (isSortedArray(engine)) {
+        void** matched = findAndTraverseSDict((SDictionary*) dict, query, &matchedNum, &comparedStr, &comparedChar,
+                                              cmpTradingNameAndCount);
+        comparedBit = BIT_PER_CHAR * comparedChar;
+        free(matched);
+    } else {
+        int matchedKeyNum = 0;
+        MatchedData** matched = prefixMatching((RDictionary*) dict, query, &matchedKeyNum, &matchedNum,
+                                               &comparedStr, &comparedChar, &comparedBit, NULL);
+        for (int i = 0; i < matchedKeyNum; i++) {
+            free(matched[i]);
+        }
+        free(matched);
+    }
+    result->matchedNum += matchedNum;
+    result->comparedBit += comparedBit;
+    result->comparedChar += comparedChar;
+    result->comparedStr += comparedStr;
+}
+
+
+static void freeEngine(int engine, void* dict) {
+    if (isLinkedList(engine)) {
+        freeDict((Dictionary*) dict, free, keepRecord);
+    } else if (isSortedArray(engine)) {
+        freeSDict((SDictionary*) dict, free, keepRecord);
+    } else {
+        freeRDict((RDictionary*) dict, keepRecord);
+    }
+}
+
+
+static int cmpLatency(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*) a, y = *(const uint64_t*) b;
+    return x < y ? -1 : x > y;
+}
+
+
+static double getPercentile(uint64_t* sortedLatencies, int num, double percentile) {
+    int idx = (int) ceil(percentile / 100 * num) - 1;
+    return (double) sortedLatencies[idx < 0 ? 0 : idx];
+}
+
+
+static void summarise(WorkloadResult* result, uint64_t* latencies, int opNum) {
+    qsort(latencies, opNum, sizeof(uint64_t), cmpLatency);
+    result->opNum = opNum;
+    result->p50 = getPercentile(latencies, opNum, 50);
+    result->p99 = getPercentile(latencies, opNum, 99);
+    result->p999 = getPercentile(latencies, opNum, 99.9);
+}
+
+
+// Print the hardware counters of a workload and start over, if they are counted
+static void printPerfCounters(int engine, int workload) {
+    if (perfCountersOn && engine == ENGINE_RADIX) {
+        printf("%s %s perf counters\n", engineNames[engine], workloadNames[workload]);
+        perfPrint(stdout);
+    }
+    perfReset();
+}
+
+
+// Run all workloads on one engine. Returns the bytes allocated per key while inserting.
+static double runEngine(int engine, Dataset* data, WorkloadResult* results, int threadNum, int maxError) {
+    memset(results, 0, WORKLOAD_NUM * sizeof(WorkloadResult));
+    int maxOpNum = data->keyNum > data->queryNum ? data->keyNum : data->queryNum;
+    uint64_t* latencies = (uint64_t*) malloc(maxOpNum * sizeof(uint64_t));
+    assert(latencies);
+
+    size_t allocatedBefore = mallinfo2().uordblks;
+    void* dict = createEngine(engine, threadNum);
+    uint64_t start = nanosecondsNow();
+    for (int i = 0; i < data->keyNum; i++) {
+        uint64_t opStart = nanosecondsNow();
+        insertKey(engine, dict, data->keys[i], data->records[i]);
+        latencies[i] = nanosecondsNow() - opStart;
+    }
+    if (engine == ENGINE_BULK || engine == ENGINE_LEARNED) {
+        sDictBuild((SDictionary*) dict, threadNum);
+    }
+    if (engine == ENGINE_EYTZINGER || engine == ENGINE_BULK) {
+        sDictOptimiseForReads((SDictionary*) dict);
+    } else if (engine == ENGINE_LEARNED) {
+        sDictEnableLearnedIndex((SDictionary*) dict, maxError);
+    }
+    results[WORKLOAD_INSERT].seconds = (nanosecondsNow() - start) / 1e9;
+    summarise(&results[WORKLOAD_INSERT], latencies, data->keyNum);
+    double bytesPerKey = (double) (mallinfo2().uordblks - allocatedBefore) / data->keyNum;
+    printPerfCounters(engine, WORKLOAD_INSERT);
+    if (engine == ENGINE_LEARNED) {
+        SDictLearnedIndexStats stats;
+        getSDictLearnedIndexStats((SDictionary*) dict, &stats);
+        printf("%-9s index    %zu segments, %zu bytes, error over %zu of %zu blocks mean %.2f max %.1f\n",
+               engineNames[engine], stats.segmentNum, stats.bytes, stats.fittedNum, stats.blockNum, stats.meanError,
+               stats.maxError);
+    }
+
+    BOOL scansAll = engine == ENGINE_LIST || engine == ENGINE_SCAN;
+    int queryNum = scansAll && data->queryNum > LIST_MAX_QUERY_NUM ? LIST_MAX_QUERY_NUM : data->queryNum;
+    for (int w = WORKLOAD_EXACT; w < WORKLOAD_NUM; w++) {
+        start = nanosecondsNow();
+        for (int q = 0; q < queryNum; q++) {
+            uint64_t opStart = nanosecondsNow();
+            searchKey(engine, dict, data->queries[w][q], &results[w]);
+            latencies[q] = nanosecondsNow() - opStart;
+        }
+        results[w].seconds = (nanosecondsNow() - start) / 1e9;
+        summarise(&results[w], latencies, queryNum);
+        printPerfCounters(engine, w);
+    }
+
+    freeEngine(engine, dict);
+    free(latencies);
+    return bytesPerKey;
+}
+
+
+static cJSON* workloadToJson(int workload, WorkloadResult* result) {
+    cJSON* obj = cJSON_CreateObject();
+    double opNum = result->opNum;
+    cJSON_AddStringToObject(obj, "workload", workloadNames[workload]);
+    cJSON_AddNumberToObject(obj, "ops", opNum);
+    cJSON_AddNumberToObject(obj, "seconds", result->seconds);
+    cJSON_AddNumberToObject(obj, "opsPerSecond", opNum / result->seconds);
+    cJSON_AddNumberToObject(obj, "p50Ns", result->p50);
+    cJSON_AddNumberToObject(obj, "p99Ns", result->p99);
+    cJSON_AddNumberToObject(obj, "p999Ns", result->p999);
+    cJSON_AddNumberToObject(obj, "matchedPerOp", result->matchedNum / opNum);
+    cJSON_AddNumberToObject(obj, "comparedBitPerOp", result->comparedBit / opNum);
+    cJSON_AddNumberToObject(obj, "comparedCharPerOp", result->comparedChar / opNum);
+    cJSON_AddNumberToObject(obj, "comparedStrPerOp", result->comparedStr / opNum);
+    return obj;
+}
+
+
+static void printResult(int engine, int workload, WorkloadResult* result) {
+    double opNum = result->opNum;
+    printf("%-9s %-7s %8d ops %11.0f ops/s   p50 %8.0f   p99 %9.0f   p999 %9.0f ns   "
+           "matched %8.1f   b%.0f c%.0f s%.1f\n",
+           engineNames[engine], workloadNames[workload], result->opNum, opNum / result->seconds,
+           result->p50, result->p99, result->p999, result->matchedNum / opNum,
+           result->comparedBit / opNum, result->comparedChar / opNum, result->comparedStr / opNum);
+}
+
+
+int main(int argc, char* argv[]) {
+    char* datasetName = "uniform";
+    char* dataFilename = NULL;
+    char* jsonFilename = NULL;
+    char* engineList = "list,hash,scan,sorted,eytzinger,bulk,learned,radix";
+    int keyNum = DEFAULT_KEY_NUM;
+    int queryNum = DEFAULT_QUERY_NUM;
+    int seed = 1;
+    int threadNum = 1;
+    int maxError = DEFAULT_MAX_ERROR;
+    for (int i = 1; i < argc; i += 2) {
+        if (strcmp(argv[i], "--perf") == 0) {
+            perfEnable();
+            i --;
+        } else if (i + 1 == argc) {
+            fprintf(stderr, "missing value of %s\n", argv[i]);
+            exit(EXIT_FAILURE);
+        } else if (strcmp(argv[i], "--dataset") == 0) {
+            datasetName = argv[i + 1];
+        } else if (strcmp(argv[i], "--data") == 0) {
+            dataFilename = argv[i + 1];
+        } else if (strcmp(argv[i], "--keys") == 0) {
+            keyNum = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--queries") == 0) {
+            queryNum = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--engines") == 0) {
+            engineList = argv[i + 1];
+        } else if (strcmp(argv[i], "--threads") == 0) {
+            threadNum = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--max-error") == 0) {
+            maxError = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            seed = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--json") == 0) {
+            jsonFilename = argv[i + 1];
+        } else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    assert(keyNum > 0 && queryNum > 0);
+    BOOL engineOn[ENGINE_NUM];
+    for (int e = 0; e < ENGINE_NUM; e++) {
+        engineOn[e] = strstr(engineList, engineNames[e]) != NULL;
+    }
+
+    srand(seed);
+    Dataset* data = makeDataset(datasetName, dataFilename, keyNum, queryNum);
+    printf("dataset %s, %d keys, %d queries, seed %d\n", data->name, data->keyNum, data->queryNum, seed);
+
+    cJSON* root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "dataset", data->name);
+    cJSON_AddNumberToObject(root, "keys", data->keyNum);
+    cJSON_AddNumberToObject(root, "queries", data->queryNum);
+    cJSON_AddNumberToObject(root, "seed", seed);
+    cJSON* engines = cJSON_CreateArray();
+    cJSON_AddItemToObject(root, "engines", engines);
+
+    for (int e = 0; e < ENGINE_NUM; e++) {
+        if (!engineOn[e]) {
+            continue;
+        }
+        WorkloadResult results[WORKLOAD_NUM];
+        double bytesPerKey = runEngine(e, data, results, threadNum, maxError);
+        cJSON* engine = cJSON_CreateObject();
+        cJSON_AddStringToObject(engine, "engine", engineNames[e]);
+        cJSON_AddNumberToObject(engine, "bytesPerKey", bytesPerKey);
+        cJSON* workloads = cJSON_CreateArray();
+        cJSON_AddItemToObject(engine, "workloads", workloads);
+        for (int w = 0; w < WORKLOAD_NUM; w++) {
+            printResult(e, w, &results[w]);
+            cJSON_AddItemToArray(workloads, workloadToJson(w, &results[w]));
+        }
+        printf("%-9s %.1f bytes/key\n", engineNames[e], bytesPerKey);
+        cJSON_AddItemToArray(engines, engine);
+    }
+
+    if (jsonFilename != NULL) {
+        FILE* jsonFile = fopen(jsonFilename, "w");
+        assert(jsonFile);
+        char* json = cJSON_Print(root);
+        fprintf(jsonFile, "%s\n", json);
+        cJSON_free(json);
+        fclose(jsonFile);
+    }
+    cJSON_Delete(root);
+    freeDataset(data);
+    return 0;
+}
@@ -0,0 +1,248 @@
+/**
+ * @brief  Compare the geospatial index with a full scan of the points.
+ *         Points are the cafes of a data file, or synthetic points around Melbourne
+ *         (most of them in the CBD) if a number is given instead of a file.
+ *         Each query is answered by both, and the answers are checked against each other:
+ *           - bounding boxes from about 100 m to 1 km wide,
+ *           - the k nearest cafes to a point.
+ *
+ *         Usage: geo_bench [dataFilename | pointNum] [queryNum] [k]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <assert.h>
+
+#include "geo_index.h"
+#include "cafe_data.h"
+
+#define DEFAULT_POINT_NUM 1000000
+#define DEFAULT_QUERY_NUM 1000
+#define DEFAULT_K 10
+
+// Melbourne CBD, and the extent of the synthetic points around it
+#define CENTRE_LONGITUDE 144.9631
+#define CENTRE_LATITUDE -37.8136
+#define CBD_SPREAD 0.03
+#define METRO_SPREAD 0.2
+
+// Widths of boxes, in degrees (about 100 m to 1 km)
+#define MIN_BOX_WIDTH 0.001
+#define MAX_BOX_WIDTH 0.01
+
+// Distances from the index and the scan are computed in the same way
+#define DISTANCE_TOLERANCE 1e-9
+
+typedef struct PointStruct Point;
+struct PointStruct {
+    double longitude;
+    double latitude;
+};
+
+
+static double secondsSince(struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+
+static double randomUniform(double low, double high) {
+    return low + (high - low) * rand() / ((double) RAND_MAX + 1);
+}
+
+
+// A rough normal distribution, the sum of uniform ones.
+static double randomNormal(double centre, double spread) {
+    double sum = 0;
+    for (int i = 0; i < 4; i++) {
+        sum += randomUniform(-1, 1);
+    }
+    return centre + sum / 2 * spread;
+}
+
+
+static Point* makePoints(int pointNum) {
+    Point* points = (Point*) malloc(pointNum * sizeof(Point));
+    assert(points);
+    for (int i = 0; i < pointNum; i++) {
+        double spread = rand() % 10 < 7 ? CBD_SPREAD : METRO_SPREAD;
+        points[i].longitude = randomNormal(CENTRE_LONGITUDE, spread);
+        points[i].latitude = randomNormal(CENTRE_LATITUDE, spread);
+    }
+    return points;
+}
+
+
+static Point* readPoints(char* dataFilename, int* pointNum) {
+    FILE* dataFile = fopen(dataFilename, "r");
+    assert(dataFile);
+    readHeadLine(dataFile);
+    int size = 1024;
+    Point* points = (Point*) malloc(size * sizeof(Point));
+    assert(points);
+    *pointNum = 0;
+    Cafe* cafe;
+    while ((cafe = readCafe(dataFile)) != NULL) {
+        if (*pointNum == size) {
+            size *= 2;
+            points = (Point*) realloc(points, size * sizeof(Point));
+            assert(points);
+        }
+        points[*pointNum].longitude = getCafeDoubleField(cafe, CAFE_LONGITUDE);
+        points[*pointNum].latitude = getCafeDoubleField(cafe, CAFE_LATITUDE);
+        (*pointNum) ++;
+        freeCafe(cafe);
+    }
+    fclose(dataFile);
+    return points;
+}
+
+
+static long long scanBox(Point* points, int pointNum, double minLongitude, double minLatitude,
+                         double maxLongitude, double maxLatitude, int* matchedNum) {
+    long long checksum = 0;
+    *matchedNum = 0;
+    for (int i = 0; i < pointNum; i++) {
+        if (points[i].longitude >= minLongitude && points[i].longitude <= maxLongitude &&
+            points[i].latitude >= minLatitude && points[i].latitude <= maxLatitude) {
+            checksum += i;
+            (*matchedNum) ++;
+        }
+    }
+    return checksum;
+}
+
+
+// Keep the k smallest distances in ascending order.
+static int scanNearest(Point* points, int pointNum, double longitude, double latitude, int k, double* distances) {
+    int num = 0;
+    for (int i = 0; i < pointNum; i++) {
+        double distance = geoDistance(longitude, latitude, points[i].longitude, points[i].latitude);
+        if (num == k && distance >= distances[k - 1]) {
+            continue;
+        }
+        int j = num < k ? num ++ : k - 1;
+        while (j > 0 && distances[j - 1] > distance) {
+            distances[j] = distances[j - 1];
+            j --;
+        }
+        distances[j] = distance;
+    }
+    return num;
+}
+
+
+static void keepPoint(void* data) {
+}
+
+
+int main(int argc, char* argv[]) {
+    srand(1);
+    int pointNum = DEFAULT_POINT_NUM;
+    Point* points;
+    if (argc > 1 && atoi(argv[1]) <= 0) {
+        points = readPoints(argv[1], &pointNum);
+    } else {
+        if (argc > 1) {
+            pointNum = atoi(argv[1]);
+        }
+        points = makePoints(pointNum);
+    }
+    int queryNum = argc > 2 ? atoi(argv[2]) : DEFAULT_QUERY_NUM;
+    int k = argc > 3 ? atoi(argv[3]) : DEFAULT_K;
+    assert(pointNum > 0 && queryNum > 0 && k > 0);
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    GeoIndex* geo = createGeoIndex();
+    for (int i = 0; i < pointNum; i++) {
+        geoIndexInsert(geo, points[i].longitude, points[i].latitude, (void*) (uintptr_t) i);
+    }
+    printf("%d points, built in %.1f ms\n", pointNum, secondsSince(&start) * 1e3);
+
+    // queries are centred on points, so they land where the points are
+    Point* boxes = (Point*) malloc(2 * queryNum * sizeof(Point));
+    Point* targets = (Point*) malloc(queryNum * sizeof(Point));
+    assert(boxes && targets);
+    for (int q = 0; q < queryNum; q++) {
+        Point centre = points[rand() % pointNum];
+        double width = randomUniform(MIN_BOX_WIDTH, MAX_BOX_WIDTH);
+        boxes[2 * q].longitude = centre.longitude - width / 2;
+        boxes[2 * q].latitude = centre.latitude - width / 2;
+        boxes[2 * q + 1].longitude = centre.longitude + width / 2;
+        boxes[2 * q + 1].latitude = centre.latitude + width / 2;
+        targets[q] = points[rand() % pointNum];
+        targets[q].longitude += randomUniform(-MIN_BOX_WIDTH, MIN_BOX_WIDTH);
+        targets[q].latitude += randomUniform(-MIN_BOX_WIDTH, MIN_BOX_WIDTH);
+    }
+
+    // bounding boxes
+    long long indexChecksum = 0, scanChecksum = 0;
+    long long matchedTotal = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int q = 0; q < queryNum; q++) {
+        int matchedNum;
+        void** matched = geoBoxSearch(geo, boxes[2 * q].longitude, boxes[2 * q].latitude,
+                                      boxes[2 * q + 1].longitude, boxes[2 * q + 1].latitude, &matchedNum);
+        for (int i = 0; i < matchedNum; i++) {
+            indexChecksum += (uintptr_t) matched[i];
+        }
+        matchedTotal += matchedNum;
+        free(matched);
+    }
+    double indexSec = secondsSince(&start);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int q = 0; q < queryNum; q++) {
+        int matchedNum;
+        scanChecksum += scanBox(points, pointNum, boxes[2 * q].longitude, boxes[2 * q].latitude,
+                                boxes[2 * q + 1].longitude, boxes[2 * q + 1].latitude, &matchedNum);
+    }
+    double scanSec = secondsSince(&start);
+    printf("%-24s index %9.2f us/query   scan %9.2f us/query   x%.1f   (%.1f points/query)%s\n", "bounding box",
+           indexSec * 1e6 / queryNum, scanSec * 1e6 / queryNum, scanSec / indexSec,
+           (double) matchedTotal / queryNum, indexChecksum == scanChecksum ? "" : "   MISMATCH");
+
+    // k nearest
+    double* indexDistances = (double*) malloc(queryNum * k * sizeof(double));
+    double* scanDistances = (double*) malloc(queryNum * k * sizeof(double));
+    assert(indexDistances && scanDistances);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int q = 0; q < queryNum; q++) {
+        int matchedNum;
+        void** matched = geoNearest(geo, targets[q].longitude, targets[q].latitude, k, &matchedNum,
+                                    &indexDistances[q * k]);
+        free(matched);
+    }
+    indexSec = secondsSince(&start);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int q = 0; q < queryNum; q++) {
+        scanNearest(points, pointNum, targets[q].longitude, targets[q].latitude, k, &scanDistances[q * k]);
+    }
+    scanSec = secondsSince(&start);
+    int mismatchNum = 0;
+    int resultNum = k < pointNum ? k : pointNum;
+    for (int i = 0; i < queryNum * resultNum; i++) {
+        int q = i / resultNum, j = i % resultNum;
+        if (fabs(indexDistances[q * k + j] - scanDistances[q * k + j]) > DISTANCE_TOLERANCE) {
+            mismatchNum ++;
+        }
+    }
+    char name[32];
+    snprintf(name, sizeof(name), "%d nearest", k);
+    printf("%-24s index %9.2f us/query   scan %9.2f us/query   x%.1f%s\n", name,
+           indexSec * 1e6 / queryNum, scanSec * 1e6 / queryNum, scanSec / indexSec,
+           mismatchNum == 0 ? "" : "   MISMATCH");
+
+    freeGeoIndex(geo, keepPoint);
+    free(indexDistances);
+    free(scanDistances);
+    free(boxes);
+    free(targets);
+    free(points);
+    return 0;
+}
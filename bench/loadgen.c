@@ -0,0 +1,667 @@
+/**
+ * @brief  Load generator for the notebook server, on localhost.
+ *         Opens connections to the server on 127.0.0.1 and sends a mix of insert, search and get_tree
+ *         requests, one at a time on each connection since the server reads a request as whatever
+ *         has arrived on a socket. A response is complete once its outer JSON object is closed.
+ *         Modes:
+ *           - closed: every connection sends its next request as soon as the response arrives,
+ *                     so the concurrency is fixed and the rate is whatever the server keeps up with
+ *           - open:   requests are scheduled at a fixed rate whether or not earlier ones are done.
+ *                     A request waits for an idle connection if there is none, and its latency is
+ *                     counted from when it was scheduled, not sent, so a stalled server is not
+ *                     hidden by the requests it kept from being sent (coordinated omission).
+ *                     Requests still unsent when the phase ends count with their wait so far.
+ *                     The service time, from sending to the response, is reported as well.
+ *         With --find-max, open-loop steps are run at rising rates, doubling until a step can't be
+ *         sustained and then bisecting, and the highest sustained rate is reported. A step is
+ *         sustained when nearly all its requests are done in time and the p99 latency of each
+ *         operation is within --slo-ms.
+ *         Keys are random lower case words, --preload of them are inserted before measuring.
+ *         Searches send a whole key, or its first --prefix-len characters.
+ *         The server accepts at most 24 clients.
+ *
+ *         Usage: loadgen --port p [--mode closed|open] [--connections n] [--rate qps] [--duration s]
+ *                        [--warmup s] [--mix insert=10,search=90,get_tree=0] [--keys n] [--preload n]
+ *                        [--prefix-len n] [--timeout-ms ms] [--find-max] [--slo-ms ms] [--seed n]
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <assert.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "histogram.h"
+#include "my_bool.h"
+
+#define LOCALHOST "127.0.0.1"
+
+#define DEFAULT_CONNECTION_NUM 16
+#define MAX_CONNECTION_NUM 24
+#define DEFAULT_RATE 1000
+#define DEFAULT_DURATION 10
+#define DEFAULT_WARMUP 1
+#define DEFAULT_MIX "insert=10,search=90,get_tree=0"
+#define DEFAULT_KEY_NUM 10000
+#define DEFAULT_TIMEOUT_MS 2000
+#define DEFAULT_SLO_MS 10
+
+// Random words
+#define MIN_WORD_LEN 6
+#define MAX_WORD_LEN 16
+#define ALPHABET_SIZE 26
+
+#define REQUEST_SIZE 256
+#define RECV_BUFFER_SIZE 65536
+
+#define NS_PER_SEC 1000000000ull
+#define NS_PER_MS 1000000ull
+#define NS_PER_US 1000.0
+
+// An open-loop step is sustained if this share of its scheduled requests got a response
+#define SUSTAINED_DONE_RATIO 0.95
+// --find-max bisects between the last sustained and the first unsustained rate this many times
+#define FIND_MAX_BISECT_NUM 5
+#define FIND_MAX_STEP_NUM 20
+
+#define MODE_CLOSED 0
+#define MODE_OPEN   1
+
+#define OP_INSERT   0
+#define OP_SEARCH   1
+#define OP_GET_TREE 2
+#define OP_NUM      3
+
+static const char* opNames[OP_NUM] = {"insert", "search", "get_tree"};
+
+typedef struct ConnectionStruct Connection;
+struct ConnectionStruct {
+    int fd;
+    BOOL busy;
+    int op;
+    uint64_t scheduledTime;     // when the request should have been sent, the sending time in closed loop
+    uint64_t sentTime;
+    char request[REQUEST_SIZE];
+    size_t requestLen;
+    size_t sentLen;
+    // state of the JSON scanner over the response
+    int depth;
+    BOOL inString;
+    BOOL escaped;
+};
+
+typedef struct LoadGenStruct LoadGen;
+struct LoadGenStruct {
+    int port;
+    Connection* connections;
+    int connectionNum;
+    int mix[OP_NUM];            // weights of the operations
+    int mixTotal;
+    char** keys;
+    int keyNum;
+    int nextInsertIdx;          // keys are inserted in order during the preload, at random afterwards
+    int prefixLen;
+    uint64_t timeout;
+    unsigned long dataId;
+};
+
+// Counters and histograms of one phase
+typedef struct PhaseResultStruct PhaseResult;
+struct PhaseResultStruct {
+    Histogram* latency[OP_NUM];     // from scheduling, coordinated omission corrected in open loop, unsent requests included
+    Histogram* service[OP_NUM];     // from sending
+    uint64_t doneNum[OP_NUM];
+    uint64_t errorNum;              // connections closed by the server
+    uint64_t timeoutNum;
+    uint64_t scheduledNum;
+    uint64_t unsentNum;             // still waiting for a connection at the end of an open-loop phase
+    double seconds;
+};
+
+
+static uint64_t nowNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * NS_PER_SEC + now.tv_nsec;
+}
+
+
+static char* randomWord(int minLen, int maxLen) {
+    int len = minLen + rand() % (maxLen - minLen + 1);
+    char* word = (char*) malloc(len + 1);
+    assert(word);
+    for (int j = 0; j < len; j++) {
+        word[j] = 'a' + rand() % ALPHABET_SIZE;
+    }
+    word[len] = '\0';
+    return word;
+}
+
+
+static void parseMix(LoadGen* gen, char* mix) {
+    memset(gen->mix, 0, sizeof(gen->mix));
+    char* copy = strdup(mix);
+    assert(copy);
+    for (char* item = strtok(copy, ","); item != NULL; item = strtok(NULL, ",")) {
+        char* equals = strchr(item, '=');
+        int op = 0;
+        while (op < OP_NUM && (equals == NULL || strncmp(item, opNames[op], equals - item) != 0
+                               || opNames[op][equals - item] != '\0')) {
+            op ++;
+        }
+        if (op == OP_NUM) {
+            fprintf(stderr, "unknown operation in mix: %s\n", item);
+            exit(EXIT_FAILURE);
+        }
+        gen->mix[op] = atoi(equals + 1);
+    }
+    free(copy);
+    gen->mixTotal = 0;
+    for (int op = 0; op < OP_NUM; op++) {
+        gen->mixTotal += gen->mix[op];
+    }
+    if (gen->mixTotal <= 0) {
+        fprintf(stderr, "the mix has no operation\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+
+static void connectToServer(LoadGen* gen, Connection* connection) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        exit(EXIT_FAILURE);
+    }
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(gen->port);
+    inet_pton(AF_INET, LOCALHOST, &address.sin_addr);
+    if (connect(fd, (struct sockaddr*) &address, sizeof(address)) < 0) {
+        perror("connect");
+        exit(EXIT_FAILURE);
+    }
+    // requests are small and must arrive in one piece
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    connection->fd = fd;
+    connection->busy = FALSE;
+}
+
+
+static void reconnect(LoadGen* gen, Connection* connection) {
+    close(connection->fd);
+    connectToServer(gen, connection);
+}
+
+
+static int pickOp(LoadGen* gen) {
+    int r = rand() % gen->mixTotal;
+    int op = 0;
+    while (r >= gen->mix[op]) {
+        r -= gen->mix[op];
+        op ++;
+    }
+    return op;
+}
+
+
+static void makeRequest(LoadGen* gen, Connection* connection, int op, BOOL preloading) {
+    int len = 0;
+    if (op == OP_INSERT) {
+        int keyIdx = preloading ? gen->nextInsertIdx ++ : rand() % gen->keyNum;
+        len = snprintf(connection->request, REQUEST_SIZE, "{\"mode\":\"insert\",\"payload\":{\"key\":\"%s\",\"data\":\"d%lu\"}}",
+                       gen->keys[keyIdx], gen->dataId ++);
+    } else if (op == OP_SEARCH) {
+        char* key = gen->keys[rand() % gen->keyNum];
+        int keyLen = gen->prefixLen > 0 ? gen->prefixLen : (int) strlen(key);
+        len = snprintf(connection->request, REQUEST_SIZE, "{\"mode\":\"search\",\"payload\":{\"key\":\"%.*s\"}}",
+                       keyLen, key);
+    } else {
+        len = snprintf(connection->request, REQUEST_SIZE, "{\"mode\":\"get_tree\"}");
+    }
+    assert(len > 0 && len < REQUEST_SIZE);
+    connection->op = op;
+    connection->requestLen = len;
+    connection->sentLen = 0;
+    connection->depth = 0;
+    connection->inString = FALSE;
+    connection->escaped = FALSE;
+    connection->busy = TRUE;
+}
+
+
+// Send what is left of the request. FALSE if the connection is broken.
+static BOOL sendRest(Connection* connection) {
+    while (connection->sentLen < connection->requestLen) {
+        ssize_t n = send(connection->fd, connection->request + connection->sentLen,
+                         connection->requestLen - connection->sentLen, MSG_NOSIGNAL);
+        if (n < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        connection->sentLen += n;
+    }
+    return TRUE;
+}
+
+
+static void startRequest(LoadGen* gen, Connection* connection, int op, uint64_t scheduledTime, BOOL preloading) {
+    makeRequest(gen, connection, op, preloading);
+    connection->sentTime = nowNs();
+    connection->scheduledTime = scheduledTime != 0 ? scheduledTime : connection->sentTime;
+    if (!sendRest(connection)) {
+        // counted as a timeout once it expires
+        connection->sentLen = connection->requestLen;
+    }
+}
+
+
+// Feed received bytes to the JSON scanner. TRUE once the outer object is closed.
+static BOOL scanResponse(Connection* connection, char* bytes, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        char c = bytes[i];
+        if (connection->inString) {
+            if (connection->escaped) {
+                connection->escaped = FALSE;
+            } else if (c == '\\') {
+                connection->escaped = TRUE;
+            } else if (c == '"') {
+                connection->inString = FALSE;
+            }
+        } else if (c == '"') {
+            connection->inString = TRUE;
+        } else if (c == '{' || c == '[') {
+            connection->depth ++;
+        } else if (c == '}' || c == ']') {
+            if (-- connection->depth == 0) {
+                return TRUE;
+            }
+        }
+    }
+    return FALSE;
+}
+
+
+static void createPhaseResult(PhaseResult* result) {
+    memset(result, 0, sizeof(PhaseResult));
+    for (int op = 0; op < OP_NUM; op++) {
+        result->latency[op] = createHistogram();
+        result->service[op] = createHistogram();
+    }
+}
+
+
+static void freePhaseResult(PhaseResult* result) {
+    for (int op = 0; op < OP_NUM; op++) {
+        freeHistogram(result->latency[op]);
+        freeHistogram(result->service[op]);
+    }
+}
+
+
+/**
+ * @brief  Run one phase on all connections.
+ * @param  gen:
+ * @param  mode: MODE_CLOSED or MODE_OPEN
+ * @param  rate: requests per second in open loop
+ * @param  seconds: requests are started during this time, then the phase waits for their responses
+ * @param  requestNum: in closed loop, stop after this many requests instead if it is positive (preload)
+ * @param  result: counters and histograms, NULL to measure nothing (warmup, preload)
+ */
+static void runPhase(LoadGen* gen, int mode, double rate, double seconds, long requestNum, PhaseResult* result) {
+    BOOL preloading = requestNum > 0;
+    char* buffer = (char*) malloc(RECV_BUFFER_SIZE);
+    struct pollfd* fds = (struct pollfd*) malloc(gen->connectionNum * sizeof(struct pollfd));
+    assert(buffer && fds);
+
+    uint64_t start = nowNs();
+    uint64_t end = start + (uint64_t) (seconds * NS_PER_SEC);
+    double interval = rate > 0 ? NS_PER_SEC / rate : 0;
+    uint64_t scheduledNum = 0;     // open loop, requests whose time has come
+    uint64_t startedNum = 0;
+    int busyNum = 0;
+
+    while (1) {
+        uint64_t now = nowNs();
+        BOOL starting = preloading ? startedNum < (uint64_t) requestNum : now < end;
+        if (mode == MODE_OPEN && starting) {
+            scheduledNum = (uint64_t) ((now - start) / interval) + 1;
+        }
+        // hand the requests that are due to idle connections
+        for (int c = 0; c < gen->connectionNum && starting; c++) {
+            Connection* connection = &gen->connections[c];
+            if (connection->busy) {
+                continue;
+            }
+            if (mode == MODE_OPEN) {
+                if (startedNum == scheduledNum) {
+                    break;
+                }
+                startRequest(gen, connection, pickOp(gen), start + (uint64_t) (startedNum * interval), FALSE);
+            } else {
+                if (preloading && startedNum == (uint64_t) requestNum) {
+                    break;
+                }
+                startRequest(gen, connection, preloading ? OP_INSERT : pickOp(gen), 0, preloading);
+            }
+            startedNum ++;
+            busyNum ++;
+        }
+        if (!starting && busyNum == 0) {
+            break;
+        }
+
+        // wait for responses, the next scheduled request or the first timeout
+        uint64_t wakeUp = now + gen->timeout;
+        if (mode == MODE_OPEN && starting) {
+            uint64_t next = start + (uint64_t) (scheduledNum * interval);
+            wakeUp = next < end ? next : end;
+        } else if (mode == MODE_CLOSED && starting && !preloading && end < wakeUp) {
+            wakeUp = end;
+        }
+        for (int c = 0; c < gen->connectionNum; c++) {
+            Connection* connection = &gen->connections[c];
+            fds[c].fd = connection->fd;
+            fds[c].events = connection->busy ? POLLIN : 0;
+            if (connection->busy && connection->sentLen < connection->requestLen) {
+                fds[c].events |= POLLOUT;
+            }
+            fds[c].revents = 0;
+            if (connection->busy && connection->sentTime + gen->timeout < wakeUp) {
+                wakeUp = connection->sentTime + gen->timeout;
+            }
+        }
+        uint64_t waitNs = wakeUp > now ? wakeUp - now : 0;
+        struct timespec waitTime = {waitNs / NS_PER_SEC, waitNs % NS_PER_SEC};
+        if (ppoll(fds, gen->connectionNum, &waitTime, NULL) < 0 && errno != EINTR) {
+            perror("ppoll");
+            exit(EXIT_FAILURE);
+        }
+
+        for (int c = 0; c < gen->connectionNum; c++) {
+            Connection* connection = &gen->connections[c];
+            if (!connection->busy) {
+                continue;
+            }
+            if (fds[c].revents & POLLOUT) {
+                if (!sendRest(connection)) {
+                    connection->sentLen = connection->requestLen;
+                }
+            }
+            BOOL done = FALSE, broken = FALSE;
+            if (fds[c].revents & (POLLIN | POLLHUP | POLLERR)) {
+                while (!done) {
+                    ssize_t n = recv(connection->fd, buffer, RECV_BUFFER_SIZE, 0);
+                    if (n > 0) {
+                        done = scanResponse(connection, buffer, n);
+                    } else {
+                        broken = n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+                        break;
+                    }
+                }
+            }
+            uint64_t finished = nowNs();
+            if (done) {
+                if (result != NULL) {
+                    histogramRecord(result->latency[connection->op], finished - connection->scheduledTime);
+                    histogramRecord(result->service[connection->op], finished - connection->sentTime);
+                    result->doneNum[connection->op] ++;
+                }
+                connection->busy = FALSE;
+                busyNum --;
+            } else if (broken || finished - connection->sentTime >= gen->timeout) {
+                // start over on a new connection, the response would be taken for the next one's
+                if (result != NULL) {
+                    if (broken) {
+                        result->errorNum ++;
+                    } else {
+                        result->timeoutNum ++;
+                    }
+                }
+                reconnect(gen, connection);
+                busyNum --;
+            }
+        }
+    }
+
+    if (result != NULL) {
+        uint64_t finished = nowNs();
+        result->seconds = (finished - start) / (double) NS_PER_SEC;
+        result->scheduledNum = mode == MODE_OPEN ? scheduledNum : startedNum;
+        result->unsentNum = scheduledNum > startedNum ? scheduledNum - startedNum : 0;
+        // requests never sent have waited at least until now, leaving them out would hide the backlog
+        for (uint64_t i = startedNum; i < scheduledNum; i++) {
+            histogramRecord(result->latency[pickOp(gen)], finished - (start + (uint64_t) (i * interval)));
+        }
+    }
+    free(fds);
+    free(buffer);
+}
+
+
+static uint64_t getDoneNum(PhaseResult* result) {
+    uint64_t doneNum = 0;
+    for (int op = 0; op < OP_NUM; op++) {
+        doneNum += result->doneNum[op];
+    }
+    return doneNum;
+}
+
+
+static BOOL isSustained(LoadGen* gen, PhaseResult* result, double sloMs) {
+    if (getDoneNum(result) < SUSTAINED_DONE_RATIO * result->scheduledNum) {
+        return FALSE;
+    }
+    for (int op = 0; op < OP_NUM; op++) {
+        if (getHistogramPercentile(result->latency[op], 99) > sloMs * NS_PER_MS) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+
+static void printPhaseSummary(LoadGen* gen, PhaseResult* result) {
+    printf("%lu done in %.2f s (%.0f qps), %lu scheduled, %lu unsent, %lu timeouts, %lu errors\n",
+           (unsigned long) getDoneNum(result), result->seconds, getDoneNum(result) / result->seconds,
+           (unsigned long) result->scheduledNum, (unsigned long) result->unsentNum,
+           (unsigned long) result->timeoutNum, (unsigned long) result->errorNum);
+    // latencies include the unsent requests, the counts and rates only the done ones
+    printf("%-9s %10s %10s %10s %10s %10s %10s %10s   (us)\n", "op", "done", "qps", "mean", "p50", "p99", "p99.9", "max");
+    for (int op = 0; op < OP_NUM; op++) {
+        Histogram* latency = result->latency[op];
+        if (gen->mix[op] == 0) {
+            continue;
+        }
+        printf("%-9s %10lu %10.0f %10.1f %10.1f %10.1f %10.1f %10.1f\n", opNames[op],
+               (unsigned long) result->doneNum[op], result->doneNum[op] / result->seconds,
+               getHistogramMean(latency) / NS_PER_US, getHistogramPercentile(latency, 50) / NS_PER_US,
+               getHistogramPercentile(latency, 99) / NS_PER_US, getHistogramPercentile(latency, 99.9) / NS_PER_US,
+               getHistogramMax(latency) / NS_PER_US);
+    }
+}
+
+
+static void printPhaseHistograms(LoadGen* gen, int mode, PhaseResult* result) {
+    for (int op = 0; op < OP_NUM; op++) {
+        if (gen->mix[op] == 0) {
+            continue;
+        }
+        printf("\n%s latency%s (us)\n", opNames[op], mode == MODE_OPEN ? " from scheduling" : "");
+        printHistogram(result->latency[op], stdout, NS_PER_US);
+        if (mode == MODE_OPEN) {
+            printf("\n%s service time from sending (us)\n", opNames[op]);
+            printHistogram(result->service[op], stdout, NS_PER_US);
+        }
+    }
+}
+
+
+// Run open-loop steps at rising rates, and return the highest rate sustained
+static double findMaxRate(LoadGen* gen, double rate, double seconds, double sloMs) {
+    double good = 0, bad = 0;
+    int bisectNum = 0;
+    for (int step = 0; step < FIND_MAX_STEP_NUM && bisectNum <= FIND_MAX_BISECT_NUM; step++) {
+        PhaseResult result;
+        createPhaseResult(&result);
+        runPhase(gen, MODE_OPEN, rate, seconds, 0, &result);
+        BOOL sustained = isSustained(gen, &result, sloMs);
+        Histogram* all = createHistogram();
+        for (int op = 0; op < OP_NUM; op++) {
+            histogramMerge(all, result.latency[op]);
+        }
+        printf("rate %10.0f   done %10.0f qps   p99 %10.1f us   %s\n", rate, getDoneNum(&result) / result.seconds,
+               getHistogramPercentile(all, 99) / NS_PER_US, sustained ? "sustained" : "not sustained");
+        freeHistogram(all);
+        freePhaseResult(&result);
+        if (sustained) {
+            good = rate;
+        } else {
+            bad = rate;
+        }
+        if (bad == 0) {
+            rate *= 2;
+        } else {
+            // halve the rate until one is sustained, then bisect
+            rate = good == 0 ? bad / 2 : (good + bad) / 2;
+            bisectNum += good != 0;
+        }
+    }
+    return good;
+}
+
+
+int main(int argc, char* argv[]) {
+    LoadGen gen;
+    memset(&gen, 0, sizeof(gen));
+    int mode = MODE_CLOSED;
+    double rate = DEFAULT_RATE;
+    double duration = DEFAULT_DURATION;
+    double warmup = DEFAULT_WARMUP;
+    double sloMs = DEFAULT_SLO_MS;
+    char* mix = DEFAULT_MIX;
+    int preloadNum = -1;
+    BOOL findMax = FALSE;
+    int seed = 1;
+    gen.connectionNum = DEFAULT_CONNECTION_NUM;
+    gen.keyNum = DEFAULT_KEY_NUM;
+    gen.timeout = DEFAULT_TIMEOUT_MS * NS_PER_MS;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--find-max") == 0) {
+            findMax = TRUE;
+            mode = MODE_OPEN;
+            continue;
+        }
+        if (i + 1 == argc) {
+            fprintf(stderr, "missing value of %s\n", argv[i]);
+            exit(EXIT_FAILURE);
+        }
+        char* value = argv[++ i];
+        if (strcmp(argv[i - 1], "--port") == 0) {
+            gen.port = atoi(value);
+        } else if (strcmp(argv[i - 1], "--mode") == 0) {
+            mode = strcmp(value, "open") == 0 ? MODE_OPEN : MODE_CLOSED;
+        } else if (strcmp(argv[i - 1], "--connections") == 0) {
+            gen.connectionNum = atoi(value);
+        } else if (strcmp(argv[i - 1], "--rate") == 0) {
+            rate = atof(value);
+        } else if (strcmp(argv[i - 1], "--duration") == 0) {
+            duration = atof(value);
+        } else if (strcmp(argv[i - 1], "--warmup") == 0) {
+            warmup = atof(value);
+        } else if (strcmp(argv[i - 1], "--mix") == 0) {
+            mix = value;
+        } else if (strcmp(argv[i - 1], "--keys") == 0) {
+            gen.keyNum = atoi(value);
+        } else if (strcmp(argv[i - 1], "--preload") == 0) {
+            preloadNum = atoi(value);
+        } else if (strcmp(argv[i - 1], "--prefix-len") == 0) {
+            gen.prefixLen = atoi(value);
+        } else if (strcmp(argv[i - 1], "--timeout-ms") == 0) {
+            gen.timeout = (uint64_t) atol(value) * NS_PER_MS;
+        } else if (strcmp(argv[i - 1], "--slo-ms") == 0) {
+            sloMs = atof(value);
+        } else if (strcmp(argv[i - 1], "--seed") == 0) {
+            seed = atoi(value);
+        } else {
+            fprintf(stderr, "unknown option %s\n", argv[i - 1]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (gen.port <= 0) {
+        fprintf(stderr, "usage: %s --port p [options], see the top of loadgen.c\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (gen.connectionNum < 1 || gen.connectionNum > MAX_CONNECTION_NUM) {
+        fprintf(stderr, "the server takes 1 to %d connections\n", MAX_CONNECTION_NUM);
+        exit(EXIT_FAILURE);
+    }
+    assert(gen.keyNum > 0 && rate > 0 && duration > 0 && gen.timeout > 0);
+    if (preloadNum < 0 || preloadNum > gen.keyNum) {
+        preloadNum = gen.keyNum;
+    }
+    parseMix(&gen, mix);
+    signal(SIGPIPE, SIG_IGN);
+
+    srand(seed);
+    gen.keys = (char**) malloc(gen.keyNum * sizeof(char*));
+    assert(gen.keys);
+    for (int i = 0; i < gen.keyNum; i++) {
+        gen.keys[i] = randomWord(MIN_WORD_LEN, MAX_WORD_LEN);
+    }
+    gen.connections = (Connection*) malloc(gen.connectionNum * sizeof(Connection));
+    assert(gen.connections);
+    for (int c = 0; c < gen.connectionNum; c++) {
+        connectToServer(&gen, &gen.connections[c]);
+    }
+
+    printf("%s loop, %d connections, %s, port %d\n", mode == MODE_OPEN ? "open" : "closed",
+           gen.connectionNum, mix, gen.port);
+    if (preloadNum > 0) {
+        uint64_t start = nowNs();
+        runPhase(&gen, MODE_CLOSED, 0, 0, preloadNum, NULL);
+        printf("preloaded %d keys in %.2f s\n", preloadNum, (nowNs() - start) / (double) NS_PER_SEC);
+    }
+    if (warmup > 0) {
+        runPhase(&gen, mode, rate, warmup, 0, NULL);
+    }
+
+    if (findMax) {
+        double maxRate = findMaxRate(&gen, rate, duration, sloMs);
+        printf("max sustainable rate %.0f qps (p99 within %.1f ms, %.0f%% of requests done)\n",
+               maxRate, sloMs, SUSTAINED_DONE_RATIO * 100);
+    } else {
+        PhaseResult result;
+        createPhaseResult(&result);
+        runPhase(&gen, mode, rate, duration, 0, &result);
+        if (mode == MODE_OPEN) {
+            printf("target %.0f qps, %s\n", rate, isSustained(&gen, &result, sloMs) ? "sustained" : "not sustained");
+        }
+        printPhaseSummary(&gen, &result);
+        printPhaseHistograms(&gen, mode, &result);
+        freePhaseResult(&result);
+    }
+
+    for (int c = 0; c < gen.connectionNum; c++) {
+        close(gen.connections[c].fd);
+    }
+    free(gen.connections);
+    for (int i = 0; i < gen.keyNum; i++) {
+        free(gen.keys[i]);
+    }
+    free(gen.keys);
+    return 0;
+}
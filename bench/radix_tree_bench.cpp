@@ -0,0 +1,201 @@
+/**
+ * @brief  Compare the C radix tree dictionary with the C++ RadixTree template.
+ *         The same synthetic trading names are inserted into
+ *           - the C dictionary, with every record allocated on its own (as the C API needs),
+ *           - RadixTree<void*> with the same allocated records,
+ *           - RadixTree<Record> with records stored inline,
+ *           - RadixTree<Record, ExactKeyTraits, ComparisonCounting>, counting like prefixMatching,
+ *         then each is searched with the same prefixes.
+ *
+ *         Usage: radix_tree_bench [keyNum] [queryNum]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "radix_tree.hpp"
+
+extern "C" {
+#include "radix_tree_dictionary.h"
+}
+
+#define DEFAULT_KEY_NUM 100000
+#define DEFAULT_QUERY_NUM 5000
+#define MAX_PREFIX_LEN 8
+
+// A record of about the size of a Cafe
+struct Record {
+    int censusYear;
+    int blockID;
+    int propertyID;
+    int seatNum;
+    double longitude;
+    double latitude;
+};
+
+static const char* words[] = {
+    "Market", "Lane", "Coffee", "Cafe", "The", "Bar", "Kitchen", "Espresso", "House", "Brew",
+    "Melbourne", "Little", "Collins", "Street", "Dumpling", "Noodle", "Pizza", "Bakery", "Co", "Grill",
+    "Deli", "Sushi", "Ramen", "Tea", "Garden", "Corner", "Hub", "Place", "Lounge", "Bistro",
+};
+static const int WORD_NUM = sizeof(words) / sizeof(words[0]);
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// A trading name of 1 to 4 words, sometimes followed by a number.
+static std::string makeName() {
+    std::string name;
+    int wordNum = 1 + rand() % 4;
+    for (int i = 0; i < wordNum; i++) {
+        if (i != 0) {
+            name += ' ';
+        }
+        name += words[rand() % WORD_NUM];
+    }
+    if (rand() % 3 == 0) {
+        name += ' ' + std::to_string(rand() % 1000);
+    }
+    return name;
+}
+
+static Record makeRecord(int i) {
+    return Record{2022, i % 1000, i, rand() % 200, 144.9 + (rand() % 1000) / 1e4, -37.8 - (rand() % 1000) / 1e4};
+}
+
+static void printRow(const char* name, double insertSec, double querySec, double freeSec, size_t keyNum,
+                     size_t queryNum, long long checksum) {
+    printf("%-40s insert %7.1f ns/key   query %8.2f us/query   free %6.1f ms   (checksum %lld)\n",
+           name, insertSec * 1e9 / keyNum, querySec * 1e6 / queryNum, freeSec * 1e3, checksum);
+}
+
+static void freeRecord(void* record) {
+    free(record);
+}
+
+int main(int argc, char* argv[]) {
+    size_t keyNum = argc > 1 ? atoi(argv[1]) : DEFAULT_KEY_NUM;
+    size_t queryNum = argc > 2 ? atoi(argv[2]) : DEFAULT_QUERY_NUM;
+
+    srand(1);
+    std::vector<std::string> keys;
+    std::vector<Record> records;
+    for (size_t i = 0; i < keyNum; i++) {
+        keys.push_back(makeName());
+        records.push_back(makeRecord(i));
+    }
+    std::vector<std::string> prefixes;
+    for (size_t i = 0; i < queryNum; i++) {
+        const std::string& key = keys[rand() % keyNum];
+        prefixes.push_back(key.substr(0, 1 + rand() % MAX_PREFIX_LEN));
+    }
+    printf("%zu keys, %zu prefix queries\n", keyNum, queryNum);
+
+    {
+        auto start = std::chrono::steady_clock::now();
+        RDictionary* rDict = createRDict();
+        for (size_t i = 0; i < keyNum; i++) {
+            Record* record = (Record*) malloc(sizeof(Record));
+            *record = records[i];
+            rDictInsert(rDict, (char*) keys[i].c_str(), record, NULL);
+        }
+        double insertSec = secondsSince(start);
+        long long checksum = 0;
+        start = std::chrono::steady_clock::now();
+        for (const std::string& prefix : prefixes) {
+            int matchedKeyNum, matchedRecordNum, comparedStr, comparedChar, comparedBit;
+            MatchedData** matched = prefixMatching(rDict, (char*) prefix.c_str(), &matchedKeyNum, &matchedRecordNum,
+                                                   &comparedStr, &comparedChar, &comparedBit, NULL);
+            for (int i = 0; i < matchedKeyNum; i++) {
+                for (int j = 0; j < matched[i]->recordNum; j++) {
+                    checksum += ((Record*) matched[i]->list[j])->seatNum;
+                }
+                free(matched[i]);
+            }
+            free(matched);
+        }
+        double querySec = secondsSince(start);
+        start = std::chrono::steady_clock::now();
+        freeRDict(rDict, freeRecord);
+        printRow("C RDictionary (void* records)", insertSec, querySec, secondsSince(start), keyNum, queryNum, checksum);
+    }
+
+    {
+        auto start = std::chrono::steady_clock::now();
+        auto* tree = new rdict::RadixTree<void*>();
+        for (size_t i = 0; i < keyNum; i++) {
+            Record* record = (Record*) malloc(sizeof(Record));
+            *record = records[i];
+            tree->insert(keys[i], record);
+        }
+        double insertSec = secondsSince(start);
+        long long checksum = 0;
+        start = std::chrono::steady_clock::now();
+        for (const std::string& prefix : prefixes) {
+            tree->prefixMatch(prefix, [&checksum](const std::string& key, const std::vector<void*>& values) {
+                for (void* value : values) {
+                    checksum += ((Record*) value)->seatNum;
+                }
+            });
+        }
+        double querySec = secondsSince(start);
+        start = std::chrono::steady_clock::now();
+        tree->prefixMatch("", [](const std::string& key, const std::vector<void*>& values) {
+            for (void* value : values) {
+                free(value);
+            }
+        });
+        delete tree;
+        printRow("RadixTree<void*>", insertSec, querySec, secondsSince(start), keyNum, queryNum, checksum);
+    }
+
+    {
+        auto start = std::chrono::steady_clock::now();
+        auto* tree = new rdict::RadixTree<Record>();
+        for (size_t i = 0; i < keyNum; i++) {
+            tree->insert(keys[i], records[i]);
+        }
+        double insertSec = secondsSince(start);
+        long long checksum = 0;
+        start = std::chrono::steady_clock::now();
+        for (const std::string& prefix : prefixes) {
+            tree->prefixMatch(prefix, [&checksum](const std::string& key, const std::vector<Record>& values) {
+                for (const Record& value : values) {
+                    checksum += value.seatNum;
+                }
+            });
+        }
+        double querySec = secondsSince(start);
+        start = std::chrono::steady_clock::now();
+        delete tree;
+        printRow("RadixTree<Record>", insertSec, querySec, secondsSince(start), keyNum, queryNum, checksum);
+    }
+
+    {
+        auto start = std::chrono::steady_clock::now();
+        auto* tree = new rdict::RadixTree<Record, rdict::ExactKeyTraits, rdict::ComparisonCounting>();
+        for (size_t i = 0; i < keyNum; i++) {
+            tree->insert(keys[i], records[i]);
+        }
+        double insertSec = secondsSince(start);
+        long long checksum = 0;
+        start = std::chrono::steady_clock::now();
+        for (const std::string& prefix : prefixes) {
+            tree->prefixMatch(prefix, [&checksum](const std::string& key, const std::vector<Record>& values) {
+                for (const Record& value : values) {
+                    checksum += value.seatNum;
+                }
+            });
+        }
+        double querySec = secondsSince(start);
+        start = std::chrono::steady_clock::now();
+        delete tree;
+        printRow("RadixTree<Record, Exact, Counting>", insertSec, querySec, secondsSince(start), keyNum, queryNum, checksum);
+    }
+    return 0;
+}
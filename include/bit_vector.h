@@ -0,0 +1,79 @@
+/**
+ * @brief  Bit vector interface.
+ *         A bit vector is built by appending bits, then frozen to answer rank queries
+ *         in constant time. A packed array keeps unsigned integers in a fixed number of bits each.
+ */
+
+#ifndef _BIT_VECTOR_H_
+#define _BIT_VECTOR_H_
+#include <stdio.h>
+#include <stdint.h>
+
+#include "my_bool.h"
+
+typedef struct BitVectorRank BitVector;
+typedef struct PackedIntArray PackedArray;
+
+/**
+ * @brief  Create an empty bit vector
+ */
+BitVector* createBitVector();
+
+/**
+ * @brief  Append a bit to the end of the bit vector
+ * @note   Only allowed before the rank directory is built
+ */
+void bitVectorAppend(BitVector* bv, BOOL bit);
+
+/**
+ * @brief  Build the rank directory, no more bits can be appended after this
+ */
+void bitVectorBuildRank(BitVector* bv);
+
+/**
+ * @brief  Get the bit at a position
+ */
+BOOL bitVectorGet(BitVector* bv, size_t pos);
+
+/**
+ * @brief  Count the 1 bits before a position (the bit at pos itself isn't counted)
+ * @note   The rank directory must have been built
+ */
+size_t bitVectorRank1(BitVector* bv, size_t pos);
+
+/**
+ * @brief  Get the number of bits
+ */
+size_t getBitVectorSize(BitVector* bv);
+
+/**
+ * @brief  Get the number of bytes used by the bit vector
+ */
+size_t getBitVectorMemory(BitVector* bv);
+
+void freeBitVector(BitVector* bv);
+
+/**
+ * @brief  Create a packed array of num integers of width bits each, all set to 0
+ * @param  num:
+ * @param  width: number of bits of each integer, 0 to 64
+ */
+PackedArray* createPackedArray(size_t num, int width);
+
+/**
+ * @brief  Get the number of bits needed to keep an integer
+ */
+int getBitWidth(uint64_t maxValue);
+
+void packedArraySet(PackedArray* pa, size_t idx, uint64_t value);
+
+uint64_t packedArrayGet(PackedArray* pa, size_t idx);
+
+/**
+ * @brief  Get the number of bytes used by the packed array
+ */
+size_t getPackedArrayMemory(PackedArray* pa);
+
+void freePackedArray(PackedArray* pa);
+
+#endif
@@ -10,12 +10,37 @@ data.h :
 #ifndef _DATA_H_
 #define _DATA_H_
 #include <stdio.h>
+#include <stdint.h>
 
 #define MAX_LINE_LEN 512
 #define DATA_FIELD_NUM 14
 
 typedef struct CafeInfo Cafe;
 
+// Fields of a Cafe, in the order of the columns of the data file
+typedef enum {
+    CAFE_CENSUS_YEAR,
+    CAFE_BLOCK_ID,
+    CAFE_PROPERTY_ID,
+    CAFE_BASE_PROPERTY_ID,
+    CAFE_BUILDING_ADDRESS,
+    CAFE_CLUE_SMALL_AREA,
+    CAFE_BUSINESS_ADDRESS,
+    CAFE_TRADING_NAME,
+    CAFE_INDUSTRY_CODE,
+    CAFE_INDUSTRY_DESCRIPTION,
+    CAFE_SEATING_TYPE,
+    CAFE_SEAT_NUM,
+    CAFE_LONGITUDE,
+    CAFE_LATITUDE,
+    CAFE_FIELD_NUM
+} CafeField;
+
+// Kinds of Cafe fields
+#define CAFE_FIELD_INT    0
+#define CAFE_FIELD_STRING 1
+#define CAFE_FIELD_DOUBLE 2
+
 /**
  * @brief Read a line from data file and parse it to form a Cafe item then return this item.
  * 
@@ -54,6 +79,65 @@ void freeCafe(void* cafe);
  */
 void* getTradingName(void* cafe);
 
+/**
+ * @brief Get the number of seats of a cafe, used as its score when ranking cafes
+ * 
+ * @param cafe 
+ * @return double number of seats
+ */
+double getSeatNumScore(void* cafe);
+
+/**
+ * @brief Get a field by its column name in the data file, e.g. "industry_code"
+ * 
+ * @param name 
+ * @return CafeField the field, {CAFE_FIELD_NUM} if there is no such column
+ */
+CafeField getCafeFieldByName(char* name);
+
+/**
+ * @brief Get the column name of a field in the data file
+ * 
+ * @param field 
+ * @return char* column name, owned by the data module
+ */
+char* getCafeFieldName(CafeField field);
+
+/**
+ * @brief Get the kind of a field
+ * 
+ * @param field 
+ * @return int {CAFE_FIELD_INT}, {CAFE_FIELD_STRING} or {CAFE_FIELD_DOUBLE}
+ */
+int getCafeFieldKind(CafeField field);
+
+/**
+ * @brief Get the value of a string field of a cafe, without copying it
+ * 
+ * @param cafe 
+ * @param field a {CAFE_FIELD_STRING} field
+ * @return char* the string owned by the cafe
+ */
+char* getCafeStringField(Cafe* cafe, CafeField field);
+
+/**
+ * @brief Get the value of an integer field of a cafe
+ * 
+ * @param cafe 
+ * @param field a {CAFE_FIELD_INT} field
+ * @return int 
+ */
+int getCafeIntField(Cafe* cafe, CafeField field);
+
+/**
+ * @brief Get the value of a double field (longitude or latitude) of a cafe
+ * 
+ * @param cafe 
+ * @param field a {CAFE_FIELD_DOUBLE} field
+ * @return double 
+ */
+double getCafeDoubleField(Cafe* cafe, CafeField field);
+
 /**
  * @brief Free space for a trading name string.
  * 
@@ -72,6 +156,15 @@ void freeTradingNameString(void* tradingName);
  */
 int cmpTradingName(void* name1, void* name2);
 
+/**
+ * @brief Hash a trading name (FNV-1a, with its bits mixed at the end so that every bit of the
+ *        hash depends on every char)
+ * 
+ * @param tradingName 
+ * @return uint64_t 
+ */
+uint64_t hashTradingName(void* tradingName);
+
 /**
  * @brief compare trading name char by char, and record the number of char comparison
  * 
@@ -0,0 +1,109 @@
+/**
+ * @brief  Cafe store interface.
+ *         Keeps every Cafe once, in a record store, with any number of secondary indexes over its fields:
+ *         string fields are indexed by radix trees, integer fields by integer radix trees.
+ *         Indexes hold record IDs rather than Cafes, and the records of a key are kept in ascending
+ *         order of IDs, so a conjunctive query intersects them as sorted posting lists.
+ */
+
+#ifndef _CAFE_INDEX_H_
+#define _CAFE_INDEX_H_
+#include <stdio.h>
+
+#include "cafe_data.h"
+#include "my_bool.h"
+
+// Ways a condition matches the value of a field
+// CAFE_MATCH_EXACT:  string or integer field equal to the value
+// CAFE_MATCH_PREFIX: string field starting with the value
+// CAFE_MATCH_RANGE:  integer field between low and high (both included)
+#define CAFE_MATCH_EXACT  0
+#define CAFE_MATCH_PREFIX 1
+#define CAFE_MATCH_RANGE  2
+
+// Separator of conditions in a query, e.g. "industry_code=4511&&clue_small_area=Carlton"
+#define CAFE_QUERY_AND "&&"
+
+typedef struct CafeStoreStruct CafeStore;
+
+// A condition on one field, used in conjunctive queries
+typedef struct CafeConditionStruct CafeCondition;
+struct CafeConditionStruct {
+    CafeField field;
+    int matchType;
+    char* text;     // string fields
+    int low;        // integer fields, the value for CAFE_MATCH_EXACT
+    int high;       // integer fields, CAFE_MATCH_RANGE only
+};
+
+
+/**
+ * @brief Cafe store creation, without any index.
+ *
+ * @return CafeStore*
+ */
+CafeStore* createCafeStore();
+
+
+/**
+ * @brief Declare a field indexed. Fields must be declared before any cafe is added.
+ *
+ * @param store
+ * @param field a string or integer field, {CAFE_FIELD_DOUBLE} fields can't be indexed
+ * @return TRUE if the field is indexed
+ */
+BOOL cafeStoreIndexField(CafeStore* store, CafeField field);
+
+
+/**
+ * @brief Add a cafe to the store and to every index. The store takes the cafe.
+ *
+ * @param store
+ * @param cafe
+ */
+void cafeStoreAdd(CafeStore* store, Cafe* cafe);
+
+
+/**
+ * @brief Get the number of cafes in the store
+ */
+size_t getCafeStoreSize(CafeStore* store);
+
+
+/**
+ * @brief Parse a query into conditions, e.g. "industry_code=4511&&clue_small_area=Carl*&&number_of_seats=10..50".
+ *        A string value ending with '*' is a prefix, an integer value "low..high" is a range.
+ * @note The line is changed in place, the texts of the conditions point into it.
+ *
+ * @param line
+ * @param conditions
+ * @param maxConditionNum size of conditions
+ * @return number of conditions, -1 if the query is not valid
+ */
+int parseCafeQuery(char* line, CafeCondition* conditions, int maxConditionNum);
+
+
+/**
+ * @brief Find the cafes matching every condition. Posting lists of the indexed conditions are
+ *        intersected shortest first, then the other conditions are checked on the remaining cafes.
+ *
+ * @param store
+ * @param conditions
+ * @param conditionNum
+ * @param matchedNum number of cafes matched
+ * @param scannedNum number of cafes checked against conditions without an index
+ * @return matched cafes in the order they were added (owned by the store)
+ */
+Cafe** cafeStoreQuery(CafeStore* store, CafeCondition* conditions, int conditionNum,
+                        int* matchedNum, int* scannedNum);
+
+
+/**
+ * @brief Free a cafe store with its indexes and cafes
+ *
+ * @param store
+ */
+void freeCafeStore(CafeStore* store);
+
+
+#endif
@@ -10,6 +10,7 @@ dictionary.h :
 #ifndef _LIST_H_
 #define _LIST_H_
 #include <stdio.h>
+#include <stdint.h>
 
 #define TRUE 1
 #define FALSE 0
@@ -23,6 +24,16 @@ typedef struct LinkedList Dictionary;
  */
 Dictionary* createDict();
 
+/**
+ * @brief Create a Dictionary with a hash index on its keys, so searchDictByKey finds the items
+ *        of a key without scanning the others. Items are still kept in the order they are appended.
+ * 
+ * @param fHash hash of a key, all of its bits are used
+ * @param compare compares two keys, 0 if they are equal
+ * @return Dictionary* 
+ */
+Dictionary* createHashedDict(uint64_t (*fHash)(void*), int (*compare)(void*, void*));
+
 /**
  * @brief Append a new node to the tail of a dictionary (linked list).
  * 
@@ -43,6 +54,8 @@ void* dictDeleteHead(Dictionary* dict);
 /**
  * @brief Use the key to search nodes in the dictionary. 
  *        A pointer to function is used to decouple this module from the data module.
+ *        A hashed dictionary only looks at the keys with the same hash as the given one, so it
+ *        only finds keys equal to it.
  * 
  * @param dict 
  * @param matchedNum 
@@ -53,6 +66,47 @@ void* dictDeleteHead(Dictionary* dict);
 void** searchDictByKey(Dictionary* dict, void* key, int* matchedNum, int* comparedKeyNum, 
                         int* countCompare, int (*compare)(void*, void*, int*));
 
+/**
+ * @brief Keep a packed copy of the keys, which must be strings, for searchDictByPrefix and
+ *        searchDictByPredicate: their bytes one after another in one buffer, and their lengths and
+ *        first 8 bytes in arrays of their own, so a scan reads memory in order and most keys are
+ *        rejected by one integer comparison. It is kept up to date by dictAppend and dictDeleteHead.
+ * 
+ * @param dict 
+ * @param threadNum number of threads scanning a large dictionary, including the calling one.
+ *                  1 or less scans on the calling thread only.
+ */
+void dictEnablePackedKeys(Dictionary* dict, int threadNum);
+
+/**
+ * @brief Search the items whose key starts with the given prefix, in the order they were appended.
+ *        Keys must be strings. With packed keys (dictEnablePackedKeys) they are scanned in memory
+ *        order, 16 bytes at a time, and split across threads if there are many, otherwise the list is
+ *        walked. Chars are counted as cmpTradingNameAndCount counts them.
+ * 
+ * @param dict 
+ * @param prefix 
+ * @param matchedNum 
+ * @param comparedKeyNum 
+ * @param countCompare 
+ * @return void** A list of pointers to the matched values in the given dictionary.
+ */
+void** searchDictByPrefix(Dictionary* dict, char* prefix, int* matchedNum, int* comparedKeyNum, int* countCompare);
+
+/**
+ * @brief Search the items whose key a predicate holds for, in the order they were appended. With
+ *        packed keys (dictEnablePackedKeys) the predicate is given the packed copy of each key, and
+ *        the keys are split across threads if there are many, so it must be safe to call from
+ *        several threads at once.
+ * 
+ * @param dict 
+ * @param predicate non-zero if the item of a key matches
+ * @param arg passed to every call of predicate
+ * @param matchedNum 
+ * @return void** A list of pointers to the matched values in the given dictionary.
+ */
+void** searchDictByPredicate(Dictionary* dict, int (*predicate)(void*, void*), void* arg, int* matchedNum);
+
 /**
  * @brief Free a dictionary, including the key and value in each node.
  * 
@@ -0,0 +1,48 @@
+/**
+ * @brief  Frozen radix tree interface.
+ *         A read-only, succinct copy of a radix tree dictionary. The shape of the tree is kept
+ *         as one bit per node (LOUDS), keys and data records are kept in packed arrays,
+ *         so no node structs or pointers between nodes are left.
+ */
+
+#ifndef _FROZEN_RADIX_TREE_H_
+#define _FROZEN_RADIX_TREE_H_
+#include <stdio.h>
+
+#include "radix_tree_dictionary.h"
+
+typedef struct FrozenRadixTree FrozenRDictionary;
+
+/**
+ * @brief  Convert a radix tree dictionary into a frozen one. The radix tree dictionary is freed,
+ *         its data records are moved to the frozen dictionary.
+ * @note   The substring index, the prefix filter, the result cache and the scores of the radix tree are not kept.
+ * @param  rDict:
+ * @retval the frozen dictionary
+ */
+FrozenRDictionary* rDictFreeze(RDictionary* rDict);
+
+/**
+ * @brief  Search a frozen dictionary using given key (prefix), in the same way as prefixMatching.
+ *         '\0' at the end of strings will be ignored in searching process.
+ * @param  fDict:
+ * @param  givenKey:
+ * @param  matchedKeyNum: number of keys (strings) that matches the prefix
+ * @param  matchedRecordNum: number of data entries collected
+ * @retval all data records that matches the given prefix, in the same order as prefixMatching
+ */
+MatchedData** frozenPrefixMatching(FrozenRDictionary* fDict, char* givenKey, int* matchedKeyNum, int* matchedRecordNum);
+
+/**
+ * @brief  Get the number of bytes used by a frozen dictionary (data records themselves are not counted)
+ */
+size_t getFrozenRDictMemory(FrozenRDictionary* fDict);
+
+/**
+ * @brief  Free a frozen dictionary
+ * @param  fDict:
+ * @param  fFreeData: method used to free data entries
+ */
+void freeFrozenRDict(FrozenRDictionary* fDict, void (*fFreeData)(void*));
+
+#endif
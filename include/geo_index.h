@@ -0,0 +1,91 @@
+/**
+ * @brief  Geospatial index interface.
+ *         Points are kept in an integer radix tree under Morton (geohash) keys: longitude and
+ *         latitude are each quantised to 32 bits and their bits are interleaved, longitude first.
+ *         Every node of the tree is then a rectangular cell, halved by each further bit, so
+ *         searches only descend into the cells that can hold an answer.
+ *
+ *         Distances are planar (equirectangular, scaled at the latitude of the query point),
+ *         which is accurate over the extent of a city. Cells don't wrap across the 180th meridian.
+ */
+
+#ifndef _GEO_INDEX_H_
+#define _GEO_INDEX_H_
+#include <stdio.h>
+
+typedef struct GeoIndexStruct GeoIndex;
+
+
+/**
+ * @brief Geospatial index creation.
+ *
+ * @return GeoIndex*
+ */
+GeoIndex* createGeoIndex();
+
+
+/**
+ * @brief Insert a data item at a point.
+ *
+ * @param geo
+ * @param longitude from -180 to 180
+ * @param latitude from -90 to 90
+ * @param data
+ */
+void geoIndexInsert(GeoIndex* geo, double longitude, double latitude, void* data);
+
+
+/**
+ * @brief Search for the data items inside a bounding box (borders included).
+ *        Cells outside the box are skipped and cells inside it are collected without checking their points.
+ *
+ * @param geo
+ * @param minLongitude
+ * @param minLatitude
+ * @param maxLongitude
+ * @param maxLatitude
+ * @param matchedNum number of data items in the box
+ * @return data items in the box, in Morton order
+ */
+void** geoBoxSearch(GeoIndex* geo, double minLongitude, double minLatitude,
+                    double maxLongitude, double maxLatitude, int* matchedNum);
+
+
+/**
+ * @brief Search for the k data items nearest to a point. Cells are visited nearest first,
+ *        so the search stops once k items are closer than every cell left.
+ *
+ * @param geo
+ * @param longitude
+ * @param latitude
+ * @param k maximum number of items returned
+ * @param matchedNum number of items returned
+ * @param distances distances of the returned items in metres, of size k. Pass NULL if not needed.
+ * @return data items, nearest first. Items at equal distances come in no particular order.
+ */
+void** geoNearest(GeoIndex* geo, double longitude, double latitude, int k, int* matchedNum, double* distances);
+
+
+/**
+ * @brief Get the distance from a point to another in metres, as used by geoNearest
+ *        (scaled at the latitude of the first point).
+ */
+double geoDistance(double longitude1, double latitude1, double longitude2, double latitude2);
+
+
+/**
+ * @brief Get the number of data items
+ */
+size_t getGeoIndexSize(GeoIndex* geo);
+
+
+/**
+ * @brief Free a geospatial index
+ *
+ * @param geo
+ * @param fFreeData method used to free data items
+ */
+void freeGeoIndex(GeoIndex* geo, void (*fFreeData)(void*));
+
+
+#endif
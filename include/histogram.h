@@ -0,0 +1,84 @@
+/**
+ * @brief  Latency histogram interface.
+ *         Values (e.g. nanoseconds) are counted in log-linear buckets: values below
+ *         HISTOGRAM_SUB_BUCKET_NUM have a bucket each, and every power of two above that is split
+ *         into HISTOGRAM_SUB_BUCKET_NUM / 2 buckets, so a value is known within 1/64 of itself
+ *         whatever its size. Recording is a shift and an increment, and histograms of different
+ *         threads or runs can be merged exactly.
+ */
+
+#ifndef _HISTOGRAM_H_
+#define _HISTOGRAM_H_
+#include <stdio.h>
+#include <stdint.h>
+
+#define HISTOGRAM_SUB_BUCKET_BITS 7
+#define HISTOGRAM_SUB_BUCKET_NUM (1 << HISTOGRAM_SUB_BUCKET_BITS)
+
+typedef struct LogLinearHistogram Histogram;
+
+/**
+ * @brief  Create an empty histogram
+ */
+Histogram* createHistogram();
+
+/**
+ * @brief  Count one value
+ */
+void histogramRecord(Histogram* histogram, uint64_t value);
+
+/**
+ * @brief  Count one value while other threads may read the histogram. There must be only one
+ *         writing thread: each field is updated with a relaxed atomic store, which costs the same
+ *         as histogramRecord. Readers may see a value counted in one field and not yet in another.
+ */
+void histogramRecordShared(Histogram* histogram, uint64_t value);
+
+/**
+ * @brief  Add the counts of src to dest
+ */
+void histogramMerge(Histogram* dest, Histogram* src);
+
+/**
+ * @brief  Forget every value
+ */
+void histogramReset(Histogram* histogram);
+
+/**
+ * @brief  Get the number of values counted
+ */
+uint64_t getHistogramCount(Histogram* histogram);
+
+/**
+ * @brief  Get the mean of the values counted, 0 if there is none
+ */
+double getHistogramMean(Histogram* histogram);
+
+/**
+ * @brief  Get the largest value counted (exact), 0 if there is none
+ */
+uint64_t getHistogramMax(Histogram* histogram);
+
+/**
+ * @brief  Get the value below or at which the given percentage of the values are
+ * @param  histogram:
+ * @param  percentile: from 0 to 100
+ * @retval the highest value of the bucket holding that value, at most the largest value counted
+ */
+uint64_t getHistogramPercentile(Histogram* histogram, double percentile);
+
+/**
+ * @brief  Print the distribution of the values, one line per percentile (50, 75, 87.5, ...
+ *         halving the rest each time, up to the largest value), with the number of values below.
+ * @param  histogram:
+ * @param  out:
+ * @param  unitScale: values are divided by it when printed, e.g. 1000 to print nanoseconds as microseconds
+ */
+void printHistogram(Histogram* histogram, FILE* out, double unitScale);
+
+/**
+ * @brief  Free a histogram
+ */
+void freeHistogram(Histogram* histogram);
+
+#endif
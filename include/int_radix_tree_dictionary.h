@@ -0,0 +1,92 @@
+/**
+ * @brief  Integer radix tree dictionary interface.
+ *         A Patricia tree over fixed-width unsigned integer keys (e.g. property IDs). It branches on
+ *         the bits of the key from the most significant one, like the string radix tree does on
+ *         the bits of a string, but each comparison is a single XOR of two integers.
+ */
+
+#ifndef _INT_RADIX_TREE_DICTIONARY_H_
+#define _INT_RADIX_TREE_DICTIONARY_H_
+#include <stdio.h>
+#include <stdint.h>
+
+// Widths of integer keys
+#define IRDICT_KEY_32 32
+#define IRDICT_KEY_64 64
+
+typedef struct IntRadixTree IRDictionary;
+
+// Data structure for searching
+typedef struct MatchedIntDataStruct MatchedIntData;
+struct MatchedIntDataStruct {
+    uint64_t key;
+    void** list;
+    int recordNum;
+};
+
+
+/**
+ * @brief Integer Radix Tree Dictionary creation.
+ *
+ * @param keyBits width of the keys, IRDICT_KEY_32 or IRDICT_KEY_64
+ * @return IRDictionary*
+ */
+IRDictionary* createIRDict(int keyBits);
+
+
+/**
+ * @brief Insert a new data item with its key.
+ *
+ * @param irDict
+ * @param key must fit in the width of the keys
+ * @param data
+ */
+void irDictInsert(IRDictionary* irDict, uint64_t key, void* data);
+
+
+/**
+ * @brief Search for the keys whose highest prefixBits bits are the same as those of the given key.
+ *        With prefixBits equal to the width of the keys, only the given key itself matches.
+ *
+ * @param irDict
+ * @param key
+ * @param prefixBits number of high bits compared, from 0 to the width of the keys
+ * @param matchedKeyNum number of keys that match
+ * @param matchedRecordNum number of data entries collected
+ * @return all data records of the matched keys, in ascending order of keys
+ */
+MatchedIntData** irDictPrefixMatching(IRDictionary* irDict, uint64_t key, int prefixBits,
+                                      int* matchedKeyNum, int* matchedRecordNum);
+
+
+/**
+ * @brief Search for the keys in a range. Subtrees outside the range are skipped,
+ *        subtrees inside it are collected without further comparisons.
+ *
+ * @param irDict
+ * @param low smallest key of the range
+ * @param high largest key of the range
+ * @param matchedKeyNum number of keys in the range
+ * @param matchedRecordNum number of data entries collected
+ * @return all data records of the keys in the range, in ascending order of keys
+ */
+MatchedIntData** irDictRangeMatching(IRDictionary* irDict, uint64_t low, uint64_t high,
+                                     int* matchedKeyNum, int* matchedRecordNum);
+
+
+/**
+ * @brief Get the number of different keys
+ */
+size_t getIRDictSize(IRDictionary* irDict);
+
+
+/**
+ * @brief Free an entire integer radix tree dictionary
+ *
+ * @param irDict
+ * @param fFreeData method used to free data entries
+ */
+void freeIRDict(IRDictionary* irDict, void (*fFreeData)(void*));
+
+
+#endif
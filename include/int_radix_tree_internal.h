@@ -0,0 +1,58 @@
+/**
+ * @brief  Integer radix tree internals, shared by the modules that walk the nodes of an
+ *         integer radix tree dictionary themselves (e.g. the geospatial index). Users of the
+ *         dictionary should only need int_radix_tree_dictionary.h.
+ */
+
+#ifndef _INT_RADIX_TREE_INTERNAL_H_
+#define _INT_RADIX_TREE_INTERNAL_H_
+#include <stdio.h>
+#include <stdint.h>
+
+#include "int_radix_tree_dictionary.h"
+
+// Keys are kept in 64 bits, narrower keys have their unused high bits set to 0.
+#define IR_KEY_BITS 64
+
+typedef struct IntRadixTreeNode IRNode;
+struct IntRadixTreeNode {
+    uint64_t key;           // leaves: the key. Other nodes: any key below, its highest prefixBits bits are the prefix.
+    uint32_t prefixBits;    // number of high bits shared by every key below, IR_KEY_BITS for leaves
+    uint32_t recordNum;     // leaves only
+    union {
+        struct {            // other nodes always have both branches
+            IRNode* branchA;
+            IRNode* branchB;
+        };
+        union {             // leaves
+            void* record;   // the only record
+            void** list;    // records, if there are more than one
+        };
+    };
+};
+
+struct IntRadixTree {
+    IRNode* root;
+    int keyBits;            // IRDICT_KEY_32 or IRDICT_KEY_64
+    size_t keyNum;
+};
+
+
+// Check whether a node is a leaf.
+static inline int isIRLeaf(IRNode* node) {
+    return node->prefixBits == IR_KEY_BITS;
+}
+
+
+// Get the records of a leaf as a list.
+static inline void** getIRLeafRecords(IRNode* leaf) {
+    return leaf->recordNum == 1 ? &leaf->record : leaf->list;
+}
+
+
+// Get a mask of the highest bitNum bits.
+static inline uint64_t getIRHighMask(uint32_t bitNum) {
+    return bitNum == 0 ? 0 : ~(uint64_t) 0 << (IR_KEY_BITS - bitNum);
+}
+
+#endif
@@ -0,0 +1,34 @@
+/** 
+ * @brief  Key normalisation interface.
+ *         ASCII letters become lower case and accented Latin-1 bytes lose their accents. Bytes of
+ *         well-formed UTF-8 multibyte sequences are kept, except that upper case Latin-1 letters
+ *         (U+00C0 to U+00DE) become lower case, so e.g. "CAFÉ" and "café" fold alike but not to "cafe".
+ *         Folding never changes the length of a key, but a byte may fold differently depending on the
+ *         bytes around it, so keys are folded whole (or byte by byte with normaliseByteAt).
+ */
+
+#ifndef _KEY_NORMALISE_H_
+#define _KEY_NORMALISE_H_
+#include <stdio.h>
+
+/**
+ * @brief  Fold byte i of a key of len bytes, as normaliseKey folds it within the key.
+ *         Bytes of a well-formed UTF-8 sequence depend on the bytes around them.
+ */
+unsigned char normaliseByteAt(const char* key, size_t len, size_t i);
+
+/**
+ * @brief  Fold the first len bytes of src into dest.
+ * @note   dest and src may be the same buffer. '\0' is kept as it is.
+ * @param  dest: 
+ * @param  src: 
+ * @param  len: 
+ */
+void normaliseKey(char* dest, const char* src, size_t len);
+
+/**
+ * @brief  Get a folded copy of a string
+ */
+char* getNormalisedKey(const char* key);
+
+#endif
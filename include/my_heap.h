@@ -0,0 +1,40 @@
+/**
+ * @brief  Interface of Heap.
+ *         A binary max-heap of items ordered by a priority, the item with the largest
+ *         priority is popped first.
+ */
+
+#ifndef _MY_HEAP_H_
+#define _MY_HEAP_H_
+#include <stdio.h>
+
+typedef struct MyHeap Heap;
+
+// get a new heap
+Heap* newHeap();
+
+/**
+ * @brief  Add a new item to the heap
+ * @param  heap:
+ * @param  item:
+ * @param  tag: a small integer kept with the item, e.g. to tell different kinds of items apart
+ * @param  priority:
+ */
+void heapPush(Heap* heap, void* item, int tag, double priority);
+
+/**
+ * @brief  Pop the item with the largest priority
+ * @param  heap:
+ * @param  tag: tag of the popped item, pass NULL if not needed
+ * @param  priority: priority of the popped item, pass NULL if not needed
+ * @retval the item, NULL if the heap is empty
+ */
+void* heapPop(Heap* heap, int* tag, double* priority);
+
+// Get the size of a heap
+size_t getHeapSize(Heap* heap);
+
+// Free a heap, items are not freed
+void freeHeap(Heap* heap);
+
+#endif
@@ -1,6 +1,11 @@
 #pragma once
 #include "radix_tree_dictionary.h"
 
+// Number of edits allowed by a fuzzy search if the request doesn't give one.
+#define DEFAULT_MAX_EDITS 1
+// Larger numbers of edits are lowered to this, as they match most of the notebook anyway.
+#define MAX_EDITS_LIMIT 8
+
 /**
  * @brief Get a JSON string representing the notebook.
  * 
@@ -36,10 +41,25 @@ void insertNotebook(RDictionary* notebook, cJSON* payload, char** execPath);
 MatchedData** searchNotebook(RDictionary* notebook, cJSON* payload, int* matchedKeyNum, int* matchedNum, int* comparedStr, int* comparedChar, int* comparedBit, char** execPath);
 
 
+/**
+ * @brief Search notebook for keys within a number of edits of the given key.
+ * 
+ * @param notebook
+ * @param jsonPayload with "key" and optional "maxEdits" (default {DEFAULT_MAX_EDITS}, at most {MAX_EDITS_LIMIT})
+ * @param matchedKeyNum number of keys within the distance
+ * @param matchedNum number of data within the distance
+ * @return all data records whose keys are within the distance, NULL if the payload has no string
+ *         "key" or a negative "maxEdits"
+ */
+MatchedData** fuzzySearchNotebook(RDictionary* notebook, cJSON* payload, int* matchedKeyNum, int* matchedNum);
+
+
 /**
  * @brief Create a new notebook
+ * 
+ * @param keyMode RDICT_KEY_EXACT or RDICT_KEY_FOLDED
  */
-RDictionary* createNotebook();
+RDictionary* createNotebook(int keyMode);
 
 
 /**
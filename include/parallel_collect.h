@@ -0,0 +1,27 @@
+/**
+ * @brief  Parallel collection of the keys in subtrees of a radix tree dictionary.
+ *         Each subtree is a task of a work-stealing pool. While a task walks its subtree, it hands
+ *         the right branch of a node over to the pool whenever its worker has nothing queued, so
+ *         idle workers can steal it. A task remembers where the results of the branches it handed
+ *         over belong, and the results are put together in the same order as collectData's.
+ */
+
+#ifndef _PARALLEL_COLLECT_H_
+#define _PARALLEL_COLLECT_H_
+#include <stdio.h>
+
+#include "radix_tree_internal.h"
+#include "work_pool.h"
+
+/**
+ * @brief  Collect the keys of subtrees, in depth-first order (branchA first), one subtree after another
+ * @param  pool:
+ * @param  roots: roots of the subtrees
+ * @param  rootNum:
+ * @param  matchedKeyNum: set to the number of keys collected
+ * @param  recordNum: set to the number of data records of those keys
+ * @retval list of matchedKeyNum matched keys, each one and the list are freed by the caller
+ */
+MatchedData** parallelCollect(WorkPool* pool, RNode** roots, int rootNum, int* matchedKeyNum, int* recordNum);
+
+#endif
@@ -0,0 +1,153 @@
+/**
+ * @brief  Hardware performance counter interface.
+ *         Cycles, instructions, L1 data cache misses, last level cache misses, data TLB misses and
+ *         branch misses are read with perf_event_open around instrumented operations, and added up
+ *         per operation. Counters are opened as one group per thread, on the first operation of
+ *         the thread, and count the user space work of that thread only.
+ *         Counters the kernel or the machine doesn't allow (perf_event_paranoid, virtual machines
+ *         without a PMU, ...) are left out and reported as not available; if none can be opened,
+ *         the instrumentation stays off.
+ */
+
+#ifndef _PERF_COUNTERS_H_
+#define _PERF_COUNTERS_H_
+#include <stdio.h>
+#include <stdint.h>
+
+#include "my_bool.h"
+
+typedef enum {
+    PERF_COUNTER_CYCLES,
+    PERF_COUNTER_INSTRUCTIONS,
+    PERF_COUNTER_L1D_MISSES,
+    PERF_COUNTER_LLC_MISSES,
+    PERF_COUNTER_DTLB_MISSES,
+    PERF_COUNTER_BRANCH_MISSES,
+    PERF_COUNTER_NUM
+} PerfCounterId;
+
+// Instrumented operations. Counts are inclusive, e.g. prefixMatching includes its collectData.
+typedef enum {
+    PERF_OP_RDICT_INSERT,
+    PERF_OP_PREFIX_MATCHING,
+    PERF_OP_COLLECT_DATA,
+    PERF_OP_NUM
+} PerfOpId;
+
+// Counter values at the start of an operation
+typedef struct PerfSampleStruct PerfSample;
+struct PerfSampleStruct {
+    BOOL started;
+    uint64_t values[PERF_COUNTER_NUM];
+    uint64_t timeEnabled;
+    uint64_t timeRunning;
+};
+
+// Totals of an operation, scaled up when the counters were multiplexed with other events
+typedef struct PerfOpStatsStruct PerfOpStats;
+struct PerfOpStatsStruct {
+    uint64_t callNum;                   // calls counted in the totals
+    uint64_t unscheduledNum;            // calls during which the counters never ran, left out of the totals
+    double totals[PERF_COUNTER_NUM];
+};
+
+// TRUE while counting, read on every instrumented operation. Use perfEnable() to change it.
+extern int perfCountersOn;
+
+/**
+ * @brief Read the counters at the start of an operation, if counting is on.
+ *
+ * @param sample a PerfSample* kept until PERF_END
+ */
+#define PERF_BEGIN(sample)                                                              \
+    do {                                                                                \
+        (sample)->started = FALSE;                                                      \
+        if (perfCountersOn) {                                                           \
+            perfSampleBegin(sample);                                                    \
+        }                                                                               \
+    } while (0)
+
+/**
+ * @brief Read the counters at the end of an operation and add the differences to it.
+ *
+ * @param sample the PerfSample* given to PERF_BEGIN
+ * @param op PerfOpId
+ */
+#define PERF_END(sample, op)                                                            \
+    do {                                                                                \
+        if ((sample)->started) {                                                        \
+            perfSampleEnd((sample), (op));                                              \
+        }                                                                               \
+    } while (0)
+
+
+/**
+ * @brief Open the counters of the calling thread and turn counting on.
+ *        The reason is printed to stderr if a counter can't be opened.
+ *
+ * @return TRUE if at least one counter is available; otherwise counting stays off
+ */
+BOOL perfEnable();
+
+
+/**
+ * @brief Turn counting off and close the counters of the calling thread.
+ *        The totals are kept.
+ */
+void perfDisable();
+
+
+/**
+ * @brief Check whether a counter could be opened. Only known once perfEnable() has been called.
+ *
+ * @param counter
+ */
+BOOL isPerfCounterAvailable(PerfCounterId counter);
+
+
+/**
+ * @brief Use the PERF_BEGIN macro instead of calling this directly.
+ */
+void perfSampleBegin(PerfSample* sample);
+
+
+/**
+ * @brief Use the PERF_END macro instead of calling this directly.
+ */
+void perfSampleEnd(PerfSample* sample, PerfOpId op);
+
+
+/**
+ * @brief Get the totals of an operation.
+ *
+ * @param op
+ * @param stats
+ */
+void getPerfOpStats(PerfOpId op, PerfOpStats* stats);
+
+
+/**
+ * @brief Get a percentile of the cycles taken by one call of an operation.
+ *
+ * @param op
+ * @param percentile from 0 to 100
+ */
+uint64_t getPerfCallCyclesPercentile(PerfOpId op, double percentile);
+
+
+/**
+ * @brief Forget the totals of every operation.
+ */
+void perfReset();
+
+
+/**
+ * @brief Write the totals and the counts per call of every operation that has been called,
+ *        and the per-call cycles distribution.
+ *
+ * @param f output file
+ */
+void perfPrint(FILE* f);
+
+
+#endif
@@ -0,0 +1,53 @@
+/**
+ * @brief  Prefix filter interface.
+ *         A blocked Bloom filter over the leading bytes of a set of keys: every prefix of 1 to
+ *         prefixLen bytes of a key is added, so a query prefix that isn't in the filter can't
+ *         start any key. All the bits of one prefix are in the same 512-bit block, so a check
+ *         costs a single cache miss. There are no false negatives.
+ */
+
+#ifndef _PREFIX_FILTER_H_
+#define _PREFIX_FILTER_H_
+#include <stdio.h>
+
+#include "my_bool.h"
+
+// Longest prefix kept by a filter
+#define PREFIX_FILTER_MAX_LEN 32
+
+typedef struct BloomPrefixFilter PrefixFilter;
+
+/**
+ * @brief  Create a prefix filter
+ * @param  prefixLen: number of leading bytes of each key whose prefixes are added, from 1 to {PREFIX_FILTER_MAX_LEN}.
+ *                    Longer queries are only checked on their first prefixLen bytes.
+ * @param  expectedKeyNum: number of keys the filter is sized for. More keys can be added,
+ *                         at a higher false positive rate.
+ * @param  falsePositiveRate: rate of absent prefixes that pass the filter with expectedKeyNum keys, e.g. 0.01.
+ *                            Smaller rates use more memory.
+ * @param  folded: TRUE if keys and prefixes should be matched case- and accent-insensitively
+ */
+PrefixFilter* createPrefixFilter(int prefixLen, size_t expectedKeyNum, double falsePositiveRate, BOOL folded);
+
+/**
+ * @brief  Add the prefixes of a key to the filter
+ */
+void prefixFilterAdd(PrefixFilter* filter, char* key);
+
+/**
+ * @brief  Check whether some key added to the filter may start with a prefix.
+ * @retval FALSE if no key starts with the prefix, TRUE if one may (always TRUE for an empty prefix)
+ */
+BOOL prefixFilterMayContain(PrefixFilter* filter, char* prefix);
+
+/**
+ * @brief  Get the number of bytes used by the filter
+ */
+size_t getPrefixFilterMemory(PrefixFilter* filter);
+
+/**
+ * @brief  Free the filter
+ */
+void freePrefixFilter(PrefixFilter* filter);
+
+#endif
@@ -0,0 +1,269 @@
+/**
+ * @brief  Header-only C++ radix tree.
+ *         The same bitwise Patricia tree as radix_tree_dictionary.c, for C++ callers:
+ *         - values are stored inline in the leaves (RadixTree<Cafe> keeps the Cafe itself,
+ *           RadixTree<void*> behaves like the C dictionary),
+ *         - KeyTraits decides how key bytes are read (exact or folded) at compile time,
+ *         - CountingPolicy decides whether comparisons are counted, NoCounting compiles to nothing,
+ *         - values are moved in on insert and destroyed with the tree, no free functions are passed.
+ *
+ *         A node covers the bits of its prefix from the end of its parent up to endBit, starting with
+ *         the bit that chose it, exactly like RNode. Instead of a copy of those bits, a node points at
+ *         the key of a leaf below it, since every key in the subtree shares them.
+ */
+
+#ifndef _RADIX_TREE_HPP_
+#define _RADIX_TREE_HPP_
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+extern "C" {
+#include "key_normalise.h"
+}
+
+namespace rdict {
+
+// Key bytes are compared as they are, like RDICT_KEY_EXACT.
+struct ExactKeyTraits {
+    static unsigned char fold(std::string_view key, size_t byteIdx) { return (unsigned char) key[byteIdx]; }
+};
+
+// Key bytes are case-folded and accent-stripped, like RDICT_KEY_FOLDED.
+struct FoldedKeyTraits {
+    static unsigned char fold(std::string_view key, size_t byteIdx) { return normaliseByteAt(key.data(), key.size(), byteIdx); }
+};
+
+// Comparisons are not counted.
+struct NoCounting {
+    void countBits(size_t bitNum) {}
+    void countString() {}
+};
+
+// Comparisons are counted in the same way as prefixMatching.
+struct ComparisonCounting {
+    size_t comparedBit = 0;
+    size_t comparedChar = 0;
+    size_t comparedStr = 0;
+
+    void countBits(size_t bitNum) {
+        comparedBit += bitNum;
+        comparedChar += (bitNum + BIT_PER_CHAR - 1) / BIT_PER_CHAR;
+    }
+    void countString() { comparedStr ++; }
+
+private:
+    static constexpr size_t BIT_PER_CHAR = 8;
+};
+
+
+template <typename V, typename KeyTraits = ExactKeyTraits, typename CountingPolicy = NoCounting>
+class RadixTree {
+public:
+    RadixTree() = default;
+    ~RadixTree() { clear(); }
+
+    RadixTree(const RadixTree&) = delete;
+    RadixTree& operator=(const RadixTree&) = delete;
+
+    RadixTree(RadixTree&& other) noexcept
+        : root(other.root), keyNum(other.keyNum), counter(std::move(other.counter)) {
+        other.root = nullptr;
+        other.keyNum = 0;
+    }
+
+    RadixTree& operator=(RadixTree&& other) noexcept {
+        if (this != &other) {
+            clear();
+            root = other.root;
+            keyNum = other.keyNum;
+            counter = std::move(other.counter);
+            other.root = nullptr;
+            other.keyNum = 0;
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Insert a value with its key. '\0' at the end of the key is counted, as in rDictInsert.
+     *        Values of the same key are kept in insertion order.
+     */
+    void insert(std::string_view key, V value) {
+        Node** link = &root;
+        size_t startBit = 0;
+        while (*link != nullptr) {
+            Node* node = *link;
+            size_t diffBit = firstDifferentBit(key, *node->repKey, startBit, node->endBit);
+            if (diffBit < node->endBit) {
+                // split: a new node with the common prefix becomes the parent of node and the new leaf
+                Leaf* leaf = newLeaf(key, std::move(value));
+                Node* parent = new Node;
+                parent->endBit = diffBit;
+                parent->repKey = node->repKey;
+                int bit = keyBit(key, diffBit);
+                parent->branch[bit] = leaf;
+                parent->branch[1 - bit] = node;
+                *link = parent;
+                return;
+            }
+            if (node->isLeaf()) {
+                // the same key
+                static_cast<Leaf*>(node)->values.push_back(std::move(value));
+                return;
+            }
+            startBit = node->endBit;
+            link = &node->branch[keyBit(key, startBit)];
+        }
+        *link = newLeaf(key, std::move(value));
+    }
+
+    /**
+     * @brief Visit every key starting with the given prefix, in the same order as prefixMatching.
+     *        '\0' at the end of the prefix is ignored.
+     * @param visit called as visit(const std::string& key, const std::vector<V>& values)
+     */
+    template <typename F>
+    void prefixMatch(std::string_view prefix, F&& visit) const {
+        counter.countString();
+        size_t prefixBits = prefix.size() * BIT_PER_CHAR;
+        const Node* node = root;
+        size_t startBit = 0;
+        while (node != nullptr) {
+            size_t endBit = node->endBit < prefixBits ? node->endBit : prefixBits;
+            size_t diffBit = firstDifferentBit(prefix, *node->repKey, startBit, endBit);
+            counter.countBits((diffBit < endBit ? diffBit + 1 : endBit) - startBit);
+            if (diffBit < endBit) {
+                return;
+            }
+            if (node->endBit >= prefixBits) {
+                // the prefix is finished, every key below this node matches
+                collect(node, visit);
+                return;
+            }
+            startBit = node->endBit;
+            node = node->branch[keyBit(prefix, startBit)];
+        }
+    }
+
+    /**
+     * @brief Get all values of the keys starting with the given prefix, in the same order as prefixMatching.
+     */
+    std::vector<const V*> prefixMatch(std::string_view prefix) const {
+        std::vector<const V*> matched;
+        prefixMatch(prefix, [&matched](const std::string& key, const std::vector<V>& values) {
+            for (const V& value : values) {
+                matched.push_back(&value);
+            }
+        });
+        return matched;
+    }
+
+    // number of different keys
+    size_t size() const { return keyNum; }
+
+    const CountingPolicy& counters() const { return counter; }
+
+    void resetCounters() { counter = CountingPolicy(); }
+
+    // Remove every key, values are destroyed with their leaves.
+    void clear() {
+        std::vector<Node*> stack;
+        if (root != nullptr) {
+            stack.push_back(root);
+        }
+        while (!stack.empty()) {
+            Node* node = stack.back();
+            stack.pop_back();
+            if (node->isLeaf()) {
+                delete static_cast<Leaf*>(node);
+            } else {
+                stack.push_back(node->branch[0]);
+                stack.push_back(node->branch[1]);
+                delete node;
+            }
+        }
+        root = nullptr;
+        keyNum = 0;
+    }
+
+private:
+    static constexpr size_t BIT_PER_CHAR = 8;
+
+    struct Node {
+        size_t endBit = 0;                  // the prefix of this node ends before this bit
+        Node* branch[2] = {nullptr, nullptr};
+        const std::string* repKey = nullptr;  // key of a leaf below, holding the bits of the prefix
+
+        bool isLeaf() const { return branch[0] == nullptr; }
+    };
+
+    struct Leaf : Node {
+        std::string key;
+        std::vector<V> values;
+    };
+
+    Node* root = nullptr;
+    size_t keyNum = 0;
+    mutable CountingPolicy counter;
+
+    Leaf* newLeaf(std::string_view key, V&& value) {
+        Leaf* leaf = new Leaf;
+        leaf->key.assign(key.data(), key.size());
+        leaf->endBit = (key.size() + 1) * BIT_PER_CHAR;
+        leaf->repKey = &leaf->key;
+        leaf->values.push_back(std::move(value));
+        keyNum ++;
+        return leaf;
+    }
+
+    // Get a byte of a key as the tree reads it, the byte after the end is the '\0'.
+    static unsigned char keyByte(std::string_view key, size_t byteIdx) {
+        return byteIdx < key.size() ? KeyTraits::fold(key, byteIdx) : 0;
+    }
+
+    // Get a bit of a key. |0|1|2|3|4|5|6|7| in each byte.
+    static int keyBit(std::string_view key, size_t bitIdx) {
+        return (keyByte(key, bitIdx / BIT_PER_CHAR) >> (BIT_PER_CHAR - 1 - bitIdx % BIT_PER_CHAR)) & 1;
+    }
+
+    // Find the first bit in [fromBit, toBit) where two keys differ, toBit if they don't.
+    static size_t firstDifferentBit(std::string_view key1, std::string_view key2, size_t fromBit, size_t toBit) {
+        for (size_t byteIdx = fromBit / BIT_PER_CHAR; byteIdx * BIT_PER_CHAR < toBit; byteIdx++) {
+            unsigned int diff = keyByte(key1, byteIdx) ^ keyByte(key2, byteIdx);
+            if (byteIdx == fromBit / BIT_PER_CHAR) {
+                diff &= 0xFFu >> (fromBit % BIT_PER_CHAR);
+            }
+            if (diff != 0) {
+                // leading zeros of the byte, in an unsigned int
+                size_t bit = byteIdx * BIT_PER_CHAR + __builtin_clz(diff) - (sizeof(unsigned int) - 1) * BIT_PER_CHAR;
+                return bit < toBit ? bit : toBit;
+            }
+        }
+        return toBit;
+    }
+
+    // Visit every leaf below a node, branch 0 first.
+    template <typename F>
+    static void collect(const Node* node, F& visit) {
+        std::vector<const Node*> stack;
+        stack.push_back(node);
+        while (!stack.empty()) {
+            const Node* currentNode = stack.back();
+            stack.pop_back();
+            if (currentNode->isLeaf()) {
+                const Leaf* leaf = static_cast<const Leaf*>(currentNode);
+                visit(leaf->key, leaf->values);
+            } else {
+                stack.push_back(currentNode->branch[1]);
+                stack.push_back(currentNode->branch[0]);
+            }
+        }
+    }
+};
+
+}
+
+#endif
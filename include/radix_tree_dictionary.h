@@ -20,8 +20,17 @@ radix_tree_dictionary.h :
 #define EXEC_PATH_NOT_MATCH     "N"
 #define EXEC_PATH_ERROR         "E"
 
+// Key modes of a radix tree dictionary.
+// RDICT_KEY_EXACT:  keys are compared byte by byte as they are.
+// RDICT_KEY_FOLDED: keys are case-folded and accent-stripped (Latin-1) at insert and query time,
+//                   UTF-8 encoded letters are only case-folded (see key_normalise.h),
+//                   the original key of the first insertion is kept for display.
+#define RDICT_KEY_EXACT         0
+#define RDICT_KEY_FOLDED        1
+
 
 typedef struct RadixTree RDictionary;
+typedef struct ResultCacheStatsStruct ResultCacheStats;     // defined in result_cache.h
 
 // Data structure for searching
 typedef struct MatchedDataStruct MatchedData; 
@@ -35,6 +44,15 @@ struct MatchedDataStruct {
 RDictionary* createRDict();
 
 
+/**
+ * @brief Radix Tree Dictionary creation with a key mode.
+ * 
+ * @param keyMode RDICT_KEY_EXACT or RDICT_KEY_FOLDED
+ * @return RDictionary* 
+ */
+RDictionary* createRDictWithKeyMode(int keyMode);
+
+
 /**
  * @brief Insert a new data item with its key. '\0' at the end of strings will be counted in inserting process.
  * 
@@ -64,6 +82,150 @@ MatchedData** prefixMatching(RDictionary* rDict, char* givenKey, int* matchedKey
                     int* comparedStr, int* comparedChar, int* comparedBit, char** execPath);
 
 
+/**
+ * @brief Find the data records of a key. Unlike prefixMatching, only the key itself matches.
+ * 
+ * @param rDict 
+ * @param key 
+ * @param recordNum number of data records of the key, 0 if the key is not in the dictionary
+ * @return data records of the key in insertion order (owned by the dictionary), NULL if the key is not in it
+ */
+void** rDictFind(RDictionary* rDict, char* key, int* recordNum);
+
+
+/**
+ * @brief Search radix tree for keys whose edit distance (Levenshtein distance, counted in bytes)
+ *        from the given key is not larger than maxEdits. Subtrees that can't be within the 
+ *        distance are pruned while walking down the tree.
+ * 
+ * @param rDict 
+ * @param givenKey 
+ * @param maxEdits maximum number of inserted, deleted or replaced bytes
+ * @param matchedKeyNum number of keys (strings) within the distance
+ * @param matchedRecordNum number of data entries collected
+ * @return all data records whose keys are within the distance
+ */
+MatchedData** rDictFuzzySearch(RDictionary* rDict, char* givenKey, int maxEdits, 
+                                int* matchedKeyNum, int* matchedRecordNum);
+
+
+/**
+ * @brief Build the substring index used by "contains" search. Keys inserted from now on are added
+ *        to it by rDictInsert.
+ * 
+ * @param rDict 
+ */
+void rDictEnableSubstringIndex(RDictionary* rDict);
+
+
+/**
+ * @brief Put a prefix filter in front of prefixMatching: a prefix that no key starts with is then
+ *        usually rejected without walking the tree. Keys already in the dictionary are added to it,
+ *        keys inserted from now on are added by rDictInsert.
+ * 
+ * @param rDict 
+ * @param prefixLen number of leading bytes of each key kept by the filter, from 1 to {PREFIX_FILTER_MAX_LEN}
+ * @param expectedKeyNum number of keys the filter is sized for
+ * @param falsePositiveRate rate of absent prefixes that still walk the tree, e.g. 0.01
+ */
+void rDictEnablePrefixFilter(RDictionary* rDict, int prefixLen, size_t expectedKeyNum, double falsePositiveRate);
+
+
+/**
+ * @brief Get the number of bytes used by the prefix filter, 0 if it isn't enabled.
+ * 
+ * @param rDict 
+ */
+size_t getRDictPrefixFilterMemory(RDictionary* rDict);
+
+
+/**
+ * @brief Cache the results of prefixMatching by prefix, within a memory budget. A cached result is
+ *        dropped as soon as an insert reaches the subtree it came from, so results are never stale.
+ *        Searches asking for an execution path bypass the cache.
+ * 
+ * @param rDict 
+ * @param memoryBudget maximum number of bytes used by the cache, least recently used results are evicted first
+ */
+void rDictEnableResultCache(RDictionary* rDict, size_t memoryBudget);
+
+
+/**
+ * @brief Get the counters of the result cache. All of them are 0 if it isn't enabled.
+ * 
+ * @param rDict 
+ * @param stats 
+ */
+void getRDictResultCacheStats(RDictionary* rDict, ResultCacheStats* stats);
+
+
+/**
+ * @brief Move every node into one contiguous block, in depth-first order with the prefix bytes of each
+ *        node right after it, so a search walks forward through memory instead of jumping around the heap.
+ *        Best called once the dictionary is loaded. Nodes inserted afterwards are allocated as usual,
+ *        and calling it again packs them in too.
+ *        Keys and data lists are not moved, so results returned earlier stay valid. The substring index
+ *        is rebuilt and the result cache is cleared, since they refer to nodes.
+ * 
+ * @param rDict 
+ */
+void rDictCompact(RDictionary* rDict);
+
+
+/**
+ * @brief Collect the keys of large subtrees (e.g. for short prefixes) with a pool of threads that steal
+ *        branches from each other. Results come in the same order as without it.
+ *        Subtrees with at most nodeThreshold nodes are collected by the calling thread alone, as before.
+ * 
+ * @param rDict 
+ * @param threadNum number of threads collecting a large subtree, including the calling one. 
+ *                  1 or less turns parallel collection off.
+ * @param nodeThreshold number of nodes visited by the calling thread before the pool takes over
+ */
+void rDictEnableParallelCollect(RDictionary* rDict, int threadNum, size_t nodeThreshold);
+
+
+/**
+ * @brief Search radix tree for keys that contain the given pattern anywhere (not only as a prefix).
+ *        The substring index is built on the first call if it hasn't been enabled.
+ * 
+ * @param rDict 
+ * @param pattern 
+ * @param matchedKeyNum number of keys (strings) that contain the pattern
+ * @param matchedRecordNum number of data entries collected
+ * @param comparedStr number of candidate keys compared with the pattern
+ * @return all data records whose keys contain the pattern
+ */
+MatchedData** containsMatching(RDictionary* rDict, char* pattern, int* matchedKeyNum, int* matchedRecordNum,
+                                int* comparedStr);
+
+
+/**
+ * @brief Set the function used to score data records for top-k search. The score bound of every 
+ *        subtree is computed again, records inserted from now on are scored by rDictInsert.
+ * 
+ * @param rDict 
+ * @param fScore score of a data record, larger is better. NULL to stop keeping scores.
+ */
+void rDictSetScoreFunction(RDictionary* rDict, double (*fScore)(void*));
+
+
+/**
+ * @brief Find the k keys with the best scores among the keys starting with the given prefix.
+ *        The score of a key is the best score of its records. Nodes are visited best bound first,
+ *        so the search stops as soon as k keys are found instead of collecting every match.
+ * @note A score function must have been set with rDictSetScoreFunction.
+ * 
+ * @param rDict 
+ * @param givenKey prefix, '\0' at the end is ignored
+ * @param k maximum number of keys returned
+ * @param matchedKeyNum number of keys returned
+ * @param matchedRecordNum number of data entries collected
+ * @return data records of the best keys, best first. Keys with equal scores come in no particular order.
+ */
+MatchedData** rDictTopK(RDictionary* rDict, char* givenKey, int k, int* matchedKeyNum, int* matchedRecordNum);
+
+
 /**
  * @brief Free an entire radix tree dictionary
  * 
@@ -0,0 +1,52 @@
+/** 
+ * @brief  Radix tree internals, shared by the modules that read or convert the nodes of a 
+ *         radix tree dictionary (e.g. the frozen radix tree). Users of the dictionary should
+ *         only need radix_tree_dictionary.h.
+ */
+
+#ifndef _RADIX_TREE_INTERNAL_H_
+#define _RADIX_TREE_INTERNAL_H_
+#include <stdio.h>
+
+#include "radix_tree_dictionary.h"
+#include "substring_index.h"
+#include "prefix_filter.h"
+#include "result_cache.h"
+#include "work_pool.h"
+
+typedef unsigned char BYTE;
+
+/*
+A node holds the bits of its prefix, starting with the bit that chose it in its parent.
+Every key ends with '\0', so no key is a prefix of another: keys are only stored in leaves,
+and every other node has both branches.
+*/
+typedef struct RadixTreeNode RNode;
+struct RadixTreeNode {
+    size_t prefixBits;
+    BYTE *prefix;
+    RNode* branchA;
+    RNode* branchB;
+    void** list;
+    size_t listSize;
+    size_t recordNum;
+    char*   key;        // If a new element is inserted, the key (and data) will be stored here in the node.
+    double maxScore;    // the best score of all records in this subtree, only kept if the tree has a score function
+    size_t version;     // bumped by every insert that compares with this node, see result_cache.h
+};
+
+
+struct RadixTree {
+    RNode* root;
+    int keyMode;        // RDICT_KEY_EXACT or RDICT_KEY_FOLDED
+    SubstringIndex* substringIndex;     // NULL until "contains" search is enabled
+    PrefixFilter* prefixFilter;         // NULL unless the prefix filter is enabled
+    ResultCache* resultCache;           // NULL unless the result cache is enabled
+    BYTE* arena;        // the block holding the nodes and prefixes placed by rDictCompact, NULL before
+    size_t arenaBytes;
+    WorkPool* collectPool;              // NULL unless collection of large subtrees is parallel
+    size_t parallelCollectThreshold;    // nodes collectData visits on its own before the pool takes over
+    double (*fScore)(void*);            // score of a data record used by top-k search, NULL if not set
+};
+
+#endif
@@ -0,0 +1,91 @@
+/**
+ * @brief  Request latency statistics of the notebook server.
+ *         Latencies are counted in histograms (see histogram.h) per request mode and phase, and the
+ *         total latency per size of the response. Each thread records into histograms of its own
+ *         without locking or atomic read-modify-writes, a few nanoseconds per value, so recording is
+ *         always on. Readers add up the histograms of all threads while they are being recorded
+ *         into. They are never reset.
+ */
+
+#ifndef _REQUEST_STATS_H_
+#define _REQUEST_STATS_H_
+#include <stdio.h>
+#include <stdint.h>
+#include <cjson/cJSON.h>
+
+typedef enum {
+    STATS_MODE_INSERT,
+    STATS_MODE_SEARCH,
+    STATS_MODE_FUZZY_SEARCH,
+    STATS_MODE_CONTAINS,
+    STATS_MODE_GET_TREE,
+    STATS_MODE_STATS,
+    STATS_MODE_UNKNOWN,     // including requests that can't be parsed
+    STATS_MODE_NUM
+} StatsModeId;
+
+typedef enum {
+    STATS_PHASE_PARSE,      // JSON text to cJSON
+    STATS_PHASE_TREE_OP,    // processRequest, the dictionary operation and building the response
+    STATS_PHASE_SERIALISE,  // cJSON to JSON text
+    STATS_PHASE_SEND,
+    STATS_PHASE_TOTAL,      // from the start of parsing to the end of sending
+    STATS_PHASE_NUM
+} StatsPhaseId;
+
+// Responses are counted in buckets of sizes below 256 bytes, 1 KB, 4 KB, ... and the rest in the last one
+#define STATS_SIZE_BUCKET_NUM 6
+#define STATS_FIRST_SIZE_BITS 8
+#define STATS_SIZE_BITS_STEP 2
+
+
+/**
+ * @brief Get the current time of the clock used by the statistics, in nanoseconds.
+ */
+uint64_t requestStatsNow();
+
+
+/**
+ * @brief Get the mode of a request.
+ *
+ * @param request parsed request, NULL if it couldn't be parsed
+ * @return StatsModeId
+ */
+StatsModeId getRequestStatsMode(cJSON* request);
+
+
+/**
+ * @brief Count the latency of one phase of a request.
+ *
+ * @param mode
+ * @param phase
+ * @param ns
+ */
+void requestStatsRecord(StatsModeId mode, StatsPhaseId phase, uint64_t ns);
+
+
+/**
+ * @brief Count the total latency of a request by the size of its response.
+ *
+ * @param responseLen bytes sent
+ * @param ns
+ */
+void requestStatsRecordSize(size_t responseLen, uint64_t ns);
+
+
+/**
+ * @brief Get the statistics as a JSON object, e.g. the response of a "stats" request.
+ *        Latencies are in microseconds. Modes, phases and sizes without any request are left out.
+ */
+cJSON* requestStats2Json();
+
+
+/**
+ * @brief Write the statistics, one line per mode and phase, and one per response size.
+ *
+ * @param f output file
+ */
+void printRequestStats(FILE* f);
+
+
+#endif
@@ -0,0 +1,73 @@
+/**
+ * @brief  Result cache interface.
+ *         An LRU cache of search results keyed by prefix, within a memory budget.
+ *         Each entry keeps a pointer to the version counter of the node that decided its result
+ *         (the node where the prefix ended, or where it stopped matching), and the value of that
+ *         counter at the time. rDictInsert bumps the counter of every node it compares with, so
+ *         an entry goes stale exactly when an insert reaches the subtree its result came from.
+ */
+
+#ifndef _RESULT_CACHE_H_
+#define _RESULT_CACHE_H_
+#include <stdio.h>
+
+#include "radix_tree_dictionary.h"
+
+typedef struct LRUResultCache ResultCache;
+
+// Counters of a result cache, ResultCacheStats is declared in radix_tree_dictionary.h
+struct ResultCacheStatsStruct {
+    size_t hitNum;
+    size_t missNum;         // stale entries included
+    size_t staleNum;        // entries found but invalidated by inserts
+    size_t evictedNum;      // entries evicted to stay within the memory budget
+    size_t entryNum;
+    size_t memory;          // bytes used by the entries
+    size_t memoryBudget;
+};
+
+/**
+ * @brief  Create a result cache
+ * @param  memoryBudget: maximum number of bytes used by the entries, least recently used ones are evicted first
+ */
+ResultCache* createResultCache(size_t memoryBudget);
+
+/**
+ * @brief  Get the result of a prefix if it is cached and not stale
+ * @param  cache:
+ * @param  prefix:
+ * @param  matchedKeyNum:
+ * @param  matchedRecordNum:
+ * @retval a new copy of the matched list (freed in the same way as the result of prefixMatching), NULL on a miss
+ */
+MatchedData** resultCacheGet(ResultCache* cache, char* prefix, int* matchedKeyNum, int* matchedRecordNum);
+
+/**
+ * @brief  Cache the result of a prefix. Results larger than the memory budget are not cached.
+ * @param  cache:
+ * @param  prefix:
+ * @param  version: version counter of the node that decided the result
+ * @param  matchedList: the result, it is copied
+ * @param  matchedKeyNum:
+ * @param  matchedRecordNum:
+ */
+void resultCachePut(ResultCache* cache, char* prefix, size_t* version, MatchedData** matchedList,
+                    int matchedKeyNum, int matchedRecordNum);
+
+/**
+ * @brief  Drop every entry, e.g. when the nodes they refer to are moved. Counters other than
+ *         entryNum and memory are kept.
+ */
+void resultCacheClear(ResultCache* cache);
+
+/**
+ * @brief  Get the counters of a result cache
+ */
+void getResultCacheStats(ResultCache* cache, ResultCacheStats* stats);
+
+/**
+ * @brief  Free a result cache. Data records are not freed.
+ */
+void freeResultCache(ResultCache* cache);
+
+#endif
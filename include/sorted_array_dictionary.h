@@ -9,9 +9,26 @@ sorted_array_dictionary.h :
 
 #ifndef _SORTED_ARRAY_DICTIONARY_H_
 #define _SORTED_ARRAY_DICTIONARY_H_
+#include <stdio.h>
 
+/*
+ * Keys are kept in sorted order in a B+tree with cache-line aligned nodes, so an insertion costs
+ * O(log n) instead of shifting the whole array, and the data of a range of keys is read by
+ * following the linked leaves. Equal keys are kept in insertion order.
+ */
 typedef struct SortedArray SDictionary;
 
+// Size and accuracy of a learned index, errors are in blocks of keys
+typedef struct SortedArrayLearnedIndexStats SDictLearnedIndexStats;
+struct SortedArrayLearnedIndexStats {
+    size_t segmentNum;
+    size_t bytes;
+    size_t blockNum;
+    size_t fittedNum;               // first keys of blocks the errors are measured on
+    double meanError;
+    double maxError;
+};
+
 
 // creation of sorted array dictionary
 SDictionary* createSDict();
@@ -33,6 +50,64 @@ SDictionary* createSDict();
 void sDictInsert(SDictionary* sDict, void* key, void* data, int (*compare)(void*, void*));
 
 
+/**
+ * @brief Add a data item to be inserted by the next sDictBuild, faster than sDictInsert when all
+ *        the items are known up front. The key must be a string. Searches don't find the item
+ *        until it is built.
+ * 
+ * @param sDict 
+ * @param key 
+ * @param data 
+ */
+void sDictAppend(SDictionary* sDict, char* key, void* data);
+
+
+/**
+ * @brief Insert the data items appended since the last build. They are sorted with a parallel MSD
+ *        radix sort, merged with the items already in the dictionary and the tree is rebuilt from
+ *        them, full. Items with equal keys stay in the order they were inserted or appended, as if
+ *        each one had been inserted by sDictInsert. All the keys must be strings, in the order of
+ *        strcmp.
+ * 
+ * @param sDict 
+ * @param threadNum number of threads sorting, including the calling one
+ */
+void sDictBuild(SDictionary* sDict, int threadNum);
+
+
+/**
+ * @brief Build a read-optimised copy of the keys, which must be strings: front-coded blocks of
+ *        sorted keys, whose first keys are searched in Eytzinger order. findAndTraverseSDict then
+ *        finds the matches with two bound searches instead of scanning them. The copy is dropped
+ *        by the next insertion.
+ * 
+ * @param sDict 
+ */
+void sDictOptimiseForReads(SDictionary* sDict);
+
+
+/**
+ * @brief Search the read layout through a learned index: a piecewise linear model predicting where
+ *        a key is among the first keys of the blocks, from its first 8 bytes, then a search of the
+ *        few blocks around. Builds the read layout if there is none, and is dropped with it.
+ *        Best for keys spread evenly once their first bytes are known.
+ * 
+ * @param sDict 
+ * @param maxError the most blocks a prediction of a first key of a block may be off by
+ */
+void sDictEnableLearnedIndex(SDictionary* sDict, int maxError);
+
+
+/**
+ * @brief Get the size and accuracy of the learned index, over the first keys of the blocks it
+ *        was fitted on (the first of those sharing their first 8 bytes). All zero if it isn't enabled.
+ * 
+ * @param sDict 
+ * @param stats 
+ */
+void getSDictLearnedIndexStats(SDictionary* sDict, SDictLearnedIndexStats* stats);
+
+
 /**
  * @brief Search data entries using a given key.
  * 
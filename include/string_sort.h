@@ -0,0 +1,30 @@
+/**
+ * @brief  Parallel stable sort of strings, with data attached to each one.
+ *         An MSD radix sort: items are distributed by their byte at the current depth (a stable
+ *         counting sort), then each bucket is sorted by the next byte, until buckets are small enough
+ *         for insertion sort. Buckets are tasks of a work-stealing pool, large ones are handed over
+ *         for idle workers to steal. For large arrays the first distribution is split across the
+ *         workers too. Strings are ordered as by strcmp, and equal strings keep their order.
+ */
+
+#ifndef _STRING_SORT_H_
+#define _STRING_SORT_H_
+#include <stdio.h>
+
+#include "work_pool.h"
+
+typedef struct StringSortItemStruct StringSortItem;
+struct StringSortItemStruct {
+    char* key;
+    void* data;
+};
+
+/**
+ * @brief  Sort items by key
+ * @param  pool: workers to sort with, can have only one
+ * @param  items:
+ * @param  num:
+ */
+void parallelStringSort(WorkPool* pool, StringSortItem* items, size_t num);
+
+#endif
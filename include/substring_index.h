@@ -0,0 +1,49 @@
+/**
+ * @brief  Substring index interface.
+ *         An n-gram posting index over a set of keys. Every 1-, 2- and 3-byte gram of a key
+ *         points to the keys that contain it, so a "contains" query only looks at the keys
+ *         that share all the grams of the pattern.
+ */
+
+#ifndef _SUBSTRING_INDEX_H_
+#define _SUBSTRING_INDEX_H_
+#include <stdio.h>
+
+#include "my_bool.h"
+
+typedef struct NGramIndex SubstringIndex;
+
+/**
+ * @brief  Create a substring index
+ * @param  folded: TRUE if keys and patterns should be matched case- and accent-insensitively
+ */
+SubstringIndex* createSubstringIndex(BOOL folded);
+
+/**
+ * @brief  Add a key to the index. The key is not copied, it must stay valid until the index is freed.
+ * @param  value: returned by searches when the key matches
+ * @note   Each key should only be added once.
+ */
+void substringIndexAdd(SubstringIndex* index, char* key, void* value);
+
+/**
+ * @brief  Find all keys that contain the pattern.
+ * @param  index:
+ * @param  pattern:
+ * @param  matchedNum: number of matched keys
+ * @param  comparedStr: number of candidate keys that have been checked
+ * @retval The values of the matched keys, in the order they were added
+ */
+void** substringSearch(SubstringIndex* index, char* pattern, int* matchedNum, int* comparedStr);
+
+/**
+ * @brief  Get the number of bytes used by the index (keys themselves are not counted)
+ */
+size_t getSubstringIndexMemory(SubstringIndex* index);
+
+/**
+ * @brief  Free the index, keys are not freed.
+ */
+void freeSubstringIndex(SubstringIndex* index);
+
+#endif
@@ -0,0 +1,103 @@
+/** 
+ * @brief  Tracing interface.
+ *         Events are recorded in binary form into per-thread ring buffers 
+ *         and only formatted when the buffers are flushed.
+ */
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+#include <stdio.h>
+#include <stdint.h>
+
+// Trace levels, an event is recorded only if its level is not larger than the current level.
+#define TRACE_LEVEL_OFF     0
+#define TRACE_LEVEL_ERROR   1
+#define TRACE_LEVEL_INFO    2
+#define TRACE_LEVEL_DEBUG   3
+
+// Events above this level are removed at compile time (e.g. make TRACE_LEVEL=3).
+#ifndef TRACE_COMPILE_LEVEL
+#define TRACE_COMPILE_LEVEL TRACE_LEVEL_INFO
+#endif
+
+// Environment variable used to set the runtime level, e.g. RDICT_TRACE=2
+#define TRACE_ENV_LEVEL "RDICT_TRACE"
+
+// Number of bytes of text (e.g. a key) kept in one event.
+#define TRACE_TEXT_LEN 32
+
+typedef enum {
+    TRACE_EV_RDICT_INSERT,
+    TRACE_EV_RDICT_SEARCH,
+    TRACE_EV_REQUEST,
+    TRACE_EV_REQUEST_UNKNOWN,
+    TRACE_EV_POLL,
+    TRACE_EV_ACCEPT,
+    TRACE_EV_RECV,
+    TRACE_EV_RECV_ERROR,
+    TRACE_EV_MESSAGE,
+    TRACE_EV_PARSE_ERROR,
+    TRACE_EV_RESPONSE,
+    TRACE_EV_NUM
+} TraceEventId;
+
+// Current runtime level, read on every trace point. Use traceSetLevel() to change it.
+extern int traceRuntimeLevel;
+
+/**
+ * @brief Record an event if its level is enabled at compile time and at runtime.
+ *        The arguments are not evaluated when the level is disabled.
+ *
+ * @param level one of TRACE_LEVEL_*
+ * @param id TraceEventId
+ * @param arg0 first integer argument
+ * @param arg1 second integer argument
+ * @param text a string to keep (truncated to TRACE_TEXT_LEN - 1 bytes), NULL if not needed
+ */
+#define TRACE(level, id, arg0, arg1, text)                                              \
+    do {                                                                                \
+        if ((level) <= TRACE_COMPILE_LEVEL && (level) <= traceRuntimeLevel) {          \
+            traceRecord((id), (uint64_t) (arg0), (uint64_t) (arg1), (text));            \
+        }                                                                               \
+    } while (0)
+
+
+/**
+ * @brief Set the runtime level from the environment variable {TRACE_ENV_LEVEL}.
+ *        Tracing is off if the variable is not set.
+ */
+void traceInit();
+
+
+/**
+ * @brief Set the runtime level.
+ *
+ * @param level
+ */
+void traceSetLevel(int level);
+
+
+/**
+ * @brief Write a binary event into the ring buffer of the calling thread.
+ *        If the ring buffer is full, the event is dropped and counted.
+ *        Use the TRACE macro instead of calling this directly.
+ *
+ * @param id
+ * @param arg0
+ * @param arg1
+ * @param text
+ */
+void traceRecord(TraceEventId id, uint64_t arg0, uint64_t arg1, const char* text);
+
+
+/**
+ * @brief Format all buffered events of all threads and write them to a file,
+ *        then empty the buffers. Call this off the hot path.
+ *
+ * @param f output file
+ * @return number of events written
+ */
+size_t traceFlush(FILE* f);
+
+
+#endif
@@ -0,0 +1,57 @@
+/**
+ * @brief  Work-stealing thread pool interface.
+ *         Each worker owns a deque of tasks: it takes the newest task from its own deque, and when
+ *         that is empty it steals the oldest task of another worker. A task can spawn more tasks
+ *         into the deque of the worker running it, so large jobs split themselves up as they go
+ *         and idle workers take over the parts nobody has started.
+ *         The thread calling workPoolRun is worker 0 and works on the tasks too.
+ */
+
+#ifndef _WORK_POOL_H_
+#define _WORK_POOL_H_
+#include <stdio.h>
+
+typedef struct WorkStealingPool WorkPool;
+
+// Run a task. workerIdx is the worker running it, to be passed to workPoolSpawn.
+typedef void (*WorkFunction)(WorkPool* pool, int workerIdx, void* task, void* context);
+
+/**
+ * @brief  Create a pool and start its threads
+ * @param  threadNum: number of workers including the thread calling workPoolRun, at least 1
+ */
+WorkPool* createWorkPool(int threadNum);
+
+/**
+ * @brief  Run tasks on all workers and wait until they, and all the tasks they spawn, are done.
+ *         Runs from different threads take turns.
+ * @param  pool:
+ * @param  tasks:
+ * @param  taskNum:
+ * @param  fWork: called once for each task
+ * @param  context: passed to every call of fWork
+ */
+void workPoolRun(WorkPool* pool, void** tasks, int taskNum, WorkFunction fWork, void* context);
+
+/**
+ * @brief  Add a task to the current run, from a task running on the given worker
+ */
+void workPoolSpawn(WorkPool* pool, int workerIdx, void* task);
+
+/**
+ * @brief  Get the number of tasks waiting in the deque of a worker. It is read without locking,
+ *         so it is only a hint, e.g. for a task to decide whether to split.
+ */
+size_t getWorkPoolQueuedNum(WorkPool* pool, int workerIdx);
+
+/**
+ * @brief  Get the number of workers, including the thread calling workPoolRun
+ */
+int getWorkPoolThreadNum(WorkPool* pool);
+
+/**
+ * @brief  Stop the threads and free the pool. It must not be running.
+ */
+void freeWorkPool(WorkPool* pool);
+
+#endif
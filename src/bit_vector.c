@@ -0,0 +1,227 @@
+/**
+ * @brief  Bit vector implementation
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include "bit_vector.h"
+
+#define BITS_PER_WORD 64
+#define INITIAL_WORD_NUM 16
+
+// The rank directory keeps one count for every block of WORDS_PER_BLOCK words,
+// the rest is counted with at most WORDS_PER_BLOCK - 1 popcounts.
+#define WORDS_PER_BLOCK 8
+
+struct BitVectorRank {
+    uint64_t* words;
+    size_t wordListSize;
+    size_t bitNum;
+    uint32_t* blockRanks;   // number of 1 bits before each block, NULL until built
+};
+
+struct PackedIntArray {
+    uint64_t* words;
+    size_t num;
+    int width;
+};
+
+
+/**
+ * @brief  Create an empty bit vector
+ */
+BitVector* createBitVector() {
+    BitVector* bv = (BitVector*) malloc(sizeof(BitVector));
+    assert(bv);
+    bv->wordListSize = INITIAL_WORD_NUM;
+    bv->words = (uint64_t*) calloc(bv->wordListSize, sizeof(uint64_t));
+    assert(bv->words);
+    bv->bitNum = 0;
+    bv->blockRanks = NULL;
+    return bv;
+}
+
+
+/**
+ * @brief  Append a bit to the end of the bit vector
+ * @note   Only allowed before the rank directory is built
+ */
+void bitVectorAppend(BitVector* bv, BOOL bit) {
+    assert(bv->blockRanks == NULL);
+    if (bv->bitNum == bv->wordListSize * BITS_PER_WORD) {
+        bv->words = (uint64_t*) realloc(bv->words, 2 * bv->wordListSize * sizeof(uint64_t));
+        assert(bv->words);
+        memset(bv->words + bv->wordListSize, 0, bv->wordListSize * sizeof(uint64_t));
+        bv->wordListSize *= 2;
+    }
+    if (bit) {
+        bv->words[bv->bitNum / BITS_PER_WORD] |= (uint64_t) 1 << (bv->bitNum % BITS_PER_WORD);
+    }
+    bv->bitNum ++;
+}
+
+
+/**
+ * @brief  Build the rank directory, no more bits can be appended after this
+ */
+void bitVectorBuildRank(BitVector* bv) {
+    size_t wordNum = (bv->bitNum + BITS_PER_WORD - 1) / BITS_PER_WORD;
+    // shrink the words to what is used, with a full last block so rank never reads past the end
+    size_t blockNum = wordNum / WORDS_PER_BLOCK + 1;
+    size_t newWordListSize = blockNum * WORDS_PER_BLOCK;
+    bv->words = (uint64_t*) realloc(bv->words, newWordListSize * sizeof(uint64_t));
+    assert(bv->words);
+    if (newWordListSize > bv->wordListSize) {
+        memset(bv->words + bv->wordListSize, 0, (newWordListSize - bv->wordListSize) * sizeof(uint64_t));
+    }
+    bv->wordListSize = newWordListSize;
+
+    bv->blockRanks = (uint32_t*) malloc(blockNum * sizeof(uint32_t));
+    assert(bv->blockRanks);
+    size_t rank = 0;
+    for (size_t i = 0; i < newWordListSize; i++) {
+        if (i % WORDS_PER_BLOCK == 0) {
+            assert(rank <= UINT32_MAX);
+            bv->blockRanks[i / WORDS_PER_BLOCK] = rank;
+        }
+        rank += __builtin_popcountll(bv->words[i]);
+    }
+}
+
+
+/**
+ * @brief  Get the bit at a position
+ */
+BOOL bitVectorGet(BitVector* bv, size_t pos) {
+    assert(pos < bv->bitNum);
+    return (bv->words[pos / BITS_PER_WORD] >> (pos % BITS_PER_WORD)) & 1;
+}
+
+
+/**
+ * @brief  Count the 1 bits before a position (the bit at pos itself isn't counted)
+ * @note   The rank directory must have been built
+ */
+size_t bitVectorRank1(BitVector* bv, size_t pos) {
+    assert(bv->blockRanks);
+    size_t wordIdx = pos / BITS_PER_WORD;
+    size_t block = wordIdx / WORDS_PER_BLOCK;
+    size_t rank = bv->blockRanks[block];
+    for (size_t i = block * WORDS_PER_BLOCK; i < wordIdx; i++) {
+        rank += __builtin_popcountll(bv->words[i]);
+    }
+    size_t bitIdx = pos % BITS_PER_WORD;
+    if (bitIdx != 0) {
+        rank += __builtin_popcountll(bv->words[wordIdx] << (BITS_PER_WORD - bitIdx));
+    }
+    return rank;
+}
+
+
+/**
+ * @brief  Get the number of bits
+ */
+size_t getBitVectorSize(BitVector* bv) {
+    return bv->bitNum;
+}
+
+
+/**
+ * @brief  Get the number of bytes used by the bit vector
+ */
+size_t getBitVectorMemory(BitVector* bv) {
+    size_t bytes = sizeof(BitVector) + bv->wordListSize * sizeof(uint64_t);
+    if (bv->blockRanks != NULL) {
+        bytes += (bv->wordListSize / WORDS_PER_BLOCK) * sizeof(uint32_t);
+    }
+    return bytes;
+}
+
+
+void freeBitVector(BitVector* bv) {
+    free(bv->words);
+    free(bv->blockRanks);
+    free(bv);
+}
+
+
+/**
+ * @brief  Create a packed array of num integers of width bits each, all set to 0
+ * @param  num:
+ * @param  width: number of bits of each integer, 0 to 64
+ */
+PackedArray* createPackedArray(size_t num, int width) {
+    assert(width >= 0 && width <= BITS_PER_WORD);
+    PackedArray* pa = (PackedArray*) malloc(sizeof(PackedArray));
+    assert(pa);
+    pa->num = num;
+    pa->width = width;
+    // one spare word, so reading an integer that ends in the last word never goes past the end
+    size_t wordNum = (num * width + BITS_PER_WORD - 1) / BITS_PER_WORD + 1;
+    pa->words = (uint64_t*) calloc(wordNum, sizeof(uint64_t));
+    assert(pa->words);
+    return pa;
+}
+
+
+/**
+ * @brief  Get the number of bits needed to keep an integer
+ */
+int getBitWidth(uint64_t maxValue) {
+    return maxValue == 0 ? 0 : BITS_PER_WORD - __builtin_clzll(maxValue);
+}
+
+
+void packedArraySet(PackedArray* pa, size_t idx, uint64_t value) {
+    assert(idx < pa->num);
+    if (pa->width == 0) {
+        assert(value == 0);
+        return;
+    }
+    assert(pa->width == BITS_PER_WORD || value >> pa->width == 0);
+    size_t bitPos = idx * pa->width;
+    size_t wordIdx = bitPos / BITS_PER_WORD;
+    size_t shift = bitPos % BITS_PER_WORD;
+    pa->words[wordIdx] |= value << shift;
+    if (shift + pa->width > BITS_PER_WORD) {
+        // the integer continues in the next word
+        pa->words[wordIdx + 1] |= value >> (BITS_PER_WORD - shift);
+    }
+}
+
+
+uint64_t packedArrayGet(PackedArray* pa, size_t idx) {
+    assert(idx < pa->num);
+    if (pa->width == 0) {
+        return 0;
+    }
+    size_t bitPos = idx * pa->width;
+    size_t wordIdx = bitPos / BITS_PER_WORD;
+    size_t shift = bitPos % BITS_PER_WORD;
+    uint64_t value = pa->words[wordIdx] >> shift;
+    if (shift + pa->width > BITS_PER_WORD) {
+        value |= pa->words[wordIdx + 1] << (BITS_PER_WORD - shift);
+    }
+    if (pa->width < BITS_PER_WORD) {
+        value &= ((uint64_t) 1 << pa->width) - 1;
+    }
+    return value;
+}
+
+
+/**
+ * @brief  Get the number of bytes used by the packed array
+ */
+size_t getPackedArrayMemory(PackedArray* pa) {
+    return sizeof(PackedArray) + ((pa->num * pa->width + BITS_PER_WORD - 1) / BITS_PER_WORD + 1) * sizeof(uint64_t);
+}
+
+
+void freePackedArray(PackedArray* pa) {
+    free(pa->words);
+    free(pa);
+}
@@ -33,6 +33,18 @@ struct CafeInfo {
     double latitude;
 };
 
+// Column names and kinds of the fields, in the order of CafeField
+static char* fieldNames[CAFE_FIELD_NUM] = {
+    "census_year", "block_id", "property_id", "base_property_id", "building_address",
+    "clue_small_area", "business_address", "trading_name", "industry_code",
+    "industry_description", "seating_type", "number_of_seats", "longitude", "latitude"
+};
+static int fieldKinds[CAFE_FIELD_NUM] = {
+    CAFE_FIELD_INT, CAFE_FIELD_INT, CAFE_FIELD_INT, CAFE_FIELD_INT, CAFE_FIELD_STRING,
+    CAFE_FIELD_STRING, CAFE_FIELD_STRING, CAFE_FIELD_STRING, CAFE_FIELD_INT,
+    CAFE_FIELD_STRING, CAFE_FIELD_STRING, CAFE_FIELD_INT, CAFE_FIELD_DOUBLE, CAFE_FIELD_DOUBLE
+};
+
 /**
  * @brief Change the delimiters from "," to "|" in a line from data file
  * 
@@ -206,6 +218,110 @@ void* getTradingName(void* cafe) {
     return tradingName;
 }
 
+/**
+ * @brief Get the number of seats of a cafe, used as its score when ranking cafes
+ * 
+ * @param cafe 
+ * @return double number of seats
+ */
+double getSeatNumScore(void* cafe) {
+    assert(cafe);
+    return ((Cafe*) cafe)->seatNum;
+}
+
+/**
+ * @brief Get a field by its column name in the data file, e.g. "industry_code"
+ * 
+ * @param name 
+ * @return CafeField the field, {CAFE_FIELD_NUM} if there is no such column
+ */
+CafeField getCafeFieldByName(char* name) {
+    int field = 0;
+    while (field < CAFE_FIELD_NUM && strcmp(fieldNames[field], name) != 0) {
+        field ++;
+    }
+    return (CafeField) field;
+}
+
+/**
+ * @brief Get the column name of a field in the data file
+ * 
+ * @param field 
+ * @return char* column name, owned by the data module
+ */
+char* getCafeFieldName(CafeField field) {
+    assert(field >= 0 && field < CAFE_FIELD_NUM);
+    return fieldNames[field];
+}
+
+/**
+ * @brief Get the kind of a field
+ * 
+ * @param field 
+ * @return int {CAFE_FIELD_INT}, {CAFE_FIELD_STRING} or {CAFE_FIELD_DOUBLE}
+ */
+int getCafeFieldKind(CafeField field) {
+    assert(field >= 0 && field < CAFE_FIELD_NUM);
+    return fieldKinds[field];
+}
+
+/**
+ * @brief Get the value of a string field of a cafe, without copying it
+ * 
+ * @param cafe 
+ * @param field a {CAFE_FIELD_STRING} field
+ * @return char* the string owned by the cafe
+ */
+char* getCafeStringField(Cafe* cafe, CafeField field) {
+    assert(cafe);
+    switch (field) {
+        case CAFE_BUILDING_ADDRESS:     return cafe->buildingAddress;
+        case CAFE_CLUE_SMALL_AREA:      return cafe->clueSmallArea;
+        case CAFE_BUSINESS_ADDRESS:     return cafe->businessAddress;
+        case CAFE_TRADING_NAME:         return cafe->tradingName;
+        case CAFE_INDUSTRY_DESCRIPTION: return cafe->industryDescription;
+        case CAFE_SEATING_TYPE:         return cafe->seatingType;
+        default:
+            assert(getCafeFieldKind(field) == CAFE_FIELD_STRING);
+            return NULL;
+    }
+}
+
+/**
+ * @brief Get the value of an integer field of a cafe
+ * 
+ * @param cafe 
+ * @param field a {CAFE_FIELD_INT} field
+ * @return int 
+ */
+int getCafeIntField(Cafe* cafe, CafeField field) {
+    assert(cafe);
+    switch (field) {
+        case CAFE_CENSUS_YEAR:      return cafe->censusYear;
+        case CAFE_BLOCK_ID:         return cafe->blockID;
+        case CAFE_PROPERTY_ID:      return cafe->propertyID;
+        case CAFE_BASE_PROPERTY_ID: return cafe->basePropertyID;
+        case CAFE_INDUSTRY_CODE:    return cafe->industryCode;
+        case CAFE_SEAT_NUM:         return cafe->seatNum;
+        default:
+            assert(getCafeFieldKind(field) == CAFE_FIELD_INT);
+            return 0;
+    }
+}
+
+/**
+ * @brief Get the value of a double field (longitude or latitude) of a cafe
+ * 
+ * @param cafe 
+ * @param field a {CAFE_FIELD_DOUBLE} field
+ * @return double 
+ */
+double getCafeDoubleField(Cafe* cafe, CafeField field) {
+    assert(cafe);
+    assert(getCafeFieldKind(field) == CAFE_FIELD_DOUBLE);
+    return field == CAFE_LONGITUDE ? cafe->longitude : cafe->latitude;
+}
+
 /**
  * @brief Free space for a trading name string.
  * 
@@ -231,6 +347,27 @@ int cmpTradingName(void* name1, void* name2) {
 }
 
 
+/**
+ * @brief Hash a trading name (FNV-1a, with its bits mixed at the end so that every bit of the
+ *        hash depends on every char)
+ * 
+ * @param tradingName 
+ * @return uint64_t 
+ */
+uint64_t hashTradingName(void* tradingName) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (unsigned char* c = (unsigned char*) tradingName; *c != '\0'; c++) {
+        hash = (hash ^ *c) * 0x100000001b3ULL;
+    }
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+
 /**
  * @brief compare trading name char by char, and record the number of char comparison
  * 
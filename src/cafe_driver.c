@@ -15,12 +15,18 @@ driver.c :
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 #include <assert.h>
 
 #include "cafe_data.h"
+#include "my_bool.h"
 #include "dictionary.h"
 #include "sorted_array_dictionary.h"
 #include "radix_tree_dictionary.h"
+#include "frozen_radix_tree.h"
+#include "cafe_index.h"
+#include "result_cache.h"
 
 
 #define COMMAND_LINE_ARG_NUM 4
@@ -32,25 +38,85 @@ driver.c :
 #define LINKED_LIST  1
 #define SORTED_ARRAY 2
 #define RADIX_TREE   3
+// Not a stage given on the command line: a radix tree frozen after it is built ({FREEZE_ARG}).
+#define FROZEN_RADIX_TREE 4
+// Not a stage given on the command line either: a record store with indexes on some columns ({INDEX_ARG}).
+#define CAFE_STORE 5
 
 #define DEFAULT_KEY_LEN 100
 
+// Optional argument of the linked list only:
+// HASH_ARG:            find the trading names equal to each key through a hash index, instead of scanning
+//                      the list for the ones starting with it
+// Optional arguments (radix tree only):
+// FOLD_KEYS_ARG:       search keys case- and accent-insensitively
+// TOP_K_ARG k:         only output the k trading names with the most seats for each key
+// FREEZE_ARG:          freeze the dictionary into a read-only succinct one before searching
+// INDEX_ARG columns:   index the given columns (separated by {INDEX_COLUMN_SEP}) instead of trading names,
+//                      each query line is then a conjunction of conditions, see parseCafeQuery
+// CACHE_ARG bytes:     cache the results of prefixes within the given memory budget, and print the hit rate
+//                      and the time of hits and misses at the end
+#define HASH_ARG "--hash"
+#define FOLD_KEYS_ARG "--fold"
+#define TOP_K_ARG "--top"
+#define FREEZE_ARG "--freeze"
+#define INDEX_ARG "--index"
+#define CACHE_ARG "--cache"
+#define INDEX_COLUMN_SEP ","
 
-void processArg(int argc, char* argv[], int* stage);
-void* readData(char* dataFilename, int stage);
-void queryDict(char* outFilename, void* dict, int stage);
+// Maximum number of conditions in a query of the cafe store
+#define MAX_CONDITION_NUM 16
+
+// Output all matched records
+#define ALL_RECORDS 0
+
+// No result cache
+#define NO_CACHE 0
+
+#define NANOSECONDS_PER_SECOND 1000000000L
+
+
+void processArg(int argc, char* argv[], int* stage, BOOL* hashed, int* keyMode, int* topK, BOOL* freeze,
+                char** indexColumns, size_t* cacheBudget);
+void* readData(char* dataFilename, int stage, BOOL hashed, int keyMode);
+CafeStore* readCafeStore(char* dataFilename, char* indexColumns);
+void queryDict(char* outFilename, void* dict, int stage, int topK);
+void queryCafeStore(char* outFilename, CafeStore* store);
 void freeAll(void* dict, int stage);
 
 int run_cafe_address_book(int argc, char* argv[]) {
     int stage;
+    BOOL hashed;
+    int keyMode;
+    int topK;
+    BOOL freeze;
+    char* indexColumns;
+    size_t cacheBudget;
     char *dataFilename, *outFilename;
     
-    processArg(argc, argv, &stage);
+    processArg(argc, argv, &stage, &hashed, &keyMode, &topK, &freeze, &indexColumns, &cacheBudget);
     dataFilename = argv[2];
     outFilename = argv[3];
 
-    void* dict = readData(dataFilename, stage);
-    queryDict(outFilename, dict, stage);
+    if (indexColumns != NULL) {
+        CafeStore* store = readCafeStore(dataFilename, indexColumns);
+        queryCafeStore(outFilename, store);
+        freeAll(store, CAFE_STORE);
+        return 0;
+    }
+
+    void* dict = readData(dataFilename, stage, hashed, keyMode);
+    if (stage == RADIX_TREE && topK != ALL_RECORDS) {
+        rDictSetScoreFunction((RDictionary*) dict, getSeatNumScore);
+    }
+    if (stage == RADIX_TREE && cacheBudget != NO_CACHE) {
+        rDictEnableResultCache((RDictionary*) dict, cacheBudget);
+    }
+    if (stage == RADIX_TREE && freeze) {
+        dict = rDictFreeze((RDictionary*) dict);
+        stage = FROZEN_RADIX_TREE;
+    }
+    queryDict(outFilename, dict, stage, topK);
 
     freeAll(dict, stage);
     
@@ -63,34 +129,92 @@ int run_cafe_address_book(int argc, char* argv[]) {
  * @param argc 
  * @param argv 
  * @param stage 
+ * @param hashed TRUE if {HASH_ARG} is given
+ * @param keyMode RDICT_KEY_FOLDED if {FOLD_KEYS_ARG} is given, otherwise RDICT_KEY_EXACT
+ * @param topK k given after {TOP_K_ARG}, otherwise {ALL_RECORDS}
+ * @param freeze TRUE if {FREEZE_ARG} is given
+ * @param indexColumns columns given after {INDEX_ARG}, otherwise NULL
+ * @param cacheBudget bytes given after {CACHE_ARG}, otherwise {NO_CACHE}
  */
-void processArg(int argc, char* argv[], int* stage) {
+void processArg(int argc, char* argv[], int* stage, BOOL* hashed, int* keyMode, int* topK, BOOL* freeze,
+                char** indexColumns, size_t* cacheBudget) {
     if (argc < COMMAND_LINE_ARG_NUM || atoi(argv[1])<STAGE_MIN || atoi(argv[1])>STAGE_MAX) {
         fprintf(stderr, "[!Invalid input!]\n");
-        fprintf(stderr, "[Usage]: %s  stage  dataFilename  outputFilename\n", argv[0]);
+        fprintf(stderr, "[Usage]: %s  stage  dataFilename  outputFilename  [%s]  [%s]  [%s k | %s | %s bytes]  [%s columns]\n", 
+                argv[0], HASH_ARG, FOLD_KEYS_ARG, TOP_K_ARG, FREEZE_ARG, CACHE_ARG, INDEX_ARG);
         exit(EXIT_FAILURE);
     }
     *stage = atoi(argv[1]);
+    *hashed = FALSE;
+    *keyMode = RDICT_KEY_EXACT;
+    *topK = ALL_RECORDS;
+    *freeze = FALSE;
+    *indexColumns = NULL;
+    *cacheBudget = NO_CACHE;
+    for (int i = COMMAND_LINE_ARG_NUM; i < argc; i++) {
+        if (strcmp(argv[i], HASH_ARG) == 0) {
+            *hashed = TRUE;
+        } else if (strcmp(argv[i], FOLD_KEYS_ARG) == 0) {
+            *keyMode = RDICT_KEY_FOLDED;
+        } else if (strcmp(argv[i], TOP_K_ARG) == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+            *topK = atoi(argv[++ i]);
+        } else if (strcmp(argv[i], FREEZE_ARG) == 0) {
+            *freeze = TRUE;
+        } else if (strcmp(argv[i], INDEX_ARG) == 0 && i + 1 < argc) {
+            *indexColumns = argv[++ i];
+        } else if (strcmp(argv[i], CACHE_ARG) == 0 && i + 1 < argc && atol(argv[i + 1]) > 0) {
+            *cacheBudget = (size_t) atol(argv[++ i]);
+        }
+    }
+    if (*hashed && (*stage != LINKED_LIST || *keyMode != RDICT_KEY_EXACT || *topK != ALL_RECORDS || *freeze ||
+                    *cacheBudget != NO_CACHE || *indexColumns != NULL)) {
+        // only the linked list has a hash index
+        fprintf(stderr, "[!Invalid input!] %s can only be used alone, in stage %d\n", HASH_ARG, LINKED_LIST);
+        exit(EXIT_FAILURE);
+    }
+    if (*indexColumns != NULL && (*stage != RADIX_TREE || *keyMode != RDICT_KEY_EXACT || 
+                                  *topK != ALL_RECORDS || *freeze || *cacheBudget != NO_CACHE)) {
+        // the cafe store has its own radix trees and queries
+        fprintf(stderr, "[!Invalid input!] %s can only be used alone, in stage %d\n", INDEX_ARG, RADIX_TREE);
+        exit(EXIT_FAILURE);
+    }
+    if (*freeze && *topK != ALL_RECORDS) {
+        // a frozen dictionary doesn't keep scores
+        fprintf(stderr, "[!Invalid input!] %s and %s can't be used together\n", TOP_K_ARG, FREEZE_ARG);
+        exit(EXIT_FAILURE);
+    }
+    if (*cacheBudget != NO_CACHE && (*stage != RADIX_TREE || *topK != ALL_RECORDS || *freeze)) {
+        // only prefixMatching of a radix tree caches its results
+        fprintf(stderr, "[!Invalid input!] %s can only be used in stage %d, without %s or %s\n",
+                CACHE_ARG, RADIX_TREE, TOP_K_ARG, FREEZE_ARG);
+        exit(EXIT_FAILURE);
+    }
 }
 
 /**
  * @brief Read data from data file, and construct a dictionary
  * 
  * @param dataFilename 
+ * @param stage 
+ * @param hashed whether the linked list (stage 1) has a hash index
+ * @param keyMode key mode of the radix tree (stage 3)
  * @return  
  */
-void* readData(char* dataFilename, int stage){
+void* readData(char* dataFilename, int stage, BOOL hashed, int keyMode){
     FILE* dataFile = fopen(dataFilename, "r");
     assert(dataFile);
     readHeadLine(dataFile);
 
     void* dict = NULL;
-    if (stage == LINKED_LIST) {
+    if (stage == LINKED_LIST && hashed) {
+        // trading names are then searched whole, through a hash index instead of a scan of the list
+        dict = createHashedDict(hashTradingName, cmpTradingName);
+    } else if (stage == LINKED_LIST) {
         dict = createDict();
     } else if (stage == SORTED_ARRAY) {
         dict = createSDict();
     } else {
-        dict = createRDict();
+        dict = createRDictWithKeyMode(keyMode);
     }
     assert(dict);
 
@@ -102,27 +226,91 @@ void* readData(char* dataFilename, int stage){
         if (stage == LINKED_LIST) {
             dictAppend((Dictionary*) dict, key, cafe);
         } else if (stage == SORTED_ARRAY) {
-            sDictInsert((SDictionary*) dict, key, cafe, cmpTradingName);
+            sDictAppend((SDictionary*) dict, key, cafe);
         } else {
             rDictInsert((RDictionary*) dict, key, cafe, NULL);
             free(key);
         }
     }
 
+    if (stage == SORTED_ARRAY) {
+        // sorted at once on every core, then only searched from now on
+        sDictBuild((SDictionary*) dict, (int) sysconf(_SC_NPROCESSORS_ONLN));
+        sDictOptimiseForReads((SDictionary*) dict);
+    }
+
     fclose(dataFile);
     return dict;
 }
 
+/**
+ * @brief Read data from data file into a cafe store, with an index on each given column
+ * 
+ * @param dataFilename 
+ * @param indexColumns column names separated by {INDEX_COLUMN_SEP}, e.g. "industry_code,clue_small_area"
+ * @return CafeStore* 
+ */
+CafeStore* readCafeStore(char* dataFilename, char* indexColumns) {
+    CafeStore* store = createCafeStore();
+    for (char* column = strtok(indexColumns, INDEX_COLUMN_SEP); column != NULL; column = strtok(NULL, INDEX_COLUMN_SEP)) {
+        CafeField field = getCafeFieldByName(column);
+        if (field == CAFE_FIELD_NUM || !cafeStoreIndexField(store, field)) {
+            fprintf(stderr, "[!Invalid input!] column %s can't be indexed\n", column);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    FILE* dataFile = fopen(dataFilename, "r");
+    assert(dataFile);
+    readHeadLine(dataFile);
+    while(1) {
+        Cafe* cafe = readCafe(dataFile);
+        if (cafe == NULL) break;
+        cafeStoreAdd(store, cafe);
+    }
+    fclose(dataFile);
+    return store;
+}
+
+/**
+ * @brief Put the data records of all matched keys into one list.
+ * 
+ * @param matchedData 
+ * @param matchedKeyNum 
+ * @param recordNum total number of records
+ * @return void** 
+ */
+void** flattenMatchedData(MatchedData** matchedData, int matchedKeyNum, int recordNum) {
+    void** records = (void**) malloc((recordNum + 1) * sizeof(void*));
+    assert(records);
+    int recordIdx = 0;
+    for (int i = 0; i < matchedKeyNum; i++) {
+        for (int j = 0; j < matchedData[i]->recordNum; j++) {
+            records[recordIdx ++] = matchedData[i]->list[j];
+        }
+        free(matchedData[i]);
+    }
+    free(matchedData);
+    return records;
+}
+
 /**
  * @brief Read lines in the query file. Each line is used as a key for searching.
  *        Print the results into output file and stdout.
  * 
  * @param outFilename 
  * @param dict 
+ * @param stage 
+ * @param topK number of trading names to output for each key, {ALL_RECORDS} to output every match
  */
-void queryDict(char* outFilename, void* dict, int stage) {
+void queryDict(char* outFilename, void* dict, int stage, int topK) {
     FILE* outFile = fopen(outFilename, "w");
     assert(outFile);
+    // time of the searches answered by the result cache and of the others, if it is enabled
+    ResultCacheStats cacheStats;
+    memset(&cacheStats, 0, sizeof(ResultCacheStats));
+    size_t hitNum = 0, missNum = 0;
+    double hitNanoseconds = 0, missNanoseconds = 0;
     // use an array of char to store current search key
     char key[DEFAULT_KEY_LEN];
     for (int i=1;scanf(" %[^\n]", key) == 1;i++) {
@@ -141,8 +329,34 @@ void queryDict(char* outFilename, void* dict, int stage) {
             queryResult = findAndTraverseSDict((SDictionary*) dict, key, &matchCount, &comparedStringNum, 
                                             &comparedCharNum, cmpTradingNameAndCount);
             comparedBitNum = BIT_PER_CHAR * comparedCharNum;
+        } else if (stage == FROZEN_RADIX_TREE) {
+            int matchedKeyNum = 0;
+            MatchedData** matchedData = frozenPrefixMatching((FrozenRDictionary*) dict, key, &matchedKeyNum, &matchCount);
+            queryResult = flattenMatchedData(matchedData, matchedKeyNum, matchCount);
+        } else if (topK != ALL_RECORDS) { // Radix tree, best trading names only
+            int matchedKeyNum = 0;
+            MatchedData** matchedData = rDictTopK((RDictionary*) dict, key, topK, &matchedKeyNum, &matchCount);
+            queryResult = flattenMatchedData(matchedData, matchedKeyNum, matchCount);
         } else { // Radix tree
-            queryResult = prefixMatching((RDictionary*) dict, key, &matchCount, &comparedStringNum, &comparedCharNum, &comparedBitNum, NULL);
+            int matchedKeyNum = 0;
+            getRDictResultCacheStats((RDictionary*) dict, &cacheStats);
+            size_t previousHitNum = cacheStats.hitNum;
+            struct timespec start, end;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            MatchedData** matchedData = prefixMatching((RDictionary*) dict, key, &matchedKeyNum, &matchCount, 
+                                            &comparedStringNum, &comparedCharNum, &comparedBitNum, NULL);
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            double nanoseconds = (double) (end.tv_sec - start.tv_sec) * NANOSECONDS_PER_SECOND 
+                                 + (end.tv_nsec - start.tv_nsec);
+            getRDictResultCacheStats((RDictionary*) dict, &cacheStats);
+            if (cacheStats.hitNum > previousHitNum) {
+                hitNum ++;
+                hitNanoseconds += nanoseconds;
+            } else {
+                missNum ++;
+                missNanoseconds += nanoseconds;
+            }
+            queryResult = flattenMatchedData(matchedData, matchedKeyNum, matchCount);
         }
         assert(queryResult);
 
@@ -154,6 +368,44 @@ void queryDict(char* outFilename, void* dict, int stage) {
 
         free(queryResult);
     }
+    if (stage == RADIX_TREE && topK == ALL_RECORDS && cacheStats.memoryBudget != NO_CACHE) {
+        printf("cache --> h%zu/%zu (%.1f%%) hit %.0fns miss %.0fns stale %zu evicted %zu memory %zu/%zu\n",
+               hitNum, hitNum + missNum, hitNum + missNum > 0 ? 100.0 * hitNum / (hitNum + missNum) : 0,
+               hitNum > 0 ? hitNanoseconds / hitNum : 0, missNum > 0 ? missNanoseconds / missNum : 0,
+               cacheStats.staleNum, cacheStats.evictedNum, cacheStats.memory, cacheStats.memoryBudget);
+    }
+    fclose(outFile);
+}
+
+/**
+ * @brief Read lines in the query file. Each line is a conjunction of conditions on the columns of cafes.
+ *        Print the results into output file, and the numbers of matched and scanned cafes to stdout.
+ * 
+ * @param outFilename 
+ * @param store 
+ */
+void queryCafeStore(char* outFilename, CafeStore* store) {
+    FILE* outFile = fopen(outFilename, "w");
+    assert(outFile);
+    char line[MAX_LINE_LEN];
+    CafeCondition conditions[MAX_CONDITION_NUM];
+    while (scanf(" %511[^\n]", line) == 1) {
+        fprintf(outFile, "%s\n", line);
+        printf("%s --> ", line);
+        int conditionNum = parseCafeQuery(line, conditions, MAX_CONDITION_NUM);
+        if (conditionNum < 0) {
+            printf("invalid query\n");
+            continue;
+        }
+        int matchCount = 0;
+        int scannedNum = 0;
+        Cafe** queryResult = cafeStoreQuery(store, conditions, conditionNum, &matchCount, &scannedNum);
+        for (int i = 0; i < matchCount; i++) {
+            printCafe(outFile, queryResult[i]);
+        }
+        printf("m%d s%d\n", matchCount, scannedNum);
+        free(queryResult);
+    }
     fclose(outFile);
 }
 
@@ -167,6 +419,10 @@ void freeAll(void* dict, int stage){
         freeDict((Dictionary*) dict, freeTradingNameString, freeCafe);
     } else if (stage == SORTED_ARRAY) {
         freeSDict((SDictionary*) dict, freeTradingNameString, freeCafe);
+    } else if (stage == FROZEN_RADIX_TREE) {
+        freeFrozenRDict((FrozenRDictionary*) dict, freeCafe);
+    } else if (stage == CAFE_STORE) {
+        freeCafeStore((CafeStore*) dict);
     } else {
         freeRDict((RDictionary*) dict, freeCafe);
     }
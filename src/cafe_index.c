@@ -0,0 +1,443 @@
+/**
+ * @brief  Cafe store implementation
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include "cafe_index.h"
+#include "radix_tree_dictionary.h"
+#include "int_radix_tree_dictionary.h"
+
+// Size of the record store when it is created
+#define INITIAL_STORE_SIZE 64
+
+// Integer keys are stored with the sign bit flipped, so negative values come before positive ones.
+#define INT_KEY_SIGN_FLIP 0x80000000u
+
+// Character ending a prefix in a query, and the separator of a range
+#define QUERY_PREFIX_CHAR '*'
+#define QUERY_RANGE_SEP ".."
+
+struct CafeStoreStruct {
+    Cafe** records;                             // record ID -> cafe
+    size_t recordNum;
+    size_t size;
+    RDictionary* stringIndexes[CAFE_FIELD_NUM];  // NULL if the field is not indexed
+    IRDictionary* intIndexes[CAFE_FIELD_NUM];
+};
+
+// A sorted list of record IDs
+typedef struct PostingListStruct PostingList;
+struct PostingListStruct {
+    uint32_t* ids;
+    int idNum;
+};
+
+
+/**
+ * @brief Cafe store creation, without any index.
+ *
+ * @return CafeStore*
+ */
+CafeStore* createCafeStore() {
+    CafeStore* store = (CafeStore*) malloc(sizeof(CafeStore));
+    assert(store);
+    store->size = INITIAL_STORE_SIZE;
+    store->recordNum = 0;
+    store->records = (Cafe**) malloc(store->size * sizeof(Cafe*));
+    assert(store->records);
+    for (int field = 0; field < CAFE_FIELD_NUM; field++) {
+        store->stringIndexes[field] = NULL;
+        store->intIndexes[field] = NULL;
+    }
+    return store;
+}
+
+
+static inline void* idToData(size_t id) {
+    return (void*) (uintptr_t) id;
+}
+
+
+static inline uint32_t dataToId(void* data) {
+    return (uint32_t) (uintptr_t) data;
+}
+
+
+static inline uint64_t getIntKey(int value) {
+    return (uint32_t) value ^ INT_KEY_SIGN_FLIP;
+}
+
+
+/**
+ * @brief Declare a field indexed. Fields must be declared before any cafe is added.
+ *
+ * @param store
+ * @param field a string or integer field, {CAFE_FIELD_DOUBLE} fields can't be indexed
+ * @return TRUE if the field is indexed
+ */
+BOOL cafeStoreIndexField(CafeStore* store, CafeField field) {
+    assert(store->recordNum == 0);
+    int kind = getCafeFieldKind(field);
+    if (kind == CAFE_FIELD_STRING && store->stringIndexes[field] == NULL) {
+        store->stringIndexes[field] = createRDict();
+    } else if (kind == CAFE_FIELD_INT && store->intIndexes[field] == NULL) {
+        store->intIndexes[field] = createIRDict(IRDICT_KEY_32);
+    }
+    return kind != CAFE_FIELD_DOUBLE;
+}
+
+
+/**
+ * @brief Add a cafe to the store and to every index. The store takes the cafe.
+ *
+ * @param store
+ * @param cafe
+ */
+void cafeStoreAdd(CafeStore* store, Cafe* cafe) {
+    assert(store->recordNum < UINT32_MAX);
+    if (store->recordNum == store->size) {
+        store->size *= 2;
+        store->records = (Cafe**) realloc(store->records, store->size * sizeof(Cafe*));
+        assert(store->records);
+    }
+    // IDs grow with each cafe, so the records of every key stay in ascending order of IDs
+    size_t id = store->recordNum ++;
+    store->records[id] = cafe;
+    for (int field = 0; field < CAFE_FIELD_NUM; field++) {
+        if (store->stringIndexes[field] != NULL) {
+            rDictInsert(store->stringIndexes[field], getCafeStringField(cafe, field), idToData(id), NULL);
+        } else if (store->intIndexes[field] != NULL) {
+            irDictInsert(store->intIndexes[field], getIntKey(getCafeIntField(cafe, field)), idToData(id));
+        }
+    }
+}
+
+
+/**
+ * @brief Get the number of cafes in the store
+ */
+size_t getCafeStoreSize(CafeStore* store) {
+    return store->recordNum;
+}
+
+
+// Parse an integer taking the whole text.
+static BOOL parseInt(char* text, int* value) {
+    char* end;
+    long number = strtol(text, &end, 10);
+    if (end == text || *end != '\0') {
+        return FALSE;
+    }
+    *value = (int) number;
+    return TRUE;
+}
+
+
+// Parse one condition "field=value".
+static BOOL parseCondition(char* text, CafeCondition* condition) {
+    char* value = strchr(text, '=');
+    if (value == NULL) {
+        return FALSE;
+    }
+    *(value ++) = '\0';
+    condition->field = getCafeFieldByName(text);
+    if (condition->field == CAFE_FIELD_NUM) {
+        return FALSE;
+    }
+
+    int kind = getCafeFieldKind(condition->field);
+    if (kind == CAFE_FIELD_STRING) {
+        size_t valueLen = strlen(value);
+        condition->matchType = CAFE_MATCH_EXACT;
+        if (valueLen > 0 && value[valueLen - 1] == QUERY_PREFIX_CHAR) {
+            value[valueLen - 1] = '\0';
+            condition->matchType = CAFE_MATCH_PREFIX;
+        }
+        condition->text = value;
+        return TRUE;
+    }
+    if (kind == CAFE_FIELD_INT) {
+        char* rangeSep = strstr(value, QUERY_RANGE_SEP);
+        if (rangeSep == NULL) {
+            condition->matchType = CAFE_MATCH_EXACT;
+            return parseInt(value, &condition->low);
+        }
+        *rangeSep = '\0';
+        condition->matchType = CAFE_MATCH_RANGE;
+        return parseInt(value, &condition->low) && parseInt(rangeSep + strlen(QUERY_RANGE_SEP), &condition->high);
+    }
+    // longitude and latitude
+    return FALSE;
+}
+
+
+/**
+ * @brief Parse a query into conditions, e.g. "industry_code=4511&&clue_small_area=Carl*&&number_of_seats=10..50".
+ *        A string value ending with '*' is a prefix, an integer value "low..high" is a range.
+ * @note The line is changed in place, the texts of the conditions point into it.
+ *
+ * @param line
+ * @param conditions
+ * @param maxConditionNum size of conditions
+ * @return number of conditions, -1 if the query is not valid
+ */
+int parseCafeQuery(char* line, CafeCondition* conditions, int maxConditionNum) {
+    int conditionNum = 0;
+    char* text = line;
+    while (text != NULL) {
+        char* next = strstr(text, CAFE_QUERY_AND);
+        if (next != NULL) {
+            *next = '\0';
+            next += strlen(CAFE_QUERY_AND);
+        }
+        if (conditionNum == maxConditionNum || !parseCondition(text, &conditions[conditionNum])) {
+            return -1;
+        }
+        conditionNum ++;
+        text = next;
+    }
+    return conditionNum;
+}
+
+
+// A prefix condition with an empty prefix matches every cafe.
+static inline BOOL isAlwaysTrue(CafeCondition* condition) {
+    return condition->matchType == CAFE_MATCH_PREFIX && condition->text[0] == '\0';
+}
+
+
+// Check a condition on a cafe without an index.
+static BOOL matchCondition(Cafe* cafe, CafeCondition* condition) {
+    if (getCafeFieldKind(condition->field) == CAFE_FIELD_STRING) {
+        char* value = getCafeStringField(cafe, condition->field);
+        if (condition->matchType == CAFE_MATCH_PREFIX) {
+            return strncmp(value, condition->text, strlen(condition->text)) == 0;
+        }
+        return strcmp(value, condition->text) == 0;
+    }
+    int value = getCafeIntField(cafe, condition->field);
+    if (condition->matchType == CAFE_MATCH_RANGE) {
+        return condition->low <= value && value <= condition->high;
+    }
+    return value == condition->low;
+}
+
+
+static int cmpId(const void* id1, const void* id2) {
+    uint32_t a = *(const uint32_t*) id1, b = *(const uint32_t*) id2;
+    return (a > b) - (a < b);
+}
+
+
+// Put the records of every matched key into one sorted posting list.
+static void mergeMatchedKeys(PostingList* list, void*** keyLists, int* keyRecordNums, int keyNum, int recordNum) {
+    list->ids = (uint32_t*) malloc((recordNum + 1) * sizeof(uint32_t));
+    assert(list->ids);
+    list->idNum = 0;
+    for (int i = 0; i < keyNum; i++) {
+        for (int j = 0; j < keyRecordNums[i]; j++) {
+            list->ids[list->idNum ++] = dataToId(keyLists[i][j]);
+        }
+    }
+    // the records of one key are already sorted
+    if (keyNum > 1) {
+        qsort(list->ids, list->idNum, sizeof(uint32_t), cmpId);
+    }
+}
+
+
+// Get the posting list of an indexed condition.
+static void getPostingList(CafeStore* store, CafeCondition* condition, PostingList* list) {
+    int keyNum = 0;
+    int recordNum = 0;
+    if (store->stringIndexes[condition->field] != NULL && condition->matchType == CAFE_MATCH_EXACT) {
+        void** records = rDictFind(store->stringIndexes[condition->field], condition->text, &recordNum);
+        mergeMatchedKeys(list, &records, &recordNum, records != NULL, recordNum);
+        return;
+    }
+
+    void*** keyLists;
+    int* keyRecordNums;
+    if (store->stringIndexes[condition->field] != NULL) {
+        int comparedStr, comparedChar, comparedBit;
+        MatchedData** matchedData = prefixMatching(store->stringIndexes[condition->field], condition->text,
+                                                   &keyNum, &recordNum, &comparedStr, &comparedChar, &comparedBit, NULL);
+        keyLists = (void***) malloc((keyNum + 1) * sizeof(void**));
+        keyRecordNums = (int*) malloc((keyNum + 1) * sizeof(int));
+        assert(keyLists && keyRecordNums);
+        for (int i = 0; i < keyNum; i++) {
+            keyLists[i] = matchedData[i]->list;
+            keyRecordNums[i] = matchedData[i]->recordNum;
+            free(matchedData[i]);
+        }
+        free(matchedData);
+    } else {
+        int high = condition->matchType == CAFE_MATCH_RANGE ? condition->high : condition->low;
+        MatchedIntData** matchedData = irDictRangeMatching(store->intIndexes[condition->field],
+                                                           getIntKey(condition->low), getIntKey(high),
+                                                           &keyNum, &recordNum);
+        keyLists = (void***) malloc((keyNum + 1) * sizeof(void**));
+        keyRecordNums = (int*) malloc((keyNum + 1) * sizeof(int));
+        assert(keyLists && keyRecordNums);
+        for (int i = 0; i < keyNum; i++) {
+            keyLists[i] = matchedData[i]->list;
+            keyRecordNums[i] = matchedData[i]->recordNum;
+            free(matchedData[i]);
+        }
+        free(matchedData);
+    }
+    mergeMatchedKeys(list, keyLists, keyRecordNums, keyNum, recordNum);
+    free(keyLists);
+    free(keyRecordNums);
+}
+
+
+static int cmpPostingListSize(const void* list1, const void* list2) {
+    return ((const PostingList*) list1)->idNum - ((const PostingList*) list2)->idNum;
+}
+
+
+// Find the first position from a start whose ID is not smaller than the target, idNum if there is none.
+// Steps double until they pass the target, then the last step is searched by halves,
+// so skipping a long run of a much longer list costs its logarithm only.
+static int gallopTo(uint32_t* ids, int idNum, int start, uint32_t target) {
+    int low = start;
+    int high = start;
+    int step = 1;
+    while (high < idNum && ids[high] < target) {
+        low = high + 1;
+        high = start + step;
+        step *= 2;
+    }
+    if (high > idNum) {
+        high = idNum;
+    }
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (ids[mid] < target) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+
+// Keep the IDs of a list that are also in another list, the first list being the shorter one.
+static void intersectPostingLists(PostingList* list, PostingList* other) {
+    int keptNum = 0;
+    int otherIdx = 0;
+    for (int i = 0; i < list->idNum && otherIdx < other->idNum; i++) {
+        otherIdx = gallopTo(other->ids, other->idNum, otherIdx, list->ids[i]);
+        if (otherIdx < other->idNum && other->ids[otherIdx] == list->ids[i]) {
+            list->ids[keptNum ++] = list->ids[i];
+        }
+    }
+    list->idNum = keptNum;
+}
+
+
+/**
+ * @brief Find the cafes matching every condition. Posting lists of the indexed conditions are
+ *        intersected shortest first, then the other conditions are checked on the remaining cafes.
+ *
+ * @param store
+ * @param conditions
+ * @param conditionNum
+ * @param matchedNum number of cafes matched
+ * @param scannedNum number of cafes checked against conditions without an index
+ * @return matched cafes in the order they were added (owned by the store)
+ */
+Cafe** cafeStoreQuery(CafeStore* store, CafeCondition* conditions, int conditionNum,
+                        int* matchedNum, int* scannedNum) {
+    PostingList* lists = (PostingList*) malloc((conditionNum + 1) * sizeof(PostingList));
+    assert(lists);
+    // conditions left to check on each candidate
+    CafeCondition** filters = (CafeCondition**) malloc((conditionNum + 1) * sizeof(CafeCondition*));
+    assert(filters);
+    int listNum = 0;
+    int filterNum = 0;
+    for (int i = 0; i < conditionNum; i++) {
+        CafeCondition* condition = &conditions[i];
+        if (isAlwaysTrue(condition)) {
+            continue;
+        }
+        if (store->stringIndexes[condition->field] != NULL || store->intIndexes[condition->field] != NULL) {
+            getPostingList(store, condition, &lists[listNum ++]);
+        } else {
+            filters[filterNum ++] = condition;
+        }
+    }
+
+    PostingList candidates;
+    if (listNum == 0) {
+        candidates.ids = (uint32_t*) malloc((store->recordNum + 1) * sizeof(uint32_t));
+        assert(candidates.ids);
+        for (size_t id = 0; id < store->recordNum; id++) {
+            candidates.ids[id] = id;
+        }
+        candidates.idNum = store->recordNum;
+    } else {
+        // the result is never longer than the shortest list
+        qsort(lists, listNum, sizeof(PostingList), cmpPostingListSize);
+        candidates = lists[0];
+        for (int i = 1; i < listNum; i++) {
+            intersectPostingLists(&candidates, &lists[i]);
+            free(lists[i].ids);
+        }
+    }
+
+    Cafe** matched = (Cafe**) malloc((candidates.idNum + 1) * sizeof(Cafe*));
+    assert(matched);
+    *matchedNum = 0;
+    *scannedNum = filterNum == 0 ? 0 : candidates.idNum;
+    for (int i = 0; i < candidates.idNum; i++) {
+        Cafe* cafe = store->records[candidates.ids[i]];
+        int j = 0;
+        while (j < filterNum && matchCondition(cafe, filters[j])) {
+            j ++;
+        }
+        if (j == filterNum) {
+            matched[(*matchedNum) ++] = cafe;
+        }
+    }
+
+    free(candidates.ids);
+    free(lists);
+    free(filters);
+    return matched;
+}
+
+
+// Record IDs in the indexes are not allocated.
+static void keepId(void* data) {
+}
+
+
+/**
+ * @brief Free a cafe store with its indexes and cafes
+ *
+ * @param store
+ */
+void freeCafeStore(CafeStore* store) {
+    assert(store);
+    for (int field = 0; field < CAFE_FIELD_NUM; field++) {
+        if (store->stringIndexes[field] != NULL) {
+            freeRDict(store->stringIndexes[field], keepId);
+        }
+        if (store->intIndexes[field] != NULL) {
+            freeIRDict(store->intIndexes[field], keepId);
+        }
+    }
+    for (size_t id = 0; id < store->recordNum; id++) {
+        freeCafe(store->records[id]);
+    }
+    free(store->records);
+    free(store);
+}
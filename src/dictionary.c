@@ -10,20 +10,99 @@ dictionary.c :
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <assert.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "dictionary.h"
+#include "work_pool.h"
 
 // Used for searching by key.
 #define MATCHED_LIST_SIZE 10
 
+// Hash index: slots are probed a group at a time, through one control byte each
+#define HASH_GROUP_SIZE 16
+#define CTRL_EMPTY 0x80
+#define CTRL_DELETED 0xFE
+// Control byte of a full slot, 7 bits of the hash; the other bits pick the first group to probe
+#define HASH_TAG(hash) ((uint8_t) ((hash) & 0x7F))
+#define HASH_GROUP(hash) ((hash) >> 7)
+// The index is rehashed once more than 7/8 of the slots are used, into twice as many slots unless
+// deleted slots are most of them
+#define MAX_LOAD_NUMERATOR 7
+#define MAX_LOAD_DENOMINATOR 8
+
+// Packed keys: the first PACKED_HEAD_LEN bytes of each key are compared as one integer, the rest
+// SIMD_WIDTH bytes at a time
+#define PACKED_HEAD_LEN 8
+#define SIMD_WIDTH 16
+#define PACKED_INITIAL_NUM 64
+// Deleted keys are dropped from the packed arrays once they are more than half of them
+#define PACKED_MIN_COMPACT_NUM 1024
+// A scan is split across threads in chunks of at least this many keys
+#define PARALLEL_SCAN_MIN_NUM 16384
+
 // use pointers to void to adapt various types of data.
 typedef struct Node DictItem;
 struct Node {
     void *key;
     void *data;
     DictItem *next;
+    DictItem *sameKeyNext;      // next item with the same key, in a hashed dictionary
+};
+
+/*
+ * A slot of the hash index holds the items of one key, in the order they were appended. Its
+ * control byte is CTRL_EMPTY if it was never used, CTRL_DELETED if its items were all deleted,
+ * otherwise the tag of the hash of the key.
+ */
+typedef struct HashSlotStruct HashSlot;
+struct HashSlotStruct {
+    uint64_t hash;
+    DictItem* first;
+    DictItem* last;
+};
+
+/*
+ * Open addressing hash index (in the style of Swiss tables): the control bytes of a group of
+ * HASH_GROUP_SIZE slots are compared to the tag of a hash at once, so a lookup usually reads one
+ * group of control bytes and one slot. Groups are probed quadratically.
+ */
+typedef struct SwissTable HashIndex;
+struct SwissTable {
+    uint8_t* ctrl;
+    HashSlot* slots;
+    size_t groupNum;            // a power of two
+    size_t usedNum;             // full and deleted slots
+    size_t liveNum;             // full slots
+    uint64_t (*fHash)(void*);
+    int (*compare)(void*, void*);
+};
+
+
+/*
+ * Copy of the keys of a dictionary, in the order of the list, for scans that read memory in order
+ * instead of chasing pointers. The bytes of the keys are stored one after another, each followed
+ * by '\0', and SIMD_WIDTH more bytes are allocated after the last one so a key can be read
+ * SIMD_WIDTH bytes at a time up to its end. Keys from first on are in the dictionary, the ones
+ * before were deleted.
+ */
+typedef struct PackedKeyArray PackedKeys;
+struct PackedKeyArray {
+    char* bytes;
+    size_t byteNum;
+    size_t byteSize;
+    size_t* offsets;
+    uint32_t* lens;
+    uint64_t* heads;            // first PACKED_HEAD_LEN bytes of each key, padded with '\0'
+    void** data;
+    size_t first;
+    size_t num;
+    size_t size;
+    WorkPool* pool;             // NULL unless large scans are split across threads
 };
 
 
@@ -31,6 +110,8 @@ struct LinkedList {
     DictItem *head;
     DictItem *tail;
     size_t size;
+    HashIndex* index;           // NULL unless hashed
+    PackedKeys* packed;         // NULL unless keys are packed
 };
 
 /**
@@ -42,9 +123,295 @@ Dictionary* createDict() {
     Dictionary* dict = (Dictionary*) malloc(sizeof(Dictionary));
     assert(dict);
     dict->size = 0;
+    dict->index = NULL;
+    dict->packed = NULL;
     return dict;
 }
 
+
+static HashIndex* newHashIndex(size_t groupNum, uint64_t (*fHash)(void*), int (*compare)(void*, void*)) {
+    HashIndex* index = (HashIndex*) malloc(sizeof(HashIndex));
+    assert(index);
+    index->groupNum = groupNum;
+    index->usedNum = 0;
+    index->liveNum = 0;
+    index->fHash = fHash;
+    index->compare = compare;
+    index->ctrl = (uint8_t*) aligned_alloc(HASH_GROUP_SIZE, groupNum * HASH_GROUP_SIZE);
+    assert(index->ctrl);
+    memset(index->ctrl, CTRL_EMPTY, groupNum * HASH_GROUP_SIZE);
+    index->slots = (HashSlot*) malloc(groupNum * HASH_GROUP_SIZE * sizeof(HashSlot));
+    assert(index->slots);
+    return index;
+}
+
+
+static void freeHashIndex(HashIndex* index) {
+    free(index->ctrl);
+    free(index->slots);
+    free(index);
+}
+
+
+/**
+ * @brief Create a Dictionary with a hash index on its keys, so searchDictByKey finds the items
+ *        of a key without scanning the others. Items are still kept in the order they are appended.
+ * 
+ * @param fHash hash of a key, all of its bits are used
+ * @param compare compares two keys, 0 if they are equal
+ * @return Dictionary* 
+ */
+Dictionary* createHashedDict(uint64_t (*fHash)(void*), int (*compare)(void*, void*)) {
+    Dictionary* dict = createDict();
+    dict->index = newHashIndex(1, fHash, compare);
+    return dict;
+}
+
+
+// Bit i is set if control byte i of the group equals the given byte
+static inline unsigned matchCtrl(uint8_t* group, uint8_t byte) {
+#ifdef __SSE2__
+    __m128i ctrl = _mm_load_si128((__m128i*) group);
+    return (unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char) byte)));
+#else
+    unsigned bits = 0;
+    for (int i = 0; i < HASH_GROUP_SIZE; i++) {
+        bits |= (unsigned) (group[i] == byte) << i;
+    }
+    return bits;
+#endif
+}
+
+
+// Bit i is set if slot i of the group is empty or deleted, the control bytes with their top bit set
+static inline unsigned matchFree(uint8_t* group) {
+#ifdef __SSE2__
+    return (unsigned) _mm_movemask_epi8(_mm_load_si128((__m128i*) group));
+#else
+    unsigned bits = 0;
+    for (int i = 0; i < HASH_GROUP_SIZE; i++) {
+        bits |= (unsigned) (group[i] >> 7) << i;
+    }
+    return bits;
+#endif
+}
+
+
+/*
+ * Find the slot of a key, NULL if it has no item. Keys are compared with compare if it is given,
+ * counting the comparisons, otherwise with the compare function of the index.
+ */
+static HashSlot* findHashSlot(HashIndex* index, void* key, uint64_t hash, int* comparedKeyNum, int* countCompare, 
+                              int (*compare)(void*, void*, int*)) {
+    size_t mask = index->groupNum - 1;
+    size_t group = HASH_GROUP(hash) & mask;
+    for (size_t step = 1; step <= index->groupNum; step++) {
+        uint8_t* ctrl = index->ctrl + group * HASH_GROUP_SIZE;
+        for (unsigned bits = matchCtrl(ctrl, HASH_TAG(hash)); bits != 0; bits &= bits - 1) {
+            HashSlot* slot = &index->slots[group * HASH_GROUP_SIZE + __builtin_ctz(bits)];
+            if (slot->hash != hash) {
+                continue;
+            }
+            int cmpRes = 0;
+            if (compare != NULL) {
+                int tmpCount = 0;
+                cmpRes = compare(slot->first->key, key, &tmpCount);
+                (*comparedKeyNum) ++;
+                (*countCompare) += tmpCount;
+            } else {
+                cmpRes = index->compare(slot->first->key, key);
+            }
+            if (cmpRes == 0) {
+                return slot;
+            }
+        }
+        if (matchCtrl(ctrl, CTRL_EMPTY) != 0) {
+            return NULL;
+        }
+        group = (group + step) & mask;
+    }
+    return NULL;
+}
+
+
+// Take a free slot for a hash that isn't in the index
+static HashSlot* takeFreeSlot(HashIndex* index, uint64_t hash) {
+    size_t mask = index->groupNum - 1;
+    size_t group = HASH_GROUP(hash) & mask;
+    for (size_t step = 1; ; step++) {
+        uint8_t* ctrl = index->ctrl + group * HASH_GROUP_SIZE;
+        unsigned bits = matchFree(ctrl);
+        if (bits != 0) {
+            size_t slotIdx = group * HASH_GROUP_SIZE + __builtin_ctz(bits);
+            if (index->ctrl[slotIdx] == CTRL_EMPTY) {
+                index->usedNum ++;
+            }
+            index->liveNum ++;
+            index->ctrl[slotIdx] = HASH_TAG(hash);
+            index->slots[slotIdx].hash = hash;
+            return &index->slots[slotIdx];
+        }
+        group = (group + step) & mask;
+    }
+}
+
+
+// Move the keys into groupNum groups of slots, leaving the deleted slots behind
+static void rehashHashIndex(Dictionary* dict, size_t groupNum) {
+    HashIndex* old = dict->index;
+    HashIndex* index = newHashIndex(groupNum, old->fHash, old->compare);
+    for (size_t i = 0; i < old->groupNum * HASH_GROUP_SIZE; i++) {
+        if (old->ctrl[i] < CTRL_EMPTY) {
+            HashSlot* slot = takeFreeSlot(index, old->slots[i].hash);
+            slot->first = old->slots[i].first;
+            slot->last = old->slots[i].last;
+        }
+    }
+    freeHashIndex(old);
+    dict->index = index;
+}
+
+
+static void addToHashIndex(Dictionary* dict, DictItem* item) {
+    HashIndex* index = dict->index;
+    uint64_t hash = index->fHash(item->key);
+    HashSlot* slot = findHashSlot(index, item->key, hash, NULL, NULL, NULL);
+    if (slot != NULL) {
+        slot->last->sameKeyNext = item;
+        slot->last = item;
+        return;
+    }
+    size_t maxUsedNum = index->groupNum * HASH_GROUP_SIZE * MAX_LOAD_NUMERATOR / MAX_LOAD_DENOMINATOR;
+    if (index->usedNum + 1 > maxUsedNum) {
+        // keys appended and deleted over and over only leave deleted slots behind, which don't need more room
+        size_t deletedNum = index->usedNum - index->liveNum;
+        int full = index->liveNum + 1 > maxUsedNum || deletedNum < index->liveNum;
+        rehashHashIndex(dict, full ? 2 * index->groupNum : index->groupNum);
+        index = dict->index;
+    }
+    slot = takeFreeSlot(index, hash);
+    slot->first = item;
+    slot->last = item;
+}
+
+
+// Remove the first item of its key from the index
+static void removeFromHashIndex(HashIndex* index, DictItem* item) {
+    uint64_t hash = index->fHash(item->key);
+    HashSlot* slot = findHashSlot(index, item->key, hash, NULL, NULL, NULL);
+    assert(slot != NULL && slot->first == item);
+    slot->first = item->sameKeyNext;
+    if (slot->first == NULL) {
+        index->ctrl[slot - index->slots] = CTRL_DELETED;
+        index->liveNum --;
+    }
+}
+
+
+// The first PACKED_HEAD_LEN bytes of a string, padded with '\0', as an integer in memory order
+static inline uint64_t getHead(const char* key, size_t len) {
+    uint64_t head = 0;
+    memcpy(&head, key, len < PACKED_HEAD_LEN ? len : PACKED_HEAD_LEN);
+    return head;
+}
+
+
+// Index of the first byte that differs in two heads, the xor of which isn't 0
+static inline size_t firstDifferentByte(uint64_t diff) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    return __builtin_ctzll(diff) / 8;
+#else
+    return __builtin_clzll(diff) / 8;
+#endif
+}
+
+
+static PackedKeys* newPackedKeys() {
+    PackedKeys* packed = (PackedKeys*) malloc(sizeof(PackedKeys));
+    assert(packed);
+    packed->byteNum = 0;
+    packed->byteSize = PACKED_INITIAL_NUM * PACKED_HEAD_LEN;
+    packed->bytes = (char*) malloc(packed->byteSize + SIMD_WIDTH);
+    assert(packed->bytes);
+    packed->first = 0;
+    packed->num = 0;
+    packed->size = PACKED_INITIAL_NUM;
+    packed->offsets = (size_t*) malloc(packed->size * sizeof(size_t));
+    assert(packed->offsets);
+    packed->lens = (uint32_t*) malloc(packed->size * sizeof(uint32_t));
+    assert(packed->lens);
+    packed->heads = (uint64_t*) malloc(packed->size * sizeof(uint64_t));
+    assert(packed->heads);
+    packed->data = (void**) malloc(packed->size * sizeof(void*));
+    assert(packed->data);
+    packed->pool = NULL;
+    return packed;
+}
+
+
+static void freePackedKeys(PackedKeys* packed) {
+    if (packed->pool != NULL) {
+        freeWorkPool(packed->pool);
+    }
+    free(packed->bytes);
+    free(packed->offsets);
+    free(packed->lens);
+    free(packed->heads);
+    free(packed->data);
+    free(packed);
+}
+
+
+static void addToPackedKeys(PackedKeys* packed, char* key, void* data) {
+    size_t len = strlen(key);
+    if (packed->num == packed->size) {
+        packed->size *= 2;
+        packed->offsets = (size_t*) realloc(packed->offsets, packed->size * sizeof(size_t));
+        assert(packed->offsets);
+        packed->lens = (uint32_t*) realloc(packed->lens, packed->size * sizeof(uint32_t));
+        assert(packed->lens);
+        packed->heads = (uint64_t*) realloc(packed->heads, packed->size * sizeof(uint64_t));
+        assert(packed->heads);
+        packed->data = (void**) realloc(packed->data, packed->size * sizeof(void*));
+        assert(packed->data);
+    }
+    if (packed->byteNum + len + 1 > packed->byteSize) {
+        while (packed->byteNum + len + 1 > packed->byteSize) {
+            packed->byteSize *= 2;
+        }
+        packed->bytes = (char*) realloc(packed->bytes, packed->byteSize + SIMD_WIDTH);
+        assert(packed->bytes);
+    }
+    memcpy(packed->bytes + packed->byteNum, key, len + 1);
+    packed->offsets[packed->num] = packed->byteNum;
+    packed->lens[packed->num] = (uint32_t) len;
+    packed->heads[packed->num] = getHead(key, len);
+    packed->data[packed->num] = data;
+    packed->byteNum += len + 1;
+    packed->num ++;
+}
+
+
+// Drop the first key, and the deleted keys with it once they are more than half of the keys
+static void deletePackedHead(PackedKeys* packed) {
+    packed->first ++;
+    if (packed->first < PACKED_MIN_COMPACT_NUM || 2 * packed->first < packed->num) {
+        return;
+    }
+    size_t keptNum = packed->num - packed->first;
+    size_t keptFrom = keptNum == 0 ? packed->byteNum : packed->offsets[packed->first];
+    memmove(packed->bytes, packed->bytes + keptFrom, packed->byteNum - keptFrom);
+    packed->byteNum -= keptFrom;
+    for (size_t i = 0; i < keptNum; i++) {
+        packed->offsets[i] = packed->offsets[packed->first + i] - keptFrom;
+    }
+    memmove(packed->lens, packed->lens + packed->first, keptNum * sizeof(uint32_t));
+    memmove(packed->heads, packed->heads + packed->first, keptNum * sizeof(uint64_t));
+    memmove(packed->data, packed->data + packed->first, keptNum * sizeof(void*));
+    packed->num = keptNum;
+    packed->first = 0;
+}
+
 /**
  * @brief Append a new node to the tail of a dictionary (linked list).
  * 
@@ -67,7 +434,14 @@ void dictAppend(Dictionary* dict, void* key, void* data) {
         dict->tail->data = data;
     }
     dict->tail->next = NULL;
+    dict->tail->sameKeyNext = NULL;
     dict->size++;
+    if (dict->index != NULL) {
+        addToHashIndex(dict, dict->tail);
+    }
+    if (dict->packed != NULL) {
+        addToPackedKeys(dict->packed, (char*) key, data);
+    }
 }
 
 /**
@@ -81,6 +455,12 @@ void* dictDeleteHead(Dictionary* dict) {
         return NULL;
     } else {
         DictItem* tmp = dict->head;
+        if (dict->index != NULL) {
+            removeFromHashIndex(dict->index, tmp);
+        }
+        if (dict->packed != NULL) {
+            deletePackedHead(dict->packed);
+        }
         dict->head = dict->head->next;
         if ((dict->size--) == 1) {
             dict->tail = dict->head;
@@ -93,6 +473,8 @@ void* dictDeleteHead(Dictionary* dict) {
 /**
  * @brief Use the key to search nodes in the dictionary. 
  *        A pointer to function is used to decouple this module from the data module.
+ *        A hashed dictionary only looks at the keys with the same hash as the given one, so it
+ *        only finds keys equal to it.
  * 
  * @param dict 
  * @param matchedNum 
@@ -109,6 +491,18 @@ void** searchDictByKey(Dictionary* dict, void* key, int* matchedNum, int* compar
     int matchedListSize = MATCHED_LIST_SIZE;
     void** matched = (void**) malloc(matchedListSize*sizeof(void*));
     assert(matched);
+    if (dict->index != NULL) {
+        HashSlot* slot = findHashSlot(dict->index, key, dict->index->fHash(key), comparedKeyNum, countCompare, compare);
+        for (tmp = slot == NULL ? NULL : slot->first; tmp != NULL; tmp = tmp->sameKeyNext) {
+            if (*matchedNum == matchedListSize) {
+                matchedListSize *= 2;
+                matched = (void**) realloc(matched, matchedListSize * sizeof(void*));
+                assert(matched);
+            }
+            matched[(*matchedNum) ++] = tmp->data;
+        }
+        return matched;
+    }
     while(tmp != NULL) {
         int tmpCount = 0;
         int cmpRes = compare(tmp->key, key, &tmpCount);
@@ -118,7 +512,7 @@ void** searchDictByKey(Dictionary* dict, void* key, int* matchedNum, int* compar
         if (cmpRes == 0) {
             if (*matchedNum == matchedListSize) {
                 matchedListSize *= 2;
-                matched = (void**) realloc(matched, matchedListSize);
+                matched = (void**) realloc(matched, matchedListSize * sizeof(void*));
                 assert(matched);
             }
             matched[*matchedNum] = tmp->data;
@@ -129,6 +523,270 @@ void** searchDictByKey(Dictionary* dict, void* key, int* matchedNum, int* compar
     return matched;
 }
 
+
+// What a scan looks for: keys starting with a prefix, or if predicate is given, keys it holds for
+typedef struct ScanQueryStruct ScanQuery;
+struct ScanQueryStruct {
+    PackedKeys* packed;
+    const char* prefix;         // followed by at least SIMD_WIDTH readable bytes
+    size_t prefixLen;
+    uint64_t prefixHead;
+    uint64_t headMask;          // the bytes of the head that are in the prefix
+    int (*predicate)(void*, void*);
+    void* arg;
+};
+
+// The keys from..to of a scan, and what was found there
+typedef struct ScanChunkStruct ScanChunk;
+struct ScanChunkStruct {
+    size_t from;
+    size_t to;
+    void** matched;
+    int matchedNum;
+    int matchedSize;
+    int comparedKeyNum;
+    int countCompare;
+};
+
+
+/*
+ * Index of the first byte from the given one on where a key and a prefix differ, prefixLen if there
+ * is none before it. The key ends before the prefix does if they differ at its '\0'.
+ */
+static inline size_t findMismatch(const char* key, const char* prefix, size_t from, size_t prefixLen) {
+#ifdef __SSE2__
+    for (size_t i = from; i < prefixLen; i += SIMD_WIDTH) {
+        __m128i keyBytes = _mm_loadu_si128((const __m128i*) (key + i));
+        __m128i prefixBytes = _mm_loadu_si128((const __m128i*) (prefix + i));
+        unsigned diff = ~(unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(keyBytes, prefixBytes)) & 0xFFFF;
+        if (diff != 0) {
+            size_t mismatch = i + __builtin_ctz(diff);
+            return mismatch < prefixLen ? mismatch : prefixLen;
+        }
+    }
+    return prefixLen;
+#else
+    size_t i = from;
+    while (i < prefixLen && key[i] == prefix[i]) {
+        i ++;
+    }
+    return i;
+#endif
+}
+
+
+static inline void addMatch(ScanChunk* chunk, void* data) {
+    if (chunk->matchedNum == chunk->matchedSize) {
+        chunk->matchedSize *= 2;
+        chunk->matched = (void**) realloc(chunk->matched, chunk->matchedSize * sizeof(void*));
+        assert(chunk->matched);
+    }
+    chunk->matched[chunk->matchedNum ++] = data;
+}
+
+
+/*
+ * Scan a chunk of the packed keys. The heads are checked first, so the bytes of a key are only
+ * read if the prefix is longer than its head and the head matches. Chars are counted as
+ * cmpTradingNameAndCount does: up to the first one that differs, plus one.
+ */
+static void scanChunk(WorkPool* pool, int workerIdx, void* arg, void* context) {
+    ScanChunk* chunk = (ScanChunk*) arg;
+    ScanQuery* query = (ScanQuery*) context;
+    PackedKeys* packed = query->packed;
+    chunk->comparedKeyNum = (int) (chunk->to - chunk->from);
+    if (query->predicate != NULL) {
+        for (size_t i = chunk->from; i < chunk->to; i++) {
+            if (query->predicate(packed->bytes + packed->offsets[i], query->arg)) {
+                addMatch(chunk, packed->data[i]);
+            }
+        }
+        return;
+    }
+    for (size_t i = chunk->from; i < chunk->to; i++) {
+        uint64_t diff = (packed->heads[i] ^ query->prefixHead) & query->headMask;
+        size_t mismatch;
+        if (diff != 0) {
+            mismatch = firstDifferentByte(diff);
+        } else if (query->prefixLen <= PACKED_HEAD_LEN) {
+            mismatch = query->prefixLen;
+        } else {
+            mismatch = findMismatch(packed->bytes + packed->offsets[i], query->prefix, PACKED_HEAD_LEN,
+                                    query->prefixLen);
+        }
+        chunk->countCompare += (int) mismatch + 1;
+        if (mismatch == query->prefixLen) {
+            addMatch(chunk, packed->data[i]);
+        }
+    }
+}
+
+
+// Scan the packed keys, in chunks on the threads of the pool if there are enough of them
+static void** scanPackedKeys(PackedKeys* packed, ScanQuery* query, int* matchedNum, int* comparedKeyNum,
+                             int* countCompare) {
+    size_t num = packed->num - packed->first;
+    size_t chunkNum = 1;
+    if (packed->pool != NULL) {
+        chunkNum = num / PARALLEL_SCAN_MIN_NUM;
+        if (chunkNum > (size_t) getWorkPoolThreadNum(packed->pool)) {
+            chunkNum = getWorkPoolThreadNum(packed->pool);
+        }
+        if (chunkNum == 0) {
+            chunkNum = 1;
+        }
+    }
+    ScanChunk* chunks = (ScanChunk*) malloc(chunkNum * sizeof(ScanChunk));
+    assert(chunks);
+    void** tasks = (void**) malloc(chunkNum * sizeof(void*));
+    assert(tasks);
+    for (size_t c = 0; c < chunkNum; c++) {
+        chunks[c].from = packed->first + num * c / chunkNum;
+        chunks[c].to = packed->first + num * (c + 1) / chunkNum;
+        chunks[c].matchedSize = MATCHED_LIST_SIZE;
+        chunks[c].matched = (void**) malloc(chunks[c].matchedSize * sizeof(void*));
+        assert(chunks[c].matched);
+        chunks[c].matchedNum = 0;
+        chunks[c].comparedKeyNum = 0;
+        chunks[c].countCompare = 0;
+        tasks[c] = &chunks[c];
+    }
+    if (chunkNum == 1) {
+        scanChunk(NULL, 0, &chunks[0], query);
+    } else {
+        workPoolRun(packed->pool, tasks, (int) chunkNum, scanChunk, query);
+    }
+
+    // the matches of the chunks, one after another
+    void** matched = chunks[0].matched;
+    *matchedNum = chunks[0].matchedNum;
+    *comparedKeyNum = chunks[0].comparedKeyNum;
+    *countCompare = chunks[0].countCompare;
+    for (size_t c = 1; c < chunkNum; c++) {
+        if (*matchedNum + chunks[c].matchedNum > chunks[0].matchedSize) {
+            chunks[0].matchedSize = *matchedNum + chunks[c].matchedNum;
+            matched = (void**) realloc(matched, chunks[0].matchedSize * sizeof(void*));
+            assert(matched);
+        }
+        memcpy(matched + *matchedNum, chunks[c].matched, chunks[c].matchedNum * sizeof(void*));
+        *matchedNum += chunks[c].matchedNum;
+        *comparedKeyNum += chunks[c].comparedKeyNum;
+        *countCompare += chunks[c].countCompare;
+        free(chunks[c].matched);
+    }
+    free(tasks);
+    free(chunks);
+    return matched;
+}
+
+
+/**
+ * @brief Keep a packed copy of the keys, which must be strings, for searchDictByPrefix and
+ *        searchDictByPredicate: their bytes one after another in one buffer, and their lengths and
+ *        first 8 bytes in arrays of their own, so a scan reads memory in order and most keys are
+ *        rejected by one integer comparison. It is kept up to date by dictAppend and dictDeleteHead.
+ * 
+ * @param dict 
+ * @param threadNum number of threads scanning a large dictionary, including the calling one.
+ *                  1 or less scans on the calling thread only.
+ */
+void dictEnablePackedKeys(Dictionary* dict, int threadNum) {
+    if (dict->packed == NULL) {
+        dict->packed = newPackedKeys();
+        for (DictItem* tmp = dict->size == 0 ? NULL : dict->head; tmp != NULL; tmp = tmp->next) {
+            addToPackedKeys(dict->packed, (char*) tmp->key, tmp->data);
+        }
+    }
+    if (dict->packed->pool != NULL) {
+        freeWorkPool(dict->packed->pool);
+        dict->packed->pool = NULL;
+    }
+    if (threadNum > 1) {
+        dict->packed->pool = createWorkPool(threadNum);
+    }
+}
+
+
+/**
+ * @brief Search the items whose key starts with the given prefix, in the order they were appended.
+ *        Keys must be strings. With packed keys (dictEnablePackedKeys) they are scanned in memory
+ *        order, 16 bytes at a time, and split across threads if there are many, otherwise the list is
+ *        walked. Chars are counted as cmpTradingNameAndCount counts them.
+ * 
+ * @param dict 
+ * @param prefix 
+ * @param matchedNum 
+ * @param comparedKeyNum 
+ * @param countCompare 
+ * @return void** A list of pointers to the matched values in the given dictionary.
+ */
+void** searchDictByPrefix(Dictionary* dict, char* prefix, int* matchedNum, int* comparedKeyNum, int* countCompare) {
+    size_t prefixLen = strlen(prefix);
+    if (dict->packed != NULL) {
+        // copied, so the prefix can be read SIMD_WIDTH bytes at a time up to its end
+        char* paddedPrefix = (char*) calloc(prefixLen + SIMD_WIDTH, sizeof(char));
+        assert(paddedPrefix);
+        memcpy(paddedPrefix, prefix, prefixLen);
+        ScanQuery query = {dict->packed, paddedPrefix, prefixLen, getHead(prefix, prefixLen), 0, NULL, NULL};
+        memset(&query.headMask, 0xFF, prefixLen < PACKED_HEAD_LEN ? prefixLen : PACKED_HEAD_LEN);
+        void** matched = scanPackedKeys(dict->packed, &query, matchedNum, comparedKeyNum, countCompare);
+        free(paddedPrefix);
+        return matched;
+    }
+
+    ScanChunk chunk = {0, 0, NULL, 0, MATCHED_LIST_SIZE, 0, 0};
+    chunk.matched = (void**) malloc(chunk.matchedSize * sizeof(void*));
+    assert(chunk.matched);
+    for (DictItem* tmp = dict->size == 0 ? NULL : dict->head; tmp != NULL; tmp = tmp->next) {
+        char* key = (char*) tmp->key;
+        size_t mismatch = 0;
+        while (mismatch < prefixLen && key[mismatch] == prefix[mismatch]) {
+            mismatch ++;
+        }
+        chunk.comparedKeyNum ++;
+        chunk.countCompare += (int) mismatch + 1;
+        if (mismatch == prefixLen) {
+            addMatch(&chunk, tmp->data);
+        }
+    }
+    *matchedNum = chunk.matchedNum;
+    *comparedKeyNum = chunk.comparedKeyNum;
+    *countCompare = chunk.countCompare;
+    return chunk.matched;
+}
+
+
+/**
+ * @brief Search the items whose key a predicate holds for, in the order they were appended. With
+ *        packed keys (dictEnablePackedKeys) the predicate is given the packed copy of each key, and
+ *        the keys are split across threads if there are many, so it must be safe to call from
+ *        several threads at once.
+ * 
+ * @param dict 
+ * @param predicate non-zero if the item of a key matches
+ * @param arg passed to every call of predicate
+ * @param matchedNum 
+ * @return void** A list of pointers to the matched values in the given dictionary.
+ */
+void** searchDictByPredicate(Dictionary* dict, int (*predicate)(void*, void*), void* arg, int* matchedNum) {
+    int comparedKeyNum = 0, countCompare = 0;
+    if (dict->packed != NULL) {
+        ScanQuery query = {dict->packed, NULL, 0, 0, 0, predicate, arg};
+        return scanPackedKeys(dict->packed, &query, matchedNum, &comparedKeyNum, &countCompare);
+    }
+
+    ScanChunk chunk = {0, 0, NULL, 0, MATCHED_LIST_SIZE, 0, 0};
+    chunk.matched = (void**) malloc(chunk.matchedSize * sizeof(void*));
+    assert(chunk.matched);
+    for (DictItem* tmp = dict->size == 0 ? NULL : dict->head; tmp != NULL; tmp = tmp->next) {
+        if (predicate(tmp->key, arg)) {
+            addMatch(&chunk, tmp->data);
+        }
+    }
+    *matchedNum = chunk.matchedNum;
+    return chunk.matched;
+}
+
 /**
  * @brief Free a dictionary, including the key and value in each node.
  * 
@@ -151,6 +809,12 @@ void freeDict(Dictionary* dict, void (*fFreeKey)(void*), void (*fFreeData)(void*
             tmp = dict->head;
         }
     }
+    if (dict->index != NULL) {
+        freeHashIndex(dict->index);
+    }
+    if (dict->packed != NULL) {
+        freePackedKeys(dict->packed);
+    }
     free(dict);
 }
 
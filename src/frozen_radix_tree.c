@@ -0,0 +1,324 @@
+/**
+ * @brief  Frozen radix tree implementation
+ *
+ *         Every internal node of a radix tree has exactly two branches, so the shape of the tree
+ *         is kept as one bit per node in BFS order: 1 for an internal node, 0 for a leaf.
+ *         With r internal nodes before node i, the branches of node i are nodes 2r+1 and 2r+2,
+ *         so one rank query moves down a level. Nodes are only walked top-down, no select is needed.
+ *
+ *         Internal nodes only keep the position of the bit their branches split at. A search
+ *         follows those bits without checking the prefixes on the way, then compares the given key
+ *         with one key of the subtree it ends in: either every key of the subtree matches or none.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include "frozen_radix_tree.h"
+#include "radix_tree_internal.h"
+#include "bit_vector.h"
+#include "key_normalise.h"
+#include "my_bool.h"
+#include "trace.h"
+
+#define BIT_PER_CHAR 8
+#define INITIAL_NODE_LIST_SIZE 64
+#define INITIAL_STACK_SIZE 64
+
+// Used for searching by key.
+#define MATCHED_LIST_SIZE 2
+
+struct FrozenRadixTree {
+    int keyMode;
+    size_t nodeNum;
+    size_t leafNum;
+    BitVector* shape;           // 1 for an internal node, 0 for a leaf, in BFS order
+    PackedArray* branchBits;    // for each internal node (by rank), the position of the bit its branches split at
+    PackedArray* keyStarts;     // for each leaf (by rank), where its key starts in keys, with an extra end offset
+    char* keys;                 // keys of all leaves, each ended with '\0'
+    PackedArray* recordStarts;  // for each leaf (by rank), where its data starts in records, with an extra end offset
+    void** records;
+};
+
+
+// Data records are moved to the frozen dictionary, they must not be freed with the radix tree.
+static void keepData(void* data) {
+}
+
+
+/**
+ * @brief  Convert a radix tree dictionary into a frozen one. The radix tree dictionary is freed,
+ *         its data records are moved to the frozen dictionary.
+ * @note   The substring index, the prefix filter, the result cache and the scores of the radix tree are not kept.
+ * @param  rDict:
+ * @retval the frozen dictionary
+ */
+FrozenRDictionary* rDictFreeze(RDictionary* rDict) {
+    FrozenRDictionary* fDict = (FrozenRDictionary*) malloc(sizeof(FrozenRDictionary));
+    assert(fDict);
+    fDict->keyMode = rDict->keyMode;
+
+    // list the nodes in BFS order, with the bit position each node starts at
+    size_t nodeListSize = INITIAL_NODE_LIST_SIZE;
+    size_t nodeNum = 0;
+    RNode** nodes = (RNode**) malloc(nodeListSize * sizeof(RNode*));
+    assert(nodes);
+    size_t* startBits = (size_t*) malloc(nodeListSize * sizeof(size_t));
+    assert(startBits);
+    if (rDict->root != NULL) {
+        nodes[nodeNum] = rDict->root;
+        startBits[nodeNum ++] = 0;
+    }
+    size_t leafNum = 0;
+    size_t keyBytes = 0;
+    size_t recordNum = 0;
+    size_t maxBranchBit = 0;
+    for (size_t i = 0; i < nodeNum; i++) {
+        RNode* node = nodes[i];
+        if (node->branchA == NULL) {
+            assert(node->branchB == NULL && node->recordNum != 0);
+            leafNum ++;
+            keyBytes += strlen(node->key) + 1;
+            recordNum += node->recordNum;
+            continue;
+        }
+        assert(node->branchB != NULL && node->recordNum == 0);
+        if (nodeNum + 2 > nodeListSize) {
+            nodeListSize *= 2;
+            nodes = (RNode**) realloc(nodes, nodeListSize * sizeof(RNode*));
+            assert(nodes);
+            startBits = (size_t*) realloc(startBits, nodeListSize * sizeof(size_t));
+            assert(startBits);
+        }
+        size_t branchBit = startBits[i] + node->prefixBits;
+        if (branchBit > maxBranchBit) {
+            maxBranchBit = branchBit;
+        }
+        nodes[nodeNum] = node->branchA;
+        startBits[nodeNum ++] = branchBit;
+        nodes[nodeNum] = node->branchB;
+        startBits[nodeNum ++] = branchBit;
+    }
+
+    fDict->nodeNum = nodeNum;
+    fDict->leafNum = leafNum;
+    fDict->shape = createBitVector();
+    fDict->branchBits = createPackedArray(nodeNum - leafNum, getBitWidth(maxBranchBit));
+    fDict->keyStarts = createPackedArray(leafNum + 1, getBitWidth(keyBytes));
+    fDict->keys = (char*) malloc(keyBytes + 1);
+    assert(fDict->keys);
+    fDict->recordStarts = createPackedArray(leafNum + 1, getBitWidth(recordNum));
+    fDict->records = (void**) malloc((recordNum + 1) * sizeof(void*));
+    assert(fDict->records);
+
+    size_t internalIdx = 0;
+    size_t leafIdx = 0;
+    size_t keyPos = 0;
+    size_t recordPos = 0;
+    for (size_t i = 0; i < nodeNum; i++) {
+        RNode* node = nodes[i];
+        if (node->branchA != NULL) {
+            bitVectorAppend(fDict->shape, TRUE);
+            packedArraySet(fDict->branchBits, internalIdx ++, startBits[i] + node->prefixBits);
+        } else {
+            bitVectorAppend(fDict->shape, FALSE);
+            packedArraySet(fDict->keyStarts, leafIdx, keyPos);
+            packedArraySet(fDict->recordStarts, leafIdx, recordPos);
+            size_t keyLen = strlen(node->key) + 1;
+            memcpy(fDict->keys + keyPos, node->key, keyLen);
+            keyPos += keyLen;
+            memcpy(fDict->records + recordPos, node->list, node->recordNum * sizeof(void*));
+            recordPos += node->recordNum;
+            leafIdx ++;
+        }
+    }
+    packedArraySet(fDict->keyStarts, leafNum, keyPos);
+    packedArraySet(fDict->recordStarts, leafNum, recordPos);
+    bitVectorBuildRank(fDict->shape);
+
+    free(nodes);
+    free(startBits);
+    freeRDict(rDict, keepData);
+    return fDict;
+}
+
+
+// Check if a node is an internal node.
+static inline BOOL isInternal(FrozenRDictionary* fDict, size_t node) {
+    return bitVectorGet(fDict->shape, node);
+}
+
+
+// Get the first branch of an internal node, the second one is right after it.
+static inline size_t getFirstBranch(FrozenRDictionary* fDict, size_t node) {
+    return 2 * bitVectorRank1(fDict->shape, node) + 1;
+}
+
+
+// Get the rank of a leaf among all leaves.
+static inline size_t getLeafIdx(FrozenRDictionary* fDict, size_t node) {
+    return node - bitVectorRank1(fDict->shape, node);
+}
+
+
+// Get the bit at given position from a key. |0|1|2|3|4|5|6|7| in each byte.
+static inline int getKeyBit(unsigned char* key, size_t index) {
+    return (key[index / BIT_PER_CHAR] >> (BIT_PER_CHAR - 1 - index % BIT_PER_CHAR)) & 1;
+}
+
+
+// Check if the key of a leaf starts with the given (already folded) key.
+static BOOL leafStartsWith(FrozenRDictionary* fDict, size_t leafIdx, unsigned char* key, size_t keyByteNum) {
+    unsigned char* leafKey = (unsigned char*) fDict->keys + packedArrayGet(fDict->keyStarts, leafIdx);
+    BOOL folded = fDict->keyMode == RDICT_KEY_FOLDED;
+    size_t leafKeyLen = folded ? strlen((char*) leafKey) : 0;
+    for (size_t i = 0; i < keyByteNum; i++) {
+        // the '\0' ending the leaf key never matches, since the given key doesn't contain one
+        if (leafKey[i] == '\0') {
+            return FALSE;
+        }
+        unsigned char byte = folded ? normaliseByteAt((char*) leafKey, leafKeyLen, i) : leafKey[i];
+        if (byte != key[i]) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+
+// Collect the data of every leaf below a node, in the same DFS order as the radix tree.
+static MatchedData** collectFrozenData(FrozenRDictionary* fDict, size_t node, int* matchedKeyNum, int* recordNum) {
+    size_t collectionSize = MATCHED_LIST_SIZE;
+    MatchedData** collection = (MatchedData**) malloc(collectionSize * sizeof(MatchedData*));
+    assert(collection);
+    size_t stackSize = INITIAL_STACK_SIZE;
+    size_t stackTop = 0;
+    size_t* stack = (size_t*) malloc(stackSize * sizeof(size_t));
+    assert(stack);
+
+    stack[stackTop ++] = node;
+    while (stackTop != 0) {
+        size_t currentNode = stack[-- stackTop];
+        if (isInternal(fDict, currentNode)) {
+            if (stackTop + 2 > stackSize) {
+                stackSize *= 2;
+                stack = (size_t*) realloc(stack, stackSize * sizeof(size_t));
+                assert(stack);
+            }
+            size_t branchA = getFirstBranch(fDict, currentNode);
+            stack[stackTop ++] = branchA + 1;
+            stack[stackTop ++] = branchA;
+            continue;
+        }
+
+        size_t leafIdx = getLeafIdx(fDict, currentNode);
+        if (*matchedKeyNum == collectionSize) {
+            collectionSize *= 2;
+            collection = (MatchedData**) realloc(collection, collectionSize * sizeof(MatchedData*));
+            assert(collection);
+        }
+        size_t recordStart = packedArrayGet(fDict->recordStarts, leafIdx);
+        MatchedData* matchedData = (MatchedData*) malloc(sizeof(MatchedData));
+        assert(matchedData);
+        matchedData->key = fDict->keys + packedArrayGet(fDict->keyStarts, leafIdx);
+        matchedData->list = fDict->records + recordStart;
+        matchedData->recordNum = packedArrayGet(fDict->recordStarts, leafIdx + 1) - recordStart;
+        collection[(*matchedKeyNum) ++] = matchedData;
+        (*recordNum) += matchedData->recordNum;
+    }
+    free(stack);
+    return collection;
+}
+
+
+/**
+ * @brief  Search a frozen dictionary using given key (prefix), in the same way as prefixMatching.
+ *         '\0' at the end of strings will be ignored in searching process.
+ * @param  fDict:
+ * @param  givenKey:
+ * @param  matchedKeyNum: number of keys (strings) that matches the prefix
+ * @param  matchedRecordNum: number of data entries collected
+ * @retval all data records that matches the given prefix, in the same order as prefixMatching
+ */
+MatchedData** frozenPrefixMatching(FrozenRDictionary* fDict, char* givenKey, int* matchedKeyNum, int* matchedRecordNum) {
+    *matchedKeyNum = 0;
+    *matchedRecordNum = 0;
+    if (fDict->nodeNum == 0) {
+        return (MatchedData**) malloc(MATCHED_LIST_SIZE * sizeof(MatchedData*));
+    }
+
+    size_t keyByteNum = strlen(givenKey);
+    size_t keyBitNum = keyByteNum * BIT_PER_CHAR;
+    unsigned char* key = (unsigned char*) malloc(keyByteNum + 1);
+    assert(key);
+    if (fDict->keyMode == RDICT_KEY_FOLDED) {
+        normaliseKey((char*) key, givenKey, keyByteNum);
+    } else {
+        memcpy(key, givenKey, keyByteNum);
+    }
+
+    // follow the given key down to the first node that splits after it ends
+    size_t node = 0;
+    while (isInternal(fDict, node)) {
+        size_t rank = bitVectorRank1(fDict->shape, node);
+        size_t branchBit = packedArrayGet(fDict->branchBits, rank);
+        if (branchBit >= keyBitNum) {
+            break;
+        }
+        node = 2 * rank + 1 + getKeyBit(key, branchBit);
+    }
+
+    // all keys below the node share their first keyBitNum bits, so checking the leftmost one is enough
+    size_t leftmost = node;
+    while (isInternal(fDict, leftmost)) {
+        leftmost = getFirstBranch(fDict, leftmost);
+    }
+    MatchedData** matchedList = NULL;
+    if (leafStartsWith(fDict, getLeafIdx(fDict, leftmost), key, keyByteNum)) {
+        matchedList = collectFrozenData(fDict, node, matchedKeyNum, matchedRecordNum);
+    } else {
+        matchedList = (MatchedData**) malloc(MATCHED_LIST_SIZE * sizeof(MatchedData*));
+        assert(matchedList);
+    }
+    free(key);
+    TRACE(TRACE_LEVEL_DEBUG, TRACE_EV_RDICT_SEARCH, *matchedKeyNum, *matchedRecordNum, givenKey);
+    return matchedList;
+}
+
+
+/**
+ * @brief  Get the number of bytes used by a frozen dictionary (data records themselves are not counted)
+ */
+size_t getFrozenRDictMemory(FrozenRDictionary* fDict) {
+    size_t bytes = sizeof(FrozenRDictionary);
+    bytes += getBitVectorMemory(fDict->shape);
+    bytes += getPackedArrayMemory(fDict->branchBits);
+    bytes += getPackedArrayMemory(fDict->keyStarts);
+    bytes += packedArrayGet(fDict->keyStarts, fDict->leafNum) + 1;
+    bytes += getPackedArrayMemory(fDict->recordStarts);
+    bytes += (packedArrayGet(fDict->recordStarts, fDict->leafNum) + 1) * sizeof(void*);
+    return bytes;
+}
+
+
+/**
+ * @brief  Free a frozen dictionary
+ * @param  fDict:
+ * @param  fFreeData: method used to free data entries
+ */
+void freeFrozenRDict(FrozenRDictionary* fDict, void (*fFreeData)(void*)) {
+    size_t recordNum = packedArrayGet(fDict->recordStarts, fDict->leafNum);
+    for (size_t i = 0; i < recordNum; i++) {
+        fFreeData(fDict->records[i]);
+    }
+    freeBitVector(fDict->shape);
+    freePackedArray(fDict->branchBits);
+    freePackedArray(fDict->keyStarts);
+    free(fDict->keys);
+    freePackedArray(fDict->recordStarts);
+    free(fDict->records);
+    free(fDict);
+}
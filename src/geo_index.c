@@ -0,0 +1,382 @@
+/**
+ * @brief  Geospatial index implementation
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <assert.h>
+
+#include "geo_index.h"
+#include "int_radix_tree_dictionary.h"
+#include "int_radix_tree_internal.h"
+#include "my_heap.h"
+#include "my_bool.h"
+
+// Each coordinate is quantised to 2^32 cells
+#define COORD_CELL_NUM 4294967296.0
+
+#define LONGITUDE_MIN -180.0
+#define LONGITUDE_MAX 180.0
+#define LATITUDE_MIN -90.0
+#define LATITUDE_MAX 90.0
+
+// Length of one degree of a great circle, with a mean Earth radius of 6371 km
+#define METRES_PER_DEGREE 111194.93
+#define RADIANS_PER_DEGREE (M_PI / 180.0)
+
+// Size of the list of entries when the index is created
+#define INITIAL_ENTRY_NUM 64
+
+// Used for searching by box.
+#define MATCHED_LIST_SIZE 16
+
+// Kinds of items in the heap of a nearest search
+#define GEO_SUBTREE 0
+#define GEO_ENTRY   1
+
+// A point with its data. The tree holds the positions of entries as its records.
+typedef struct GeoEntryStruct GeoEntry;
+struct GeoEntryStruct {
+    double longitude;
+    double latitude;
+    void* data;
+};
+
+struct GeoIndexStruct {
+    IRDictionary* tree;
+    GeoEntry* entries;
+    size_t entryNum;
+    size_t size;
+};
+
+// Quantised ranges of coordinates covered by a node, both ends included
+typedef struct CellStruct Cell;
+struct CellStruct {
+    uint32_t longitudeLow;
+    uint32_t longitudeHigh;
+    uint32_t latitudeLow;
+    uint32_t latitudeHigh;
+};
+
+// A growing list of matched data items
+typedef struct GeoCollectionStruct GeoCollection;
+struct GeoCollectionStruct {
+    void** list;
+    size_t size;
+    int num;
+};
+
+
+/**
+ * @brief Geospatial index creation.
+ *
+ * @return GeoIndex*
+ */
+GeoIndex* createGeoIndex() {
+    GeoIndex* geo = (GeoIndex*) malloc(sizeof(GeoIndex));
+    assert(geo);
+    geo->tree = createIRDict(IRDICT_KEY_64);
+    geo->size = INITIAL_ENTRY_NUM;
+    geo->entryNum = 0;
+    geo->entries = (GeoEntry*) malloc(geo->size * sizeof(GeoEntry));
+    assert(geo->entries);
+    return geo;
+}
+
+
+// Get the cell of a coordinate, coordinates out of the range are put in the cells at its ends.
+static uint32_t quantise(double value, double min, double max) {
+    double cell = (value - min) / (max - min) * COORD_CELL_NUM;
+    if (cell < 0) {
+        return 0;
+    }
+    if (cell >= COORD_CELL_NUM) {
+        return UINT32_MAX;
+    }
+    return (uint32_t) cell;
+}
+
+
+// Get the coordinate where a cell starts.
+static double cellToCoord(uint64_t cell, double min, double max) {
+    return min + cell * (max - min) / COORD_CELL_NUM;
+}
+
+
+// Put a 0 before each bit of a value: ...dcba -> ...0d0c0b0a
+static uint64_t spreadBits(uint32_t value) {
+    uint64_t x = value;
+    x = (x | (x << 16)) & 0x0000FFFF0000FFFFull;
+    x = (x | (x << 8))  & 0x00FF00FF00FF00FFull;
+    x = (x | (x << 4))  & 0x0F0F0F0F0F0F0F0Full;
+    x = (x | (x << 2))  & 0x3333333333333333ull;
+    x = (x | (x << 1))  & 0x5555555555555555ull;
+    return x;
+}
+
+
+// Take every other bit of a value, starting with the lowest one. The reverse of spreadBits.
+static uint32_t compactBits(uint64_t x) {
+    x &= 0x5555555555555555ull;
+    x = (x | (x >> 1))  & 0x3333333333333333ull;
+    x = (x | (x >> 2))  & 0x0F0F0F0F0F0F0F0Full;
+    x = (x | (x >> 4))  & 0x00FF00FF00FF00FFull;
+    x = (x | (x >> 8))  & 0x0000FFFF0000FFFFull;
+    x = (x | (x >> 16)) & 0x00000000FFFFFFFFull;
+    return (uint32_t) x;
+}
+
+
+// Interleave the cells of the coordinates of a point, longitude first as in geohash.
+static uint64_t getMortonKey(double longitude, double latitude) {
+    return spreadBits(quantise(longitude, LONGITUDE_MIN, LONGITUDE_MAX)) << 1 |
+           spreadBits(quantise(latitude, LATITUDE_MIN, LATITUDE_MAX));
+}
+
+
+// Get the cells covered by a node: the bits below its prefix can be anything.
+static void getCell(IRNode* node, Cell* cell) {
+    uint64_t mask = getIRHighMask(node->prefixBits);
+    uint64_t low = node->key & mask;
+    uint64_t high = node->key | ~mask;
+    cell->longitudeLow = compactBits(low >> 1);
+    cell->longitudeHigh = compactBits(high >> 1);
+    cell->latitudeLow = compactBits(low);
+    cell->latitudeHigh = compactBits(high);
+}
+
+
+/**
+ * @brief Insert a data item at a point.
+ *
+ * @param geo
+ * @param longitude from -180 to 180
+ * @param latitude from -90 to 90
+ * @param data
+ */
+void geoIndexInsert(GeoIndex* geo, double longitude, double latitude, void* data) {
+    if (geo->entryNum == geo->size) {
+        geo->size *= 2;
+        geo->entries = (GeoEntry*) realloc(geo->entries, geo->size * sizeof(GeoEntry));
+        assert(geo->entries);
+    }
+    size_t position = geo->entryNum ++;
+    geo->entries[position].longitude = longitude;
+    geo->entries[position].latitude = latitude;
+    geo->entries[position].data = data;
+    irDictInsert(geo->tree, getMortonKey(longitude, latitude), (void*) (uintptr_t) position);
+}
+
+
+static inline GeoEntry* getEntry(GeoIndex* geo, void* record) {
+    return &geo->entries[(uintptr_t) record];
+}
+
+
+static void initCollection(GeoCollection* collection) {
+    collection->size = MATCHED_LIST_SIZE;
+    collection->num = 0;
+    collection->list = (void**) malloc(collection->size * sizeof(void*));
+    assert(collection->list);
+}
+
+
+static void addMatchedData(GeoCollection* collection, void* data) {
+    if (collection->num == collection->size) {
+        collection->size *= 2;
+        collection->list = (void**) realloc(collection->list, collection->size * sizeof(void*));
+        assert(collection->list);
+    }
+    collection->list[collection->num ++] = data;
+}
+
+
+// Collect every data item below a node, in Morton order.
+static void collectSubtree(GeoIndex* geo, GeoCollection* collection, IRNode* node) {
+    IRNode* stack[IR_KEY_BITS + 2];
+    int stackTop = 0;
+    stack[stackTop ++] = node;
+    while (stackTop != 0) {
+        IRNode* currentNode = stack[-- stackTop];
+        if (isIRLeaf(currentNode)) {
+            void** records = getIRLeafRecords(currentNode);
+            for (uint32_t i = 0; i < currentNode->recordNum; i++) {
+                addMatchedData(collection, getEntry(geo, records[i])->data);
+            }
+        } else {
+            stack[stackTop ++] = currentNode->branchB;
+            stack[stackTop ++] = currentNode->branchA;
+        }
+    }
+}
+
+
+/**
+ * @brief Search for the data items inside a bounding box (borders included).
+ *        Cells outside the box are skipped and cells inside it are collected without checking their points.
+ *
+ * @param geo
+ * @param minLongitude
+ * @param minLatitude
+ * @param maxLongitude
+ * @param maxLatitude
+ * @param matchedNum number of data items in the box
+ * @return data items in the box, in Morton order
+ */
+void** geoBoxSearch(GeoIndex* geo, double minLongitude, double minLatitude,
+                    double maxLongitude, double maxLatitude, int* matchedNum) {
+    GeoCollection collection;
+    initCollection(&collection);
+    uint32_t lowLongitude = quantise(minLongitude, LONGITUDE_MIN, LONGITUDE_MAX);
+    uint32_t highLongitude = quantise(maxLongitude, LONGITUDE_MIN, LONGITUDE_MAX);
+    uint32_t lowLatitude = quantise(minLatitude, LATITUDE_MIN, LATITUDE_MAX);
+    uint32_t highLatitude = quantise(maxLatitude, LATITUDE_MIN, LATITUDE_MAX);
+
+    IRNode* stack[IR_KEY_BITS + 2];
+    int stackTop = 0;
+    if (geo->tree->root != NULL && minLongitude <= maxLongitude && minLatitude <= maxLatitude) {
+        stack[stackTop ++] = geo->tree->root;
+    }
+    while (stackTop != 0) {
+        IRNode* node = stack[-- stackTop];
+        Cell cell;
+        getCell(node, &cell);
+        if (cell.longitudeHigh < lowLongitude || cell.longitudeLow > highLongitude ||
+            cell.latitudeHigh < lowLatitude || cell.latitudeLow > highLatitude) {
+            continue;
+        }
+        // the cells of the borders may hold points outside the box, the cells between them can't
+        if (cell.longitudeLow > lowLongitude && cell.longitudeHigh < highLongitude &&
+            cell.latitudeLow > lowLatitude && cell.latitudeHigh < highLatitude) {
+            collectSubtree(geo, &collection, node);
+            continue;
+        }
+        if (isIRLeaf(node)) {
+            void** records = getIRLeafRecords(node);
+            for (uint32_t i = 0; i < node->recordNum; i++) {
+                GeoEntry* entry = getEntry(geo, records[i]);
+                if (entry->longitude >= minLongitude && entry->longitude <= maxLongitude &&
+                    entry->latitude >= minLatitude && entry->latitude <= maxLatitude) {
+                    addMatchedData(&collection, entry->data);
+                }
+            }
+            continue;
+        }
+        stack[stackTop ++] = node->branchB;
+        stack[stackTop ++] = node->branchA;
+    }
+
+    *matchedNum = collection.num;
+    return collection.list;
+}
+
+
+/**
+ * @brief Get the distance from a point to another in metres, as used by geoNearest
+ *        (scaled at the latitude of the first point).
+ */
+double geoDistance(double longitude1, double latitude1, double longitude2, double latitude2) {
+    // scaled at the first point, so the distance from one point to any other is a Euclidean one
+    double dx = (longitude2 - longitude1) * cos(latitude1 * RADIANS_PER_DEGREE);
+    double dy = latitude2 - latitude1;
+    return sqrt(dx * dx + dy * dy) * METRES_PER_DEGREE;
+}
+
+
+// Get the distance from a point to the nearest point of the cells of a node, never more than the
+// distance to any point below it.
+static double getCellDistance(IRNode* node, double longitude, double latitude) {
+    Cell cell;
+    getCell(node, &cell);
+    double minLongitude = cellToCoord(cell.longitudeLow, LONGITUDE_MIN, LONGITUDE_MAX);
+    double maxLongitude = cellToCoord((uint64_t) cell.longitudeHigh + 1, LONGITUDE_MIN, LONGITUDE_MAX);
+    double minLatitude = cellToCoord(cell.latitudeLow, LATITUDE_MIN, LATITUDE_MAX);
+    double maxLatitude = cellToCoord((uint64_t) cell.latitudeHigh + 1, LATITUDE_MIN, LATITUDE_MAX);
+    double nearestLongitude = fmin(fmax(longitude, minLongitude), maxLongitude);
+    double nearestLatitude = fmin(fmax(latitude, minLatitude), maxLatitude);
+    return geoDistance(longitude, latitude, nearestLongitude, nearestLatitude);
+}
+
+
+/**
+ * @brief Search for the k data items nearest to a point. Cells are visited nearest first,
+ *        so the search stops once k items are closer than every cell left.
+ *
+ * @param geo
+ * @param longitude
+ * @param latitude
+ * @param k maximum number of items returned
+ * @param matchedNum number of items returned
+ * @param distances distances of the returned items in metres, of size k. Pass NULL if not needed.
+ * @return data items, nearest first. Items at equal distances come in no particular order.
+ */
+void** geoNearest(GeoIndex* geo, double longitude, double latitude, int k, int* matchedNum, double* distances) {
+    void** matched = (void**) malloc(((k > 0 ? k : 0) + 1) * sizeof(void*));
+    assert(matched);
+    *matchedNum = 0;
+    if (geo->tree->root == NULL || k <= 0) {
+        return matched;
+    }
+
+    // the heap pops the largest priority, so distances are negated
+    Heap* heap = newHeap();
+    heapPush(heap, geo->tree->root, GEO_SUBTREE, -getCellDistance(geo->tree->root, longitude, latitude));
+    while (*matchedNum < k && getHeapSize(heap) != 0) {
+        int kind;
+        double priority;
+        void* item = heapPop(heap, &kind, &priority);
+        if (kind == GEO_ENTRY) {
+            // nothing left in the heap is nearer
+            if (distances != NULL) {
+                distances[*matchedNum] = -priority;
+            }
+            matched[(*matchedNum) ++] = ((GeoEntry*) item)->data;
+            continue;
+        }
+        IRNode* node = (IRNode*) item;
+        if (isIRLeaf(node)) {
+            void** records = getIRLeafRecords(node);
+            for (uint32_t i = 0; i < node->recordNum; i++) {
+                GeoEntry* entry = getEntry(geo, records[i]);
+                heapPush(heap, entry, GEO_ENTRY, -geoDistance(longitude, latitude, entry->longitude, entry->latitude));
+            }
+        } else {
+            heapPush(heap, node->branchA, GEO_SUBTREE, -getCellDistance(node->branchA, longitude, latitude));
+            heapPush(heap, node->branchB, GEO_SUBTREE, -getCellDistance(node->branchB, longitude, latitude));
+        }
+    }
+    freeHeap(heap);
+    return matched;
+}
+
+
+/**
+ * @brief Get the number of data items
+ */
+size_t getGeoIndexSize(GeoIndex* geo) {
+    return geo->entryNum;
+}
+
+
+// Positions of entries in the tree are not allocated.
+static void keepPosition(void* data) {
+}
+
+
+/**
+ * @brief Free a geospatial index
+ *
+ * @param geo
+ * @param fFreeData method used to free data items
+ */
+void freeGeoIndex(GeoIndex* geo, void (*fFreeData)(void*)) {
+    assert(geo);
+    freeIRDict(geo->tree, keepPosition);
+    for (size_t i = 0; i < geo->entryNum; i++) {
+        fFreeData(geo->entries[i].data);
+    }
+    free(geo->entries);
+    free(geo);
+}
@@ -0,0 +1,206 @@
+/**
+ * @brief  Latency histogram implementation
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "histogram.h"
+
+// Values of HISTOGRAM_SUB_BUCKET_NUM and above are counted in the half of the sub-buckets holding
+// their top HISTOGRAM_SUB_BUCKET_BITS bits, one set of them for each shift.
+#define HALF_SUB_BUCKET_NUM (HISTOGRAM_SUB_BUCKET_NUM / 2)
+#define MAX_SHIFT (64 - HISTOGRAM_SUB_BUCKET_BITS)
+#define BUCKET_NUM ((MAX_SHIFT + 1) * HALF_SUB_BUCKET_NUM + HALF_SUB_BUCKET_NUM)
+
+// Number of percentile lines printed at most, the last one is at 100 - 100 / 2^PRINT_MAX_STEP_NUM
+#define PRINT_MAX_STEP_NUM 20
+
+struct LogLinearHistogram {
+    uint64_t counts[BUCKET_NUM];
+    uint64_t count;
+    uint64_t max;
+    uint64_t sum;
+};
+
+
+static inline int getShift(uint64_t value) {
+    if (value < HISTOGRAM_SUB_BUCKET_NUM) {
+        return 0;
+    }
+    return 63 - __builtin_clzll(value) - (HISTOGRAM_SUB_BUCKET_BITS - 1);
+}
+
+
+static inline size_t getBucketIdx(uint64_t value) {
+    int shift = getShift(value);
+    return (size_t) shift * HALF_SUB_BUCKET_NUM + (value >> shift);
+}
+
+
+// Highest value counted in a bucket
+static uint64_t getBucketHighest(size_t idx) {
+    int shift = idx < HISTOGRAM_SUB_BUCKET_NUM ? 0 : (int) (idx / HALF_SUB_BUCKET_NUM) - 1;
+    uint64_t sub = idx - (uint64_t) shift * HALF_SUB_BUCKET_NUM;
+    return (sub << shift) + ((1ull << shift) - 1);
+}
+
+
+/**
+ * @brief  Create an empty histogram
+ */
+Histogram* createHistogram() {
+    Histogram* histogram = (Histogram*) calloc(1, sizeof(Histogram));
+    assert(histogram);
+    return histogram;
+}
+
+
+/**
+ * @brief  Count one value
+ */
+void histogramRecord(Histogram* histogram, uint64_t value) {
+    histogram->counts[getBucketIdx(value)] ++;
+    histogram->count ++;
+    histogram->sum += value;
+    if (value > histogram->max) {
+        histogram->max = value;
+    }
+}
+
+
+/**
+ * @brief  Count one value while other threads may read the histogram. There must be only one
+ *         writing thread: each field is updated with a relaxed atomic store, which costs the same
+ *         as histogramRecord. Readers may see a value counted in one field and not yet in another.
+ */
+void histogramRecordShared(Histogram* histogram, uint64_t value) {
+    uint64_t* bucket = &histogram->counts[getBucketIdx(value)];
+    __atomic_store_n(bucket, *bucket + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&histogram->count, histogram->count + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&histogram->sum, histogram->sum + value, __ATOMIC_RELAXED);
+    if (value > histogram->max) {
+        __atomic_store_n(&histogram->max, value, __ATOMIC_RELAXED);
+    }
+}
+
+
+/**
+ * @brief  Add the counts of src to dest
+ */
+void histogramMerge(Histogram* dest, Histogram* src) {
+    for (size_t i = 0; i < BUCKET_NUM; i++) {
+        dest->counts[i] += src->counts[i];
+    }
+    dest->count += src->count;
+    dest->sum += src->sum;
+    if (src->max > dest->max) {
+        dest->max = src->max;
+    }
+}
+
+
+/**
+ * @brief  Forget every value
+ */
+void histogramReset(Histogram* histogram) {
+    memset(histogram, 0, sizeof(Histogram));
+}
+
+
+/**
+ * @brief  Get the number of values counted
+ */
+uint64_t getHistogramCount(Histogram* histogram) {
+    return histogram->count;
+}
+
+
+/**
+ * @brief  Get the mean of the values counted, 0 if there is none
+ */
+double getHistogramMean(Histogram* histogram) {
+    return histogram->count == 0 ? 0 : (double) histogram->sum / histogram->count;
+}
+
+
+/**
+ * @brief  Get the largest value counted (exact), 0 if there is none
+ */
+uint64_t getHistogramMax(Histogram* histogram) {
+    return histogram->max;
+}
+
+
+/**
+ * @brief  Get the value below or at which the given percentage of the values are
+ * @param  histogram:
+ * @param  percentile: from 0 to 100
+ * @retval the highest value of the bucket holding that value, at most the largest value counted
+ */
+uint64_t getHistogramPercentile(Histogram* histogram, double percentile) {
+    if (histogram->count == 0) {
+        return 0;
+    }
+    uint64_t target = (uint64_t) (percentile / 100 * histogram->count + 0.5);
+    if (target < 1) {
+        target = 1;
+    }
+    uint64_t below = 0;
+    for (size_t i = 0; i < BUCKET_NUM; i++) {
+        below += histogram->counts[i];
+        if (below >= target) {
+            uint64_t highest = getBucketHighest(i);
+            return highest < histogram->max ? highest : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+
+// Number of values below or at a value
+static uint64_t getCountAtOrBelow(Histogram* histogram, uint64_t value) {
+    uint64_t below = 0;
+    size_t lastIdx = getBucketIdx(value);
+    for (size_t i = 0; i <= lastIdx; i++) {
+        below += histogram->counts[i];
+    }
+    return below;
+}
+
+
+/**
+ * @brief  Print the distribution of the values, one line per percentile (50, 75, 87.5, ...
+ *         halving the rest each time, up to the largest value), with the number of values below.
+ * @param  histogram:
+ * @param  out:
+ * @param  unitScale: values are divided by it when printed, e.g. 1000 to print nanoseconds as microseconds
+ */
+void printHistogram(Histogram* histogram, FILE* out, double unitScale) {
+    fprintf(out, "%14s %12s %12s\n", "value", "percentile", "count");
+    if (histogram->count == 0) {
+        return;
+    }
+    double rest = 50;
+    for (int step = 0; step < PRINT_MAX_STEP_NUM; step++) {
+        double percentile = 100 - rest;
+        uint64_t value = getHistogramPercentile(histogram, percentile);
+        uint64_t below = getCountAtOrBelow(histogram, value);
+        if (value == histogram->max) {
+            break;
+        }
+        fprintf(out, "%14.1f %12.6f %12lu\n", value / unitScale, percentile, (unsigned long) below);
+        rest /= 2;
+    }
+    fprintf(out, "%14.1f %12.6f %12lu\n", histogram->max / unitScale, 100.0, (unsigned long) histogram->count);
+}
+
+
+/**
+ * @brief  Free a histogram
+ */
+void freeHistogram(Histogram* histogram) {
+    free(histogram);
+}
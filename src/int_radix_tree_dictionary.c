@@ -0,0 +1,297 @@
+/**
+ * @brief  Integer radix tree dictionary implementation
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include "int_radix_tree_dictionary.h"
+#include "int_radix_tree_internal.h"
+#include "my_bool.h"
+
+// Used for searching by key.
+#define MATCHED_LIST_SIZE 2
+
+// Smallest list of records of a leaf, used once a key has more than one record.
+#define INITIAL_LIST_SIZE 2
+
+
+/**
+ * @brief Integer Radix Tree Dictionary creation.
+ *
+ * @param keyBits width of the keys, IRDICT_KEY_32 or IRDICT_KEY_64
+ * @return IRDictionary*
+ */
+IRDictionary* createIRDict(int keyBits) {
+    assert(keyBits == IRDICT_KEY_32 || keyBits == IRDICT_KEY_64);
+    IRDictionary* irDict = (IRDictionary*) malloc(sizeof(IRDictionary));
+    assert(irDict);
+    irDict->root = NULL;
+    irDict->keyBits = keyBits;
+    irDict->keyNum = 0;
+    return irDict;
+}
+
+
+// Get the bit at a position of a key, position 0 is the most significant bit.
+static inline int getIntKeyBit(uint64_t key, uint32_t index) {
+    return (key >> (IR_KEY_BITS - 1 - index)) & 1;
+}
+
+
+// Get the number of high bits two keys share.
+static inline uint32_t getCommonBits(uint64_t key1, uint64_t key2) {
+    uint64_t diff = key1 ^ key2;
+    return diff == 0 ? IR_KEY_BITS : __builtin_clzll(diff);
+}
+
+
+static IRNode* getNewLeaf(uint64_t key, void* data) {
+    IRNode* leaf = (IRNode*) malloc(sizeof(IRNode));
+    assert(leaf);
+    leaf->key = key;
+    leaf->prefixBits = IR_KEY_BITS;
+    leaf->recordNum = 1;
+    leaf->record = data;
+    return leaf;
+}
+
+
+// Add a record to a leaf. The list is doubled whenever it is full, i.e. its size is a power of 2.
+static void addRecord(IRNode* leaf, void* data) {
+    if (leaf->recordNum == 1) {
+        void** list = (void**) malloc(INITIAL_LIST_SIZE * sizeof(void*));
+        assert(list);
+        list[0] = leaf->record;
+        leaf->list = list;
+    } else if ((leaf->recordNum & (leaf->recordNum - 1)) == 0) {
+        leaf->list = (void**) realloc(leaf->list, 2 * leaf->recordNum * sizeof(void*));
+        assert(leaf->list);
+    }
+    leaf->list[leaf->recordNum ++] = data;
+}
+
+
+/**
+ * @brief Insert a new data item with its key.
+ *
+ * @param irDict
+ * @param key must fit in the width of the keys
+ * @param data
+ */
+void irDictInsert(IRDictionary* irDict, uint64_t key, void* data) {
+    assert(irDict->keyBits == IR_KEY_BITS || (key >> irDict->keyBits) == 0);
+    IRNode** link = &irDict->root;
+    while (*link != NULL) {
+        IRNode* node = *link;
+        uint32_t commonBits = getCommonBits(key, node->key);
+        if (commonBits < node->prefixBits) {
+            // a new node with the common prefix becomes the parent of node and the new leaf
+            IRNode* leaf = getNewLeaf(key, data);
+            IRNode* parent = (IRNode*) malloc(sizeof(IRNode));
+            assert(parent);
+            parent->key = key;
+            parent->prefixBits = commonBits;
+            parent->recordNum = 0;
+            if (getIntKeyBit(key, commonBits) == 0) {
+                parent->branchA = leaf;
+                parent->branchB = node;
+            } else {
+                parent->branchA = node;
+                parent->branchB = leaf;
+            }
+            *link = parent;
+            irDict->keyNum ++;
+            return;
+        }
+        if (node->prefixBits == IR_KEY_BITS) {
+            // the same key
+            addRecord(node, data);
+            return;
+        }
+        link = getIntKeyBit(key, node->prefixBits) == 0 ? &node->branchA : &node->branchB;
+    }
+    *link = getNewLeaf(key, data);
+    irDict->keyNum ++;
+}
+
+
+// A growing list of matched keys
+typedef struct IntCollection IntCollection;
+struct IntCollection {
+    MatchedIntData** list;
+    size_t size;
+    int keyNum;
+    int recordNum;
+};
+
+
+static void addMatchedLeaf(IntCollection* collection, IRNode* leaf) {
+    if (collection->keyNum == collection->size) {
+        collection->size *= 2;
+        collection->list = (MatchedIntData**) realloc(collection->list, collection->size * sizeof(MatchedIntData*));
+        assert(collection->list);
+    }
+    MatchedIntData* matchedData = (MatchedIntData*) malloc(sizeof(MatchedIntData));
+    assert(matchedData);
+    matchedData->key = leaf->key;
+    matchedData->list = getIRLeafRecords(leaf);
+    matchedData->recordNum = leaf->recordNum;
+    collection->list[collection->keyNum ++] = matchedData;
+    collection->recordNum += leaf->recordNum;
+}
+
+
+// Collect every leaf below a node, in ascending order of keys.
+static void collectIntData(IntCollection* collection, IRNode* node) {
+    // a DFS never keeps more than one node for each level
+    IRNode* stack[IR_KEY_BITS + 2];
+    int stackTop = 0;
+    stack[stackTop ++] = node;
+    while (stackTop != 0) {
+        IRNode* currentNode = stack[-- stackTop];
+        if (currentNode->prefixBits == IR_KEY_BITS) {
+            addMatchedLeaf(collection, currentNode);
+        } else {
+            stack[stackTop ++] = currentNode->branchB;
+            stack[stackTop ++] = currentNode->branchA;
+        }
+    }
+}
+
+
+static void initCollection(IntCollection* collection) {
+    collection->size = MATCHED_LIST_SIZE;
+    collection->keyNum = 0;
+    collection->recordNum = 0;
+    collection->list = (MatchedIntData**) malloc(collection->size * sizeof(MatchedIntData*));
+    assert(collection->list);
+}
+
+
+/**
+ * @brief Search for the keys whose highest prefixBits bits are the same as those of the given key.
+ *        With prefixBits equal to the width of the keys, only the given key itself matches.
+ *
+ * @param irDict
+ * @param key
+ * @param prefixBits number of high bits compared, from 0 to the width of the keys
+ * @param matchedKeyNum number of keys that match
+ * @param matchedRecordNum number of data entries collected
+ * @return all data records of the matched keys, in ascending order of keys
+ */
+MatchedIntData** irDictPrefixMatching(IRDictionary* irDict, uint64_t key, int prefixBits,
+                                      int* matchedKeyNum, int* matchedRecordNum) {
+    assert(prefixBits >= 0 && prefixBits <= irDict->keyBits);
+    IntCollection collection;
+    initCollection(&collection);
+
+    // narrower keys are stored with their unused high bits set to 0
+    uint32_t queryBits = prefixBits + (IR_KEY_BITS - irDict->keyBits);
+    IRNode* node = irDict->root;
+    while (node != NULL) {
+        uint32_t comparedBits = node->prefixBits < queryBits ? node->prefixBits : queryBits;
+        if (getCommonBits(key, node->key) < comparedBits) {
+            break;
+        }
+        if (node->prefixBits >= queryBits) {
+            // every key below this node starts with the prefix
+            collectIntData(&collection, node);
+            break;
+        }
+        node = getIntKeyBit(key, node->prefixBits) == 0 ? node->branchA : node->branchB;
+    }
+
+    *matchedKeyNum = collection.keyNum;
+    *matchedRecordNum = collection.recordNum;
+    return collection.list;
+}
+
+
+/**
+ * @brief Search for the keys in a range. Subtrees outside the range are skipped,
+ *        subtrees inside it are collected without further comparisons.
+ *
+ * @param irDict
+ * @param low smallest key of the range
+ * @param high largest key of the range
+ * @param matchedKeyNum number of keys in the range
+ * @param matchedRecordNum number of data entries collected
+ * @return all data records of the keys in the range, in ascending order of keys
+ */
+MatchedIntData** irDictRangeMatching(IRDictionary* irDict, uint64_t low, uint64_t high,
+                                     int* matchedKeyNum, int* matchedRecordNum) {
+    IntCollection collection;
+    initCollection(&collection);
+
+    IRNode* stack[IR_KEY_BITS + 2];
+    int stackTop = 0;
+    if (irDict->root != NULL && low <= high) {
+        stack[stackTop ++] = irDict->root;
+    }
+    while (stackTop != 0) {
+        IRNode* node = stack[-- stackTop];
+        // the smallest and largest keys the subtree can hold
+        uint64_t mask = getIRHighMask(node->prefixBits);
+        uint64_t subtreeLow = node->key & mask;
+        uint64_t subtreeHigh = node->key | ~mask;
+        if (subtreeHigh < low || subtreeLow > high) {
+            continue;
+        }
+        if (low <= subtreeLow && subtreeHigh <= high) {
+            collectIntData(&collection, node);
+            continue;
+        }
+        // only a node with branches can be partly in the range
+        stack[stackTop ++] = node->branchB;
+        stack[stackTop ++] = node->branchA;
+    }
+
+    *matchedKeyNum = collection.keyNum;
+    *matchedRecordNum = collection.recordNum;
+    return collection.list;
+}
+
+
+/**
+ * @brief Get the number of different keys
+ */
+size_t getIRDictSize(IRDictionary* irDict) {
+    return irDict->keyNum;
+}
+
+
+/**
+ * @brief Free an entire integer radix tree dictionary
+ *
+ * @param irDict
+ * @param fFreeData method used to free data entries
+ */
+void freeIRDict(IRDictionary* irDict, void (*fFreeData)(void*)) {
+    assert(irDict);
+    IRNode* stack[IR_KEY_BITS + 2];
+    int stackTop = 0;
+    if (irDict->root != NULL) {
+        stack[stackTop ++] = irDict->root;
+    }
+    while (stackTop != 0) {
+        IRNode* node = stack[-- stackTop];
+        if (node->prefixBits != IR_KEY_BITS) {
+            stack[stackTop ++] = node->branchB;
+            stack[stackTop ++] = node->branchA;
+        } else {
+            void** records = getIRLeafRecords(node);
+            for (uint32_t i = 0; i < node->recordNum; i++) {
+                fFreeData(records[i]);
+            }
+            if (node->recordNum > 1) {
+                free(node->list);
+            }
+        }
+        free(node);
+    }
+    free(irDict);
+}
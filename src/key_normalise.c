@@ -0,0 +1,171 @@
+/** 
+ * @brief  Key normalisation implementation
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include "key_normalise.h"
+
+#define WORD_BYTES 8
+
+// High bit of every byte in a word, set only for non-ASCII bytes.
+#define WORD_HIGH_BITS  0x8080808080808080ULL
+#define WORD_ONES       0x0101010101010101ULL
+
+// UTF-8 continuation bytes are 10xxxxxx
+#define IS_UTF8_CONTINUATION(byte) (((byte) & 0xC0) == 0x80)
+#define UTF8_MAX_SEQ_LEN 4
+// Latin-1 letters U+00C0 to U+00DE are encoded as this lead byte and a continuation byte from
+// 0x80 to 0x9E, their lower case letters are 0x20 further on (U+00D7, the multiplication sign, isn't a letter)
+#define UTF8_LATIN1_LEAD        0xC3
+#define UTF8_LATIN1_UPPER_LAST  0x9E
+#define UTF8_MULTIPLICATION     0x97
+#define UTF8_LOWER_CASE_OFFSET  0x20
+
+// Folding of every Latin-1 byte: 'A'-'Z' to 'a'-'z', accented letters to their base letters.
+// Bytes of well-formed UTF-8 sequences don't go through it, see foldUtf8Byte.
+static const unsigned char foldTable[256] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F,   // 0x00
+    0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F,   // 0x10
+    0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F,   // 0x20
+    0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0x3E, 0x3F,   // 0x30
+    0x40, 0x61, 0x62, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6A, 0x6B, 0x6C, 0x6D, 0x6E, 0x6F,   // 0x40
+    0x70, 0x71, 0x72, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x5B, 0x5C, 0x5D, 0x5E, 0x5F,   // 0x50
+    0x60, 0x61, 0x62, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6A, 0x6B, 0x6C, 0x6D, 0x6E, 0x6F,   // 0x60
+    0x70, 0x71, 0x72, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x7B, 0x7C, 0x7D, 0x7E, 0x7F,   // 0x70
+    0x80, 0x81, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8A, 0x8B, 0x8C, 0x8D, 0x8E, 0x8F,   // 0x80
+    0x90, 0x91, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0x9B, 0x9C, 0x9D, 0x9E, 0x9F,   // 0x90
+    0xA0, 0xA1, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xAB, 0xAC, 0xAD, 0xAE, 0xAF,   // 0xA0
+    0xB0, 0xB1, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xBB, 0xBC, 0xBD, 0xBE, 0xBF,   // 0xB0
+    0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0xE6, 0x63, 0x65, 0x65, 0x65, 0x65, 0x69, 0x69, 0x69, 0x69,   // 0xC0
+    0x64, 0x6E, 0x6F, 0x6F, 0x6F, 0x6F, 0x6F, 0xD7, 0x6F, 0x75, 0x75, 0x75, 0x75, 0x79, 0xFE, 0xDF,   // 0xD0
+    0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0xE6, 0x63, 0x65, 0x65, 0x65, 0x65, 0x69, 0x69, 0x69, 0x69,   // 0xE0
+    0x64, 0x6E, 0x6F, 0x6F, 0x6F, 0x6F, 0x6F, 0xF7, 0x6F, 0x75, 0x75, 0x75, 0x75, 0x79, 0xFE, 0x79,   // 0xF0
+};
+
+
+// Number of bytes of a UTF-8 sequence starting with a byte, 0 if it can't start one
+static inline size_t getUtf8SeqLen(unsigned char lead) {
+    if (lead >= 0xC2 && lead <= 0xDF) {
+        return 2;
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+        return 3;
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+        return 4;
+    }
+    return 0;
+}
+
+
+// Length of the well-formed UTF-8 multibyte sequence starting at key[i], 0 if there is none
+static inline size_t getUtf8SeqLenAt(const unsigned char* key, size_t len, size_t i) {
+    size_t seqLen = getUtf8SeqLen(key[i]);
+    if (seqLen == 0 || i + seqLen > len) {
+        return 0;
+    }
+    for (size_t j = 1; j < seqLen; j++) {
+        if (!IS_UTF8_CONTINUATION(key[i + j])) {
+            return 0;
+        }
+    }
+    return seqLen;
+}
+
+
+// Fold byte j of a well-formed UTF-8 sequence. Its length has to stay the same, so accents are kept,
+// only upper case Latin-1 letters become lower case.
+static inline unsigned char foldUtf8Byte(const unsigned char* seq, size_t j) {
+    if (j == 1 && seq[0] == UTF8_LATIN1_LEAD && seq[1] <= UTF8_LATIN1_UPPER_LAST && seq[1] != UTF8_MULTIPLICATION) {
+        return seq[1] + UTF8_LOWER_CASE_OFFSET;
+    }
+    return seq[j];
+}
+
+
+/**
+ * @brief  Fold byte i of a key of len bytes, as normaliseKey folds it within the key.
+ *         Bytes of a well-formed UTF-8 sequence depend on the bytes around them.
+ */
+unsigned char normaliseByteAt(const char* key, size_t len, size_t i) {
+    const unsigned char* bytes = (const unsigned char*) key;
+    if (bytes[i] < 0x80) {
+        return foldTable[bytes[i]];
+    }
+    // a sequence byte i can be in starts at the last byte before it that isn't a continuation byte
+    size_t start = i;
+    while (start > 0 && i - start < UTF8_MAX_SEQ_LEN - 1 && IS_UTF8_CONTINUATION(bytes[start])) {
+        start --;
+    }
+    size_t seqLen = getUtf8SeqLenAt(bytes, len, start);
+    if (seqLen != 0 && i < start + seqLen) {
+        return foldUtf8Byte(bytes + start, i - start);
+    }
+    return foldTable[bytes[i]];
+}
+
+
+/**
+ * @brief  Fold 8 ASCII bytes at once: a byte gets 0x20 added if it's within ['A', 'Z'].
+ * @note   Every byte of word must be smaller than 0x80.
+ */
+static inline uint64_t foldAsciiWord(uint64_t word) {
+    uint64_t aboveA = word + WORD_ONES * (0x80 - 'A');        // high bit set if byte >= 'A'
+    uint64_t aboveZ = word + WORD_ONES * (0x80 - 'Z' - 1);    // high bit set if byte > 'Z'
+    uint64_t upper = (aboveA ^ aboveZ) & WORD_HIGH_BITS;
+    return word | (upper >> 2);
+}
+
+
+/**
+ * @brief  Fold the first len bytes of src into dest.
+ * @note   dest and src may be the same buffer. '\0' is kept as it is.
+ *         Runs of ASCII bytes are folded a word at a time. Well-formed UTF-8 sequences are copied,
+ *         with upper case Latin-1 letters made lower case, other bytes go through the table.
+ * @param  dest: 
+ * @param  src: 
+ * @param  len: 
+ */
+void normaliseKey(char* dest, const char* src, size_t len) {
+    const unsigned char* bytes = (const unsigned char*) src;
+    size_t i = 0;
+    while (i < len) {
+        if (i + WORD_BYTES <= len) {
+            uint64_t word;
+            memcpy(&word, src + i, WORD_BYTES);
+            if ((word & WORD_HIGH_BITS) == 0) {
+                word = foldAsciiWord(word);
+                memcpy(dest + i, &word, WORD_BYTES);
+                i += WORD_BYTES;
+                continue;
+            }
+        }
+        size_t seqLen = bytes[i] < 0x80 ? 0 : getUtf8SeqLenAt(bytes, len, i);
+        if (seqLen == 0) {
+            dest[i] = (char) foldTable[bytes[i]];
+            i ++;
+            continue;
+        }
+        unsigned char seq[UTF8_MAX_SEQ_LEN];
+        memcpy(seq, bytes + i, seqLen);
+        for (size_t j = 0; j < seqLen; j++) {
+            dest[i + j] = (char) foldUtf8Byte(seq, j);
+        }
+        i += seqLen;
+    }
+}
+
+
+/**
+ * @brief  Get a folded copy of a string
+ */
+char* getNormalisedKey(const char* key) {
+    size_t len = strlen(key);
+    char* normalised = (char*) malloc(len + 1);
+    assert(normalised);
+    normaliseKey(normalised, key, len + 1);
+    return normalised;
+}
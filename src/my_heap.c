@@ -0,0 +1,115 @@
+/**
+ * @brief  Implementation of Heap
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "my_heap.h"
+
+#define INITIAL_HEAP_SIZE 16
+
+typedef struct HeapEntry HEntry;
+struct HeapEntry {
+    double priority;
+    void* item;
+    int tag;
+};
+
+
+struct MyHeap {
+    HEntry* entries;
+    size_t size;
+    size_t capacity;
+};
+
+
+// get a new heap
+Heap* newHeap() {
+    Heap* heap = (Heap*) malloc(sizeof(Heap));
+    assert(heap);
+    heap->capacity = INITIAL_HEAP_SIZE;
+    heap->size = 0;
+    heap->entries = (HEntry*) malloc(heap->capacity * sizeof(HEntry));
+    assert(heap->entries);
+    return heap;
+}
+
+
+// Get the size of a heap
+size_t getHeapSize(Heap* heap) {
+    return heap->size;
+}
+
+
+/**
+ * @brief  Add a new item to the heap
+ * @param  heap:
+ * @param  item:
+ * @param  tag: a small integer kept with the item, e.g. to tell different kinds of items apart
+ * @param  priority:
+ */
+void heapPush(Heap* heap, void* item, int tag, double priority) {
+    if (heap->size == heap->capacity) {
+        heap->capacity *= 2;
+        heap->entries = (HEntry*) realloc(heap->entries, heap->capacity * sizeof(HEntry));
+        assert(heap->entries);
+    }
+    // move the new entry up until its parent isn't smaller
+    size_t i = heap->size ++;
+    while (i > 0 && heap->entries[(i - 1) / 2].priority < priority) {
+        heap->entries[i] = heap->entries[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap->entries[i].priority = priority;
+    heap->entries[i].item = item;
+    heap->entries[i].tag = tag;
+}
+
+
+/**
+ * @brief  Pop the item with the largest priority
+ * @param  heap:
+ * @param  tag: tag of the popped item, pass NULL if not needed
+ * @param  priority: priority of the popped item, pass NULL if not needed
+ * @retval the item, NULL if the heap is empty
+ */
+void* heapPop(Heap* heap, int* tag, double* priority) {
+    if (heap->size == 0) {
+        return NULL;
+    }
+    HEntry top = heap->entries[0];
+    HEntry last = heap->entries[-- heap->size];
+
+    // move the last entry down from the root until no child is larger
+    size_t i = 0;
+    while (2 * i + 1 < heap->size) {
+        size_t child = 2 * i + 1;
+        if (child + 1 < heap->size && heap->entries[child + 1].priority > heap->entries[child].priority) {
+            child ++;
+        }
+        if (heap->entries[child].priority <= last.priority) {
+            break;
+        }
+        heap->entries[i] = heap->entries[child];
+        i = child;
+    }
+    heap->entries[i] = last;
+
+    if (tag != NULL) {
+        *tag = top.tag;
+    }
+    if (priority != NULL) {
+        *priority = top.priority;
+    }
+    return top.item;
+}
+
+
+// Free a heap, items are not freed
+void freeHeap(Heap* heap) {
+    free(heap->entries);
+    free(heap);
+}
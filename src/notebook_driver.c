@@ -7,6 +7,8 @@
 #include "notebook_driver.h"
 #include "radix_tree_dictionary.h"
 #include "my_bool.h"
+#include "trace.h"
+#include "request_stats.h"
 
 /**
  * @brief Get a JSON string representing the notebook.
@@ -64,11 +66,78 @@ MatchedData** searchNotebook(RDictionary* notebook, cJSON* payload, int* matched
     return queryResult;
 }
 
+/**
+ * @brief Search notebook for keys within a number of edits of the given key.
+ * 
+ * @param notebook
+ * @param jsonPayload with "key" and optional "maxEdits" (default {DEFAULT_MAX_EDITS}, at most {MAX_EDITS_LIMIT})
+ * @param matchedKeyNum number of keys within the distance
+ * @param matchedNum number of data within the distance
+ * @return all data records whose keys are within the distance, NULL if the payload has no string
+ *         "key" or a negative "maxEdits"
+ */
+MatchedData** fuzzySearchNotebook(RDictionary* notebook, cJSON* payload, int* matchedKeyNum, int* matchedNum) {
+    int maxEdits = DEFAULT_MAX_EDITS;
+    cJSON* searchKeyJSON = cJSON_GetObjectItem(payload, "key");
+    if (!cJSON_IsString(searchKeyJSON) || searchKeyJSON->valuestring == NULL) {
+        return NULL;
+    }
+    char* searchKey = searchKeyJSON->valuestring;
+    cJSON* maxEditsJSON = cJSON_GetObjectItem(payload, "maxEdits");
+    if (cJSON_IsNumber(maxEditsJSON)) {
+        maxEdits = maxEditsJSON->valueint;
+    }
+    if (maxEdits < 0) {
+        return NULL;
+    }
+    if (maxEdits > MAX_EDITS_LIMIT) {
+        maxEdits = MAX_EDITS_LIMIT;
+    }
+
+    MatchedData** queryResult = rDictFuzzySearch(notebook, searchKey, maxEdits, matchedKeyNum, matchedNum);
+    assert(queryResult);
+    return queryResult;
+}
+
+/**
+ * @brief Add the matched keys and their data to a result object.
+ * 
+ * @param result
+ * @param queryResult
+ * @param matchedKeyNum
+ */
+void addMatchedData(cJSON* result, MatchedData** queryResult, int matchedKeyNum) {
+    cJSON* matchedDataArray = cJSON_CreateArray();
+    cJSON_AddItemToObject(result, "matchedData", matchedDataArray);
+    for (int i = 0; i < matchedKeyNum; i++) {
+        cJSON* matchedDataItem = cJSON_CreateObject();
+        cJSON_AddStringToObject(matchedDataItem, "key", queryResult[i]->key);
+        cJSON_AddItemToObject(matchedDataItem, "list", cJSON_CreateStringArray((const char**) queryResult[i]->list, queryResult[i]->recordNum));
+        cJSON_AddNumberToObject(matchedDataItem, "recordNum", queryResult[i]->recordNum);
+        cJSON_AddItemToArray(matchedDataArray, matchedDataItem);
+    }
+}
+
+/**
+ * @brief Free the list of matched keys of a search, not the keys and data they point to.
+ * 
+ * @param queryResult
+ * @param matchedKeyNum
+ */
+void freeMatchedData(MatchedData** queryResult, int matchedKeyNum) {
+    for (int i = 0; i < matchedKeyNum; i++) {
+        free(queryResult[i]);
+    }
+    free(queryResult);
+}
+
 /**
  * @brief Create a new notebook
+ * 
+ * @param keyMode RDICT_KEY_EXACT or RDICT_KEY_FOLDED
  */
-RDictionary* createNotebook() {
-    return createRDict();
+RDictionary* createNotebook(int keyMode) {
+    return createRDictWithKeyMode(keyMode);
 }
 
 
@@ -80,12 +149,10 @@ RDictionary* createNotebook() {
  * @return cJSON* 
  */
 cJSON* processRequest(cJSON* jsonRequest, RDictionary* notebook) {
-    printf("Processing request...\n");
     cJSON* mode = cJSON_GetObjectItem(jsonRequest, "mode");
-    printf("Mode: %s\n", mode->valuestring);
     if (cJSON_IsString(mode) && mode->valuestring != NULL) {
+        TRACE(TRACE_LEVEL_INFO, TRACE_EV_REQUEST, cJSON_GetObjectItem(jsonRequest, "payload") != NULL, 0, mode->valuestring);
         if (strcmp(mode->valuestring, "insert") == 0) {
-            printf("Inserting...\n");
             cJSON* payload = cJSON_GetObjectItem(jsonRequest, "payload");
             char* execPath = NULL;
             if (payload != NULL) {
@@ -93,7 +160,6 @@ cJSON* processRequest(cJSON* jsonRequest, RDictionary* notebook) {
             } else {
                 execPath = EXEC_PATH_ERROR;
             }
-            printf("Result ExecPath: %s\n", execPath);
             cJSON* result = cJSON_CreateObject();
             cJSON_AddStringToObject(result, "execPath", execPath);
             return result;
@@ -113,27 +179,53 @@ cJSON* processRequest(cJSON* jsonRequest, RDictionary* notebook) {
                 cJSON_AddNumberToObject(result, "comparedStr", comparedStr);
                 cJSON_AddNumberToObject(result, "comparedChar", comparedChar);
                 cJSON_AddNumberToObject(result, "comparedBit", comparedBit);
-                cJSON* matchedDataArray = cJSON_CreateArray();
-                cJSON_AddItemToObject(result, "matchedData", matchedDataArray);
-                for (int i = 0; i < matchedKeyNum; i++) {
-                    cJSON* matchedDataItem = cJSON_CreateObject();
-                    cJSON_AddStringToObject(matchedDataItem, "key", queryResult[i]->key);
-                    cJSON_AddItemToObject(matchedDataItem, "list", cJSON_CreateStringArray((const char**) queryResult[i]->list, queryResult[i]->recordNum));
-                    cJSON_AddNumberToObject(matchedDataItem, "recordNum", queryResult[i]->recordNum);
-                    cJSON_AddItemToArray(matchedDataArray, matchedDataItem);
-                }
+                addMatchedData(result, queryResult, matchedKeyNum);
             } else {
                 execPath = EXEC_PATH_ERROR;
             }
             cJSON_AddStringToObject(result, "execPath", execPath);
             return result;
+        } else if (strcmp(mode->valuestring, "fuzzy_search") == 0) {
+            cJSON* payload = cJSON_GetObjectItem(jsonRequest, "payload");
+            cJSON* result = cJSON_CreateObject();
+            int matchedKeyNum = 0;
+            int matchedRecordNum = 0;
+            MatchedData** queryResult = payload == NULL ? NULL :
+                                        fuzzySearchNotebook(notebook, payload, &matchedKeyNum, &matchedRecordNum);
+            if (queryResult != NULL) {
+                cJSON_AddNumberToObject(result, "matchedKeyNum", matchedKeyNum);
+                cJSON_AddNumberToObject(result, "matchedRecordNum", matchedRecordNum);
+                addMatchedData(result, queryResult, matchedKeyNum);
+                freeMatchedData(queryResult, matchedKeyNum);
+            }
+            return result;
+        } else if (strcmp(mode->valuestring, "contains") == 0) {
+            cJSON* payload = cJSON_GetObjectItem(jsonRequest, "payload");
+            cJSON* keyJSON = cJSON_GetObjectItem(payload, "key");
+            cJSON* result = cJSON_CreateObject();
+            if (cJSON_IsString(keyJSON) && keyJSON->valuestring != NULL) {
+                int matchedKeyNum = 0;
+                int matchedRecordNum = 0;
+                int comparedStr = 0;
+                MatchedData** queryResult = containsMatching(notebook, keyJSON->valuestring, &matchedKeyNum, 
+                                                            &matchedRecordNum, &comparedStr);
+                cJSON_AddNumberToObject(result, "matchedKeyNum", matchedKeyNum);
+                cJSON_AddNumberToObject(result, "matchedRecordNum", matchedRecordNum);
+                cJSON_AddNumberToObject(result, "comparedStr", comparedStr);
+                addMatchedData(result, queryResult, matchedKeyNum);
+                freeMatchedData(queryResult, matchedKeyNum);
+            }
+            return result;
         } else if (strcmp(mode->valuestring, "get_tree") == 0) {
             char* notebookJson = getNotebookTrieJson(notebook);
             cJSON* result = cJSON_CreateObject();
             cJSON_AddStringToObject(result, "notebookJson", notebookJson);
             return result;
+        } else if (strcmp(mode->valuestring, "stats") == 0) {
+            return requestStats2Json();
         }
     }
+    TRACE(TRACE_LEVEL_ERROR, TRACE_EV_REQUEST_UNKNOWN, 0, 0, NULL);
     return NULL;
 }
 
@@ -0,0 +1,172 @@
+/**
+ * @brief  Parallel collection implementation
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "parallel_collect.h"
+
+#define INITIAL_ITEM_NUM 16
+#define INITIAL_PENDING_NUM 64
+
+typedef struct CollectTaskStruct CollectTask;
+
+// Either a key found by a task, or a subtree handed over to the pool whose keys go at this place
+typedef struct CollectItemStruct CollectItem;
+struct CollectItemStruct {
+    MatchedData* data;
+    CollectTask* subtask;
+};
+
+struct CollectTaskStruct {
+    RNode* root;
+    CollectItem* items;     // in depth-first order
+    size_t itemNum;
+    size_t itemSize;
+};
+
+// Counters of the whole collection, added to by every task
+typedef struct CollectContextStruct CollectContext;
+struct CollectContextStruct {
+    int keyNum;
+    int recordNum;
+};
+
+
+static CollectTask* newCollectTask(RNode* root) {
+    CollectTask* task = (CollectTask*) malloc(sizeof(CollectTask));
+    assert(task);
+    task->root = root;
+    task->itemSize = INITIAL_ITEM_NUM;
+    task->itemNum = 0;
+    task->items = (CollectItem*) malloc(task->itemSize * sizeof(CollectItem));
+    assert(task->items);
+    return task;
+}
+
+
+static void appendItem(CollectTask* task, MatchedData* data, CollectTask* subtask) {
+    if (task->itemNum == task->itemSize) {
+        task->itemSize *= 2;
+        task->items = (CollectItem*) realloc(task->items, task->itemSize * sizeof(CollectItem));
+        assert(task->items);
+    }
+    task->items[task->itemNum].data = data;
+    task->items[task->itemNum].subtask = subtask;
+    task->itemNum ++;
+}
+
+
+// A node still to visit, or a subtree handed over to the pool (subtask set) whose keys go at this place
+typedef struct PendingEntryStruct PendingEntry;
+struct PendingEntryStruct {
+    RNode* node;
+    CollectTask* subtask;
+};
+
+
+// Walk the subtree of a task. Subtrees handed over stay on the pending stack, so they are popped
+// once everything before them is done, which is where their keys belong.
+static void collectTask(WorkPool* pool, int workerIdx, void* arg, void* context) {
+    CollectTask* task = (CollectTask*) arg;
+    int keyNum = 0, recordNum = 0;
+
+    size_t pendingSize = INITIAL_PENDING_NUM;
+    size_t pendingNum = 0;
+    PendingEntry* pending = (PendingEntry*) malloc(pendingSize * sizeof(PendingEntry));
+    assert(pending);
+    pending[pendingNum].node = task->root;
+    pending[pendingNum ++].subtask = NULL;
+
+    while (pendingNum != 0) {
+        PendingEntry entry = pending[-- pendingNum];
+        if (entry.subtask != NULL) {
+            appendItem(task, NULL, entry.subtask);
+            continue;
+        }
+        RNode* currentNode = entry.node;
+        if (currentNode->recordNum != 0) {
+            MatchedData* matchedData = (MatchedData*) malloc(sizeof(MatchedData));
+            assert(matchedData);
+            matchedData->key = currentNode->key;
+            matchedData->list = currentNode->list;
+            matchedData->recordNum = currentNode->recordNum;
+            appendItem(task, matchedData, NULL);
+            keyNum ++;
+            recordNum += currentNode->recordNum;
+        }
+
+        if (pendingNum + 2 > pendingSize) {
+            pendingSize *= 2;
+            pending = (PendingEntry*) realloc(pending, pendingSize * sizeof(PendingEntry));
+            assert(pending);
+        }
+        if (currentNode->branchB != NULL) {
+            pending[pendingNum].node = currentNode->branchB;
+            pending[pendingNum].subtask = NULL;
+            if (currentNode->branchA != NULL && getWorkPoolQueuedNum(pool, workerIdx) == 0) {
+                // nothing left for thieves on this worker, offer them branchB
+                pending[pendingNum].subtask = newCollectTask(currentNode->branchB);
+                workPoolSpawn(pool, workerIdx, pending[pendingNum].subtask);
+            }
+            pendingNum ++;
+        }
+        if (currentNode->branchA != NULL) {
+            pending[pendingNum].node = currentNode->branchA;
+            pending[pendingNum ++].subtask = NULL;
+        }
+    }
+    free(pending);
+
+    CollectContext* counters = (CollectContext*) context;
+    __atomic_add_fetch(&counters->keyNum, keyNum, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&counters->recordNum, recordNum, __ATOMIC_RELAXED);
+}
+
+
+// Move the keys of a task and of the subtasks it handed over into the list, and free them.
+static void gatherTask(CollectTask* task, MatchedData** list, int* num) {
+    for (size_t i = 0; i < task->itemNum; i++) {
+        if (task->items[i].subtask != NULL) {
+            gatherTask(task->items[i].subtask, list, num);
+        } else {
+            list[(*num) ++] = task->items[i].data;
+        }
+    }
+    free(task->items);
+    free(task);
+}
+
+
+/**
+ * @brief  Collect the keys of subtrees, in depth-first order (branchA first), one subtree after another
+ * @param  pool:
+ * @param  roots: roots of the subtrees
+ * @param  rootNum:
+ * @param  matchedKeyNum: set to the number of keys collected
+ * @param  recordNum: set to the number of data records of those keys
+ * @retval list of matchedKeyNum matched keys, each one and the list are freed by the caller
+ */
+MatchedData** parallelCollect(WorkPool* pool, RNode** roots, int rootNum, int* matchedKeyNum, int* recordNum) {
+    CollectTask** tasks = (CollectTask**) malloc(rootNum * sizeof(CollectTask*));
+    assert(tasks);
+    for (int i = 0; i < rootNum; i++) {
+        tasks[i] = newCollectTask(roots[i]);
+    }
+    CollectContext counters = {0, 0};
+    workPoolRun(pool, (void**) tasks, rootNum, collectTask, &counters);
+
+    MatchedData** list = (MatchedData**) malloc((counters.keyNum + 1) * sizeof(MatchedData*));
+    assert(list);
+    int num = 0;
+    for (int i = 0; i < rootNum; i++) {
+        gatherTask(tasks[i], list, &num);
+    }
+    assert(num == counters.keyNum);
+    free(tasks);
+    *matchedKeyNum = counters.keyNum;
+    *recordNum = counters.recordNum;
+    return list;
+}
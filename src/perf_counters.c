@@ -0,0 +1,321 @@
+/**
+ * @brief  Hardware performance counter implementation
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <assert.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "perf_counters.h"
+#include "histogram.h"
+
+#define CACHE_READ_MISS(cache) \
+    ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+typedef struct PerfCounterInfoStruct PerfCounterInfo;
+struct PerfCounterInfoStruct {
+    const char* name;
+    uint32_t type;
+    uint64_t config;
+};
+
+static const PerfCounterInfo counterInfo[PERF_COUNTER_NUM] = {
+    [PERF_COUNTER_CYCLES]        = {"cycles",        PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    [PERF_COUNTER_INSTRUCTIONS]  = {"instructions",  PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    [PERF_COUNTER_L1D_MISSES]    = {"L1d-misses",    PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_L1D)},
+    [PERF_COUNTER_LLC_MISSES]    = {"LLC-misses",    PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_LL)},
+    [PERF_COUNTER_DTLB_MISSES]   = {"dTLB-misses",   PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_DTLB)},
+    [PERF_COUNTER_BRANCH_MISSES] = {"branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+};
+
+static const char* opNames[PERF_OP_NUM] = {
+    [PERF_OP_RDICT_INSERT]    = "rDictInsert",
+    [PERF_OP_PREFIX_MATCHING] = "prefixMatching",
+    [PERF_OP_COLLECT_DATA]    = "collectData",
+};
+
+// Layout of a read of a group with PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING
+typedef struct PerfGroupReadStruct PerfGroupRead;
+struct PerfGroupReadStruct {
+    uint64_t memberNum;
+    uint64_t timeEnabled;
+    uint64_t timeRunning;
+    uint64_t values[PERF_COUNTER_NUM];
+};
+
+// Counters of one thread, opened on its first operation
+typedef struct PerfThreadCountersStruct PerfThreadCounters;
+struct PerfThreadCountersStruct {
+    BOOL opened;
+    int fds[PERF_COUNTER_NUM];          // -1 if the counter isn't available
+    int slots[PERF_COUNTER_NUM];        // place of the counter in a group read
+    int leaderFd;
+};
+
+int perfCountersOn = FALSE;
+
+static __thread PerfThreadCounters threadCounters = {FALSE};
+
+// Decided by the first thread that opens its counters
+static BOOL counterAvailable[PERF_COUNTER_NUM];
+
+static pthread_mutex_t statsLock = PTHREAD_MUTEX_INITIALIZER;
+static PerfOpStats opStats[PERF_OP_NUM];
+static Histogram* callCycles[PERF_OP_NUM];
+
+
+static int openCounter(PerfCounterId counter, int groupFd) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = counterInfo[counter].type;
+    attr.config = counterInfo[counter].config;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.disabled = groupFd == -1;
+    // user space only, which perf_event_paranoid 2 still allows
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int) syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, 0);
+}
+
+
+// Open the counters of the calling thread. FALSE if none could be opened.
+static BOOL openThreadCounters(BOOL reportErrors) {
+    PerfThreadCounters* counters = &threadCounters;
+    counters->opened = TRUE;
+    counters->leaderFd = -1;
+    int memberNum = 0;
+    for (int c = 0; c < PERF_COUNTER_NUM; c++) {
+        counters->fds[c] = openCounter(c, counters->leaderFd);
+        counters->slots[c] = -1;
+        if (counters->fds[c] < 0) {
+            if (reportErrors) {
+                fprintf(stderr, "perf counter %s not available: %s%s\n", counterInfo[c].name, strerror(errno),
+                        errno == EACCES || errno == EPERM ? " (see /proc/sys/kernel/perf_event_paranoid)" : "");
+            }
+            counters->fds[c] = -1;
+            continue;
+        }
+        if (counters->leaderFd == -1) {
+            counters->leaderFd = counters->fds[c];
+        }
+        counters->slots[c] = memberNum ++;
+    }
+    if (counters->leaderFd == -1) {
+        return FALSE;
+    }
+    ioctl(counters->leaderFd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(counters->leaderFd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return TRUE;
+}
+
+
+static void closeThreadCounters() {
+    PerfThreadCounters* counters = &threadCounters;
+    for (int c = 0; c < PERF_COUNTER_NUM; c++) {
+        if (counters->opened && counters->fds[c] != -1) {
+            close(counters->fds[c]);
+        }
+    }
+    counters->opened = FALSE;
+}
+
+
+// Read the group of the calling thread into a sample. FALSE if it can't be read.
+static BOOL readThreadCounters(PerfSample* sample) {
+    PerfThreadCounters* counters = &threadCounters;
+    if (!counters->opened) {
+        openThreadCounters(FALSE);
+    }
+    if (counters->leaderFd == -1) {
+        return FALSE;
+    }
+    PerfGroupRead groupRead;
+    if (read(counters->leaderFd, &groupRead, sizeof(groupRead)) <= 0) {
+        return FALSE;
+    }
+    for (int c = 0; c < PERF_COUNTER_NUM; c++) {
+        sample->values[c] = counters->slots[c] != -1 ? groupRead.values[counters->slots[c]] : 0;
+    }
+    sample->timeEnabled = groupRead.timeEnabled;
+    sample->timeRunning = groupRead.timeRunning;
+    return TRUE;
+}
+
+
+/**
+ * @brief Open the counters of the calling thread and turn counting on.
+ *        The reason is printed to stderr if a counter can't be opened.
+ *
+ * @return TRUE if at least one counter is available; otherwise counting stays off
+ */
+BOOL perfEnable() {
+    if (threadCounters.opened) {
+        closeThreadCounters();
+    }
+    BOOL anyAvailable = openThreadCounters(TRUE);
+    for (int c = 0; c < PERF_COUNTER_NUM; c++) {
+        counterAvailable[c] = threadCounters.fds[c] != -1;
+    }
+    pthread_mutex_lock(&statsLock);
+    for (int op = 0; op < PERF_OP_NUM; op++) {
+        if (callCycles[op] == NULL) {
+            callCycles[op] = createHistogram();
+        }
+    }
+    pthread_mutex_unlock(&statsLock);
+    if (!anyAvailable) {
+        fprintf(stderr, "no perf counter available, operations are not counted\n");
+    }
+    perfCountersOn = anyAvailable;
+    return anyAvailable;
+}
+
+
+/**
+ * @brief Turn counting off and close the counters of the calling thread.
+ *        The totals are kept.
+ */
+void perfDisable() {
+    perfCountersOn = FALSE;
+    closeThreadCounters();
+}
+
+
+/**
+ * @brief Check whether a counter could be opened. Only known once perfEnable() has been called.
+ *
+ * @param counter
+ */
+BOOL isPerfCounterAvailable(PerfCounterId counter) {
+    return counterAvailable[counter];
+}
+
+
+/**
+ * @brief Use the PERF_BEGIN macro instead of calling this directly.
+ */
+void perfSampleBegin(PerfSample* sample) {
+    sample->started = readThreadCounters(sample);
+}
+
+
+/**
+ * @brief Use the PERF_END macro instead of calling this directly.
+ */
+void perfSampleEnd(PerfSample* sample, PerfOpId op) {
+    PerfSample end;
+    if (!readThreadCounters(&end)) {
+        return;
+    }
+    // the group only counted for part of the time if it was multiplexed with other events
+    uint64_t enabled = end.timeEnabled - sample->timeEnabled;
+    uint64_t running = end.timeRunning - sample->timeRunning;
+    pthread_mutex_lock(&statsLock);
+    if (running == 0) {
+        // the group was never scheduled during the call, so there is nothing to scale up
+        opStats[op].unscheduledNum ++;
+        pthread_mutex_unlock(&statsLock);
+        return;
+    }
+    double scale = (double) enabled / running;
+    opStats[op].callNum ++;
+    for (int c = 0; c < PERF_COUNTER_NUM; c++) {
+        opStats[op].totals[c] += (end.values[c] - sample->values[c]) * scale;
+    }
+    histogramRecord(callCycles[op], (uint64_t) ((end.values[PERF_COUNTER_CYCLES] - sample->values[PERF_COUNTER_CYCLES]) * scale));
+    pthread_mutex_unlock(&statsLock);
+}
+
+
+/**
+ * @brief Get the totals of an operation.
+ *
+ * @param op
+ * @param stats
+ */
+void getPerfOpStats(PerfOpId op, PerfOpStats* stats) {
+    pthread_mutex_lock(&statsLock);
+    *stats = opStats[op];
+    pthread_mutex_unlock(&statsLock);
+}
+
+
+/**
+ * @brief Get a percentile of the cycles taken by one call of an operation.
+ *
+ * @param op
+ * @param percentile from 0 to 100
+ */
+uint64_t getPerfCallCyclesPercentile(PerfOpId op, double percentile) {
+    pthread_mutex_lock(&statsLock);
+    uint64_t cycles = callCycles[op] != NULL ? getHistogramPercentile(callCycles[op], percentile) : 0;
+    pthread_mutex_unlock(&statsLock);
+    return cycles;
+}
+
+
+/**
+ * @brief Forget the totals of every operation.
+ */
+void perfReset() {
+    pthread_mutex_lock(&statsLock);
+    memset(opStats, 0, sizeof(opStats));
+    for (int op = 0; op < PERF_OP_NUM; op++) {
+        if (callCycles[op] != NULL) {
+            histogramReset(callCycles[op]);
+        }
+    }
+    pthread_mutex_unlock(&statsLock);
+}
+
+
+/**
+ * @brief Write the totals and the counts per call of every operation that has been called,
+ *        and the per-call cycles distribution.
+ *
+ * @param f output file
+ */
+void perfPrint(FILE* f) {
+    for (int op = 0; op < PERF_OP_NUM; op++) {
+        PerfOpStats stats;
+        getPerfOpStats(op, &stats);
+        if (stats.callNum == 0 && stats.unscheduledNum == 0) {
+            continue;
+        }
+        fprintf(f, "%s: %lu calls", opNames[op], (unsigned long) stats.callNum);
+        if (stats.unscheduledNum != 0) {
+            fprintf(f, " (%lu more while the counters weren't scheduled)", (unsigned long) stats.unscheduledNum);
+        }
+        fprintf(f, "\n");
+        if (stats.callNum == 0) {
+            continue;
+        }
+        for (int c = 0; c < PERF_COUNTER_NUM; c++) {
+            if (!counterAvailable[c]) {
+                fprintf(f, "  %-14s %16s\n", counterInfo[c].name, "n/a");
+                continue;
+            }
+            fprintf(f, "  %-14s %16.0f total %14.1f per call", counterInfo[c].name, stats.totals[c],
+                    stats.totals[c] / stats.callNum);
+            if (c == PERF_COUNTER_INSTRUCTIONS && counterAvailable[PERF_COUNTER_CYCLES] && stats.totals[c] > 0) {
+                fprintf(f, "   %.2f cycles per instruction", stats.totals[PERF_COUNTER_CYCLES] / stats.totals[c]);
+            }
+            fprintf(f, "\n");
+        }
+        if (counterAvailable[PERF_COUNTER_CYCLES]) {
+            fprintf(f, "  cycles per call p50 %lu p99 %lu p999 %lu\n",
+                    (unsigned long) getPerfCallCyclesPercentile(op, 50),
+                    (unsigned long) getPerfCallCyclesPercentile(op, 99),
+                    (unsigned long) getPerfCallCyclesPercentile(op, 99.9));
+        }
+    }
+}
@@ -0,0 +1,165 @@
+/**
+ * @brief  Prefix filter implementation
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <assert.h>
+
+#include "prefix_filter.h"
+#include "key_normalise.h"
+
+// A block is one cache line
+#define BLOCK_BYTES 64
+#define BLOCK_BITS (BLOCK_BYTES * 8)
+#define BLOCK_WORDS (BLOCK_BYTES / sizeof(uint64_t))
+#define WORD_BITS 64
+
+// Bounds of the number of bits set for each prefix
+#define MIN_HASH_NUM 1
+#define MAX_HASH_NUM 16
+
+// 64-bit FNV-1a
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ull
+#define FNV_PRIME 0x100000001b3ull
+
+struct BloomPrefixFilter {
+    uint64_t* blocks;
+    size_t blockNum;
+    int prefixLen;
+    int hashNum;        // bits set in a block for each prefix
+    BOOL folded;
+};
+
+
+/**
+ * @brief  Create a prefix filter
+ * @param  prefixLen: number of leading bytes of each key whose prefixes are added, from 1 to {PREFIX_FILTER_MAX_LEN}.
+ *                    Longer queries are only checked on their first prefixLen bytes.
+ * @param  expectedKeyNum: number of keys the filter is sized for. More keys can be added,
+ *                         at a higher false positive rate.
+ * @param  falsePositiveRate: rate of absent prefixes that pass the filter with expectedKeyNum keys, e.g. 0.01.
+ *                            Smaller rates use more memory.
+ * @param  folded: TRUE if keys and prefixes should be matched case- and accent-insensitively
+ */
+PrefixFilter* createPrefixFilter(int prefixLen, size_t expectedKeyNum, double falsePositiveRate, BOOL folded) {
+    assert(prefixLen >= 1 && prefixLen <= PREFIX_FILTER_MAX_LEN);
+    assert(falsePositiveRate > 0 && falsePositiveRate < 1);
+    PrefixFilter* filter = (PrefixFilter*) malloc(sizeof(PrefixFilter));
+    assert(filter);
+    filter->prefixLen = prefixLen;
+    filter->folded = folded;
+
+    // Sized as if no two keys shared a prefix, keys with common starts only make it emptier.
+    // The optimal Bloom filter has -ln(p) / ln(2)^2 bits per item and sets ln(2) times as many bits.
+    double bitsPerPrefix = -log(falsePositiveRate) / (M_LN2 * M_LN2);
+    double bitNum = bitsPerPrefix * (double) (expectedKeyNum > 0 ? expectedKeyNum : 1) * prefixLen;
+    filter->blockNum = (size_t) ceil(bitNum / BLOCK_BITS);
+    int hashNum = (int) round(bitsPerPrefix * M_LN2);
+    filter->hashNum = hashNum < MIN_HASH_NUM ? MIN_HASH_NUM : hashNum > MAX_HASH_NUM ? MAX_HASH_NUM : hashNum;
+
+    filter->blocks = (uint64_t*) aligned_alloc(BLOCK_BYTES, filter->blockNum * BLOCK_BYTES);
+    assert(filter->blocks);
+    for (size_t i = 0; i < filter->blockNum * BLOCK_WORDS; i++) {
+        filter->blocks[i] = 0;
+    }
+    return filter;
+}
+
+
+// Mix the bits of a hash, so the block and the bits in it are taken from independent-looking bits.
+static inline uint64_t mixHash(uint64_t hash) {
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+
+// Extend the hash of a prefix with the byte at position i of a key of keyLen bytes.
+static inline uint64_t extendHash(PrefixFilter* filter, uint64_t hash, char* key, size_t keyLen, size_t i) {
+    unsigned char b = filter->folded ? normaliseByteAt(key, keyLen, i) : (unsigned char) key[i];
+    return (hash ^ b) * FNV_PRIME;
+}
+
+
+// Get the block of a prefix from the high bits of its hash.
+static inline uint64_t* getBlock(PrefixFilter* filter, uint64_t hash) {
+    size_t blockIdx = (size_t) (((hash >> 32) * filter->blockNum) >> 32);
+    return &filter->blocks[blockIdx * BLOCK_WORDS];
+}
+
+
+// Get the position of the i-th bit of a prefix in its block, by double hashing on the low bits of the hash.
+static inline unsigned int getBitPosition(uint64_t hash, int i) {
+    unsigned int first = hash & (BLOCK_BITS - 1);
+    unsigned int step = ((hash >> 16) & (BLOCK_BITS - 1)) | 1;
+    return (first + i * step) & (BLOCK_BITS - 1);
+}
+
+
+/**
+ * @brief  Add the prefixes of a key to the filter
+ */
+void prefixFilterAdd(PrefixFilter* filter, char* key) {
+    // a folded byte may depend on the bytes after the prefix
+    size_t keyLen = filter->folded ? strlen(key) : 0;
+    uint64_t hash = FNV_OFFSET_BASIS;
+    for (int len = 0; len < filter->prefixLen && key[len] != '\0'; len++) {
+        hash = extendHash(filter, hash, key, keyLen, len);
+        uint64_t mixed = mixHash(hash);
+        uint64_t* block = getBlock(filter, mixed);
+        for (int i = 0; i < filter->hashNum; i++) {
+            unsigned int bit = getBitPosition(mixed, i);
+            block[bit / WORD_BITS] |= (uint64_t) 1 << (bit % WORD_BITS);
+        }
+    }
+}
+
+
+/**
+ * @brief  Check whether some key added to the filter may start with a prefix.
+ * @retval FALSE if no key starts with the prefix, TRUE if one may (always TRUE for an empty prefix)
+ */
+BOOL prefixFilterMayContain(PrefixFilter* filter, char* prefix) {
+    if (prefix[0] == '\0') {
+        return TRUE;
+    }
+    size_t prefixByteNum = filter->folded ? strlen(prefix) : 0;
+    uint64_t hash = FNV_OFFSET_BASIS;
+    for (int len = 0; len < filter->prefixLen && prefix[len] != '\0'; len++) {
+        hash = extendHash(filter, hash, prefix, prefixByteNum, len);
+    }
+    uint64_t mixed = mixHash(hash);
+    uint64_t* block = getBlock(filter, mixed);
+    for (int i = 0; i < filter->hashNum; i++) {
+        unsigned int bit = getBitPosition(mixed, i);
+        if ((block[bit / WORD_BITS] & ((uint64_t) 1 << (bit % WORD_BITS))) == 0) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+
+/**
+ * @brief  Get the number of bytes used by the filter
+ */
+size_t getPrefixFilterMemory(PrefixFilter* filter) {
+    return sizeof(PrefixFilter) + filter->blockNum * BLOCK_BYTES;
+}
+
+
+/**
+ * @brief  Free the filter
+ */
+void freePrefixFilter(PrefixFilter* filter) {
+    assert(filter);
+    free(filter->blocks);
+    free(filter);
+}
@@ -9,15 +9,24 @@ radix_tree_dictionary.c :
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <assert.h>
+#include <float.h>
 #include <cjson/cJSON.h>
 
 #include "radix_tree_dictionary.h"
+#include "radix_tree_internal.h"
 #include "my_stack.h"
 #include "my_queue.h"
+#include "my_heap.h"
 #include "my_bool.h"
 #include "utils.h"
+#include "trace.h"
+#include "perf_counters.h"
+#include "key_normalise.h"
+#include "substring_index.h"
+#include "parallel_collect.h"
 
 #define BIT_PER_CHAR 8
 #define INITIAL_LIST_SIZE 2
@@ -33,24 +42,28 @@ radix_tree_dictionary.c :
 
 #define ALL_ZERO_BYTE 0b00000000
 
+// Score of nodes whose subtree has no scored record yet.
+#define NO_SCORE (-DBL_MAX)
 
-typedef unsigned char BYTE;
+// Kinds of entries in the heap of a top-k search.
+#define TOPK_SUBTREE 0      // a node, ordered by the best score in its subtree
+#define TOPK_KEY     1      // the key stored in a node, ordered by its own score
 
-typedef struct RadixTreeNode RNode;
-struct RadixTreeNode {
-    size_t prefixBits;
-    BYTE *prefix;
-    RNode* branchA;
-    RNode* branchB;
-    void** list;
-    size_t listSize;
-    size_t recordNum;
-    char*   key;        // If a new element is inserted, the key (and data) will be stored here in the node.
-};
+// Length of an execution path kept in place, longer paths move to the heap.
+#define EXEC_PATH_INLINE_LEN 256
+
+// Nodes placed by rDictCompact start at multiples of this
+#define ARENA_ALIGNMENT _Alignof(RNode)
 
 
-struct RadixTree {
-    RNode* root;
+// Execution path encoded into a buffer in place, so recording the steps of a usual path never
+// allocates. A longer path is moved to a buffer on the heap that doubles as it grows.
+typedef struct ExecPathBuffer ExecPath;
+struct ExecPathBuffer {
+    char inlineSteps[EXEC_PATH_INLINE_LEN];
+    char* steps;                // inlineSteps, or the heap buffer once the path outgrows it
+    size_t len;
+    size_t size;
 };
 
 
@@ -65,13 +78,57 @@ size_t min(size_t num1, size_t num2) {
 
 // Radix Tree Dictionary creation.
 RDictionary* createRDict() {
+    return createRDictWithKeyMode(RDICT_KEY_EXACT);
+}
+
+
+/**
+ * @brief Radix Tree Dictionary creation with a key mode.
+ * 
+ * @param keyMode RDICT_KEY_EXACT or RDICT_KEY_FOLDED
+ * @return RDictionary* 
+ */
+RDictionary* createRDictWithKeyMode(int keyMode) {
     RDictionary* rDict = (RDictionary*) malloc (sizeof(RDictionary));
     assert(rDict);
     rDict->root = NULL;
+    rDict->keyMode = keyMode;
+    rDict->substringIndex = NULL;
+    rDict->prefixFilter = NULL;
+    rDict->resultCache = NULL;
+    rDict->arena = NULL;
+    rDict->arenaBytes = 0;
+    rDict->collectPool = NULL;
+    rDict->parallelCollectThreshold = 0;
+    rDict->fScore = NULL;
     return rDict;
 }
 
 
+/**
+ * @brief Copy the bytes of a key into a key used by the tree, folding them in RDICT_KEY_FOLDED mode.
+ * 
+ * @param rDict 
+ * @param dest 
+ * @param key 
+ * @param byteNum number of bytes to copy
+ */
+void copyTreeKey(RDictionary* rDict, BYTE* dest, char* key, size_t byteNum) {
+    if (rDict->keyMode == RDICT_KEY_FOLDED) {
+        normaliseKey((char*) dest, key, byteNum);
+    } else {
+        memcpy(dest, key, byteNum);
+    }
+}
+
+
+// Check whether a node or a prefix was placed by rDictCompact, such memory is only freed with the whole block.
+static inline BOOL isInArena(RDictionary* rDict, void* ptr) {
+    return rDict->arena != NULL && (uintptr_t) ptr >= (uintptr_t) rDict->arena 
+           && (uintptr_t) ptr < (uintptr_t) rDict->arena + rDict->arenaBytes;
+}
+
+
 // Construct a new radix tree node using given data.
 RNode* getNewNode(size_t prefixBits, BYTE* prefix, RNode* branchA, RNode* branchB,
                 void** list, size_t listSize, size_t recordNum) {
@@ -86,6 +143,8 @@ RNode* getNewNode(size_t prefixBits, BYTE* prefix, RNode* branchA, RNode* branch
     newNode->listSize = listSize;
     newNode->recordNum = recordNum;
     newNode->key = NULL;
+    newNode->maxScore = NO_SCORE;
+    newNode->version = 0;
     return newNode;
 }
 
@@ -225,73 +284,124 @@ void sliceKey(BYTE* dest, size_t destBits, BYTE* src, size_t srcBits, size_t sta
 
 
 /**
- * @brief Free the spaces used by the execution path.
+ * @brief Start an empty execution path.
  * 
- * @param execPathQueue
+ * @param path
  */
-void freeExecPath(Queue* execPathQueue) {
-    while (getQueueSize(execPathQueue) != 0) {
-        char* step = (char*) dequeue(execPathQueue);
-        // if the step is a number, it's a malloced string, free it.
-        if (step[0] >= '0' && step[0] <= '9') {
-            free(step);
-        }
+void initExecPath(ExecPath* path) {
+    path->steps = path->inlineSteps;
+    path->len = 0;
+    path->size = EXEC_PATH_INLINE_LEN;
+}
+
+
+// Make room for num more chars
+static void execPathReserve(ExecPath* path, size_t num) {
+    if (path->len + num <= path->size) {
+        return;
     }
-    free(execPathQueue);
+    size_t size = path->size;
+    while (path->len + num > size) {
+        size *= 2;
+    }
+    if (path->steps == path->inlineSteps) {
+        path->steps = (char*) malloc(size);
+        assert(path->steps);
+        memcpy(path->steps, path->inlineSteps, path->len);
+    } else {
+        path->steps = (char*) realloc(path->steps, size);
+        assert(path->steps);
+    }
+    path->size = size;
 }
 
 
 /**
- * @brief construct the execution path from the queue.
+ * @brief Append a token (EXEC_PATH_*) to the execution path. Does nothing if path is NULL.
  * 
- * @param execPathQueue
- * @return char* 
+ * @param path
+ * @param token
  */
-char* constructExecPath(Queue* execPathQueue) {
-    size_t queueSize = getQueueSize(execPathQueue);
-    char** steps = (char**) malloc(sizeof(char*) * queueSize);
-    assert(steps);
-    for (size_t i = 0; i < queueSize; i++) {
-        steps[i] = (char*) dequeue(execPathQueue);
+void execPathAppendToken(ExecPath* path, const char* token) {
+    if (path == NULL) {
+        return;
     }
-    char* execPath = concatMultipleStrings(steps, queueSize, '\0');
-    freeExecPath(execPathQueue);
-    return execPath;
+    size_t len = strlen(token);
+    execPathReserve(path, len);
+    memcpy(path->steps + path->len, token, len);
+    path->len += len;
 }
 
 
+/**
+ * @brief Append the decimal digits of a number of compared bits to the execution path.
+ *        Does nothing if path is NULL.
+ * 
+ * @param path
+ * @param bitCount
+ */
+void execPathAppendCount(ExecPath* path, size_t bitCount) {
+    if (path == NULL) {
+        return;
+    }
+    char digits[24];
+    size_t digitNum = 0;
+    do {
+        digits[digitNum ++] = '0' + (bitCount % 10);
+        bitCount /= 10;
+    } while (bitCount != 0);
+    execPathReserve(path, digitNum);
+    for (size_t i = 0; i < digitNum; i++) {
+        path->steps[path->len ++] = digits[digitNum - 1 - i];
+    }
+}
 
 
 /**
- * @brief Insert a new data item with its key. '\0' at the end of strings will be counted in inserting process.
+ * @brief Turn the execution path into a new string. The heap buffer of a long path becomes the
+ *        string, so the path must not be used afterwards.
  * 
- * @param rDict 
- * @param key 
- * @param data 
- * @param execPath: A string representing the path of the execution in the radix tree, pass NULL if not needed.
+ * @param path
+ * @return char* 
  */
-void rDictInsert(RDictionary* rDict, char* key, void* data, char** execPath) {
+char* execPathToString(ExecPath* path) {
+    if (path->steps != path->inlineSteps) {
+        execPathReserve(path, 1);
+        path->steps[path->len] = '\0';
+        return path->steps;
+    }
+    char* execPath = (char*) malloc(path->len + 1);
+    assert(execPath);
+    memcpy(execPath, path->steps, path->len);
+    execPath[path->len] = '\0';
+    return execPath;
+}
+
+
+// rDictInsert without the instrumentation
+static void insertRecord(RDictionary* rDict, char* key, void* data, char** execPath) {
 
     char* keyBackup = (char*) malloc(strlen(key) + 1);
     assert(keyBackup);
     strcpy(keyBackup, key);
 
-    printf("Inserting key: %s\n", key);
-    printf("Inserting data: %s\n", (char*) data);
-    printf("is execPath Null? %d\n", execPath == NULL);
-
-    Queue* execPathQueue;
+    ExecPath pathBuffer;
+    ExecPath* path = NULL;
     if (execPath != NULL) {
-        execPathQueue = newQueue();
-        enqueue(execPathQueue, EXEC_PATH_ROOT);
+        initExecPath(&pathBuffer);
+        path = &pathBuffer;
     }
+    execPathAppendToken(path, EXEC_PATH_ROOT);
+
+    // every node on the way to the key gets the score of the new record as a bound of its subtree
+    double score = rDict->fScore != NULL ? rDict->fScore(data) : NO_SCORE;
 
     int byteNum = strlen(key) + 1;
     if (rDict->root == NULL) {
         // '\0' is also counted
         BYTE* prefix = (BYTE*) malloc(byteNum * sizeof (BYTE));
         assert(prefix);
-        memcpy(prefix, key, byteNum);
+        copyTreeKey(rDict, prefix, key, byteNum);
         size_t prefixBits = BIT_PER_CHAR * byteNum;
         void** list = (void**) malloc(INITIAL_LIST_SIZE * sizeof(void*));
         assert(list);
@@ -299,18 +409,30 @@ void rDictInsert(RDictionary* rDict, char* key, void* data, char** execPath) {
         size_t num = 1;
         rDict->root = getNewNode(prefixBits, prefix, NULL, NULL, list, INITIAL_LIST_SIZE, num);
         rDict->root->key = keyBackup;
+        rDict->root->maxScore = score;
+        if (rDict->substringIndex != NULL) {
+            substringIndexAdd(rDict->substringIndex, keyBackup, rDict->root);
+        }
+        if (rDict->prefixFilter != NULL) {
+            prefixFilterAdd(rDict->prefixFilter, keyBackup);
+        }
         if (execPath != NULL) {
-            *execPath = constructExecPath(execPathQueue);
+            *execPath = execPathToString(path);
         }
+        TRACE(TRACE_LEVEL_DEBUG, TRACE_EV_RDICT_INSERT, byteNum - 1, 0, key);
         return;
     }
 
     RNode* currentNode = rDict->root;
+    RNode** link = &rDict->root;    // the pointer to currentNode in its parent
 
     BYTE* tmpKey = (BYTE*) malloc(byteNum * sizeof(BYTE));
     assert(tmpKey);
-    memcpy(tmpKey, key, byteNum);
+    copyTreeKey(rDict, tmpKey, key, byteNum);
     size_t tmpKeyBitNum = byteNum * BIT_PER_CHAR;
+    size_t totalBitCount = 0;
+    BOOL isNewKey = TRUE;
+    RNode* keyNode = NULL;      // the node that ends up holding the key
 
     while (1) {
         BYTE* currentPrefix = currentNode->prefix;
@@ -318,10 +440,11 @@ void rDictInsert(RDictionary* rDict, char* key, void* data, char** execPath) {
         
         int bitCount = 0;
         int cmpResult = bitCompare(tmpKey, tmpKeyBitNum, currentPrefix, currentPrefixBitNum, &bitCount);
+        totalBitCount += bitCount;
+        execPathAppendCount(path, bitCount);
 
-        if (execPath != NULL) {
-            enqueue(execPathQueue, my_itoa(bitCount));
-        }
+        // any cached result decided at this node may change with this insert
+        currentNode->version ++;
 
         /* 
         Possible cases after the comparison:
@@ -348,24 +471,23 @@ void rDictInsert(RDictionary* rDict, char* key, void* data, char** execPath) {
             BYTE* commonPrefix = getBlankKey(commonPrefixBitNum);
             sliceKey(commonPrefix, commonPrefixBitNum, currentPrefix, currentPrefixBitNum, 0);
             
-            // node with common prefix become the parent of new nodes.
-            currentNode->prefix = commonPrefix;
-            currentNode->prefixBits = commonPrefixBitNum;
+            // a new node with the common prefix becomes the parent of the two branches.
+            // non-leaf nodes don't store data record
+            RNode* commonPrefixNode = getNewNode(commonPrefixBitNum, commonPrefix, NULL, NULL, NULL, INITIAL_LIST_SIZE, 0);
+            commonPrefixNode->maxScore = currentNode->maxScore > score ? currentNode->maxScore : score;
+            *link = commonPrefixNode;
 
-            // create new node with the rest of the prefix, parent node's data list will be transfered to this node
+            // currentNode keeps its children, key and data list with the rest of the prefix,
+            // so a node holding a key is never moved by an insert and pointers to it stay valid.
             size_t slicedPrefixBitNum = currentPrefixBitNum - commonPrefixBitNum;
             BYTE* slicedPrefix = getBlankKey(slicedPrefixBitNum);
             sliceKey(slicedPrefix, slicedPrefixBitNum, currentPrefix, currentPrefixBitNum, bitCount - 1);
-            RNode* slicedPrefixNode = getNewNode(slicedPrefixBitNum, slicedPrefix, 
-                                                currentNode->branchA, currentNode->branchB, 
-                                                currentNode->list, currentNode->listSize, currentNode->recordNum);
-            slicedPrefixNode->key = currentNode->key;
-            currentNode->key = NULL;
-            free(currentPrefix);
-            // non-leaf nodes don't store data record
-            currentNode->list = NULL;
-            currentNode->listSize = INITIAL_LIST_SIZE;
-            currentNode->recordNum = 0;
+            RNode* slicedPrefixNode = currentNode;
+            slicedPrefixNode->prefix = slicedPrefix;
+            slicedPrefixNode->prefixBits = slicedPrefixBitNum;
+            if (!isInArena(rDict, currentPrefix)) {
+                free(currentPrefix);
+            }
 
             // create new node with the rest of the given key, new data list will be created in this node
             size_t slicedTmpKeyBitNum = tmpKeyBitNum - commonPrefixBitNum;
@@ -377,26 +499,29 @@ void rDictInsert(RDictionary* rDict, char* key, void* data, char** execPath) {
             assert(slicedTmpKeyNode->list);
             slicedTmpKeyNode->list[0] = data;
             slicedTmpKeyNode->recordNum += 1;
+            slicedTmpKeyNode->maxScore = score;
+            keyNode = slicedTmpKeyNode;
 
             // get first bits from two new prefix and decide order
             BYTE bitFromSlicedPrefix = getBitFromKey(slicedPrefix, slicedPrefixBitNum, 0);
             BYTE bitFromSlicedTmpKey = getBitFromKey(slicedTmpKey, slicedTmpKeyBitNum, 0);
 
             BOOL createNewRightChild = bitFromSlicedPrefix < bitFromSlicedTmpKey;
-            if (execPath != NULL) {
-                enqueue(execPathQueue, createNewRightChild ? EXEC_PATH_NEW_RIGHT : EXEC_PATH_NEW_LEFT);
-            }
+            execPathAppendToken(path, createNewRightChild ? EXEC_PATH_NEW_RIGHT : EXEC_PATH_NEW_LEFT);
 
             if (createNewRightChild) {
-                currentNode->branchA = slicedPrefixNode;
-                currentNode->branchB = slicedTmpKeyNode;
+                commonPrefixNode->branchA = slicedPrefixNode;
+                commonPrefixNode->branchB = slicedTmpKeyNode;
             } else {
-                currentNode->branchA = slicedTmpKeyNode;
-                currentNode->branchB = slicedPrefixNode;
+                commonPrefixNode->branchA = slicedTmpKeyNode;
+                commonPrefixNode->branchB = slicedPrefixNode;
             }
 
             break;
         } else { // No difference has been found yet.
+            if (currentNode->maxScore < score) {
+                currentNode->maxScore = score;
+            }
             if (bitCount < tmpKeyBitNum) { // tmpKey is not finished, but currentPrefix has been finished.
                 size_t slicedBitNum = tmpKeyBitNum - bitCount;
                 BYTE* slicedKey = getBlankKey(slicedBitNum);
@@ -416,17 +541,16 @@ void rDictInsert(RDictionary* rDict, char* key, void* data, char** execPath) {
                         assert(currentNode->branchA->list);
                         currentNode->branchA->list[0] = data;
                         currentNode->branchA->recordNum += 1;
-                        if (execPath != NULL) {
-                            enqueue(execPathQueue, EXEC_PATH_MATCH);
-                            enqueue(execPathQueue, EXEC_PATH_NEW_LEFT);
-                        }
+                        currentNode->branchA->maxScore = score;
+                        keyNode = currentNode->branchA;
+                        execPathAppendToken(path, EXEC_PATH_MATCH);
+                        execPathAppendToken(path, EXEC_PATH_NEW_LEFT);
                         break;
                     } else {
                         // Search in branchA
+                        link = &currentNode->branchA;
                         currentNode = currentNode->branchA;
-                        if (execPath != NULL) {
-                            enqueue(execPathQueue, EXEC_PATH_LEFT);
-                        }
+                        execPathAppendToken(path, EXEC_PATH_LEFT);
                         continue;
                     }
                 } else { // first bit of the sliced key is 1
@@ -438,58 +562,127 @@ void rDictInsert(RDictionary* rDict, char* key, void* data, char** execPath) {
                         assert(currentNode->branchB->list);
                         currentNode->branchB->list[0] = data;
                         currentNode->branchB->recordNum += 1;
-                        if (execPath != NULL) {
-                            enqueue(execPathQueue, EXEC_PATH_MATCH);
-                            enqueue(execPathQueue, EXEC_PATH_NEW_RIGHT);
-                        }
+                        currentNode->branchB->maxScore = score;
+                        keyNode = currentNode->branchB;
+                        execPathAppendToken(path, EXEC_PATH_MATCH);
+                        execPathAppendToken(path, EXEC_PATH_NEW_RIGHT);
                         break;
                     } else {
                         // Search in branchB
+                        link = &currentNode->branchB;
                         currentNode = currentNode->branchB;
-                        if (execPath != NULL) {
-                            enqueue(execPathQueue, EXEC_PATH_RIGHT);
-                        }
+                        execPathAppendToken(path, EXEC_PATH_RIGHT);
                         continue;
                     }
                 }
                 
             } else { // bitcount == currentPrefixBitNum == tmpKeyBitNum, both two keys has been finished.
-                if (execPath != NULL) {
-                    enqueue(execPathQueue, EXEC_PATH_MATCH);
-                }
+                execPathAppendToken(path, EXEC_PATH_MATCH);
                 if (currentNode->recordNum == currentNode->listSize) {
                     currentNode->listSize *= 2;
                     currentNode->list = (void**) realloc(currentNode->list, (currentNode->listSize) * sizeof(void*));
                     assert(currentNode->list);
                 }
                 currentNode->list[currentNode->recordNum ++] = data;
+                keyNode = currentNode;
+                isNewKey = FALSE;
                 break;
             }
         }
     }
+    if (!isNewKey) {
+        // the node already keeps a copy of this key
+        free(keyBackup);
+    } else {
+        if (rDict->substringIndex != NULL) {
+            substringIndexAdd(rDict->substringIndex, keyBackup, keyNode);
+        }
+        if (rDict->prefixFilter != NULL) {
+            prefixFilterAdd(rDict->prefixFilter, keyBackup);
+        }
+    }
     if (execPath != NULL) {
-        *execPath = constructExecPath(execPathQueue);
+        *execPath = execPathToString(path);
     }
+    TRACE(TRACE_LEVEL_DEBUG, TRACE_EV_RDICT_INSERT, byteNum - 1, totalBitCount, key);
     free(tmpKey);
 }
 
 
+/**
+ * @brief Insert a new data item with its key. '\0' at the end of strings will be counted in inserting process.
+ * 
+ * @param rDict 
+ * @param key 
+ * @param data 
+ * @param execPath: A string representing the path of the execution in the radix tree, pass NULL if not needed.
+ */
+void rDictInsert(RDictionary* rDict, char* key, void* data, char** execPath) {
+    PerfSample sample;
+    PERF_BEGIN(&sample);
+    insertRecord(rDict, key, data, execPath);
+    PERF_END(&sample, PERF_OP_RDICT_INSERT);
+}
+
+
+// Collect the subtrees left on the stack of collectData with the pool, and append their keys to the collection.
+static MatchedData** collectRestInParallel(RDictionary* rDict, Stack* stack, MatchedData** collection, 
+                                           size_t* collectionSize, size_t* collectionItemNum, 
+                                           int* matchedKeyNum, int* recordNum) {
+    // popped in the order collectData would have visited them
+    int rootNum = getStackSize(stack);
+    RNode** roots = (RNode**) malloc(rootNum * sizeof(RNode*));
+    assert(roots);
+    for (int i = 0; i < rootNum; i++) {
+        roots[i] = (RNode*) pop(stack);
+    }
+    int keyNum = 0, keyRecordNum = 0;
+    MatchedData** rest = parallelCollect(rDict->collectPool, roots, rootNum, &keyNum, &keyRecordNum);
+    free(roots);
+
+    if (*collectionItemNum + keyNum > *collectionSize) {
+        *collectionSize = *collectionItemNum + keyNum;
+        collection = (MatchedData**) realloc(collection, *collectionSize * sizeof(MatchedData*));
+        assert(collection);
+    }
+    memcpy(collection + *collectionItemNum, rest, keyNum * sizeof(MatchedData*));
+    *collectionItemNum += keyNum;
+    (*matchedKeyNum) += keyNum;
+    (*recordNum) += keyRecordNum;
+    free(rest);
+    return collection;
+}
+
+
 /**
  * @brief collect all data entries from a radix tree node and all its child nodes (using DFS) 
+ *        If the subtree has more nodes than the threshold of parallel collection, the rest of it is
+ *        collected by the pool, in the same order.
  * 
+ * @param rDict 
  * @param node 
  * @param matechedKeyNum number of keys (strings) that matches the prefix
  * @param recordNum number of data entries collected
  */
-MatchedData** collectData(RNode* node, int* matchedKeyNum, int* recordNum) {
+MatchedData** collectData(RDictionary* rDict, RNode* node, int* matchedKeyNum, int* recordNum) {
+    PerfSample sample;
+    PERF_BEGIN(&sample);
     size_t collectionSize = MATCHED_LIST_SIZE;
     size_t collectionItemNum = 0;
     MatchedData** collection = (MatchedData**) malloc(collectionSize * sizeof(MatchedData*));
     assert(collection);
 
+    size_t visitedNum = 0;
     Stack* stack = newStack();
     push(stack, node);
     while (getStackSize(stack) != 0) {
+        if (rDict->collectPool != NULL && visitedNum == rDict->parallelCollectThreshold) {
+            // a large subtree, the nodes still on the stack are collected in parallel
+            collection = collectRestInParallel(rDict, stack, collection, &collectionSize, &collectionItemNum,
+                                               matchedKeyNum, recordNum);
+            break;
+        }
+        visitedNum ++;
         RNode* currentNode = (RNode*) pop(stack);
         if (currentNode->branchB != NULL) {
             push(stack, currentNode->branchB);
@@ -517,26 +710,14 @@ MatchedData** collectData(RNode* node, int* matchedKeyNum, int* recordNum) {
         }
     }
     free(stack);
+    PERF_END(&sample, PERF_OP_COLLECT_DATA);
     return collection;
 }
 
 
-/**
- * @brief Search radix tree using given key (prefix).
- *        '\0' at the end of strings will be ignored in searching process.
- * 
- * @param rDict 
- * @param givenKey 
- * @param matchedKeyNum number of keys (strings) that matches the prefix
- * @param matchedRecordNum number of data entries collected
- * @param comparedStr number of strings compared
- * @param comparedChar number of char compared
- * @param comparedBit number of bit compared
- * @param execPath A string representing the path of the execution in the radix tree, pass NULL if not needed.
- * @return all data records that matches the given prefix 
- */
-MatchedData** prefixMatching(RDictionary* rDict, char* givenKey, int* matchedKeyNum, int* matchedRecordNum,
-                    int* comparedStr, int* comparedChar, int* comparedBit, char** execPath) {
+// prefixMatching without the instrumentation
+static MatchedData** matchPrefix(RDictionary* rDict, char* givenKey, int* matchedKeyNum, int* matchedRecordNum,
+                                 int* comparedStr, int* comparedChar, int* comparedBit, char** execPath) {
     
     MatchedData** matchedList = NULL;
     *matchedKeyNum = 0;
@@ -545,24 +726,45 @@ MatchedData** prefixMatching(RDictionary* rDict, char* givenKey, int* matchedKey
     *comparedChar = 0;
     *comparedBit = 0;
 
+    ExecPath pathBuffer;
+    ExecPath* path = NULL;
+    if (execPath != NULL) {
+        initExecPath(&pathBuffer);
+        path = &pathBuffer;
+    }
+
+    if (rDict->resultCache != NULL && execPath == NULL) {
+        matchedList = resultCacheGet(rDict->resultCache, givenKey, matchedKeyNum, matchedRecordNum);
+        if (matchedList != NULL) {
+            // nothing is compared on a hit
+            TRACE(TRACE_LEVEL_DEBUG, TRACE_EV_RDICT_SEARCH, *matchedKeyNum, *matchedRecordNum, givenKey);
+            return matchedList;
+        }
+    }
+
+    if (rDict->prefixFilter != NULL && !prefixFilterMayContain(rDict->prefixFilter, givenKey)) {
+        // no key starts with the prefix, the tree isn't walked and the key isn't copied
+        execPathAppendToken(path, EXEC_PATH_NOT_MATCH);
+        if (execPath != NULL) {
+            *execPath = execPathToString(path);
+        }
+        TRACE(TRACE_LEVEL_DEBUG, TRACE_EV_RDICT_SEARCH, 0, 0, givenKey);
+        matchedList = (MatchedData**) malloc(MATCHED_LIST_SIZE * sizeof(MatchedData*));
+        assert(matchedList);
+        return matchedList;
+    }
+
     size_t keyByteNum = strlen(givenKey); // ignoring the ending '\0'
     size_t keyBitNum = keyByteNum * BIT_PER_CHAR;
     BYTE* key = getBlankKey(keyBitNum);
-    memcpy(key, givenKey, keyByteNum);
+    copyTreeKey(rDict, key, givenKey, keyByteNum);
 
     RNode* currentNode = rDict->root;
-
-    Queue* execPathQueue;
-    if (execPath != NULL) {
-        execPathQueue = newQueue();
-        if (currentNode == NULL) {
-            enqueue(execPathQueue, EXEC_PATH_NOT_MATCH);
-        } else {
-            enqueue(execPathQueue, EXEC_PATH_ROOT);
-        }
-    }
+    execPathAppendToken(path, currentNode == NULL ? EXEC_PATH_NOT_MATCH : EXEC_PATH_ROOT);
+    RNode* decidingNode = currentNode;  // the node where the search ends, every key with the prefix passes it
 
     while (currentNode != NULL) {
+        decidingNode = currentNode;
         int tmpBitCount = 0;
         BYTE* currentPrefix = currentNode->prefix;
         size_t currentPrefixBitNum = currentNode->prefixBits;
@@ -570,10 +772,7 @@ MatchedData** prefixMatching(RDictionary* rDict, char* givenKey, int* matchedKey
         int cmpResult = bitCompare(key, keyBitNum, currentPrefix, currentPrefixBitNum, &tmpBitCount);
         (*comparedBit) += tmpBitCount;
         (*comparedChar) += ceiling(tmpBitCount, BIT_PER_CHAR);
-
-        if (execPath != NULL) {
-            enqueue(execPathQueue, my_itoa(tmpBitCount));
-        }
+        execPathAppendCount(path, tmpBitCount);
 
         /*
         There are three cases after comparison:
@@ -586,17 +785,13 @@ MatchedData** prefixMatching(RDictionary* rDict, char* givenKey, int* matchedKey
         */
         if (cmpResult == FOUND_DIFFERENCE) { // Bitwise difference has been found.
             // No matching records, Search ended!
-            if (execPath != NULL) {
-                enqueue(execPathQueue, EXEC_PATH_NOT_MATCH);
-            }
+            execPathAppendToken(path, EXEC_PATH_NOT_MATCH);
             break;
         } else { // No bitwise difference has been found yet.
             if (tmpBitCount == keyBitNum) { // key is finished.
                 // traverse all the child nodes of currentNode to gather matched data.
-                matchedList = collectData(currentNode, matchedKeyNum, matchedRecordNum);
-                if (execPath != NULL) {
-                    enqueue(execPathQueue, EXEC_PATH_MATCH);
-                }
+                matchedList = collectData(rDict, currentNode, matchedKeyNum, matchedRecordNum);
+                execPathAppendToken(path, EXEC_PATH_MATCH);
                 break;
             } else { // key is not finished but currentPrefix is finished.
                 size_t slicedBitNum = keyBitNum - tmpBitCount;
@@ -609,32 +804,24 @@ MatchedData** prefixMatching(RDictionary* rDict, char* givenKey, int* matchedKey
                 BYTE firstBitOfSlicedKey = getBitFromKey(slicedKey, slicedBitNum, 0);
                 if (firstBitOfSlicedKey == BIT_ZERO) {
                     if (currentNode->branchA == NULL) {
-                        if (execPath != NULL) {
-                            enqueue(execPathQueue, EXEC_PATH_NOT_MATCH);
-                        }
+                        execPathAppendToken(path, EXEC_PATH_NOT_MATCH);
                         // No matching records, Search ended!
                         break;
                     } else {
                         // search in branchA
                         currentNode = currentNode->branchA;
-                        if (execPath != NULL) {
-                            enqueue(execPathQueue, EXEC_PATH_LEFT);
-                        }
+                        execPathAppendToken(path, EXEC_PATH_LEFT);
                         continue;
                     }
                 } else { // first bit of sliced key is 1
                     if (currentNode->branchB == NULL) {
-                        if (execPath != NULL) {
-                            enqueue(execPathQueue, EXEC_PATH_NOT_MATCH);
-                        }
+                        execPathAppendToken(path, EXEC_PATH_NOT_MATCH);
                         // No matching records, Search ended!
                         break;
                     } else {
                         // search in branchA
                         currentNode = currentNode->branchB;
-                        if (execPath != NULL) {
-                            enqueue(execPathQueue, EXEC_PATH_RIGHT);
-                        }
+                        execPathAppendToken(path, EXEC_PATH_RIGHT);
                         continue;
                     }
                 }
@@ -644,8 +831,9 @@ MatchedData** prefixMatching(RDictionary* rDict, char* givenKey, int* matchedKey
     }
 
     if (execPath != NULL) {
-        *execPath = constructExecPath(execPathQueue);
+        *execPath = execPathToString(path);
     }
+    TRACE(TRACE_LEVEL_DEBUG, TRACE_EV_RDICT_SEARCH, *matchedKeyNum, *matchedRecordNum, givenKey);
 
     free(key);
 
@@ -656,31 +844,726 @@ MatchedData** prefixMatching(RDictionary* rDict, char* givenKey, int* matchedKey
     (*comparedStr) = 1;
     if (matchedList == NULL) {
         matchedList = (MatchedData**) malloc(MATCHED_LIST_SIZE * sizeof(MatchedData*));
+        assert(matchedList);
+    }
+    if (rDict->resultCache != NULL && execPath == NULL && decidingNode != NULL) {
+        resultCachePut(rDict->resultCache, givenKey, &decidingNode->version, matchedList,
+                       *matchedKeyNum, *matchedRecordNum);
     }
     return matchedList;
 }
 
 
+/**
+ * @brief Search radix tree using given key (prefix).
+ *        '\0' at the end of strings will be ignored in searching process.
+ * 
+ * @param rDict 
+ * @param givenKey 
+ * @param matchedKeyNum number of keys (strings) that matches the prefix
+ * @param matchedRecordNum number of data entries collected
+ * @param comparedStr number of strings compared
+ * @param comparedChar number of char compared
+ * @param comparedBit number of bit compared
+ * @param execPath A string representing the path of the execution in the radix tree, pass NULL if not needed.
+ * @return all data records that matches the given prefix 
+ */
+MatchedData** prefixMatching(RDictionary* rDict, char* givenKey, int* matchedKeyNum, int* matchedRecordNum,
+                    int* comparedStr, int* comparedChar, int* comparedBit, char** execPath) {
+    PerfSample sample;
+    PERF_BEGIN(&sample);
+    MatchedData** matchedList = matchPrefix(rDict, givenKey, matchedKeyNum, matchedRecordNum,
+                                            comparedStr, comparedChar, comparedBit, execPath);
+    PERF_END(&sample, PERF_OP_PREFIX_MATCHING);
+    return matchedList;
+}
+
+
+// State shared by all the steps of a fuzzy search.
+typedef struct FuzzySearchState FuzzyState;
+struct FuzzySearchState {
+    BYTE* key;
+    size_t keyLen;
+    int maxEdits;
+    int* rows;              // one row of the edit distance table per matched byte, (keyLen + 1) ints each
+    size_t rowNum;          // number of rows allocated, doubled as the walk goes deeper
+    MatchedData** collection;
+    size_t collectionSize;
+    size_t collectionItemNum;
+    int* matchedKeyNum;
+    int* matchedRecordNum;
+};
+
+
+/**
+ * @brief Compute the edit distance row of byte depth {depth} from the row above it.
+ *
+ * @param state
+ * @param depth depth of the new row, must be at least 1
+ * @param byte the byte matched at this depth
+ * @return the smallest value in the new row
+ */
+int fuzzyNextRow(FuzzyState* state, size_t depth, BYTE byte) {
+    size_t width = state->keyLen + 1;
+    if (depth >= state->rowNum) {
+        state->rowNum *= 2;
+        state->rows = (int*) realloc(state->rows, state->rowNum * width * sizeof(int));
+        assert(state->rows);
+    }
+    int* prev = state->rows + (depth - 1) * width;
+    int* row = state->rows + depth * width;
+    row[0] = depth;
+    int rowMin = row[0];
+    for (size_t j = 1; j < width; j++) {
+        int replacement = prev[j - 1] + (state->key[j - 1] != byte);
+        int deletion = prev[j] + 1;
+        int insertion = row[j - 1] + 1;
+        int best = replacement < deletion ? replacement : deletion;
+        row[j] = best < insertion ? best : insertion;
+        if (row[j] < rowMin) {
+            rowMin = row[j];
+        }
+    }
+    return rowMin;
+}
+
+
+/**
+ * @brief Get a lower bound of the edit distance of any key that continues with the given bits.
+ *        The known high bits of the next byte limit it to a range of values, and a key byte
+ *        outside of that range can only be reached with one more edit.
+ *
+ * @param state
+ * @param depth number of complete bytes, its row must have been computed
+ * @param partialByte known bits of the next byte
+ * @param partialBits number of known bits, range: [1, 8]
+ * @return int 
+ */
+int fuzzyLowerBound(FuzzyState* state, size_t depth, BYTE partialByte, size_t partialBits) {
+    int* row = state->rows + depth * (state->keyLen + 1);
+    size_t freeBits = BIT_PER_CHAR - partialBits;
+    BYTE low = (BYTE) (partialByte << freeBits);
+    BYTE high = low | (BYTE) ((1 << freeBits) - 1);
+    if (low == ALL_ZERO_BYTE && row[state->keyLen] <= state->maxEdits) {
+        // the next byte can be '\0', which ends a key within the distance.
+        return row[state->keyLen];
+    }
+    int bound = depth + 1;
+    for (size_t j = 1; j <= state->keyLen; j++) {
+        BYTE keyByte = state->key[j - 1];
+        int replacement = row[j - 1] + (keyByte < low || keyByte > high);
+        int deletion = row[j] + 1;
+        int best = replacement < deletion ? replacement : deletion;
+        if (best < bound) {
+            bound = best;
+        }
+    }
+    return bound;
+}
+
+
+/**
+ * @brief Visit a node and its children, bit by bit. A new edit distance row is computed every time
+ *        8 bits (one byte) have been gathered, and the subtree is pruned as soon as every value in the
+ *        row is larger than maxEdits. Children are only visited if their lower bound is within maxEdits.
+ *
+ * @param state
+ * @param node
+ * @param depth number of complete bytes before this node
+ * @param partialByte bits gathered for the next byte
+ * @param partialBits number of bits in partialByte
+ */
+void fuzzyVisit(FuzzyState* state, RNode* node, size_t depth, BYTE partialByte, size_t partialBits) {
+    for (size_t i = 0; i < node->prefixBits; i++) {
+        partialByte = (partialByte << 1) | getBitFromKey(node->prefix, node->prefixBits, i);
+        if (++ partialBits < BIT_PER_CHAR) {
+            continue;
+        }
+        if (partialByte == ALL_ZERO_BYTE) {
+            // '\0' ends a key, so it's the last bit of this node.
+            int distance = state->rows[depth * (state->keyLen + 1) + state->keyLen];
+            if (distance <= state->maxEdits && node->recordNum != 0) {
+                if (state->collectionItemNum == state->collectionSize) {
+                    state->collectionSize *= 2;
+                    state->collection = (MatchedData**) realloc(state->collection,
+                                                        state->collectionSize * sizeof(MatchedData*));
+                    assert(state->collection);
+                }
+                MatchedData* matchedData = (MatchedData*) malloc(sizeof(MatchedData));
+                assert(matchedData);
+                matchedData->key = node->key;
+                matchedData->list = node->list;
+                matchedData->recordNum = node->recordNum;
+                state->collection[state->collectionItemNum ++] = matchedData;
+                (*state->matchedKeyNum) ++;
+                (*state->matchedRecordNum) += node->recordNum;
+            }
+            return;
+        }
+        depth ++;
+        if (fuzzyNextRow(state, depth, partialByte) > state->maxEdits) {
+            // no key in this subtree can be close enough.
+            return;
+        }
+        partialByte = ALL_ZERO_BYTE;
+        partialBits = 0;
+    }
+    // The first bit of branchA is 0 and the first bit of branchB is 1, so a child can be pruned
+    // before it is visited.
+    BYTE byteA = partialByte << 1;
+    BYTE byteB = byteA | BIT_ONE;
+    BOOL visitA = node->branchA != NULL && fuzzyLowerBound(state, depth, byteA, partialBits + 1) <= state->maxEdits;
+    BOOL visitB = node->branchB != NULL && fuzzyLowerBound(state, depth, byteB, partialBits + 1) <= state->maxEdits;
+    if (visitB) {
+        // start loading branchB while branchA is being visited
+        __builtin_prefetch(node->branchB);
+    }
+    if (visitA) {
+        fuzzyVisit(state, node->branchA, depth, partialByte, partialBits);
+    }
+    if (visitB) {
+        fuzzyVisit(state, node->branchB, depth, partialByte, partialBits);
+    }
+}
+
+
+/**
+ * @brief Search radix tree for keys whose edit distance (Levenshtein distance, counted in bytes)
+ *        from the given key is not larger than maxEdits.
+ *
+ * @param rDict
+ * @param givenKey
+ * @param maxEdits maximum number of inserted, deleted or replaced bytes
+ * @param matchedKeyNum number of keys (strings) within the distance
+ * @param matchedRecordNum number of data entries collected
+ * @return all data records whose keys are within the distance
+ */
+MatchedData** rDictFuzzySearch(RDictionary* rDict, char* givenKey, int maxEdits,
+                                int* matchedKeyNum, int* matchedRecordNum) {
+    *matchedKeyNum = 0;
+    *matchedRecordNum = 0;
+
+    FuzzyState state;
+    state.collectionSize = MATCHED_LIST_SIZE;
+    state.collectionItemNum = 0;
+    state.collection = (MatchedData**) malloc(state.collectionSize * sizeof(MatchedData*));
+    assert(state.collection);
+    if (rDict->root == NULL || maxEdits < 0) {
+        TRACE(TRACE_LEVEL_DEBUG, TRACE_EV_RDICT_SEARCH, 0, 0, givenKey);
+        return state.collection;
+    }
+
+    if (rDict->keyMode == RDICT_KEY_FOLDED) {
+        state.key = (BYTE*) getNormalisedKey(givenKey);
+    } else {
+        state.key = (BYTE*) givenKey;
+    }
+    state.keyLen = strlen(givenKey);
+    state.maxEdits = maxEdits;
+    // enough rows for keys as long as the given one, fuzzyNextRow adds more for longer ones
+    state.rowNum = state.keyLen + 2;
+    state.rows = (int*) malloc(state.rowNum * (state.keyLen + 1) * sizeof(int));
+    assert(state.rows);
+    for (size_t j = 0; j <= state.keyLen; j++) {
+        state.rows[j] = j;
+    }
+    state.matchedKeyNum = matchedKeyNum;
+    state.matchedRecordNum = matchedRecordNum;
+
+    fuzzyVisit(&state, rDict->root, 0, ALL_ZERO_BYTE, 0);
+    free(state.rows);
+    if (state.key != (BYTE*) givenKey) {
+        free(state.key);
+    }
+    TRACE(TRACE_LEVEL_DEBUG, TRACE_EV_RDICT_SEARCH, *matchedKeyNum, *matchedRecordNum, givenKey);
+    return state.collection;
+}
+
+
+/**
+ * @brief Build the substring index used by "contains" search. Keys inserted from now on are added
+ *        to it by rDictInsert.
+ * 
+ * @param rDict 
+ */
+void rDictEnableSubstringIndex(RDictionary* rDict) {
+    if (rDict->substringIndex != NULL) {
+        return;
+    }
+    rDict->substringIndex = createSubstringIndex(rDict->keyMode == RDICT_KEY_FOLDED);
+    if (rDict->root == NULL) {
+        return;
+    }
+    Stack* stack = newStack();
+    push(stack, rDict->root);
+    while (getStackSize(stack) != 0) {
+        RNode* currentNode = (RNode*) pop(stack);
+        if (currentNode->branchB != NULL) {
+            push(stack, currentNode->branchB);
+        }
+        if (currentNode->branchA != NULL) {
+            push(stack, currentNode->branchA);
+        }
+        if (currentNode->recordNum != 0) {
+            substringIndexAdd(rDict->substringIndex, currentNode->key, currentNode);
+        }
+    }
+    free(stack);
+}
+
+
+/**
+ * @brief Put a prefix filter in front of prefixMatching: a prefix that no key starts with is then
+ *        usually rejected without walking the tree. Keys already in the dictionary are added to it,
+ *        keys inserted from now on are added by rDictInsert.
+ * 
+ * @param rDict 
+ * @param prefixLen number of leading bytes of each key kept by the filter, from 1 to {PREFIX_FILTER_MAX_LEN}
+ * @param expectedKeyNum number of keys the filter is sized for
+ * @param falsePositiveRate rate of absent prefixes that still walk the tree, e.g. 0.01
+ */
+void rDictEnablePrefixFilter(RDictionary* rDict, int prefixLen, size_t expectedKeyNum, double falsePositiveRate) {
+    if (rDict->prefixFilter != NULL) {
+        freePrefixFilter(rDict->prefixFilter);
+    }
+    rDict->prefixFilter = createPrefixFilter(prefixLen, expectedKeyNum, falsePositiveRate, 
+                                             rDict->keyMode == RDICT_KEY_FOLDED);
+    if (rDict->root == NULL) {
+        return;
+    }
+    Stack* stack = newStack();
+    push(stack, rDict->root);
+    while (getStackSize(stack) != 0) {
+        RNode* currentNode = (RNode*) pop(stack);
+        if (currentNode->branchB != NULL) {
+            push(stack, currentNode->branchB);
+        }
+        if (currentNode->branchA != NULL) {
+            push(stack, currentNode->branchA);
+        }
+        if (currentNode->recordNum != 0) {
+            prefixFilterAdd(rDict->prefixFilter, currentNode->key);
+        }
+    }
+    free(stack);
+}
+
+
+/**
+ * @brief Get the number of bytes used by the prefix filter, 0 if it isn't enabled.
+ * 
+ * @param rDict 
+ */
+size_t getRDictPrefixFilterMemory(RDictionary* rDict) {
+    return rDict->prefixFilter != NULL ? getPrefixFilterMemory(rDict->prefixFilter) : 0;
+}
+
+
+/**
+ * @brief Cache the results of prefixMatching by prefix, within a memory budget. A cached result is
+ *        dropped as soon as an insert reaches the subtree it came from, so results are never stale.
+ *        Searches asking for an execution path bypass the cache.
+ * 
+ * @param rDict 
+ * @param memoryBudget maximum number of bytes used by the cache, least recently used results are evicted first
+ */
+void rDictEnableResultCache(RDictionary* rDict, size_t memoryBudget) {
+    if (rDict->resultCache != NULL) {
+        freeResultCache(rDict->resultCache);
+    }
+    rDict->resultCache = createResultCache(memoryBudget);
+}
+
+
+/**
+ * @brief Get the counters of the result cache. All of them are 0 if it isn't enabled.
+ * 
+ * @param rDict 
+ * @param stats 
+ */
+void getRDictResultCacheStats(RDictionary* rDict, ResultCacheStats* stats) {
+    if (rDict->resultCache != NULL) {
+        getResultCacheStats(rDict->resultCache, stats);
+    } else {
+        memset(stats, 0, sizeof(ResultCacheStats));
+    }
+}
+
+
+// Bytes taken by a node and its prefix in the block of rDictCompact, rounded up so the next node is aligned.
+static size_t getArenaNodeBytes(RNode* node) {
+    size_t bytes = sizeof(RNode) + ceiling(node->prefixBits, BIT_PER_CHAR);
+    return (bytes + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT * ARENA_ALIGNMENT;
+}
+
+
+/**
+ * @brief Move every node into one contiguous block, in depth-first order with the prefix bytes of each
+ *        node right after it, so a search walks forward through memory instead of jumping around the heap.
+ *        Best called once the dictionary is loaded. Nodes inserted afterwards are allocated as usual,
+ *        and calling it again packs them in too.
+ *        Keys and data lists are not moved, so results returned earlier stay valid. The substring index
+ *        is rebuilt and the result cache is cleared, since they refer to nodes.
+ * 
+ * @param rDict 
+ */
+void rDictCompact(RDictionary* rDict) {
+    if (rDict->root == NULL) {
+        return;
+    }
+    size_t arenaBytes = 0;
+    Stack* stack = newStack();
+    push(stack, rDict->root);
+    while (getStackSize(stack) != 0) {
+        RNode* currentNode = (RNode*) pop(stack);
+        if (currentNode->branchB != NULL) {
+            push(stack, currentNode->branchB);
+        }
+        if (currentNode->branchA != NULL) {
+            push(stack, currentNode->branchA);
+        }
+        arenaBytes += getArenaNodeBytes(currentNode);
+    }
+
+    BYTE* arena = (BYTE*) aligned_alloc(ARENA_ALIGNMENT, arenaBytes);
+    assert(arena);
+    size_t used = 0;
+
+    // The stack holds the links to the nodes still to be moved. Each node is copied where the walk has
+    // got to, and the link to it (already in the block, except for the root) is pointed at the copy.
+    push(stack, &rDict->root);
+    while (getStackSize(stack) != 0) {
+        RNode** link = (RNode**) pop(stack);
+        RNode* oldNode = *link;
+        RNode* newNode = (RNode*) (arena + used);
+        size_t prefixBytes = ceiling(oldNode->prefixBits, BIT_PER_CHAR);
+        *newNode = *oldNode;
+        newNode->prefix = (BYTE*) (newNode + 1);
+        memcpy(newNode->prefix, oldNode->prefix, prefixBytes);
+        used += getArenaNodeBytes(oldNode);
+        *link = newNode;
+
+        if (!isInArena(rDict, oldNode->prefix)) {
+            free(oldNode->prefix);
+        }
+        if (!isInArena(rDict, oldNode)) {
+            free(oldNode);
+        }
+        if (newNode->branchB != NULL) {
+            push(stack, &newNode->branchB);
+        }
+        if (newNode->branchA != NULL) {
+            push(stack, &newNode->branchA);
+        }
+    }
+    free(stack);
+    assert(used == arenaBytes);
+
+    if (rDict->arena != NULL) {
+        free(rDict->arena);
+    }
+    rDict->arena = arena;
+    rDict->arenaBytes = arenaBytes;
+
+    if (rDict->substringIndex != NULL) {
+        freeSubstringIndex(rDict->substringIndex);
+        rDict->substringIndex = NULL;
+        rDictEnableSubstringIndex(rDict);
+    }
+    if (rDict->resultCache != NULL) {
+        resultCacheClear(rDict->resultCache);
+    }
+}
+
+
+/**
+ * @brief Collect the keys of large subtrees (e.g. for short prefixes) with a pool of threads that steal
+ *        branches from each other. Results come in the same order as without it.
+ *        Subtrees with at most nodeThreshold nodes are collected by the calling thread alone, as before.
+ * 
+ * @param rDict 
+ * @param threadNum number of threads collecting a large subtree, including the calling one. 
+ *                  1 or less turns parallel collection off.
+ * @param nodeThreshold number of nodes visited by the calling thread before the pool takes over
+ */
+void rDictEnableParallelCollect(RDictionary* rDict, int threadNum, size_t nodeThreshold) {
+    if (rDict->collectPool != NULL) {
+        freeWorkPool(rDict->collectPool);
+        rDict->collectPool = NULL;
+    }
+    if (threadNum > 1) {
+        rDict->collectPool = createWorkPool(threadNum);
+    }
+    rDict->parallelCollectThreshold = nodeThreshold;
+}
+
+
+/**
+ * @brief Search radix tree for keys that contain the given pattern anywhere (not only as a prefix).
+ *        The substring index is built on the first call if it hasn't been enabled.
+ * 
+ * @param rDict 
+ * @param pattern 
+ * @param matchedKeyNum number of keys (strings) that contain the pattern
+ * @param matchedRecordNum number of data entries collected
+ * @param comparedStr number of candidate keys compared with the pattern
+ * @return all data records whose keys contain the pattern
+ */
+MatchedData** containsMatching(RDictionary* rDict, char* pattern, int* matchedKeyNum, int* matchedRecordNum,
+                                int* comparedStr) {
+    rDictEnableSubstringIndex(rDict);
+    *matchedKeyNum = 0;
+    *matchedRecordNum = 0;
+
+    // nodes holding a key are never moved by later inserts (rDictCompact rebuilds the index), so the index
+    // can point at them directly
+    int keyNum = 0;
+    RNode** nodes = (RNode**) substringSearch(rDict->substringIndex, pattern, &keyNum, comparedStr);
+    MatchedData** matchedList = (MatchedData**) malloc((keyNum + 1) * sizeof(MatchedData*));
+    assert(matchedList);
+    for (int i = 0; i < keyNum; i++) {
+        RNode* node = nodes[i];
+        MatchedData* matchedData = (MatchedData*) malloc(sizeof(MatchedData));
+        assert(matchedData);
+        matchedData->key = node->key;
+        matchedData->list = node->list;
+        matchedData->recordNum = node->recordNum;
+        matchedList[(*matchedKeyNum) ++] = matchedData;
+        (*matchedRecordNum) += node->recordNum;
+    }
+    free(nodes);
+    TRACE(TRACE_LEVEL_DEBUG, TRACE_EV_RDICT_SEARCH, *matchedKeyNum, *matchedRecordNum, pattern);
+    return matchedList;
+}
+
+
+/**
+ * @brief Get the score of the key stored in a node: the best score of its records.
+ * 
+ * @param rDict 
+ * @param node 
+ * @return the score, {NO_SCORE} if the node has no record
+ */
+double getKeyScore(RDictionary* rDict, RNode* node) {
+    double score = NO_SCORE;
+    for (size_t i = 0; i < node->recordNum; i++) {
+        double recordScore = rDict->fScore(node->list[i]);
+        if (recordScore > score) {
+            score = recordScore;
+        }
+    }
+    return score;
+}
+
+
+/**
+ * @brief Set the function used to score data records for top-k search. The score bound of every 
+ *        subtree is computed again, records inserted from now on are scored by rDictInsert.
+ * 
+ * @param rDict 
+ * @param fScore score of a data record, larger is better. NULL to stop keeping scores.
+ */
+void rDictSetScoreFunction(RDictionary* rDict, double (*fScore)(void*)) {
+    rDict->fScore = fScore;
+    if (rDict->root == NULL || fScore == NULL) {
+        return;
+    }
+
+    // list the nodes in DFS order, so every node comes before the nodes in its subtree
+    size_t nodeNum = 0;
+    size_t nodeListSize = INITIAL_LIST_SIZE;
+    RNode** nodes = (RNode**) malloc(nodeListSize * sizeof(RNode*));
+    assert(nodes);
+    Stack* stack = newStack();
+    push(stack, rDict->root);
+    while (getStackSize(stack) != 0) {
+        RNode* currentNode = (RNode*) pop(stack);
+        if (nodeNum == nodeListSize) {
+            nodeListSize *= 2;
+            nodes = (RNode**) realloc(nodes, nodeListSize * sizeof(RNode*));
+            assert(nodes);
+        }
+        nodes[nodeNum ++] = currentNode;
+        if (currentNode->branchB != NULL) {
+            push(stack, currentNode->branchB);
+        }
+        if (currentNode->branchA != NULL) {
+            push(stack, currentNode->branchA);
+        }
+    }
+    free(stack);
+
+    // going backwards, the children of a node are always done before the node itself
+    for (size_t i = nodeNum; i > 0; i--) {
+        RNode* node = nodes[i - 1];
+        node->maxScore = getKeyScore(rDict, node);
+        if (node->branchA != NULL && node->branchA->maxScore > node->maxScore) {
+            node->maxScore = node->branchA->maxScore;
+        }
+        if (node->branchB != NULL && node->branchB->maxScore > node->maxScore) {
+            node->maxScore = node->branchB->maxScore;
+        }
+    }
+    free(nodes);
+}
+
+
+/**
+ * @brief Find the node whose subtree holds exactly the keys starting with the given prefix.
+ * 
+ * @param rDict 
+ * @param givenKey prefix, '\0' at the end is ignored
+ * @return the node, or NULL if no key starts with the prefix
+ */
+RNode* findPrefixNode(RDictionary* rDict, char* givenKey) {
+    size_t keyByteNum = strlen(givenKey);
+    if (keyByteNum == 0) {
+        // every key starts with an empty prefix
+        return rDict->root;
+    }
+    if (rDict->prefixFilter != NULL && !prefixFilterMayContain(rDict->prefixFilter, givenKey)) {
+        return NULL;
+    }
+    size_t keyBitNum = keyByteNum * BIT_PER_CHAR;
+    BYTE* key = getBlankKey(keyBitNum);
+    copyTreeKey(rDict, key, givenKey, keyByteNum);
+
+    RNode* currentNode = rDict->root;
+    size_t bitIdx = 0;      // bits of the key that have been matched
+    while (currentNode != NULL) {
+        size_t i = 0;
+        while (i < currentNode->prefixBits && bitIdx + i < keyBitNum && 
+                getBitFromKey(currentNode->prefix, currentNode->prefixBits, i) == getBitFromKey(key, keyBitNum, bitIdx + i)) {
+            i ++;
+        }
+        if (bitIdx + i == keyBitNum) {
+            // the key is finished, every key below this node starts with it
+            break;
+        }
+        if (i < currentNode->prefixBits) {
+            currentNode = NULL;
+            break;
+        }
+        bitIdx += currentNode->prefixBits;
+        if (getBitFromKey(key, keyBitNum, bitIdx) == BIT_ZERO) {
+            currentNode = currentNode->branchA;
+        } else {
+            currentNode = currentNode->branchB;
+        }
+    }
+    free(key);
+    return currentNode;
+}
+
+
+/**
+ * @brief Find the k keys with the best scores among the keys starting with the given prefix.
+ *        The score of a key is the best score of its records. Nodes are visited best bound first,
+ *        so the search stops as soon as k keys are found instead of collecting every match.
+ * @note A score function must have been set with rDictSetScoreFunction.
+ * 
+ * @param rDict 
+ * @param givenKey prefix, '\0' at the end is ignored
+ * @param k maximum number of keys returned
+ * @param matchedKeyNum number of keys returned
+ * @param matchedRecordNum number of data entries collected
+ * @return data records of the best keys, best first. Keys with equal scores come in no particular order.
+ */
+MatchedData** rDictTopK(RDictionary* rDict, char* givenKey, int k, int* matchedKeyNum, int* matchedRecordNum) {
+    assert(rDict->fScore);
+    *matchedKeyNum = 0;
+    *matchedRecordNum = 0;
+    MatchedData** matchedList = (MatchedData**) malloc((k > 0 ? k : 1) * sizeof(MatchedData*));
+    assert(matchedList);
+
+    RNode* subtree = findPrefixNode(rDict, givenKey);
+    if (subtree == NULL || k <= 0) {
+        return matchedList;
+    }
+
+    // A key is taken only when nothing left in the heap can beat it,
+    // since the bound of a subtree is never lower than any score in it.
+    Heap* heap = newHeap();
+    heapPush(heap, subtree, TOPK_SUBTREE, subtree->maxScore);
+    while (*matchedKeyNum < k && getHeapSize(heap) != 0) {
+        int kind;
+        RNode* node = (RNode*) heapPop(heap, &kind, NULL);
+        if (kind == TOPK_KEY) {
+            MatchedData* matchedData = (MatchedData*) malloc(sizeof(MatchedData));
+            assert(matchedData);
+            matchedData->key = node->key;
+            matchedData->list = node->list;
+            matchedData->recordNum = node->recordNum;
+            matchedList[(*matchedKeyNum) ++] = matchedData;
+            (*matchedRecordNum) += node->recordNum;
+            continue;
+        }
+        if (node->recordNum != 0) {
+            heapPush(heap, node, TOPK_KEY, getKeyScore(rDict, node));
+        }
+        if (node->branchA != NULL) {
+            heapPush(heap, node->branchA, TOPK_SUBTREE, node->branchA->maxScore);
+        }
+        if (node->branchB != NULL) {
+            heapPush(heap, node->branchB, TOPK_SUBTREE, node->branchB->maxScore);
+        }
+    }
+    freeHeap(heap);
+    TRACE(TRACE_LEVEL_DEBUG, TRACE_EV_RDICT_SEARCH, *matchedKeyNum, *matchedRecordNum, givenKey);
+    return matchedList;
+}
+
+
+/**
+ * @brief Find the data records of a key. Unlike prefixMatching, only the key itself matches.
+ *        Every key below the node of the prefix starts with it, and '\0' is the smallest byte,
+ *        so the key can only be the leftmost leaf there.
+ * 
+ * @param rDict 
+ * @param key 
+ * @param recordNum number of data records of the key, 0 if the key is not in the dictionary
+ * @return data records of the key in insertion order (owned by the dictionary), NULL if the key is not in it
+ */
+void** rDictFind(RDictionary* rDict, char* key, int* recordNum) {
+    *recordNum = 0;
+    RNode* node = findPrefixNode(rDict, key);
+    if (node == NULL) {
+        return NULL;
+    }
+    while (node->branchA != NULL) {
+        node = node->branchA;
+    }
+    // keys keep their length when they are folded
+    if (node->recordNum == 0 || strlen(node->key) != strlen(key)) {
+        return NULL;
+    }
+    *recordNum = node->recordNum;
+    return node->list;
+}
+
+
 /**
  * @brief Free radix tree nodes
  * 
  * @param node 
  * @param fFreeData 
  */
-void freeNode(RNode* node, void (*fFreeData)(void*)) {
+void freeNode(RDictionary* rDict, RNode* node, void (*fFreeData)(void*)) {
     if (node->recordNum != 0) {
         for (size_t i = 0; i < node->recordNum; i++) {
             fFreeData(node->list[i]);
         }
         free(node->list);
     }
-    if (node->prefix != NULL) {
+    if (node->prefix != NULL && !isInArena(rDict, node->prefix)) {
         free(node->prefix);
     }
     if (node->key != NULL) {
         free(node->key);
     }
-    free(node);
+    if (!isInArena(rDict, node)) {
+        free(node);
+    }
 }
 
 
@@ -705,13 +1588,28 @@ void freeRDict(RDictionary* rDict, void (*fFreeData)(void*)) {
             if (currentNode->branchA != NULL) {
                 push(stack, currentNode->branchA);
             }
-            freeNode(currentNode, fFreeData);
+            freeNode(rDict, currentNode, fFreeData);
 
             // if (currentNode->branchA == NULL && currentNode->branchB == NULL) {
             // }
         }
         free(stack);
     }
+    if (rDict->substringIndex != NULL) {
+        freeSubstringIndex(rDict->substringIndex);
+    }
+    if (rDict->prefixFilter != NULL) {
+        freePrefixFilter(rDict->prefixFilter);
+    }
+    if (rDict->resultCache != NULL) {
+        freeResultCache(rDict->resultCache);
+    }
+    if (rDict->arena != NULL) {
+        free(rDict->arena);
+    }
+    if (rDict->collectPool != NULL) {
+        freeWorkPool(rDict->collectPool);
+    }
     free(rDict);
 }
 
@@ -746,14 +1644,9 @@ struct RNodeJSONObj {
 
 };
 
+// The other items belong to the tree of the JSON object, and are deleted with it
 void freeRNodeJSONObject(RNodeJSONObject* obj) {
-    cJSON_Delete(obj->cjsonNode);
-    cJSON_Delete(obj->prefix);
-    cJSON_Delete(obj->prefixBits);
-    cJSON_Delete(obj->data);
-    cJSON_Delete(obj->pid);
     cJSON_Delete(obj->nid);
-    cJSON_Delete(obj->masked);
     free(obj);
 }
 
@@ -771,7 +1664,6 @@ char* rDict2Json(RDictionary* rDict, char* (*stringifyData)(void*)) {
     cJSON_AddItemToObject(trie, "radix_tree", dict);
     if (rDict->root == NULL) {
         char* result = cJSON_Print(trie);
-        cJSON_Delete(dict);
         cJSON_Delete(trie);
         return result;
     }
@@ -864,7 +1756,6 @@ char* rDict2Json(RDictionary* rDict, char* (*stringifyData)(void*)) {
     for (int i = 0; i < nodeNum; i++) {
         freeRNodeJSONObject(chosenNodes[i]);
     }
-    cJSON_Delete(dict);
     cJSON_Delete(trie);
 
     return result;
@@ -0,0 +1,266 @@
+/**
+ * @brief  Request latency statistics implementation
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <assert.h>
+#include <pthread.h>
+#include <cjson/cJSON.h>
+
+#include "request_stats.h"
+#include "histogram.h"
+#include "my_bool.h"
+
+#define NS_PER_SEC 1000000000ULL
+#define NS_PER_US 1000.0
+
+static const char* modeNames[STATS_MODE_NUM] = {
+    [STATS_MODE_INSERT]       = "insert",
+    [STATS_MODE_SEARCH]       = "search",
+    [STATS_MODE_FUZZY_SEARCH] = "fuzzy_search",
+    [STATS_MODE_CONTAINS]     = "contains",
+    [STATS_MODE_GET_TREE]     = "get_tree",
+    [STATS_MODE_STATS]        = "stats",
+    [STATS_MODE_UNKNOWN]      = "unknown",
+};
+
+static const char* phaseNames[STATS_PHASE_NUM] = {
+    [STATS_PHASE_PARSE]     = "parse",
+    [STATS_PHASE_TREE_OP]   = "tree_op",
+    [STATS_PHASE_SERIALISE] = "serialise",
+    [STATS_PHASE_SEND]      = "send",
+    [STATS_PHASE_TOTAL]     = "total",
+};
+
+// Histograms written by one thread, readers add up those of every thread
+typedef struct StatsShardStruct StatsShard;
+struct StatsShardStruct {
+    Histogram* phases[STATS_MODE_NUM][STATS_PHASE_NUM];
+    Histogram* sizes[STATS_SIZE_BUCKET_NUM];
+    StatsShard* next;
+};
+
+static __thread StatsShard* threadShard = NULL;
+static StatsShard* allShards = NULL;
+static pthread_mutex_t shardsLock = PTHREAD_MUTEX_INITIALIZER;
+
+
+static StatsShard* newShard() {
+    StatsShard* shard = (StatsShard*) malloc(sizeof(StatsShard));
+    assert(shard);
+    for (int m = 0; m < STATS_MODE_NUM; m++) {
+        for (int p = 0; p < STATS_PHASE_NUM; p++) {
+            shard->phases[m][p] = createHistogram();
+        }
+    }
+    for (int b = 0; b < STATS_SIZE_BUCKET_NUM; b++) {
+        shard->sizes[b] = createHistogram();
+    }
+    return shard;
+}
+
+
+// Shard of the calling thread, created on its first request
+static StatsShard* getThreadShard() {
+    if (threadShard == NULL) {
+        threadShard = newShard();
+        pthread_mutex_lock(&shardsLock);
+        threadShard->next = allShards;
+        allShards = threadShard;
+        pthread_mutex_unlock(&shardsLock);
+    }
+    return threadShard;
+}
+
+
+// Add up the shards of all threads into a new shard, freed with freeShard
+static StatsShard* mergeShards() {
+    StatsShard* merged = newShard();
+    pthread_mutex_lock(&shardsLock);
+    for (StatsShard* shard = allShards; shard != NULL; shard = shard->next) {
+        for (int m = 0; m < STATS_MODE_NUM; m++) {
+            for (int p = 0; p < STATS_PHASE_NUM; p++) {
+                histogramMerge(merged->phases[m][p], shard->phases[m][p]);
+            }
+        }
+        for (int b = 0; b < STATS_SIZE_BUCKET_NUM; b++) {
+            histogramMerge(merged->sizes[b], shard->sizes[b]);
+        }
+    }
+    pthread_mutex_unlock(&shardsLock);
+    return merged;
+}
+
+
+static void freeShard(StatsShard* shard) {
+    for (int m = 0; m < STATS_MODE_NUM; m++) {
+        for (int p = 0; p < STATS_PHASE_NUM; p++) {
+            freeHistogram(shard->phases[m][p]);
+        }
+    }
+    for (int b = 0; b < STATS_SIZE_BUCKET_NUM; b++) {
+        freeHistogram(shard->sizes[b]);
+    }
+    free(shard);
+}
+
+
+static int getSizeBucket(size_t responseLen) {
+    int bucket = 0;
+    size_t limit = (size_t) 1 << STATS_FIRST_SIZE_BITS;
+    while (bucket < STATS_SIZE_BUCKET_NUM - 1 && responseLen >= limit) {
+        bucket ++;
+        limit <<= STATS_SIZE_BITS_STEP;
+    }
+    return bucket;
+}
+
+
+// Name of a size bucket, e.g. "<1KB" or ">=64KB"
+static void getSizeBucketName(int bucket, char* name, size_t nameSize) {
+    size_t limit = (size_t) 1 << (STATS_FIRST_SIZE_BITS + STATS_SIZE_BITS_STEP * bucket);
+    BOOL last = bucket == STATS_SIZE_BUCKET_NUM - 1;
+    if (last) {
+        limit >>= STATS_SIZE_BITS_STEP;
+    }
+    const char* unit = limit >= 1024 ? "KB" : "B";
+    snprintf(name, nameSize, "%s%zu%s", last ? ">=" : "<", limit >= 1024 ? limit / 1024 : limit, unit);
+}
+
+
+/**
+ * @brief Get the current time of the clock used by the statistics, in nanoseconds.
+ */
+uint64_t requestStatsNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+}
+
+
+/**
+ * @brief Get the mode of a request.
+ *
+ * @param request parsed request, NULL if it couldn't be parsed
+ * @return StatsModeId
+ */
+StatsModeId getRequestStatsMode(cJSON* request) {
+    cJSON* mode = cJSON_GetObjectItem(request, "mode");
+    if (!cJSON_IsString(mode) || mode->valuestring == NULL) {
+        return STATS_MODE_UNKNOWN;
+    }
+    for (int m = 0; m < STATS_MODE_UNKNOWN; m++) {
+        if (strcmp(mode->valuestring, modeNames[m]) == 0) {
+            return m;
+        }
+    }
+    return STATS_MODE_UNKNOWN;
+}
+
+
+/**
+ * @brief Count the latency of one phase of a request.
+ *
+ * @param mode
+ * @param phase
+ * @param ns
+ */
+void requestStatsRecord(StatsModeId mode, StatsPhaseId phase, uint64_t ns) {
+    histogramRecordShared(getThreadShard()->phases[mode][phase], ns);
+}
+
+
+/**
+ * @brief Count the total latency of a request by the size of its response.
+ *
+ * @param responseLen bytes sent
+ * @param ns
+ */
+void requestStatsRecordSize(size_t responseLen, uint64_t ns) {
+    histogramRecordShared(getThreadShard()->sizes[getSizeBucket(responseLen)], ns);
+}
+
+
+static cJSON* histogram2Json(Histogram* histogram) {
+    cJSON* obj = cJSON_CreateObject();
+    cJSON_AddNumberToObject(obj, "count", getHistogramCount(histogram));
+    cJSON_AddNumberToObject(obj, "mean", getHistogramMean(histogram) / NS_PER_US);
+    cJSON_AddNumberToObject(obj, "p50", getHistogramPercentile(histogram, 50) / NS_PER_US);
+    cJSON_AddNumberToObject(obj, "p90", getHistogramPercentile(histogram, 90) / NS_PER_US);
+    cJSON_AddNumberToObject(obj, "p99", getHistogramPercentile(histogram, 99) / NS_PER_US);
+    cJSON_AddNumberToObject(obj, "p999", getHistogramPercentile(histogram, 99.9) / NS_PER_US);
+    cJSON_AddNumberToObject(obj, "max", getHistogramMax(histogram) / NS_PER_US);
+    return obj;
+}
+
+
+/**
+ * @brief Get the statistics as a JSON object, e.g. the response of a "stats" request.
+ *        Latencies are in microseconds. Modes, phases and sizes without any request are left out.
+ */
+cJSON* requestStats2Json() {
+    StatsShard* merged = mergeShards();
+    cJSON* stats = cJSON_CreateObject();
+    cJSON* modes = cJSON_CreateObject();
+    cJSON_AddItemToObject(stats, "modes", modes);
+    for (int m = 0; m < STATS_MODE_NUM; m++) {
+        if (getHistogramCount(merged->phases[m][STATS_PHASE_PARSE]) == 0) {
+            continue;
+        }
+        cJSON* phases = cJSON_CreateObject();
+        cJSON_AddItemToObject(modes, modeNames[m], phases);
+        for (int p = 0; p < STATS_PHASE_NUM; p++) {
+            if (getHistogramCount(merged->phases[m][p]) != 0) {
+                cJSON_AddItemToObject(phases, phaseNames[p], histogram2Json(merged->phases[m][p]));
+            }
+        }
+    }
+    cJSON* sizes = cJSON_CreateObject();
+    cJSON_AddItemToObject(stats, "responseSizes", sizes);
+    for (int b = 0; b < STATS_SIZE_BUCKET_NUM; b++) {
+        if (getHistogramCount(merged->sizes[b]) != 0) {
+            char name[16];
+            getSizeBucketName(b, name, sizeof(name));
+            cJSON_AddItemToObject(sizes, name, histogram2Json(merged->sizes[b]));
+        }
+    }
+    freeShard(merged);
+    return stats;
+}
+
+
+static void printHistogramLine(FILE* f, const char* name, const char* subName, Histogram* histogram) {
+    fprintf(f, "%-13s %-10s %10lu   mean %9.1f   p50 %9.1f   p99 %9.1f   p999 %9.1f   max %9.1f us\n",
+            name, subName, (unsigned long) getHistogramCount(histogram), getHistogramMean(histogram) / NS_PER_US,
+            getHistogramPercentile(histogram, 50) / NS_PER_US, getHistogramPercentile(histogram, 99) / NS_PER_US,
+            getHistogramPercentile(histogram, 99.9) / NS_PER_US, getHistogramMax(histogram) / NS_PER_US);
+}
+
+
+/**
+ * @brief Write the statistics, one line per mode and phase, and one per response size.
+ *
+ * @param f output file
+ */
+void printRequestStats(FILE* f) {
+    StatsShard* merged = mergeShards();
+    for (int m = 0; m < STATS_MODE_NUM; m++) {
+        for (int p = 0; p < STATS_PHASE_NUM; p++) {
+            if (getHistogramCount(merged->phases[m][p]) != 0) {
+                printHistogramLine(f, modeNames[m], phaseNames[p], merged->phases[m][p]);
+            }
+        }
+    }
+    for (int b = 0; b < STATS_SIZE_BUCKET_NUM; b++) {
+        if (getHistogramCount(merged->sizes[b]) != 0) {
+            char name[16];
+            getSizeBucketName(b, name, sizeof(name));
+            printHistogramLine(f, "response", name, merged->sizes[b]);
+        }
+    }
+    freeShard(merged);
+}
@@ -0,0 +1,277 @@
+/**
+ * @brief  Result cache implementation
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include "result_cache.h"
+
+// Number of hash buckets when the cache is created, doubled whenever there are more entries than buckets
+#define INITIAL_BUCKET_NUM 64
+
+// 64-bit FNV-1a
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ull
+#define FNV_PRIME 0x100000001b3ull
+
+typedef struct CacheEntryStruct CacheEntry;
+struct CacheEntryStruct {
+    char* prefix;
+    uint64_t hash;
+    size_t* version;            // version counter of the node that decided the result
+    size_t savedVersion;        // its value when the result was cached
+    MatchedData* keys;          // copies of the matched keys, sharing their keys and lists with the tree
+    int keyNum;
+    int recordNum;
+    size_t memory;
+    CacheEntry* hashNext;       // next entry in the same bucket
+    CacheEntry* prev;           // more recently used entry
+    CacheEntry* next;           // less recently used entry
+};
+
+struct LRUResultCache {
+    CacheEntry** buckets;
+    size_t bucketNum;
+    CacheEntry* head;           // most recently used entry
+    CacheEntry* tail;           // least recently used entry
+    ResultCacheStats stats;
+};
+
+
+static CacheEntry** createBuckets(size_t bucketNum) {
+    CacheEntry** buckets = (CacheEntry**) malloc(bucketNum * sizeof(CacheEntry*));
+    assert(buckets);
+    for (size_t i = 0; i < bucketNum; i++) {
+        buckets[i] = NULL;
+    }
+    return buckets;
+}
+
+
+/**
+ * @brief  Create a result cache
+ * @param  memoryBudget: maximum number of bytes used by the entries, least recently used ones are evicted first
+ */
+ResultCache* createResultCache(size_t memoryBudget) {
+    ResultCache* cache = (ResultCache*) malloc(sizeof(ResultCache));
+    assert(cache);
+    cache->bucketNum = INITIAL_BUCKET_NUM;
+    cache->buckets = createBuckets(cache->bucketNum);
+    cache->head = NULL;
+    cache->tail = NULL;
+    memset(&cache->stats, 0, sizeof(ResultCacheStats));
+    cache->stats.memoryBudget = memoryBudget;
+    return cache;
+}
+
+
+static uint64_t hashPrefix(char* prefix) {
+    uint64_t hash = FNV_OFFSET_BASIS;
+    for (size_t i = 0; prefix[i] != '\0'; i++) {
+        hash = (hash ^ (unsigned char) prefix[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+
+// Get the link to an entry in its bucket, or to the end of the bucket if the prefix isn't cached.
+static CacheEntry** findEntryLink(ResultCache* cache, char* prefix, uint64_t hash) {
+    CacheEntry** link = &cache->buckets[hash & (cache->bucketNum - 1)];
+    while (*link != NULL && ((*link)->hash != hash || strcmp((*link)->prefix, prefix) != 0)) {
+        link = &(*link)->hashNext;
+    }
+    return link;
+}
+
+
+static void unlinkLRU(ResultCache* cache, CacheEntry* entry) {
+    if (entry->prev != NULL) {
+        entry->prev->next = entry->next;
+    } else {
+        cache->head = entry->next;
+    }
+    if (entry->next != NULL) {
+        entry->next->prev = entry->prev;
+    } else {
+        cache->tail = entry->prev;
+    }
+}
+
+
+static void pushFrontLRU(ResultCache* cache, CacheEntry* entry) {
+    entry->prev = NULL;
+    entry->next = cache->head;
+    if (cache->head != NULL) {
+        cache->head->prev = entry;
+    } else {
+        cache->tail = entry;
+    }
+    cache->head = entry;
+}
+
+
+static void removeEntry(ResultCache* cache, CacheEntry* entry) {
+    CacheEntry** link = findEntryLink(cache, entry->prefix, entry->hash);
+    assert(*link == entry);
+    *link = entry->hashNext;
+    unlinkLRU(cache, entry);
+    cache->stats.memory -= entry->memory;
+    cache->stats.entryNum --;
+    free(entry->prefix);
+    free(entry->keys);
+    free(entry);
+}
+
+
+// Double the number of buckets, so chains stay short.
+static void growBuckets(ResultCache* cache) {
+    size_t bucketNum = cache->bucketNum * 2;
+    CacheEntry** buckets = createBuckets(bucketNum);
+    for (size_t i = 0; i < cache->bucketNum; i++) {
+        CacheEntry* entry = cache->buckets[i];
+        while (entry != NULL) {
+            CacheEntry* next = entry->hashNext;
+            CacheEntry** bucket = &buckets[entry->hash & (bucketNum - 1)];
+            entry->hashNext = *bucket;
+            *bucket = entry;
+            entry = next;
+        }
+    }
+    free(cache->buckets);
+    cache->buckets = buckets;
+    cache->bucketNum = bucketNum;
+}
+
+
+/**
+ * @brief  Get the result of a prefix if it is cached and not stale
+ * @param  cache:
+ * @param  prefix:
+ * @param  matchedKeyNum:
+ * @param  matchedRecordNum:
+ * @retval a new copy of the matched list (freed in the same way as the result of prefixMatching), NULL on a miss
+ */
+MatchedData** resultCacheGet(ResultCache* cache, char* prefix, int* matchedKeyNum, int* matchedRecordNum) {
+    CacheEntry* entry = *findEntryLink(cache, prefix, hashPrefix(prefix));
+    if (entry == NULL) {
+        cache->stats.missNum ++;
+        return NULL;
+    }
+    if (*entry->version != entry->savedVersion) {
+        // an insert has reached the subtree of the result since it was cached
+        cache->stats.staleNum ++;
+        cache->stats.missNum ++;
+        removeEntry(cache, entry);
+        return NULL;
+    }
+    cache->stats.hitNum ++;
+    unlinkLRU(cache, entry);
+    pushFrontLRU(cache, entry);
+
+    MatchedData** matchedList = (MatchedData**) malloc((entry->keyNum + 1) * sizeof(MatchedData*));
+    assert(matchedList);
+    for (int i = 0; i < entry->keyNum; i++) {
+        matchedList[i] = (MatchedData*) malloc(sizeof(MatchedData));
+        assert(matchedList[i]);
+        *matchedList[i] = entry->keys[i];
+    }
+    *matchedKeyNum = entry->keyNum;
+    *matchedRecordNum = entry->recordNum;
+    return matchedList;
+}
+
+
+/**
+ * @brief  Cache the result of a prefix. Results larger than the memory budget are not cached.
+ * @param  cache:
+ * @param  prefix:
+ * @param  version: version counter of the node that decided the result
+ * @param  matchedList: the result, it is copied
+ * @param  matchedKeyNum:
+ * @param  matchedRecordNum:
+ */
+void resultCachePut(ResultCache* cache, char* prefix, size_t* version, MatchedData** matchedList,
+                    int matchedKeyNum, int matchedRecordNum) {
+    size_t prefixLen = strlen(prefix);
+    size_t memory = sizeof(CacheEntry) + prefixLen + 1 + matchedKeyNum * sizeof(MatchedData);
+    if (memory > cache->stats.memoryBudget) {
+        return;
+    }
+    uint64_t hash = hashPrefix(prefix);
+    CacheEntry* oldEntry = *findEntryLink(cache, prefix, hash);
+    if (oldEntry != NULL) {
+        removeEntry(cache, oldEntry);
+    }
+
+    CacheEntry* entry = (CacheEntry*) malloc(sizeof(CacheEntry));
+    assert(entry);
+    entry->prefix = (char*) malloc(prefixLen + 1);
+    assert(entry->prefix);
+    memcpy(entry->prefix, prefix, prefixLen + 1);
+    entry->hash = hash;
+    entry->version = version;
+    entry->savedVersion = *version;
+    entry->keys = (MatchedData*) malloc((matchedKeyNum + 1) * sizeof(MatchedData));
+    assert(entry->keys);
+    for (int i = 0; i < matchedKeyNum; i++) {
+        entry->keys[i] = *matchedList[i];
+    }
+    entry->keyNum = matchedKeyNum;
+    entry->recordNum = matchedRecordNum;
+    entry->memory = memory;
+
+    if (cache->stats.entryNum >= cache->bucketNum) {
+        growBuckets(cache);
+    }
+    CacheEntry** bucket = &cache->buckets[hash & (cache->bucketNum - 1)];
+    entry->hashNext = *bucket;
+    *bucket = entry;
+    pushFrontLRU(cache, entry);
+    cache->stats.entryNum ++;
+    cache->stats.memory += memory;
+
+    while (cache->stats.memory > cache->stats.memoryBudget) {
+        cache->stats.evictedNum ++;
+        removeEntry(cache, cache->tail);
+    }
+}
+
+
+/**
+ * @brief  Drop every entry, e.g. when the nodes they refer to are moved. Counters other than
+ *         entryNum and memory are kept.
+ */
+void resultCacheClear(ResultCache* cache) {
+    while (cache->head != NULL) {
+        removeEntry(cache, cache->head);
+    }
+}
+
+
+/**
+ * @brief  Get the counters of a result cache
+ */
+void getResultCacheStats(ResultCache* cache, ResultCacheStats* stats) {
+    *stats = cache->stats;
+}
+
+
+/**
+ * @brief  Free a result cache. Data records are not freed.
+ */
+void freeResultCache(ResultCache* cache) {
+    assert(cache);
+    CacheEntry* entry = cache->head;
+    while (entry != NULL) {
+        CacheEntry* next = entry->next;
+        free(entry->prefix);
+        free(entry->keys);
+        free(entry);
+        entry = next;
+    }
+    free(cache->buckets);
+    free(cache);
+}
@@ -18,10 +18,18 @@
 
 #include "notebook_driver.h"
 #include "my_bool.h"
+#include "trace.h"
+#include "request_stats.h"
 
 #define MAX_CLIENTS 25
 #define BUFFER_SIZE 256
 
+#define FOLD_KEYS_ARG "--fold"
+// Followed by a number of seconds, the request statistics are printed that often
+#define STATS_INTERVAL_ARG "--stats-interval"
+#define MS_PER_SEC 1000
+#define NS_PER_SEC 1000000000ULL
+
 int create_listening_socket(char* service);
 void add_new_client(int newsockfd, struct pollfd fds[], int* nfds);
 void delete_client(int i, struct pollfd fds[], int* nfds);
@@ -31,7 +39,7 @@ int set_nonblocking(int sockfd);
 
 int main(int argc, char** argv) {
 
-	RDictionary* notebookInstance = createNotebook();
+	traceInit();
 
 	int sockfd, newsockfd;
 	char buffer[BUFFER_SIZE];
@@ -47,6 +55,18 @@ int main(int argc, char** argv) {
 		exit(EXIT_FAILURE);
 	}
 
+	// Optional arguments: search keys case- and accent-insensitively, print the request statistics periodically
+	int keyMode = RDICT_KEY_EXACT;
+	int statsInterval = 0;
+	for (int i = 2; i < argc; i++) {
+		if (strcmp(argv[i], FOLD_KEYS_ARG) == 0) {
+			keyMode = RDICT_KEY_FOLDED;
+		} else if (strcmp(argv[i], STATS_INTERVAL_ARG) == 0 && i + 1 < argc) {
+			statsInterval = atoi(argv[++ i]);
+		}
+	}
+	RDictionary* notebookInstance = createNotebook(keyMode);
+
 	fprintf(stdout, "Preparing to create listening socket on port %s ...\n", argv[1]);
 
 	// Create the listening socket
@@ -71,20 +91,21 @@ int main(int argc, char** argv) {
 	initialiseFds(fds, nfds, MAX_CLIENTS);
 
 	timeout = (2500);
+	if (statsInterval > 0 && statsInterval * MS_PER_SEC < timeout) {
+		timeout = statsInterval * MS_PER_SEC;
+	}
+	uint64_t lastStatsDump = requestStatsNow();
 
 	for (;;) {
-		printf("Number of clients: %d\n", nfds);
-
 		// If timeout happens, poll() will return 0
 		int poll_count = poll(fds, nfds, timeout);
 		if (poll_count < 0) {
 			perror("poll() failed");
 			break;
 		}
-		printf("Iterating through poll() results...\n");
+		TRACE(TRACE_LEVEL_INFO, TRACE_EV_POLL, nfds, poll_count, NULL);
 		for (int i = 0; i < nfds ;i++) {
 			if (fds[i].revents & POLLIN) {
-				printf("Event caught on socket %d\n", fds[i].fd);
 				// sockfd is the listening socket
 				// If it is readable, it means we have a new connection
 				if (fds[i].fd == sockfd) {
@@ -100,9 +121,8 @@ int main(int argc, char** argv) {
 							continue;
 						}
 						add_new_client(newsockfd, fds, &nfds);
-						printf("Pollserver: new connection from %s on socket %d\n", 
-								inet_ntop(remoteaddr.ss_family, get_sockaddr((struct sockaddr*) &remoteaddr), remoteIP, INET_ADDRSTRLEN), 
-								newsockfd);
+						TRACE(TRACE_LEVEL_INFO, TRACE_EV_ACCEPT, newsockfd, 0, 
+								inet_ntop(remoteaddr.ss_family, get_sockaddr((struct sockaddr*) &remoteaddr), remoteIP, INET_ADDRSTRLEN));
 					}
 				} else {
 					// The coming data is not from the listening socket, so it is from an existing client
@@ -122,36 +142,63 @@ int main(int argc, char** argv) {
 								readComplete = TRUE;
 								continue;
 							} else {
+								TRACE(TRACE_LEVEL_ERROR, TRACE_EV_RECV_ERROR, sender_fd, errno, NULL);
 								perror("recv() failed");
 								close(fds[i].fd);
 								delete_client(i, fds, &nfds);
 								break;
 							}
 						} else {
-							printf("Pollserver: received %d bytes from socket %d\n", nbytes, sender_fd);
+							TRACE(TRACE_LEVEL_DEBUG, TRACE_EV_RECV, sender_fd, nbytes, NULL);
 							readPool = realloc(readPool, readPoolSize + nbytes);
 							memcpy(readPool + readPoolSize, buffer, nbytes);
 							readPoolSize += nbytes;
 						}
 					}
-					printf("Pollserver: received message: %s\n", readPool);
+					TRACE(TRACE_LEVEL_INFO, TRACE_EV_MESSAGE, sender_fd, readPoolSize, readPool);
 					// TODO: Process the message
+					uint64_t parseStart = requestStatsNow();
 					cJSON* request = cJSON_Parse(readPool);
+					uint64_t parseEnd = requestStatsNow();
+					StatsModeId statsMode = getRequestStatsMode(request);
+					if (readPool != NULL) {
+						requestStatsRecord(statsMode, STATS_PHASE_PARSE, parseEnd - parseStart);
+					}
 					if (request == NULL) {
-						printf("Pollserver: failed to parse JSON string\n");
+						TRACE(TRACE_LEVEL_ERROR, TRACE_EV_PARSE_ERROR, sender_fd, readPoolSize, NULL);
 					} else {
 						cJSON* response = processRequest(request, notebookInstance);
-						char* responseStr = cJSON_Print(response);
-						printf("Pollserver: response: %s\n", responseStr);
-						send(sender_fd, responseStr, strlen(responseStr), 0);
-						cJSON_free(responseStr);
-						cJSON_Delete(response);
+						uint64_t treeOpEnd = requestStatsNow();
+						requestStatsRecord(statsMode, STATS_PHASE_TREE_OP, treeOpEnd - parseEnd);
+						// unknown modes have no response
+						if (response != NULL) {
+							char* responseStr = cJSON_Print(response);
+							size_t responseLen = strlen(responseStr);
+							uint64_t serialiseEnd = requestStatsNow();
+							TRACE(TRACE_LEVEL_INFO, TRACE_EV_RESPONSE, sender_fd, responseLen, responseStr);
+							send(sender_fd, responseStr, responseLen, 0);
+							uint64_t sendEnd = requestStatsNow();
+							requestStatsRecord(statsMode, STATS_PHASE_SERIALISE, serialiseEnd - treeOpEnd);
+							requestStatsRecord(statsMode, STATS_PHASE_SEND, sendEnd - serialiseEnd);
+							requestStatsRecord(statsMode, STATS_PHASE_TOTAL, sendEnd - parseStart);
+							requestStatsRecordSize(responseLen, sendEnd - parseStart);
+							cJSON_free(responseStr);
+							cJSON_Delete(response);
+						}
 						cJSON_free(request);
 					}
 				}
 			}
 		}
-		printf("Iteration done.\n");
+		// Responses have been sent, format the buffered trace events now
+		if (traceRuntimeLevel != TRACE_LEVEL_OFF) {
+			traceFlush(stdout);
+		}
+		if (statsInterval > 0 && requestStatsNow() - lastStatsDump >= (uint64_t) statsInterval * NS_PER_SEC) {
+			printRequestStats(stdout);
+			fflush(stdout);
+			lastStatsDump = requestStatsNow();
+		}
 	}
 
 	fprintf(stdout, "Closing sockets...\n");
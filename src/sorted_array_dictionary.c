@@ -9,58 +9,258 @@ sorted_array_dictionary.c :
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
+#include <math.h>
 #include <assert.h>
 
 #include "sorted_array_dictionary.h"
-
-#define INITIAL_SORTED_ARRAY_SIZE 2
+#include "my_bool.h"
+#include "string_sort.h"
 
 // Used for searching by key.
 #define MATCHED_LIST_SIZE 2
+// Used for appending before a build.
+#define INITIAL_APPENDED_SIZE 16
+
+// Heads of the read layout are prefetched this many levels down, a cache line of pointers
+#define PREFETCH_LEVELS 3
+// Keys per front-coded block of the read layout
+#define FRONT_CODING_BLOCK_SIZE 16
+// Longest common prefix with the head stored for a key, it takes one byte
+#define MAX_SHARED_LEN 255
+// Bytes of a key the learned index predicts its position from
+#define LEARNED_KEY_BYTES 8
+
+// Nodes are aligned to cache lines, and sized so that the keys searched in a node fill two of them.
+#define CACHE_LINE_SIZE 64
+#define LEAF_CAPACITY 16            // keys in a leaf
+#define FANOUT 16                   // children of an inner node
+
+/*
+ * The dictionary is a B+tree. Leaves hold the keys and data in sorted order, and are linked for
+ * scanning a range of keys. An inner node with n children keeps n - 1 separator keys: the first key
+ * of the subtree of each child but the first one.
+ * Equal keys stay in insertion order: a new key goes after the keys equal to it.
+ */
+typedef struct BTreeLeaf SDictLeaf;
+struct BTreeLeaf {
+    int keyNum;
+    void* keys[LEAF_CAPACITY];
+    void* data[LEAF_CAPACITY];
+    SDictLeaf* next;
+};
 
-typedef struct SNode SDictItem;
-struct SNode {
-    void *key;
-    void *data;
+typedef struct BTreeInner SDictInner;
+struct BTreeInner {
+    int childNum;
+    void* keys[FANOUT - 1];
+    void* children[FANOUT];         // inner nodes, or leaves at the lowest level
+};
+
+
+/*
+ * Learned index over the heads of the read layout: the first LEARNED_KEY_BYTES bytes of a key, read
+ * as a big-endian integer, are mapped to the block of the first head not below it by a piecewise
+ * linear function. Each segment predicts the blocks of the heads it was fitted on within the
+ * maximum error of the index. Heads sharing their first bytes can't be told apart, and keys between
+ * heads can fall further, so a search checks the predicted window and widens it when it is wrong.
+ */
+typedef struct LinearSegmentStruct LinearSegment;
+struct LinearSegmentStruct {
+    uint64_t firstX;                // key integer of the first head of the segment
+    double firstBlock;              // predicted block at firstX
+    double slope;                   // blocks per key integer
+};
+
+typedef struct LearnedIndexStruct LearnedIndex;
+struct LearnedIndexStruct {
+    LinearSegment* segments;        // by firstX
+    size_t segmentNum;
+    int maxError;
+};
+
+
+/*
+ * Read layout built by sDictOptimiseForReads, for string keys. The sorted keys are stored in one
+ * buffer in blocks of FRONT_CODING_BLOCK_SIZE: the first key of a block (its head) in full, then
+ * each other key as the length of its common prefix with the head (one byte) and the rest of it.
+ * The heads are indexed in Eytzinger order, i.e. placed in an implicit binary search tree laid out
+ * level by level (root at 1, children of k at 2k and 2k + 1), so the top levels shared by every
+ * search stay in cache and the heads compared next are prefetched together. A bound is found by
+ * searching the heads, then decoding one block.
+ */
+typedef struct FrontCodedLayout SDictReadLayout;
+struct FrontCodedLayout {
+    char* blocks;
+    size_t* blockStarts;            // offset of each block in blocks
+    char** heads;                   // head of each block from index 1 to blockNum, NULL up to 2 * blockNum + 1
+    size_t* headBlocks;             // block of each head
+    void** sortedData;
+    size_t num;
+    size_t blockNum;
+    size_t maxKeyLen;
+    LearnedIndex* learnedIndex;     // NULL unless enabled, then searched instead of the Eytzinger order
 };
 
 
 struct SortedArray {
-    SDictItem **sArray;
-    size_t size;
+    void* root;                     // a leaf if height is 0
+    int height;                     // number of inner levels
+    SDictLeaf* firstLeaf;
     size_t num;
+    SDictReadLayout* readLayout;    // NULL until optimised for reads, dropped by the next insertion
+    StringSortItem* appended;       // waiting for sDictBuild, in order of appending
+    size_t appendedNum;
+    size_t appendedSize;
 };
 
 
+static void* allocNode(size_t size) {
+    size_t alignedSize = (size + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+    void* node = aligned_alloc(CACHE_LINE_SIZE, alignedSize);
+    assert(node);
+    return node;
+}
+
+
+static SDictLeaf* newLeaf() {
+    SDictLeaf* leaf = (SDictLeaf*) allocNode(sizeof(SDictLeaf));
+    leaf->keyNum = 0;
+    leaf->next = NULL;
+    return leaf;
+}
+
+
+static SDictInner* newInner() {
+    SDictInner* inner = (SDictInner*) allocNode(sizeof(SDictInner));
+    inner->childNum = 0;
+    return inner;
+}
+
+
 // creation of sorted array dictionary
 SDictionary* createSDict() {
     SDictionary *sDict = (SDictionary*) malloc(sizeof(SDictionary));
     assert(sDict);
-    sDict->size = INITIAL_SORTED_ARRAY_SIZE;
+    sDict->firstLeaf = newLeaf();
+    sDict->root = sDict->firstLeaf;
+    sDict->height = 0;
     sDict->num = 0;
-    sDict->sArray = (SDictItem **) malloc(sDict->size * sizeof(SDictItem*));
-    assert(sDict->sArray);
+    sDict->readLayout = NULL;
+    sDict->appended = NULL;
+    sDict->appendedNum = 0;
+    sDict->appendedSize = 0;
     return sDict;
 }
 
 
-// ensure size of the sorted array, double the size of array if not enough
-void ensureSortedArraySize(SDictionary* sDict) {
-    if (sDict->num == sDict->size) {
-        sDict->size *= 2;
-        sDict->sArray = (SDictItem**) realloc(sDict->sArray, sDict->size * sizeof(SDictItem*));
-        assert(sDict->sArray);
+// Index of the first key larger than the given one
+static int upperBound(void** keys, int keyNum, void* givenKey, int (*compare)(void*, void*)) {
+    int left = 0, right = keyNum;
+    while (left < right) {
+        int mid = (left + right) / 2;
+        if (compare(givenKey, keys[mid]) >= 0) {
+            left = mid + 1;
+        } else {
+            right = mid;
+        }
+    }
+    return left;
+}
+
+
+/*
+ * Insert into the subtree of a node at a height (0 for a leaf). If the node is split, the new node
+ * on its right is returned with the first key of its subtree in splitKey; otherwise NULL.
+ */
+static void* insertIntoNode(void* node, int height, void* givenKey, void* data, int (*compare)(void*, void*),
+                            void** splitKey) {
+    if (height == 0) {
+        SDictLeaf* leaf = (SDictLeaf*) node;
+        int idx = upperBound(leaf->keys, leaf->keyNum, givenKey, compare);
+        SDictLeaf* right = NULL;
+        if (leaf->keyNum == LEAF_CAPACITY) {
+            // move the upper half to a new leaf, then insert into the half the key belongs to
+            right = newLeaf();
+            int half = LEAF_CAPACITY / 2;
+            right->keyNum = LEAF_CAPACITY - half;
+            memcpy(right->keys, leaf->keys + half, right->keyNum * sizeof(void*));
+            memcpy(right->data, leaf->data + half, right->keyNum * sizeof(void*));
+            leaf->keyNum = half;
+            right->next = leaf->next;
+            leaf->next = right;
+            if (idx > half) {
+                leaf = right;
+                idx -= half;
+            }
+        }
+        memmove(leaf->keys + idx + 1, leaf->keys + idx, (leaf->keyNum - idx) * sizeof(void*));
+        memmove(leaf->data + idx + 1, leaf->data + idx, (leaf->keyNum - idx) * sizeof(void*));
+        leaf->keys[idx] = givenKey;
+        leaf->data[idx] = data;
+        leaf->keyNum ++;
+        if (right != NULL) {
+            *splitKey = right->keys[0];
+        }
+        return right;
+    }
+
+    SDictInner* inner = (SDictInner*) node;
+    int childIdx = upperBound(inner->keys, inner->childNum - 1, givenKey, compare);
+    void* childSplitKey = NULL;
+    void* newChild = insertIntoNode(inner->children[childIdx], height - 1, givenKey, data, compare, &childSplitKey);
+    if (newChild == NULL) {
+        return NULL;
+    }
+
+    // the new child goes right after the one that was split, with its first key before it
+    void* keys[FANOUT];
+    void* children[FANOUT + 1];
+    int keyNum = inner->childNum - 1;
+    memcpy(keys, inner->keys, childIdx * sizeof(void*));
+    keys[childIdx] = childSplitKey;
+    memcpy(keys + childIdx + 1, inner->keys + childIdx, (keyNum - childIdx) * sizeof(void*));
+    memcpy(children, inner->children, (childIdx + 1) * sizeof(void*));
+    children[childIdx + 1] = newChild;
+    memcpy(children + childIdx + 2, inner->children + childIdx + 1, (inner->childNum - childIdx - 1) * sizeof(void*));
+    int childNum = inner->childNum + 1;
+
+    if (childNum <= FANOUT) {
+        memcpy(inner->keys, keys, (childNum - 1) * sizeof(void*));
+        memcpy(inner->children, children, childNum * sizeof(void*));
+        inner->childNum = childNum;
+        return NULL;
     }
+    // split, the middle key moves up
+    SDictInner* right = newInner();
+    int leftNum = childNum / 2;
+    inner->childNum = leftNum;
+    memcpy(inner->keys, keys, (leftNum - 1) * sizeof(void*));
+    memcpy(inner->children, children, leftNum * sizeof(void*));
+    right->childNum = childNum - leftNum;
+    memcpy(right->keys, keys + leftNum, (right->childNum - 1) * sizeof(void*));
+    memcpy(right->children, children + leftNum, right->childNum * sizeof(void*));
+    *splitKey = keys[leftNum - 1];
+    return right;
 }
 
-// minimize the size of sorted array
-void shrinkSortedArray(SDictionary* sDict) {
-    if (sDict->num < sDict->size) {
-        sDict->size = (sDict->num > INITIAL_SORTED_ARRAY_SIZE) ? sDict->num : INITIAL_SORTED_ARRAY_SIZE;
-        sDict->sArray = (SDictItem**) realloc(sDict->sArray, sDict->size * sizeof(SDictItem*));
-        assert(sDict->sArray);
+
+static void freeReadLayout(SDictionary* sDict) {
+    if (sDict->readLayout == NULL) {
+        return;
+    }
+    free(sDict->readLayout->blocks);
+    free(sDict->readLayout->blockStarts);
+    free(sDict->readLayout->heads);
+    free(sDict->readLayout->headBlocks);
+    free(sDict->readLayout->sortedData);
+    if (sDict->readLayout->learnedIndex != NULL) {
+        free(sDict->readLayout->learnedIndex->segments);
+        free(sDict->readLayout->learnedIndex);
     }
+    free(sDict->readLayout);
+    sDict->readLayout = NULL;
 }
 
 
@@ -78,60 +278,547 @@ void shrinkSortedArray(SDictionary* sDict) {
  *                  - 0 if the first key "equals to" the second key.
  */
 void sDictInsert(SDictionary* sDict, void* givenKey, void* data, int (*compare)(void*, void*)) {
-    SDictItem* newItem = (SDictItem*) malloc(sizeof(SDictItem));
-    newItem->key = givenKey;
-    newItem->data = data;
+    freeReadLayout(sDict);
+    void* splitKey = NULL;
+    void* right = insertIntoNode(sDict->root, sDict->height, givenKey, data, compare, &splitKey);
+    if (right != NULL) {
+        // the root was split, the tree grows by one level
+        SDictInner* root = newInner();
+        root->childNum = 2;
+        root->keys[0] = splitKey;
+        root->children[0] = sDict->root;
+        root->children[1] = right;
+        sDict->root = root;
+        sDict->height ++;
+    }
+    sDict->num ++;
+}
+
 
-    if (sDict->num == 0) {
-        sDict->sArray[0] = newItem;
-        sDict->num ++;
+/**
+ * @brief Add a data item to be inserted by the next sDictBuild, faster than sDictInsert when all
+ *        the items are known up front. The key must be a string. Searches don't find the item
+ *        until it is built.
+ * 
+ * @param sDict 
+ * @param key 
+ * @param data 
+ */
+void sDictAppend(SDictionary* sDict, char* key, void* data) {
+    if (sDict->appendedNum == sDict->appendedSize) {
+        sDict->appendedSize = sDict->appendedSize == 0 ? INITIAL_APPENDED_SIZE : 2 * sDict->appendedSize;
+        sDict->appended = (StringSortItem*) realloc(sDict->appended, sDict->appendedSize * sizeof(StringSortItem));
+        assert(sDict->appended);
+    }
+    sDict->appended[sDict->appendedNum].key = key;
+    sDict->appended[sDict->appendedNum].data = data;
+    sDict->appendedNum ++;
+}
+
+
+// Free the inner nodes of a subtree, and the leaves
+static void freeNodes(void* node, int height) {
+    if (height > 0) {
+        SDictInner* inner = (SDictInner*) node;
+        for (int i = 0; i < inner->childNum; i++) {
+            freeNodes(inner->children[i], height - 1);
+        }
+    }
+    free(node);
+}
+
+
+// Replace the tree with one of full nodes holding the sorted items
+static void bulkLoad(SDictionary* sDict, StringSortItem* items, size_t num) {
+    freeNodes(sDict->root, sDict->height);
+    // nodes of the current level, with the first key of their subtrees
+    size_t nodeNum = num == 0 ? 1 : (num + LEAF_CAPACITY - 1) / LEAF_CAPACITY;
+    void** nodes = (void**) malloc(nodeNum * sizeof(void*));
+    assert(nodes);
+    void** firstKeys = (void**) malloc(nodeNum * sizeof(void*));
+    assert(firstKeys);
+
+    // items are spread evenly over the leaves
+    SDictLeaf* prev = NULL;
+    for (size_t n = 0; n < nodeNum; n++) {
+        SDictLeaf* leaf = newLeaf();
+        size_t first = num * n / nodeNum, last = num * (n + 1) / nodeNum;
+        leaf->keyNum = (int) (last - first);
+        for (size_t i = first; i < last; i++) {
+            leaf->keys[i - first] = items[i].key;
+            leaf->data[i - first] = items[i].data;
+        }
+        firstKeys[n] = leaf->keyNum == 0 ? NULL : leaf->keys[0];
+        if (prev == NULL) {
+            sDict->firstLeaf = leaf;
+        } else {
+            prev->next = leaf;
+        }
+        prev = leaf;
+        nodes[n] = leaf;
+    }
+
+    // then the nodes of each level over the inner nodes of the level above
+    int height = 0;
+    while (nodeNum > 1) {
+        size_t parentNum = (nodeNum + FANOUT - 1) / FANOUT;
+        for (size_t p = 0; p < parentNum; p++) {
+            SDictInner* inner = newInner();
+            size_t first = nodeNum * p / parentNum, last = nodeNum * (p + 1) / parentNum;
+            inner->childNum = (int) (last - first);
+            for (size_t i = first; i < last; i++) {
+                inner->children[i - first] = nodes[i];
+                if (i != first) {
+                    inner->keys[i - first - 1] = firstKeys[i];
+                }
+            }
+            nodes[p] = inner;
+            firstKeys[p] = firstKeys[first];
+        }
+        nodeNum = parentNum;
+        height ++;
+    }
+    sDict->root = nodes[0];
+    sDict->height = height;
+    sDict->num = num;
+    free(nodes);
+    free(firstKeys);
+}
+
+
+/**
+ * @brief Insert the data items appended since the last build. They are sorted with a parallel MSD
+ *        radix sort, merged with the items already in the dictionary and the tree is rebuilt from
+ *        them, full. Items with equal keys stay in the order they were inserted or appended, as if
+ *        each one had been inserted by sDictInsert. All the keys must be strings, in the order of
+ *        strcmp.
+ * 
+ * @param sDict 
+ * @param threadNum number of threads sorting, including the calling one
+ */
+void sDictBuild(SDictionary* sDict, int threadNum) {
+    freeReadLayout(sDict);
+    WorkPool* pool = createWorkPool(threadNum < 1 ? 1 : threadNum);
+    parallelStringSort(pool, sDict->appended, sDict->appendedNum);
+    freeWorkPool(pool);
+
+    // the items already in come first among equal keys
+    size_t num = sDict->num + sDict->appendedNum;
+    StringSortItem* items = (StringSortItem*) malloc((num + 1) * sizeof(StringSortItem));
+    assert(items);
+    size_t i = 0, appendedIdx = 0;
+    for (SDictLeaf* leaf = sDict->firstLeaf; leaf != NULL; leaf = leaf->next) {
+        for (int j = 0; j < leaf->keyNum; j++) {
+            while (appendedIdx < sDict->appendedNum && strcmp(sDict->appended[appendedIdx].key, leaf->keys[j]) < 0) {
+                items[i ++] = sDict->appended[appendedIdx ++];
+            }
+            items[i].key = leaf->keys[j];
+            items[i ++].data = leaf->data[j];
+        }
+    }
+    memcpy(items + i, sDict->appended + appendedIdx, (sDict->appendedNum - appendedIdx) * sizeof(StringSortItem));
+
+    bulkLoad(sDict, items, num);
+    free(items);
+    free(sDict->appended);
+    sDict->appended = NULL;
+    sDict->appendedNum = 0;
+    sDict->appendedSize = 0;
+}
+
+
+// Place the heads from *next on in the subtree of k, in order
+static void fillEytzinger(SDictReadLayout* layout, size_t* next, size_t k) {
+    if (k > layout->blockNum) {
         return;
     }
+    fillEytzinger(layout, next, 2 * k);
+    layout->heads[k] = layout->blocks + layout->blockStarts[*next];
+    layout->headBlocks[k] = (*next) ++;
+    fillEytzinger(layout, next, 2 * k + 1);
+}
+
 
-    int left = 0, right = sDict->num - 1;
-    int mid;
-    int insertIndex;
+static size_t getSharedLen(char* head, char* key) {
+    size_t len = 0;
+    while (len < MAX_SHARED_LEN && head[len] != '\0' && head[len] == key[len]) {
+        len ++;
+    }
+    return len;
+}
 
-    // binary search, find the index to insert
-    while (left <= right) {
-        mid = (left + right) / 2;
-        void* midKey = (sDict->sArray[mid])->key;
-        int cmpResult = compare(givenKey, midKey);
 
-        if (cmpResult > 0) {
-            left = mid + 1;
-            insertIndex = mid + 1;
-        } else if (cmpResult < 0) {
-            right = mid - 1;
-            insertIndex = mid;
+/**
+ * @brief Build a read-optimised copy of the keys, which must be strings: front-coded blocks of
+ *        sorted keys, whose first keys are searched in Eytzinger order. findAndTraverseSDict then
+ *        finds the matches with two bound searches instead of scanning them. The copy is dropped
+ *        by the next insertion.
+ * 
+ * @param sDict 
+ */
+void sDictOptimiseForReads(SDictionary* sDict) {
+    freeReadLayout(sDict);
+    SDictReadLayout* layout = (SDictReadLayout*) malloc(sizeof(SDictReadLayout));
+    assert(layout);
+    size_t num = sDict->num;
+    layout->num = num;
+    layout->blockNum = (num + FRONT_CODING_BLOCK_SIZE - 1) / FRONT_CODING_BLOCK_SIZE;
+    layout->maxKeyLen = 0;
+    layout->learnedIndex = NULL;
+    layout->sortedData = (void**) malloc((num + 1) * sizeof(void*));
+    assert(layout->sortedData);
+    char** sortedKeys = (char**) malloc((num + 1) * sizeof(char*));
+    assert(sortedKeys);
+
+    size_t i = 0;
+    for (SDictLeaf* leaf = sDict->firstLeaf; leaf != NULL; leaf = leaf->next) {
+        memcpy(sortedKeys + i, leaf->keys, leaf->keyNum * sizeof(void*));
+        memcpy(layout->sortedData + i, leaf->data, leaf->keyNum * sizeof(void*));
+        i += leaf->keyNum;
+    }
+
+    // size of the blocks
+    size_t size = 0;
+    for (i = 0; i < num; i++) {
+        size_t len = strlen(sortedKeys[i]);
+        if (len > layout->maxKeyLen) {
+            layout->maxKeyLen = len;
+        }
+        if (i % FRONT_CODING_BLOCK_SIZE == 0) {
+            size += len + 1;
         } else {
-            insertIndex = mid;
-            break;
+            size += 1 + len - getSharedLen(sortedKeys[i - i % FRONT_CODING_BLOCK_SIZE], sortedKeys[i]) + 1;
         }
     }
+    layout->blocks = (char*) malloc(size + 1);
+    assert(layout->blocks);
+    layout->blockStarts = (size_t*) malloc((layout->blockNum + 1) * sizeof(size_t));
+    assert(layout->blockStarts);
+
+    char* pos = layout->blocks;
+    for (i = 0; i < num; i++) {
+        char* head = sortedKeys[i - i % FRONT_CODING_BLOCK_SIZE];
+        size_t sharedLen = 0;
+        if (i % FRONT_CODING_BLOCK_SIZE == 0) {
+            layout->blockStarts[i / FRONT_CODING_BLOCK_SIZE] = pos - layout->blocks;
+        } else {
+            sharedLen = getSharedLen(head, sortedKeys[i]);
+            *(pos ++) = (char) sharedLen;
+        }
+        size_t restLen = strlen(sortedKeys[i] + sharedLen);
+        memcpy(pos, sortedKeys[i] + sharedLen, restLen + 1);
+        pos += restLen + 1;
+    }
+    free(sortedKeys);
+
+    layout->heads = (char**) aligned_alloc(CACHE_LINE_SIZE, ((2 * layout->blockNum + 2) * sizeof(char*) + CACHE_LINE_SIZE - 1)
+                                                            / CACHE_LINE_SIZE * CACHE_LINE_SIZE);
+    assert(layout->heads);
+    memset(layout->heads, 0, (2 * layout->blockNum + 2) * sizeof(char*));
+    layout->headBlocks = (size_t*) malloc((layout->blockNum + 1) * sizeof(size_t));
+    assert(layout->headBlocks);
+    size_t next = 0;
+    fillEytzinger(layout, &next, 1);
+    sDict->readLayout = layout;
+}
 
-    // only traverse right side to ensure stable sort
-    for (int i = insertIndex; i < sDict->num; i++) {
-        void* tmpKey = (sDict->sArray[i])->key;
-        int cmpResult = compare(givenKey, tmpKey);
-        if (cmpResult != 0) {
-            insertIndex = i;
+
+static int compareAndCount(void* givenKey, char* key, int* comparedKeyNum, int* countCompare, 
+                           int (*compare)(void*, void*, int*)) {
+    int tmpCount = 0;
+    int cmpResult = compare(givenKey, key, &tmpCount);
+    (*comparedKeyNum) ++;
+    (*countCompare) += tmpCount;
+    return cmpResult;
+}
+
+
+// First bytes of a string as a big-endian integer, so integers are in the order of the strings
+static uint64_t getKeyInteger(char* key) {
+    uint64_t x = 0;
+    int i = 0;
+    for (; i < LEARNED_KEY_BYTES && key[i] != '\0'; i++) {
+        x = (x << 8) | (unsigned char) key[i];
+    }
+    return i == LEARNED_KEY_BYTES ? x : x << (8 * (LEARNED_KEY_BYTES - i));
+}
+
+
+static char* getHead(SDictReadLayout* layout, size_t block) {
+    return layout->blocks + layout->blockStarts[block];
+}
+
+
+// Block predicted for a key integer, from the last segment starting at or before it
+static double predictBlock(LearnedIndex* index, uint64_t x) {
+    size_t left = 0, right = index->segmentNum;
+    while (right - left > 1) {
+        size_t mid = (left + right) / 2;
+        if (index->segments[mid].firstX <= x) {
+            left = mid;
+        } else {
+            right = mid;
+        }
+    }
+    LinearSegment* segment = &index->segments[left];
+    if (x < segment->firstX) {
+        return segment->firstBlock;
+    }
+    return segment->firstBlock + segment->slope * (double) (x - segment->firstX);
+}
+
+
+/**
+ * @brief Search the read layout through a learned index: a piecewise linear model predicting where
+ *        a key is among the first keys of the blocks, from its first 8 bytes, then a search of the
+ *        few blocks around. Builds the read layout if there is none, and is dropped with it.
+ *        Best for keys spread evenly once their first bytes are known.
+ * 
+ * @param sDict 
+ * @param maxError the most blocks a prediction of a first key of a block may be off by
+ */
+void sDictEnableLearnedIndex(SDictionary* sDict, int maxError) {
+    if (sDict->readLayout == NULL) {
+        sDictOptimiseForReads(sDict);
+    }
+    SDictReadLayout* layout = sDict->readLayout;
+    if (layout->learnedIndex != NULL) {
+        free(layout->learnedIndex->segments);
+        free(layout->learnedIndex);
+    }
+    LearnedIndex* index = (LearnedIndex*) malloc(sizeof(LearnedIndex));
+    assert(index);
+    index->maxError = maxError < 0 ? 0 : maxError;
+    index->segmentNum = 0;
+    size_t segmentSize = 1;
+    index->segments = (LinearSegment*) malloc(segmentSize * sizeof(LinearSegment));
+    assert(index->segments);
+
+    // greedy fitting: a segment takes heads while some slope keeps all of them within the error
+    // (the range of such slopes only shrinks). Of the heads with the same integer, only the first
+    // one is fitted, where searches for that integer start.
+    size_t block = 0;
+    do {
+        uint64_t firstX = layout->blockNum == 0 ? 0 : getKeyInteger(getHead(layout, block));
+        double minSlope = 0, maxSlope = INFINITY;
+        uint64_t prevX = firstX;
+        size_t next = block + 1;
+        for (; next < layout->blockNum; next++) {
+            uint64_t x = getKeyInteger(getHead(layout, next));
+            double distance = (double) (next - block);
+            if (x == prevX) {
+                continue;
+            }
+            prevX = x;
+            double dx = (double) (x - firstX);
+            double low = fmax(minSlope, (distance - index->maxError) / dx);
+            double high = fmin(maxSlope, (distance + index->maxError) / dx);
+            if (low > high) {
+                break;
+            }
+            minSlope = low;
+            maxSlope = high;
+        }
+        if (index->segmentNum == segmentSize) {
+            segmentSize *= 2;
+            index->segments = (LinearSegment*) realloc(index->segments, segmentSize * sizeof(LinearSegment));
+            assert(index->segments);
+        }
+        LinearSegment* segment = &index->segments[index->segmentNum ++];
+        segment->firstX = firstX;
+        segment->firstBlock = (double) block;
+        segment->slope = isinf(maxSlope) ? minSlope : (minSlope + maxSlope) / 2;
+        block = next;
+    } while (block < layout->blockNum);
+    layout->learnedIndex = index;
+}
+
+
+/**
+ * @brief Get the size and accuracy of the learned index, over the first keys of the blocks it
+ *        was fitted on (the first of those sharing their first 8 bytes). All zero if it isn't enabled.
+ * 
+ * @param sDict 
+ * @param stats 
+ */
+void getSDictLearnedIndexStats(SDictionary* sDict, SDictLearnedIndexStats* stats) {
+    memset(stats, 0, sizeof(SDictLearnedIndexStats));
+    if (sDict->readLayout == NULL || sDict->readLayout->learnedIndex == NULL) {
+        return;
+    }
+    SDictReadLayout* layout = sDict->readLayout;
+    LearnedIndex* index = layout->learnedIndex;
+    stats->segmentNum = index->segmentNum;
+    stats->bytes = sizeof(LearnedIndex) + index->segmentNum * sizeof(LinearSegment);
+    stats->blockNum = layout->blockNum;
+    double errorSum = 0;
+    for (size_t block = 0; block < layout->blockNum; block++) {
+        uint64_t x = getKeyInteger(getHead(layout, block));
+        if (block > 0 && x == getKeyInteger(getHead(layout, block - 1))) {
+            continue;
+        }
+        stats->fittedNum ++;
+        double error = fabs(predictBlock(index, x) - block);
+        errorSum += error;
+        if (error > stats->maxError) {
+            stats->maxError = error;
+        }
+    }
+    stats->meanError = stats->fittedNum == 0 ? 0 : errorSum / stats->fittedNum;
+}
+
+
+/*
+ * Block of the first head for which the given key is no longer larger (lower bound), or is smaller
+ * (upper bound), blockNum if there is none. *headCmpResult is the comparison with that head.
+ * Searched with no branch on the comparisons: each one picks the child arithmetically, and that
+ * head is at the last node where the search went left, found by dropping the trailing right turns
+ * (1 bits) of the path and the left turn before them.
+ */
+static size_t findHeadInEytzinger(SDictReadLayout* layout, void* givenKey, BOOL upper, int* headCmpResult,
+                                  int* comparedKeyNum, int* countCompare, int (*compare)(void*, void*, int*)) {
+    char** heads = layout->heads;
+    size_t k = 1;
+    int leftCmpResult = -1;
+    while (k <= layout->blockNum) {
+        __builtin_prefetch(heads + (k << PREFETCH_LEVELS));
+        __builtin_prefetch(heads[2 * k]);
+        __builtin_prefetch(heads[2 * k + 1]);
+        int cmpResult = compareAndCount(givenKey, heads[k], comparedKeyNum, countCompare, compare);
+        BOOL right = upper ? cmpResult >= 0 : cmpResult > 0;
+        leftCmpResult = right ? leftCmpResult : cmpResult;
+        k = 2 * k + right;
+    }
+    k >>= __builtin_ffsll(~k);
+    *headCmpResult = leftCmpResult;
+    return k == 0 ? layout->blockNum : layout->headBlocks[k];
+}
+
+
+/*
+ * The same with the learned index. The heads between left and right (excluded) are binary searched,
+ * once the head at left is known not to be a bound and the one at right to be one (-1 and blockNum
+ * stand for heads before and after all). The window starts around the prediction, and doubles
+ * towards the bound until it holds.
+ */
+static size_t findHeadWithLearnedIndex(SDictReadLayout* layout, void* givenKey, BOOL upper, int* headCmpResult,
+                                       int* comparedKeyNum, int* countCompare, int (*compare)(void*, void*, int*)) {
+    LearnedIndex* index = layout->learnedIndex;
+    long long blockNum = (long long) layout->blockNum;
+    // the last segment is extrapolated past the last head, so keep the prediction within the blocks
+    // before rounding it
+    double prediction = predictBlock(index, getKeyInteger((char*) givenKey));
+    prediction = prediction < 0 ? 0 : (prediction > (double) blockNum ? (double) blockNum : prediction);
+    long long predicted = llround(prediction);
+    long long left = predicted - index->maxError - 1, right = predicted + index->maxError + 1;
+    left = left < -1 ? -1 : (left > blockNum - 1 ? blockNum - 1 : left);
+    right = right > blockNum ? blockNum : (right < left + 1 ? left + 1 : right);
+    int rightCmpResult = -1;
+
+    // widen to the left while the head at left is a bound, which also makes the one at right known
+    BOOL rightKnown = right == blockNum;
+    long long step = right - left;
+    while (left >= 0) {
+        int cmpResult = compareAndCount(givenKey, getHead(layout, left), comparedKeyNum, countCompare, compare);
+        if (upper ? cmpResult >= 0 : cmpResult > 0) {
+            break;
+        }
+        right = left;
+        rightCmpResult = cmpResult;
+        rightKnown = TRUE;
+        left = left - step < -1 ? -1 : left - step;
+        step *= 2;
+    }
+    // otherwise widen to the right while the head at right isn't a bound
+    while (!rightKnown) {
+        int cmpResult = compareAndCount(givenKey, getHead(layout, right), comparedKeyNum, countCompare, compare);
+        if (!(upper ? cmpResult >= 0 : cmpResult > 0)) {
+            rightCmpResult = cmpResult;
             break;
         }
+        left = right;
+        right = right + step > blockNum ? blockNum : right + step;
+        rightKnown = right == blockNum;
+        step *= 2;
     }
 
-    // insert
-    ensureSortedArraySize(sDict);
+    while (right - left > 1) {
+        long long mid = (left + right) / 2;
+        int cmpResult = compareAndCount(givenKey, getHead(layout, mid), comparedKeyNum, countCompare, compare);
+        if (upper ? cmpResult >= 0 : cmpResult > 0) {
+            left = mid;
+        } else {
+            right = mid;
+            rightCmpResult = cmpResult;
+        }
+    }
+    *headCmpResult = rightCmpResult;
+    return (size_t) right;
+}
+
+
+/*
+ * Sorted position of the first key for which the given key is no longer larger (lower bound), or
+ * is smaller (upper bound, i.e. after the keys it is a prefix of), num if there is none.
+ * *matching tells whether the given key is a prefix of the key found.
+ * The first head that is a bound is searched first. The bound is then either a key of the block
+ * before that head (the head of which isn't a bound), or the head.
+ */
+static size_t findBound(SDictReadLayout* layout, void* givenKey, BOOL upper, BOOL* matching, char* keyBuffer, 
+                        int* comparedKeyNum, int* countCompare, int (*compare)(void*, void*, int*)) {
+    int headCmpResult = -1;
+    size_t block = 0;
+    if (layout->learnedIndex != NULL) {
+        block = findHeadWithLearnedIndex(layout, givenKey, upper, &headCmpResult, comparedKeyNum, countCompare, compare);
+    } else {
+        block = findHeadInEytzinger(layout, givenKey, upper, &headCmpResult, comparedKeyNum, countCompare, compare);
+    }
+    *matching = block < layout->blockNum && headCmpResult == 0;
+    if (block == 0) {
+        return 0;
+    }
+
+    // decode the block before, after its head
+    block --;
+    char* head = layout->blocks + layout->blockStarts[block];
+    char* pos = head + strlen(head) + 1;
+    size_t first = block * FRONT_CODING_BLOCK_SIZE;
+    size_t last = first + FRONT_CODING_BLOCK_SIZE < layout->num ? first + FRONT_CODING_BLOCK_SIZE : layout->num;
+    for (size_t i = first + 1; i < last; i++) {
+        size_t sharedLen = (unsigned char) *(pos ++);
+        size_t restLen = strlen(pos);
+        memcpy(keyBuffer, head, sharedLen);
+        memcpy(keyBuffer + sharedLen, pos, restLen + 1);
+        pos += restLen + 1;
+        int cmpResult = compareAndCount(givenKey, keyBuffer, comparedKeyNum, countCompare, compare);
+        if (upper ? cmpResult < 0 : cmpResult <= 0) {
+            *matching = cmpResult == 0;
+            return i;
+        }
+    }
+    return last;
+}
 
-    sDict->sArray[(sDict->num)] = newItem;
-    (sDict->num) ++;
 
-    // swap 
-    for (int i = insertIndex; i < sDict->num; i++) {
-        SDictItem* tmp = sDict->sArray[i];
-        sDict->sArray[i] = sDict->sArray[sDict->num - 1];
-        sDict->sArray[sDict->num - 1] = tmp;        
+// Search the read layout: the matches lie between the two bounds of the given key
+static void** findInReadLayout(SDictReadLayout* layout, void* givenKey, int* matchedNum, int* comparedKeyNum, 
+                               int* countCompare, int (*compare)(void*, void*, int*)) {
+    char* keyBuffer = (char*) malloc(layout->maxKeyLen + 1);
+    assert(keyBuffer);
+    BOOL matching = FALSE;
+    size_t first = findBound(layout, givenKey, FALSE, &matching, keyBuffer, comparedKeyNum, countCompare, compare);
+    size_t last = first;
+    // nothing matches unless the given key is a prefix of the lower bound
+    if (matching) {
+        last = findBound(layout, givenKey, TRUE, &matching, keyBuffer, comparedKeyNum, countCompare, compare);
     }
+    free(keyBuffer);
+
+    *matchedNum = (int) (last - first);
+    void** matched = (void**) malloc((*matchedNum > MATCHED_LIST_SIZE ? *matchedNum : MATCHED_LIST_SIZE) * sizeof(void*));
+    assert(matched);
+    memcpy(matched, layout->sortedData + first, *matchedNum * sizeof(void*));
+    return matched;
 }
 
 
@@ -150,84 +837,76 @@ void** findAndTraverseSDict(SDictionary* sDict, void* givenKey, int* matchedNum,
                             int* countCompare, int (*compare)(void*, void*, int*)) {
     
     *matchedNum = 0;
+    (*comparedKeyNum) = 0;
+    (*countCompare) = 0;
+    if (sDict->readLayout != NULL) {
+        return findInReadLayout(sDict->readLayout, givenKey, matchedNum, comparedKeyNum, countCompare, compare);
+    }
+
     int matchedListSize = MATCHED_LIST_SIZE;
     void** matched = (void**) malloc(matchedListSize * sizeof(void*));
     assert(matched);
 
-    int left = 0, right = sDict->num - 1;
-    int mid;
-
-    (*comparedKeyNum) = 0;
-    (*countCompare) = 0;
+    // go down to the leaf where keys stop being smaller than the given one (keys it is a prefix of
+    // count as equal), keys equal to a separator may start in the child before it
+    void* node = sDict->root;
+    for (int level = sDict->height; level > 0; level--) {
+        SDictInner* inner = (SDictInner*) node;
+        int left = 0, right = inner->childNum - 1;
+        while (left < right) {
+            int tmpCount = 0;
+            int mid = (left + right) / 2;
+            int cmpResult = compare(givenKey, inner->keys[mid], &tmpCount);
+            (*comparedKeyNum) ++;
+            (*countCompare) += tmpCount;
+            if (cmpResult > 0) {
+                left = mid + 1;
+            } else {
+                right = mid;
+            }
+        }
+        node = inner->children[left];
+    }
 
-    // binary search
-    while (left <= right) {
+    // first key of the leaf that isn't smaller
+    SDictLeaf* leaf = (SDictLeaf*) node;
+    int left = 0, right = leaf->keyNum;
+    while (left < right) {
         int tmpCount = 0;
-        mid = (left + right) / 2;
-        void* midKey = (sDict->sArray[mid])->key;
-        int cmpResult = compare(givenKey, midKey, &tmpCount);
+        int mid = (left + right) / 2;
+        int cmpResult = compare(givenKey, leaf->keys[mid], &tmpCount);
         (*comparedKeyNum) ++;
         (*countCompare) += tmpCount;
-
         if (cmpResult > 0) {
             left = mid + 1;
-        } else if (cmpResult < 0) {
-            right = mid - 1;
         } else {
-            (*matchedNum) ++;
-            break;
+            right = mid;
         }
     }
 
-    // nothing was matched
-    if (*matchedNum == 0) {
-        return matched;
-    }
-
-    // traverse left
-    int matchStartIndex = mid; // inclusive
-    for (int i = mid - 1; i >= 0; i--) {
-        int tmpCount = 0;
-        void* tmpKey = (sDict->sArray[i])->key;
-        int cmpResult = compare(givenKey, tmpKey, &tmpCount);
-        (*comparedKeyNum) ++;
-        (*countCompare) += tmpCount;
-
-        if (cmpResult != 0) {
-            break;
-        } else {
-            (*matchedNum) ++;
-            matchStartIndex = i;
+    // traverse right, along the leaves
+    int idx = left;
+    while (leaf != NULL) {
+        if (idx == leaf->keyNum) {
+            leaf = leaf->next;
+            idx = 0;
+            continue;
         }
-    }
-
-    // traverse right
-    for (int i = mid + 1; i < sDict->num; i++) {
         int tmpCount = 0;
-        void* tmpKey = (sDict->sArray[i])->key;
-        int cmpResult = compare(givenKey, tmpKey, &tmpCount);
+        int cmpResult = compare(givenKey, leaf->keys[idx], &tmpCount);
         (*comparedKeyNum) ++;
         (*countCompare) += tmpCount;
-
         if (cmpResult != 0) {
             break;
-        } else {
-            (*matchedNum) ++;
         }
-    }
-
-    // ensure the size of matchedList
-    if (*matchedNum > matchedListSize) {
-        matchedListSize = *matchedNum;
-        matched = (void**) realloc(matched, matchedListSize * sizeof(void*));
-        assert(matched);
-    }
-
-    // collect matched records
-    int matchEndIndex = matchStartIndex + *matchedNum; // exclusive
-    for (int i = matchStartIndex; i < matchEndIndex; i++) {
-        SDictItem* item = (sDict->sArray)[i];
-        matched[i - matchStartIndex] = item->data;
+        // ensure the size of matchedList
+        if (*matchedNum == matchedListSize) {
+            matchedListSize *= 2;
+            matched = (void**) realloc(matched, matchedListSize * sizeof(void*));
+            assert(matched);
+        }
+        matched[(*matchedNum) ++] = leaf->data[idx];
+        idx ++;
     }
 
     return matched;
@@ -242,13 +921,18 @@ void** findAndTraverseSDict(SDictionary* sDict, void* givenKey, int* matchedNum,
  * @param fFreeData 
  */
 void freeSDict(SDictionary* sDict, void (*fFreeKey)(void*), void (*fFreeData)(void*)) {
-    for (int i = 0; i < sDict->num; i++) {
-        SDictItem* tmp = (sDict->sArray)[i];
-        fFreeKey(tmp->key);
-        fFreeData(tmp->data);
-        free(tmp);
+    for (SDictLeaf* leaf = sDict->firstLeaf; leaf != NULL; leaf = leaf->next) {
+        for (int i = 0; i < leaf->keyNum; i++) {
+            fFreeKey(leaf->keys[i]);
+            fFreeData(leaf->data[i]);
+        }
+    }
+    for (size_t i = 0; i < sDict->appendedNum; i++) {
+        fFreeKey(sDict->appended[i].key);
+        fFreeData(sDict->appended[i].data);
     }
-    free(sDict->sArray);
+    free(sDict->appended);
+    freeNodes(sDict->root, sDict->height);
+    freeReadLayout(sDict);
     free(sDict);
 }
-
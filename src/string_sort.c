@@ -0,0 +1,214 @@
+/**
+ * @brief  Parallel string sort implementation
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "string_sort.h"
+
+#define BYTE_NUM 256
+// Buckets of at most this many items are sorted by insertion sort
+#define INSERTION_SORT_MAX_NUM 32
+// Buckets of more items are handed over to the pool, smaller ones are sorted by the same task
+#define SPAWN_MIN_NUM 4096
+// Arrays of at least this many items have their first distribution split across the workers
+#define PARALLEL_PASS_MIN_NUM 65536
+
+// Items from depth on, all sharing their first depth bytes. If fromTemp is set, they are still
+// in temp and are moved to items first.
+typedef struct SortTaskStruct SortTask;
+struct SortTaskStruct {
+    StringSortItem* items;
+    StringSortItem* temp;   // as many items, to distribute into
+    size_t num;
+    size_t depth;
+    int fromTemp;
+};
+
+// Part of the first distribution, over a chunk of the items
+typedef struct ChunkTaskStruct ChunkTask;
+struct ChunkTaskStruct {
+    StringSortItem* items;
+    StringSortItem* temp;
+    size_t first;
+    size_t num;
+    size_t counts[BYTE_NUM];
+    size_t offsets[BYTE_NUM];   // where the chunk's items of each byte go in temp
+};
+
+
+static SortTask* newSortTask(StringSortItem* items, StringSortItem* temp, size_t num, size_t depth, int fromTemp) {
+    SortTask* task = (SortTask*) malloc(sizeof(SortTask));
+    assert(task);
+    task->items = items;
+    task->temp = temp;
+    task->num = num;
+    task->depth = depth;
+    task->fromTemp = fromTemp;
+    return task;
+}
+
+
+static void insertionSort(StringSortItem* items, size_t num, size_t depth) {
+    for (size_t i = 1; i < num; i++) {
+        StringSortItem item = items[i];
+        size_t j = i;
+        // strictly greater, so equal keys keep their order
+        while (j > 0 && strcmp(items[j - 1].key + depth, item.key + depth) > 0) {
+            items[j] = items[j - 1];
+            j --;
+        }
+        items[j] = item;
+    }
+}
+
+
+static void sortTask(WorkPool* pool, int workerIdx, void* arg, void* context) {
+    SortTask* task = (SortTask*) arg;
+    StringSortItem* items = task->items;
+    StringSortItem* temp = task->temp;
+    size_t num = task->num;
+    size_t depth = task->depth;
+    if (task->fromTemp) {
+        memcpy(items, temp, num * sizeof(StringSortItem));
+    }
+    free(task);
+
+    size_t counts[BYTE_NUM];
+    while (num > INSERTION_SORT_MAX_NUM) {
+        memset(counts, 0, sizeof(counts));
+        for (size_t i = 0; i < num; i++) {
+            counts[(unsigned char) items[i].key[depth]] ++;
+        }
+        unsigned char onlyByte = (unsigned char) items[0].key[depth];
+        if (counts[onlyByte] == num) {
+            // the same byte for all, nothing to move
+            if (onlyByte == '\0') {
+                return;
+            }
+            depth ++;
+            continue;
+        }
+
+        size_t offsets[BYTE_NUM];
+        size_t offset = 0;
+        for (int b = 0; b < BYTE_NUM; b++) {
+            offsets[b] = offset;
+            offset += counts[b];
+        }
+        for (size_t i = 0; i < num; i++) {
+            temp[offsets[(unsigned char) items[i].key[depth]] ++] = items[i];
+        }
+        memcpy(items, temp, num * sizeof(StringSortItem));
+
+        // keys of bucket 0 have ended, they are equal and already in order
+        offset = counts[0];
+        for (int b = 1; b < BYTE_NUM; b++) {
+            if (counts[b] > 1) {
+                SortTask* bucket = newSortTask(items + offset, temp + offset, counts[b], depth + 1, 0);
+                if (counts[b] >= SPAWN_MIN_NUM) {
+                    workPoolSpawn(pool, workerIdx, bucket);
+                } else {
+                    sortTask(pool, workerIdx, bucket, context);
+                }
+            }
+            offset += counts[b];
+        }
+        return;
+    }
+    insertionSort(items, num, depth);
+}
+
+
+static void countChunkTask(WorkPool* pool, int workerIdx, void* arg, void* context) {
+    ChunkTask* chunk = (ChunkTask*) arg;
+    memset(chunk->counts, 0, sizeof(chunk->counts));
+    for (size_t i = chunk->first; i < chunk->first + chunk->num; i++) {
+        chunk->counts[(unsigned char) chunk->items[i].key[0]] ++;
+    }
+}
+
+
+static void scatterChunkTask(WorkPool* pool, int workerIdx, void* arg, void* context) {
+    ChunkTask* chunk = (ChunkTask*) arg;
+    for (size_t i = chunk->first; i < chunk->first + chunk->num; i++) {
+        chunk->temp[chunk->offsets[(unsigned char) chunk->items[i].key[0]] ++] = chunk->items[i];
+    }
+}
+
+
+// Distribute the items by their first byte into temp, one chunk per worker, keeping the order of
+// the chunks within a bucket. Returns the number of items of each byte.
+static void distributeInParallel(WorkPool* pool, StringSortItem* items, StringSortItem* temp, size_t num,
+                                 size_t* counts) {
+    int chunkNum = getWorkPoolThreadNum(pool);
+    ChunkTask* chunks = (ChunkTask*) malloc(chunkNum * sizeof(ChunkTask));
+    assert(chunks);
+    void** tasks = (void**) malloc(chunkNum * sizeof(void*));
+    assert(tasks);
+    for (int c = 0; c < chunkNum; c++) {
+        chunks[c].items = items;
+        chunks[c].temp = temp;
+        chunks[c].first = num * c / chunkNum;
+        chunks[c].num = num * (c + 1) / chunkNum - chunks[c].first;
+        tasks[c] = &chunks[c];
+    }
+    workPoolRun(pool, tasks, chunkNum, countChunkTask, NULL);
+
+    size_t offset = 0;
+    for (int b = 0; b < BYTE_NUM; b++) {
+        counts[b] = 0;
+        for (int c = 0; c < chunkNum; c++) {
+            chunks[c].offsets[b] = offset;
+            offset += chunks[c].counts[b];
+            counts[b] += chunks[c].counts[b];
+        }
+    }
+    workPoolRun(pool, tasks, chunkNum, scatterChunkTask, NULL);
+    free(tasks);
+    free(chunks);
+}
+
+
+/**
+ * @brief  Sort items by key
+ * @param  pool: workers to sort with, can have only one
+ * @param  items:
+ * @param  num:
+ */
+void parallelStringSort(WorkPool* pool, StringSortItem* items, size_t num) {
+    if (num < 2) {
+        return;
+    }
+    StringSortItem* temp = (StringSortItem*) malloc(num * sizeof(StringSortItem));
+    assert(temp);
+
+    if (getWorkPoolThreadNum(pool) == 1 || num < PARALLEL_PASS_MIN_NUM) {
+        void* task = newSortTask(items, temp, num, 0, 0);
+        workPoolRun(pool, &task, 1, sortTask, NULL);
+        free(temp);
+        return;
+    }
+
+    size_t counts[BYTE_NUM];
+    distributeInParallel(pool, items, temp, num, counts);
+    // empty keys are done, every other bucket moves itself back from temp and is sorted from the
+    // second byte on
+    memcpy(items, temp, counts[0] * sizeof(StringSortItem));
+    void** tasks = (void**) malloc(BYTE_NUM * sizeof(void*));
+    assert(tasks);
+    int taskNum = 0;
+    size_t offset = counts[0];
+    for (int b = 1; b < BYTE_NUM; b++) {
+        if (counts[b] != 0) {
+            tasks[taskNum ++] = newSortTask(items + offset, temp + offset, counts[b], 1, 1);
+        }
+        offset += counts[b];
+    }
+    workPoolRun(pool, tasks, taskNum, sortTask, NULL);
+    free(tasks);
+    free(temp);
+}
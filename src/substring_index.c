@@ -0,0 +1,343 @@
+/**
+ * @brief  Substring index implementation
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include "substring_index.h"
+#include "key_normalise.h"
+
+// Grams of 1 to MAX_GRAM_LEN bytes are indexed.
+#define MAX_GRAM_LEN 3
+
+#define INITIAL_TABLE_SIZE 1024     // must be a power of 2
+#define MAX_LOAD_PERCENT 70
+#define INITIAL_POSTING_SIZE 2
+#define INITIAL_KEY_LIST_SIZE 16
+
+// Gram codes are smaller than 2^26, so this never clashes with a real gram.
+#define EMPTY_GRAM 0xFFFFFFFFu
+
+// A list much longer than the candidates is probed by binary search instead of being merged.
+#define GALLOP_RATIO 8
+
+typedef unsigned char BYTE;
+
+// Ids of the keys that contain a gram, in ascending order.
+typedef struct PostingList Posting;
+struct PostingList {
+    uint32_t* ids;
+    uint32_t num;
+    uint32_t size;
+};
+
+struct NGramIndex {
+    BOOL folded;
+    char** keys;
+    void** values;          // value added with each key, returned by searches
+    size_t keyNum;
+    size_t keyListSize;
+    uint32_t* grams;        // gram code in each slot of the hash table, EMPTY_GRAM if unused
+    Posting* postings;      // posting list in each slot of the hash table
+    size_t tableSize;
+    size_t gramNum;
+};
+
+
+/**
+ * @brief  Create a substring index
+ * @param  folded: TRUE if keys and patterns should be matched case- and accent-insensitively
+ */
+SubstringIndex* createSubstringIndex(BOOL folded) {
+    SubstringIndex* index = (SubstringIndex*) malloc(sizeof(SubstringIndex));
+    assert(index);
+    index->folded = folded;
+    index->keyListSize = INITIAL_KEY_LIST_SIZE;
+    index->keyNum = 0;
+    index->keys = (char**) malloc(index->keyListSize * sizeof(char*));
+    assert(index->keys);
+    index->values = (void**) malloc(index->keyListSize * sizeof(void*));
+    assert(index->values);
+    index->tableSize = INITIAL_TABLE_SIZE;
+    index->gramNum = 0;
+    index->grams = (uint32_t*) malloc(index->tableSize * sizeof(uint32_t));
+    assert(index->grams);
+    memset(index->grams, 0xFF, index->tableSize * sizeof(uint32_t));
+    index->postings = (Posting*) calloc(index->tableSize, sizeof(Posting));
+    assert(index->postings);
+    return index;
+}
+
+
+// Get the byte at a position of a key of strLen bytes, folded (within the whole key) if the index is folded.
+static inline BYTE gramByte(SubstringIndex* index, const char* str, size_t strLen, size_t i) {
+    return index->folded ? normaliseByteAt(str, strLen, i) : (BYTE) str[i];
+}
+
+
+// Pack a gram of len bytes starting at str[start] into a code: |len|byte0|byte1|byte2|
+static uint32_t gramCode(SubstringIndex* index, const char* str, size_t strLen, size_t start, size_t len) {
+    uint32_t code = len;
+    for (size_t i = 0; i < MAX_GRAM_LEN; i++) {
+        code = (code << 8) | (i < len ? gramByte(index, str, strLen, start + i) : 0);
+    }
+    return code;
+}
+
+
+// Find the slot of a gram, or the empty slot where it should be put (linear probing).
+static size_t findSlot(uint32_t* grams, size_t tableSize, uint32_t code) {
+    size_t slot = (size_t) ((code * 0x9E3779B97F4A7C15ULL) >> 32) & (tableSize - 1);
+    while (grams[slot] != code && grams[slot] != EMPTY_GRAM) {
+        slot = (slot + 1) & (tableSize - 1);
+    }
+    return slot;
+}
+
+
+// Double the size of the hash table.
+static void growTable(SubstringIndex* index) {
+    size_t newSize = index->tableSize * 2;
+    uint32_t* grams = (uint32_t*) malloc(newSize * sizeof(uint32_t));
+    assert(grams);
+    memset(grams, 0xFF, newSize * sizeof(uint32_t));
+    Posting* postings = (Posting*) calloc(newSize, sizeof(Posting));
+    assert(postings);
+    for (size_t i = 0; i < index->tableSize; i++) {
+        if (index->grams[i] != EMPTY_GRAM) {
+            size_t slot = findSlot(grams, newSize, index->grams[i]);
+            grams[slot] = index->grams[i];
+            postings[slot] = index->postings[i];
+        }
+    }
+    free(index->grams);
+    free(index->postings);
+    index->grams = grams;
+    index->postings = postings;
+    index->tableSize = newSize;
+}
+
+
+// Add a key id to the posting list of a gram, unless the key is already the last one in it.
+static void addPosting(SubstringIndex* index, uint32_t code, uint32_t id) {
+    if ((index->gramNum + 1) * 100 > index->tableSize * MAX_LOAD_PERCENT) {
+        growTable(index);
+    }
+    size_t slot = findSlot(index->grams, index->tableSize, code);
+    Posting* posting = &index->postings[slot];
+    if (index->grams[slot] == EMPTY_GRAM) {
+        index->grams[slot] = code;
+        index->gramNum ++;
+        posting->size = INITIAL_POSTING_SIZE;
+        posting->num = 0;
+        posting->ids = (uint32_t*) malloc(posting->size * sizeof(uint32_t));
+        assert(posting->ids);
+    }
+    if (posting->num != 0 && posting->ids[posting->num - 1] == id) {
+        return;
+    }
+    if (posting->num == posting->size) {
+        posting->size *= 2;
+        posting->ids = (uint32_t*) realloc(posting->ids, posting->size * sizeof(uint32_t));
+        assert(posting->ids);
+    }
+    posting->ids[posting->num ++] = id;
+}
+
+
+/**
+ * @brief  Add a key to the index. The key is not copied, it must stay valid until the index is freed.
+ * @param  value: returned by searches when the key matches
+ * @note   Each key should only be added once.
+ */
+void substringIndexAdd(SubstringIndex* index, char* key, void* value) {
+    if (index->keyNum == index->keyListSize) {
+        index->keyListSize *= 2;
+        index->keys = (char**) realloc(index->keys, index->keyListSize * sizeof(char*));
+        assert(index->keys);
+        index->values = (void**) realloc(index->values, index->keyListSize * sizeof(void*));
+        assert(index->values);
+    }
+    uint32_t id = index->keyNum;
+    index->keys[id] = key;
+    index->values[id] = value;
+    index->keyNum ++;
+
+    size_t keyLen = strlen(key);
+    for (size_t i = 0; i < keyLen; i++) {
+        for (size_t len = 1; len <= MAX_GRAM_LEN && i + len <= keyLen; len++) {
+            addPosting(index, gramCode(index, key, keyLen, i, len), id);
+        }
+    }
+}
+
+
+// Get the posting list of a gram, NULL if no key contains it.
+static Posting* getPosting(SubstringIndex* index, uint32_t code) {
+    size_t slot = findSlot(index->grams, index->tableSize, code);
+    if (index->grams[slot] == EMPTY_GRAM) {
+        return NULL;
+    }
+    return &index->postings[slot];
+}
+
+
+// Keep the candidates that also appear in the posting list, return the number of candidates left.
+static size_t intersect(uint32_t* candidates, size_t candidateNum, Posting* posting) {
+    size_t kept = 0;
+    if (posting->num > candidateNum * GALLOP_RATIO) {
+        size_t low = 0;
+        for (size_t i = 0; i < candidateNum; i++) {
+            size_t high = posting->num;
+            while (low < high) {
+                size_t mid = (low + high) / 2;
+                if (posting->ids[mid] < candidates[i]) {
+                    low = mid + 1;
+                } else {
+                    high = mid;
+                }
+            }
+            if (low < posting->num && posting->ids[low] == candidates[i]) {
+                candidates[kept ++] = candidates[i];
+            }
+        }
+    } else {
+        size_t j = 0;
+        for (size_t i = 0; i < candidateNum && j < posting->num; i++) {
+            while (j < posting->num && posting->ids[j] < candidates[i]) {
+                j ++;
+            }
+            if (j < posting->num && posting->ids[j] == candidates[i]) {
+                candidates[kept ++] = candidates[i];
+            }
+        }
+    }
+    return kept;
+}
+
+
+// Check if a key contains the pattern, folding both if the index is folded.
+static BOOL containsPattern(SubstringIndex* index, char* key, char* pattern, size_t patternLen) {
+    if (!index->folded) {
+        return strstr(key, pattern) != NULL;
+    }
+    size_t keyLen = strlen(key);
+    for (size_t start = 0; start + patternLen <= keyLen; start++) {
+        size_t i = 0;
+        while (i < patternLen && gramByte(index, key, keyLen, start + i) == gramByte(index, pattern, patternLen, i)) {
+            i ++;
+        }
+        if (i == patternLen) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+
+/**
+ * @brief  Find all keys that contain the pattern.
+ *         The posting lists of all grams of the pattern are intersected, starting with the shortest one.
+ *         Patterns longer than a gram are then checked against each candidate key.
+ * @param  index:
+ * @param  pattern:
+ * @param  matchedNum: number of matched keys
+ * @param  comparedStr: number of candidate keys that have been checked
+ * @retval The values of the matched keys, in the order they were added
+ */
+void** substringSearch(SubstringIndex* index, char* pattern, int* matchedNum, int* comparedStr) {
+    *matchedNum = 0;
+    *comparedStr = 0;
+    size_t patternLen = strlen(pattern);
+
+    if (patternLen == 0) {
+        // every key contains an empty pattern
+        void** matched = (void**) malloc((index->keyNum + 1) * sizeof(void*));
+        assert(matched);
+        memcpy(matched, index->values, index->keyNum * sizeof(void*));
+        *matchedNum = index->keyNum;
+        return matched;
+    }
+
+    size_t gramLen = patternLen < MAX_GRAM_LEN ? patternLen : MAX_GRAM_LEN;
+    size_t gramNum = patternLen - gramLen + 1;
+    Posting** postings = (Posting**) malloc(gramNum * sizeof(Posting*));
+    assert(postings);
+    Posting* shortest = NULL;
+    for (size_t i = 0; i < gramNum; i++) {
+        postings[i] = getPosting(index, gramCode(index, pattern, patternLen, i, gramLen));
+        if (postings[i] == NULL) {
+            // no key contains this gram
+            free(postings);
+            void** matched = (void**) malloc(sizeof(void*));
+            assert(matched);
+            return matched;
+        }
+        if (shortest == NULL || postings[i]->num < shortest->num) {
+            shortest = postings[i];
+        }
+    }
+
+    uint32_t* candidates = (uint32_t*) malloc(shortest->num * sizeof(uint32_t));
+    assert(candidates);
+    memcpy(candidates, shortest->ids, shortest->num * sizeof(uint32_t));
+    size_t candidateNum = shortest->num;
+    // the matches are some of the candidates
+    void** matched = (void**) malloc((candidateNum + 1) * sizeof(void*));
+    assert(matched);
+    for (size_t i = 0; i < gramNum && candidateNum != 0; i++) {
+        if (postings[i] != shortest) {
+            candidateNum = intersect(candidates, candidateNum, postings[i]);
+        }
+    }
+
+    for (size_t i = 0; i < candidateNum; i++) {
+        if (patternLen > MAX_GRAM_LEN) {
+            // sharing all the grams doesn't mean the grams are next to each other
+            (*comparedStr) ++;
+            if (!containsPattern(index, index->keys[candidates[i]], pattern, patternLen)) {
+                continue;
+            }
+        }
+        matched[(*matchedNum) ++] = index->values[candidates[i]];
+    }
+
+    free(candidates);
+    free(postings);
+    return matched;
+}
+
+
+/**
+ * @brief  Get the number of bytes used by the index (keys themselves are not counted)
+ */
+size_t getSubstringIndexMemory(SubstringIndex* index) {
+    size_t bytes = sizeof(SubstringIndex);
+    bytes += index->keyListSize * (sizeof(char*) + sizeof(void*));
+    bytes += index->tableSize * (sizeof(uint32_t) + sizeof(Posting));
+    for (size_t i = 0; i < index->tableSize; i++) {
+        bytes += index->postings[i].size * sizeof(uint32_t);
+    }
+    return bytes;
+}
+
+
+/**
+ * @brief  Free the index, keys are not freed.
+ */
+void freeSubstringIndex(SubstringIndex* index) {
+    for (size_t i = 0; i < index->tableSize; i++) {
+        if (index->grams[i] != EMPTY_GRAM) {
+            free(index->postings[i].ids);
+        }
+    }
+    free(index->grams);
+    free(index->postings);
+    free(index->keys);
+    free(index->values);
+    free(index);
+}
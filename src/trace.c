@@ -0,0 +1,212 @@
+/**
+ * @brief  Tracing implementation
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "trace.h"
+
+// Number of events in each ring buffer, must be a power of 2.
+#define TRACE_RING_SIZE 4096
+
+#define NS_PER_SEC 1000000000ULL
+
+// One event fills one 64-byte cache line.
+typedef struct TraceEventRecord TraceEvent;
+struct TraceEventRecord {
+    uint64_t timestamp;
+    uint64_t arg0;
+    uint64_t arg1;
+    uint16_t id;
+    char text[TRACE_TEXT_LEN];
+};
+
+// Single producer (the owning thread), single consumer (traceFlush).
+typedef struct TraceRingBuffer TraceRing;
+struct TraceRingBuffer {
+    TraceEvent events[TRACE_RING_SIZE];
+    uint64_t head;          // next slot to write, only written by the owner
+    uint64_t tail;          // next slot to read, only written by the consumer
+    uint64_t dropped;       // added to by the owner, taken by the consumer
+    int threadNum;
+    TraceRing* next;
+};
+
+// Names used when events are formatted.
+typedef struct TraceEventInfo TraceInfo;
+struct TraceEventInfo {
+    const char* name;
+    const char* arg0Name;
+    const char* arg1Name;
+};
+
+static const TraceInfo eventInfo[TRACE_EV_NUM] = {
+    [TRACE_EV_RDICT_INSERT]     = {"rdict.insert",      "keyLen",   "comparedBit"},
+    [TRACE_EV_RDICT_SEARCH]     = {"rdict.search",      "keys",     "records"},
+    [TRACE_EV_REQUEST]          = {"request",           "payload",  NULL},
+    [TRACE_EV_REQUEST_UNKNOWN]  = {"request.unknown",   NULL,       NULL},
+    [TRACE_EV_POLL]             = {"server.poll",       "clients",  "events"},
+    [TRACE_EV_ACCEPT]           = {"server.accept",     "socket",   NULL},
+    [TRACE_EV_RECV]             = {"server.recv",       "socket",   "bytes"},
+    [TRACE_EV_RECV_ERROR]       = {"server.recv_error", "socket",   "errno"},
+    [TRACE_EV_MESSAGE]          = {"server.message",    "socket",   "bytes"},
+    [TRACE_EV_PARSE_ERROR]      = {"server.parse_error","socket",   "bytes"},
+    [TRACE_EV_RESPONSE]         = {"server.response",   "socket",   "bytes"},
+};
+
+int traceRuntimeLevel = TRACE_LEVEL_OFF;
+
+static __thread TraceRing* threadRing = NULL;
+static TraceRing* allRings = NULL;
+static int ringNum = 0;
+static pthread_mutex_t ringsLock = PTHREAD_MUTEX_INITIALIZER;
+
+// Reference points used to convert timestamps to nanoseconds.
+static uint64_t startTicks = 0;
+static uint64_t startNs = 0;
+
+
+static uint64_t monotonicNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+}
+
+
+// Read the cheapest clock available: the time stamp counter on x86, otherwise the monotonic clock.
+static inline uint64_t readTicks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return monotonicNs();
+#endif
+}
+
+
+/**
+ * @brief Set the runtime level from the environment variable {TRACE_ENV_LEVEL}.
+ *        Tracing is off if the variable is not set.
+ */
+void traceInit() {
+    char* level = getenv(TRACE_ENV_LEVEL);
+    traceSetLevel(level == NULL ? TRACE_LEVEL_OFF : atoi(level));
+}
+
+
+/**
+ * @brief Set the runtime level.
+ *
+ * @param level
+ */
+void traceSetLevel(int level) {
+    if (startNs == 0) {
+        startTicks = readTicks();
+        startNs = monotonicNs();
+    }
+    traceRuntimeLevel = level;
+}
+
+
+// Create the ring buffer of the calling thread and register it for flushing.
+static TraceRing* newThreadRing() {
+    TraceRing* ring = (TraceRing*) calloc(1, sizeof(TraceRing));
+    assert(ring);
+    pthread_mutex_lock(&ringsLock);
+    ring->threadNum = ringNum ++;
+    ring->next = allRings;
+    allRings = ring;
+    pthread_mutex_unlock(&ringsLock);
+    return ring;
+}
+
+
+/**
+ * @brief Write a binary event into the ring buffer of the calling thread.
+ *        If the ring buffer is full, the event is dropped and counted.
+ *        Use the TRACE macro instead of calling this directly.
+ *
+ * @param id
+ * @param arg0
+ * @param arg1
+ * @param text
+ */
+void traceRecord(TraceEventId id, uint64_t arg0, uint64_t arg1, const char* text) {
+    TraceRing* ring = threadRing;
+    if (ring == NULL) {
+        ring = threadRing = newThreadRing();
+    }
+    uint64_t head = ring->head;
+    if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == TRACE_RING_SIZE) {
+        __atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    TraceEvent* event = &ring->events[head & (TRACE_RING_SIZE - 1)];
+    event->timestamp = readTicks();
+    event->arg0 = arg0;
+    event->arg1 = arg1;
+    event->id = (uint16_t) id;
+    if (text != NULL) {
+        size_t len = strnlen(text, TRACE_TEXT_LEN - 1);
+        memcpy(event->text, text, len);
+        event->text[len] = '\0';
+    } else {
+        event->text[0] = '\0';
+    }
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+
+// Write one event in a readable form.
+static void printEvent(FILE* f, TraceEvent* event, int threadNum, double nsPerTick) {
+    const TraceInfo* info = &eventInfo[event->id];
+    double ns = (double) (event->timestamp - startTicks) * nsPerTick;
+    fprintf(f, "[%12.3f us] [t%d] %s", ns / 1000, threadNum, info->name);
+    if (info->arg0Name != NULL) {
+        fprintf(f, " %s=%llu", info->arg0Name, (unsigned long long) event->arg0);
+    }
+    if (info->arg1Name != NULL) {
+        fprintf(f, " %s=%llu", info->arg1Name, (unsigned long long) event->arg1);
+    }
+    if (event->text[0] != '\0') {
+        fprintf(f, " \"%s\"", event->text);
+    }
+    fprintf(f, "\n");
+}
+
+
+/**
+ * @brief Format all buffered events of all threads and write them to a file,
+ *        then empty the buffers. Call this off the hot path.
+ *
+ * @param f output file
+ * @return number of events written
+ */
+size_t traceFlush(FILE* f) {
+    size_t written = 0;
+    uint64_t ticks = readTicks() - startTicks;
+    double nsPerTick = (ticks == 0) ? 1.0 : (double) (monotonicNs() - startNs) / ticks;
+
+    pthread_mutex_lock(&ringsLock);
+    for (TraceRing* ring = allRings; ring != NULL; ring = ring->next) {
+        uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        uint64_t tail = ring->tail;
+        for (; tail != head; tail++) {
+            printEvent(f, &ring->events[tail & (TRACE_RING_SIZE - 1)], ring->threadNum, nsPerTick);
+            written ++;
+        }
+        __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+        uint64_t dropped = __atomic_exchange_n(&ring->dropped, 0, __ATOMIC_RELAXED);
+        if (dropped != 0) {
+            fprintf(f, "[t%d] %llu events dropped\n", ring->threadNum, (unsigned long long) dropped);
+        }
+    }
+    pthread_mutex_unlock(&ringsLock);
+    fflush(f);
+    return written;
+}
@@ -14,7 +14,8 @@
  * @brief  Round up int division
  */
 size_t ceiling(size_t dividend, size_t divisor) {
-    return ((dividend - 1) / divisor) + 1;
+    // dividend - 1 would wrap around for 0, e.g. a common prefix of 0 bits when keys differ in their first bit
+    return dividend == 0 ? 0 : ((dividend - 1) / divisor) + 1;
 }
 
 
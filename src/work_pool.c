@@ -0,0 +1,264 @@
+/**
+ * @brief  Work-stealing thread pool implementation
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "work_pool.h"
+#include "my_bool.h"
+
+#define INITIAL_DEQUE_SIZE 64
+
+// Tasks of one worker. The owner pushes and pops at the tail, thieves take from the head.
+typedef struct WorkDequeStruct WorkDeque;
+struct WorkDequeStruct {
+    pthread_mutex_t lock;
+    void** tasks;
+    size_t size;
+    size_t head;            // oldest task
+    size_t tail;            // one past the newest task
+    size_t queuedNum;       // tail - head, also read without the lock by getWorkPoolQueuedNum
+};
+
+typedef struct WorkerArgStruct WorkerArg;
+struct WorkerArgStruct {
+    WorkPool* pool;
+    int workerIdx;
+};
+
+struct WorkStealingPool {
+    int threadNum;
+    pthread_t* threads;             // workers 1 to threadNum - 1, worker 0 is the caller of workPoolRun
+    WorkerArg* args;
+    WorkDeque* deques;
+    pthread_mutex_t runLock;        // held for a whole run, so runs take turns
+    pthread_mutex_t lock;           // guards the fields below
+    pthread_cond_t runStarted;
+    pthread_cond_t runFinished;
+    unsigned long runId;            // bumped by each run, threads join a run when it changes
+    int activeNum;                  // threads that haven't left the current run yet
+    BOOL stopping;
+    WorkFunction fWork;
+    void* context;
+    size_t pendingNum;              // tasks queued or running in the current run, updated atomically
+};
+
+
+static void pushTask(WorkDeque* deque, void* task) {
+    pthread_mutex_lock(&deque->lock);
+    if (deque->tail == deque->size) {
+        // move the tasks to the front first, grow only if the deque is really full
+        size_t num = deque->tail - deque->head;
+        memmove(deque->tasks, deque->tasks + deque->head, num * sizeof(void*));
+        deque->head = 0;
+        deque->tail = num;
+        if (num * 2 > deque->size) {
+            deque->size *= 2;
+            deque->tasks = (void**) realloc(deque->tasks, deque->size * sizeof(void*));
+            assert(deque->tasks);
+        }
+    }
+    deque->tasks[deque->tail ++] = task;
+    __atomic_store_n(&deque->queuedNum, deque->tail - deque->head, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&deque->lock);
+}
+
+
+// Take the newest task if the owner asks, the oldest one if a thief does. NULL if there is none.
+static void* takeTask(WorkDeque* deque, BOOL isOwner) {
+    void* task = NULL;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->head < deque->tail) {
+        task = isOwner ? deque->tasks[-- deque->tail] : deque->tasks[deque->head ++];
+        if (deque->head == deque->tail) {
+            deque->head = deque->tail = 0;
+        }
+        __atomic_store_n(&deque->queuedNum, deque->tail - deque->head, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return task;
+}
+
+
+// Work on the current run until every task is done.
+static void runWorker(WorkPool* pool, int workerIdx) {
+    while (__atomic_load_n(&pool->pendingNum, __ATOMIC_ACQUIRE) != 0) {
+        void* task = takeTask(&pool->deques[workerIdx], TRUE);
+        for (int i = 1; task == NULL && i < pool->threadNum; i++) {
+            task = takeTask(&pool->deques[(workerIdx + i) % pool->threadNum], FALSE);
+        }
+        if (task == NULL) {
+            // the remaining tasks are running, some of them may still spawn more
+            sched_yield();
+            continue;
+        }
+        pool->fWork(pool, workerIdx, task, pool->context);
+        __atomic_sub_fetch(&pool->pendingNum, 1, __ATOMIC_ACQ_REL);
+    }
+}
+
+
+static void* workerThread(void* arg) {
+    WorkPool* pool = ((WorkerArg*) arg)->pool;
+    int workerIdx = ((WorkerArg*) arg)->workerIdx;
+    unsigned long seenRunId = 0;
+    pthread_mutex_lock(&pool->lock);
+    while (1) {
+        while (!pool->stopping && pool->runId == seenRunId) {
+            pthread_cond_wait(&pool->runStarted, &pool->lock);
+        }
+        if (pool->stopping) {
+            break;
+        }
+        seenRunId = pool->runId;
+        pthread_mutex_unlock(&pool->lock);
+        runWorker(pool, workerIdx);
+        pthread_mutex_lock(&pool->lock);
+        if (-- pool->activeNum == 0) {
+            pthread_cond_signal(&pool->runFinished);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+
+/**
+ * @brief  Create a pool and start its threads
+ * @param  threadNum: number of workers including the thread calling workPoolRun, at least 1
+ */
+WorkPool* createWorkPool(int threadNum) {
+    assert(threadNum >= 1);
+    WorkPool* pool = (WorkPool*) malloc(sizeof(WorkPool));
+    assert(pool);
+    pool->threadNum = threadNum;
+    pool->deques = (WorkDeque*) malloc(threadNum * sizeof(WorkDeque));
+    assert(pool->deques);
+    for (int i = 0; i < threadNum; i++) {
+        WorkDeque* deque = &pool->deques[i];
+        pthread_mutex_init(&deque->lock, NULL);
+        deque->size = INITIAL_DEQUE_SIZE;
+        deque->tasks = (void**) malloc(deque->size * sizeof(void*));
+        assert(deque->tasks);
+        deque->head = deque->tail = deque->queuedNum = 0;
+    }
+    pthread_mutex_init(&pool->runLock, NULL);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->runStarted, NULL);
+    pthread_cond_init(&pool->runFinished, NULL);
+    pool->runId = 0;
+    pool->activeNum = 0;
+    pool->stopping = FALSE;
+    pool->fWork = NULL;
+    pool->context = NULL;
+    pool->pendingNum = 0;
+
+    pool->threads = (pthread_t*) malloc(threadNum * sizeof(pthread_t));
+    pool->args = (WorkerArg*) malloc(threadNum * sizeof(WorkerArg));
+    assert(pool->threads && pool->args);
+    for (int i = 1; i < threadNum; i++) {
+        pool->args[i].pool = pool;
+        pool->args[i].workerIdx = i;
+        int err = pthread_create(&pool->threads[i], NULL, workerThread, &pool->args[i]);
+        assert(err == 0);
+    }
+    return pool;
+}
+
+
+/**
+ * @brief  Run tasks on all workers and wait until they, and all the tasks they spawn, are done.
+ *         Runs from different threads take turns.
+ * @param  pool:
+ * @param  tasks:
+ * @param  taskNum:
+ * @param  fWork: called once for each task
+ * @param  context: passed to every call of fWork
+ */
+void workPoolRun(WorkPool* pool, void** tasks, int taskNum, WorkFunction fWork, void* context) {
+    if (taskNum <= 0) {
+        return;
+    }
+    pthread_mutex_lock(&pool->runLock);
+    pool->fWork = fWork;
+    pool->context = context;
+    __atomic_store_n(&pool->pendingNum, (size_t) taskNum, __ATOMIC_RELEASE);
+    for (int i = 0; i < taskNum; i++) {
+        pushTask(&pool->deques[i % pool->threadNum], tasks[i]);
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->runId ++;
+    pool->activeNum = pool->threadNum - 1;
+    pthread_cond_broadcast(&pool->runStarted);
+    pthread_mutex_unlock(&pool->lock);
+
+    runWorker(pool, 0);
+
+    // the context may be gone once this returns, so wait for every thread to leave the run
+    pthread_mutex_lock(&pool->lock);
+    while (pool->activeNum > 0) {
+        pthread_cond_wait(&pool->runFinished, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    pthread_mutex_unlock(&pool->runLock);
+}
+
+
+/**
+ * @brief  Add a task to the current run, from a task running on the given worker
+ */
+void workPoolSpawn(WorkPool* pool, int workerIdx, void* task) {
+    // counted before it is queued, so the run can't be seen as finished in between
+    __atomic_add_fetch(&pool->pendingNum, 1, __ATOMIC_ACQ_REL);
+    pushTask(&pool->deques[workerIdx], task);
+}
+
+
+/**
+ * @brief  Get the number of tasks waiting in the deque of a worker. It is read without locking,
+ *         so it is only a hint, e.g. for a task to decide whether to split.
+ */
+size_t getWorkPoolQueuedNum(WorkPool* pool, int workerIdx) {
+    return __atomic_load_n(&pool->deques[workerIdx].queuedNum, __ATOMIC_RELAXED);
+}
+
+
+/**
+ * @brief  Get the number of workers, including the thread calling workPoolRun
+ */
+int getWorkPoolThreadNum(WorkPool* pool) {
+    return pool->threadNum;
+}
+
+
+/**
+ * @brief  Stop the threads and free the pool. It must not be running.
+ */
+void freeWorkPool(WorkPool* pool) {
+    assert(pool);
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = TRUE;
+    pthread_cond_broadcast(&pool->runStarted);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 1; i < pool->threadNum; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    for (int i = 0; i < pool->threadNum; i++) {
+        pthread_mutex_destroy(&pool->deques[i].lock);
+        free(pool->deques[i].tasks);
+    }
+    pthread_mutex_destroy(&pool->runLock);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->runStarted);
+    pthread_cond_destroy(&pool->runFinished);
+    free(pool->deques);
+    free(pool->threads);
+    free(pool->args);
+    free(pool);
+}